@@ -14,6 +14,9 @@ extern "C" {
 #endif
 
 #include "TelnetSpy.h"
+#ifndef ESP8266
+#include <lwip/sockets.h>
+#endif
 
 #ifndef min
 #define min(a,b) ((a)<(b)?(a):(b))
@@ -55,6 +58,17 @@ TelnetSpy::TelnetSpy() {
 	waitRef = 0xFFFFFFFF; 
 	telnetBuf = NULL;
 	bufLen = 0;
+	bufUsed = 0;
+	bufWrCount = 0;
+	markHead = 0;
+	markTail = 0;
+	tailIdx = 0;
+	tailLen = 0;
+	serHead = 0;
+	serTail = 0;
+#ifndef ESP8266
+	serialMutex = NULL;   // created by begin()
+#endif
 	uint16_t size = TELNETSPY_BUFFER_LEN;
 	while (!setBufferSize(size)) {
 		size = size >> 1;
@@ -136,57 +150,32 @@ bool TelnetSpy::setBufferSize(uint16_t newSize) {
 		return true;
 	}
 	newSize = max(newSize, minBlockSize);
-	uint16_t oldBufLen = bufLen;
-	bufLen = newSize;
-	uint16_t tmp;
-	if (!telnetBuf || (bufUsed == 0)) {
-		bufRdIdx = 0;
-		bufWrIdx = 0;
-		bufUsed = 0;
-	} else {
-		if (bufLen < oldBufLen) {
-			if (bufRdIdx < bufWrIdx) {
-				if (bufWrIdx > bufLen) {
-					tmp = min(bufLen, (uint16_t) (bufWrIdx - max(bufLen, bufRdIdx)));
-					memcpy(telnetBuf, &telnetBuf[bufWrIdx - tmp], tmp);
-					bufWrIdx = tmp;
-					if (bufWrIdx > bufRdIdx) {
-						bufRdIdx = bufWrIdx;
-					} else {
-						if (bufRdIdx > bufLen) {
-							bufRdIdx = 0;
-						}
-					}
-					if (bufRdIdx == bufWrIdx) {
-						bufUsed = bufLen;
-					} else {
-						bufUsed = bufWrIdx - bufRdIdx;
-					}
-				}
-			} else {
-				if (bufWrIdx > bufLen) {
-					memcpy(telnetBuf, &telnetBuf[bufWrIdx - bufLen], bufLen);
-					bufRdIdx = 0;
-					bufWrIdx = 0;
-					bufUsed = bufLen;
-				} else {
-					tmp = min(bufLen - bufWrIdx, oldBufLen - bufRdIdx);
-					memcpy(&telnetBuf[bufLen - tmp], &telnetBuf[oldBufLen - tmp], tmp);
-					bufRdIdx = bufLen - tmp;
-					bufUsed = bufWrIdx + tmp;
-				}
-			}
-		}
-	}
-	char* temp = (char*) realloc(telnetBuf, bufLen);
+	char* temp = (char*) malloc(newSize);
 	if (!temp) {
 		return false;
 	}
+CRITCAL_SECTION_START
+	// preserve the youngest data, lined up at the start of the new buffer
+	uint16_t keep = 0;
+	if (telnetBuf) {
+		keep = min(bufUsed, newSize);
+		uint16_t idx = (bufWrIdx + bufLen - keep) % bufLen;
+		for (uint16_t i = 0; i < keep; i++) {
+			temp[i] = telnetBuf[idx++];
+			if (idx >= bufLen) {
+				idx = 0;
+			}
+		}
+	}
+	char* oldBuf = telnetBuf;
 	telnetBuf = temp;
-	if (telnetBuf && (bufLen > oldBufLen) && (bufRdIdx > bufWrIdx)) {
-		tmp = bufLen - (oldBufLen - bufRdIdx);
-		memcpy(&telnetBuf[tmp], &telnetBuf[bufRdIdx], oldBufLen - bufRdIdx);
-		bufRdIdx = tmp;
+	bufLen = newSize;
+	bufRdIdx = 0;
+	bufWrIdx = (keep < bufLen) ? keep : 0;
+	bufUsed = keep;        // bufWrCount is unchanged, so the line marks remain valid
+CRITCAL_SECTION_END
+	if (oldBuf) {
+		free(oldBuf);
 	}
 	if (telnetServer) {
 		telnetServer->setNoDelay(true);
@@ -223,36 +212,75 @@ void TelnetSpy::setSerial(HardwareSerial* usedSerial) {
 }
 
 size_t TelnetSpy::write (uint8_t data) {
+	return write(&data, 1);
+}
+
+size_t TelnetSpy::write (const uint8_t* data, size_t len) {
+	// never waits on the telnet client: handle() sends the buffered data
 	if (telnetBuf) {
-		if (storeOffline || client.connected()) {
-			if (bufUsed == bufLen) {
-				if (client.connected()) {
-					sendBlock();
-				}
-				if (bufUsed == bufLen) {
-					char c;
-					while (bufUsed > 0) {
-						c = pullTelnetBuf();
-						if (c == '\n') {
-							break;
-						}
-					}
-					if (peekTelnetBuf() == '\r') {
-						pullTelnetBuf();
-					}
-				}
-			}
-			addTelnetBuf(data);
+		if (storeOffline || connected) {
+			addTelnetBuf(data, len);
 		}
 	} else {
-		if (client.connected()) {
-			client.write(data);
+		if (connected) {
+			client.write(data, len);
 		}
 	}
 	if (usedSer) {
-		return usedSer->write(data);
+		writeSerial(data, len);
+	}
+	return len;
+}
+
+void TelnetSpy::writeSerial(const uint8_t* data, size_t len) {
+SERIAL_SECTION_START
+	drainSerial(false);  // older data must go first
+	if (serHead == serTail) {
+		// nothing held back, straight into the UART FIFO as far as it will go
+		int room = usedSer->availableForWrite();
+		if (room > 0) {
+			size_t n = min(len, (size_t) room);
+			usedSer->write(data, n);
+			data += n;
+			len -= n;
+		}
+	}
+	while (len) {
+		uint16_t used = (uint16_t) (serHead - serTail);
+		if (used == TELNETSPY_SERIAL_BACKLOG) {
+			drainSerial(true);   // backlog is full, only now wait for the UART
+			continue;
+		}
+		uint16_t idx = serHead & (TELNETSPY_SERIAL_BACKLOG - 1);
+		size_t n = min(len, (size_t) (TELNETSPY_SERIAL_BACKLOG - used));
+		n = min(n, (size_t) (TELNETSPY_SERIAL_BACKLOG - idx));
+		memcpy(&serBuf[idx], data, n);
+		serHead += n;
+		data += n;
+		len -= n;
+	}
+SERIAL_SECTION_END
+}
+
+// move the serial backlog into the UART FIFO
+// if <wait>, block until at least one chunk has been written
+void TelnetSpy::drainSerial(bool wait) {
+	while (serHead != serTail) {
+		uint16_t idx = serTail & (TELNETSPY_SERIAL_BACKLOG - 1);
+		size_t n = min((size_t) (uint16_t) (serHead - serTail), (size_t) (TELNETSPY_SERIAL_BACKLOG - idx));
+		if (!wait) {
+			int room = usedSer->availableForWrite();
+			if (room <= 0) {
+				return;
+			}
+			n = min(n, (size_t) room);
+		}
+		usedSer->write(&serBuf[idx], n);
+		serTail += n;
+		if (wait) {
+			return;
+		}
 	}
-	return 1;
 }
     
 int TelnetSpy::available (void) {
@@ -302,6 +330,11 @@ int TelnetSpy::peek (void) {
     
 void TelnetSpy::flush (void) {
 	if (usedSer) {
+SERIAL_SECTION_START
+		while (serHead != serTail) {
+			drainSerial(true);
+		}
+SERIAL_SECTION_END
 		usedSer->flush();
 	}
 }
@@ -318,6 +351,9 @@ void TelnetSpy::begin(unsigned long baud, SerialConfig config, SerialMode mode,
 #else // ESP32
 
 void TelnetSpy::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin, bool invert) {
+	if (!serialMutex) {
+		serialMutex = xSemaphoreCreateMutex();
+	}
 	if (usedSer) {
 		usedSer->begin(baud, config, rxPin, txPin, invert);
 	}
@@ -331,6 +367,7 @@ void TelnetSpy::end() {
 		setDebugOutput(false);
 	}
 	if (usedSer) {
+		flush();     // serial backlog
 		usedSer->end();
 	}
 	if (client.connected()) {
@@ -428,7 +465,23 @@ uint32_t TelnetSpy::baudRate(void) {
 	return 115200;
 }
 
-void TelnetSpy::sendBlock() {
+// send the rest of a part sent line, else the oldest contiguous block of
+// buffered data, but only as much as the socket accepts right now.
+// Returns true if anything was sent.
+bool TelnetSpy::sendBlock() {
+	if (tailLen) {
+#ifdef ESP8266
+		int sent = client.write(&lineTail[tailIdx], tailLen);
+#else
+		int sent = send(client.fd(), &lineTail[tailIdx], tailLen, MSG_DONTWAIT);
+#endif
+		if (sent <= 0) {
+			return false;
+		}
+		tailIdx += sent;
+		tailLen -= sent;
+		return true;
+	}
 CRITCAL_SECTION_START
 	uint16_t len = bufUsed;
 	if (len > maxBlockSize) {
@@ -436,14 +489,30 @@ CRITCAL_SECTION_START
 	}
 	len = min(len, (uint16_t) (bufLen - bufRdIdx));
 	uint16_t idx = bufRdIdx;
+	uint32_t rdCount = bufWrCount - bufUsed;
 CRITCAL_SECTION_END
-	client.write(&telnetBuf[idx], len);
+	if (len == 0) {
+		return false;
+	}
+#ifdef ESP8266
+	int sent = client.write(&telnetBuf[idx], len);
+#else
+	int sent = send(client.fd(), &telnetBuf[idx], len, MSG_DONTWAIT);
+#endif
+	if (sent <= 0) {
+		return false;    // socket is full (or closed), try again next handle()
+	}
 CRITCAL_SECTION_START
-	bufRdIdx += len;
-	if (bufRdIdx >= bufLen) {
-		bufRdIdx = 0;
+	// a writer may have dropped lines whilst we were sending
+	int32_t done = rdCount + sent - (bufWrCount - bufUsed);
+	if (done > 0) {
+		bufRdIdx += done;
+		if (bufRdIdx >= bufLen) {
+			bufRdIdx -= bufLen;
+		}
+		bufUsed -= done;
+		holdLineTail();
 	}
-	bufUsed -= len;
 	if (bufUsed == 0) {
 		bufRdIdx = 0;
 		bufWrIdx = 0;
@@ -456,49 +525,89 @@ CRITCAL_SECTION_END
 			pingRef -= 0x80000000;
 		}
 	}
+	return true;
+}
+
+// a block which ended part way through a line leaves the rest of that line
+// in lineTail, to be sent next. Dropping old lines from the ring buffer then
+// cannot splice the start of one line onto a later one.
+// must be called inside the critical section
+void TelnetSpy::holdLineTail() {
+	uint32_t rdCount = bufWrCount - bufUsed;
+	// forget the line starts already sent
+	while ((markHead != markTail) && ((int32_t) (lineMarks[markTail & (TELNETSPY_LINE_MARKS - 1)] - rdCount) < 0)) {
+		markTail++;
+	}
+	if (markHead == markTail) {
+		return;    // the line is still being written
+	}
+	uint32_t len = lineMarks[markTail & (TELNETSPY_LINE_MARKS - 1)] - rdCount;
+	if ((len == 0) || (len > TELNETSPY_LINE_TAIL)) {
+		return;    // at a line start, or a line too long to hold
+	}
+	uint16_t n = min(len, (uint32_t) (bufLen - bufRdIdx));
+	memcpy(lineTail, &telnetBuf[bufRdIdx], n);
+	memcpy(&lineTail[n], telnetBuf, len - n);
+	tailIdx = 0;
+	tailLen = len;
+	bufRdIdx += len;
+	if (bufRdIdx >= bufLen) {
+		bufRdIdx -= bufLen;
+	}
+	bufUsed -= len;
 }
 
-void TelnetSpy::addTelnetBuf(char c) {
+void TelnetSpy::addTelnetBuf(const uint8_t* data, size_t len) {
+	if (len > bufLen) {
+		// only the youngest data can be kept
+		data += len - bufLen;
+		len = bufLen;
+	}
 CRITCAL_SECTION_START
-	telnetBuf[bufWrIdx] = c;
-	if (bufUsed == bufLen) {
-		bufRdIdx++;
-		if (bufRdIdx >= bufLen) {
-			bufRdIdx = 0;
+	if (bufUsed + len > bufLen) {
+		dropLines(bufUsed + len - bufLen);
+	}
+	// remember where each new line starts
+	const uint8_t* pEnd = data + len;
+	for (const uint8_t* p = data; (p = (const uint8_t*) memchr(p, '\n', pEnd - p)) != NULL; ) {
+		p++;
+		if ((uint16_t) (markHead - markTail) == TELNETSPY_LINE_MARKS) {
+			markTail++;   // forget the oldest, it merely makes the next drop bigger
 		}
-	} else {
-		bufUsed++;
+		lineMarks[markHead++ & (TELNETSPY_LINE_MARKS - 1)] = bufWrCount + (p - data);
 	}
-	bufWrIdx++;
+	uint16_t n = min(len, (size_t) (bufLen - bufWrIdx));
+	memcpy(&telnetBuf[bufWrIdx], data, n);
+	memcpy(telnetBuf, data + n, len - n);
+	bufWrIdx += len;
 	if (bufWrIdx >= bufLen) {
-		bufWrIdx = 0;
+		bufWrIdx -= bufLen;
 	}
+	bufUsed += len;
+	bufWrCount += len;
 CRITCAL_SECTION_END
 }
 
-char TelnetSpy::pullTelnetBuf() {
-	if (bufUsed == 0) {
-		return 0;
+// discard the oldest whole lines to make room for <len> more bytes
+// the line marks make this O(1) per line, rather than a byte by byte search
+// must be called inside the critical section
+void TelnetSpy::dropLines(size_t len) {
+	uint32_t rdCount = bufWrCount - bufUsed;
+	uint32_t target = rdCount + len;
+	uint32_t newRd = bufWrCount;   // if no line starts beyond target, everything goes
+	while (markHead != markTail) {
+		uint32_t mark = lineMarks[markTail++ & (TELNETSPY_LINE_MARKS - 1)];
+		if ((int32_t) (mark - target) >= 0) {
+			newRd = mark;
+			break;
+		}
 	}
-CRITCAL_SECTION_START
-	char c = telnetBuf[bufRdIdx++]; 
+	uint16_t drop = newRd - rdCount;
+	bufRdIdx += drop;
 	if (bufRdIdx >= bufLen) {
-		bufRdIdx = 0;
+		bufRdIdx -= bufLen;
 	}
-	bufUsed--;
-CRITCAL_SECTION_END
-	return c;
-}
-
-char TelnetSpy::peekTelnetBuf() {
-	if (bufUsed == 0) {
-		return 0;
-	}
-CRITCAL_SECTION_START
-char c = telnetBuf[bufRdIdx]; 
-CRITCAL_SECTION_END
-//	return telnetBuf[bufRdIdx]; 
-return c;
+	bufUsed -= drop;
 }
 
 int TelnetSpy::telnetAvailable() {
@@ -541,6 +650,11 @@ void TelnetSpy::handle() {
 			setDebugOutput(true);
 		}
 	}
+	if (usedSer) {
+SERIAL_SECTION_START
+		drainSerial(false);
+SERIAL_SECTION_END
+	}
 	if (!started) {
 		return;
 	}
@@ -591,15 +705,16 @@ void TelnetSpy::handle() {
             client.stop();
 			pingRef = 0xFFFFFFFF;
 			waitRef = 0xFFFFFFFF; 
+			tailLen = 0;
 			if (callbackDisconnect != NULL) {
 				callbackDisconnect();
 			}
 		}
 	}
 	
-	if (client.connected() && (bufUsed > 0)) {
-		if (bufUsed >= minBlockSize) {
-			sendBlock();
+	if (client.connected() && ((bufUsed > 0) || (tailLen > 0))) {
+		if ((bufUsed >= minBlockSize) || (tailLen > 0)) {
+			while ((bufUsed || tailLen) && sendBlock());   // as much as the socket will take
 		} else {
 			unsigned long m = millis() & 0x7FFFFFF;
 			if (waitRef == 0xFFFFFFFF) {
@@ -617,7 +732,8 @@ void TelnetSpy::handle() {
 	if (client.connected() && (pingRef != 0xFFFFFFFF)) {
 		unsigned long m = millis() & 0x7FFFFFF;
 		if (!((pingRef < 0x20000000) && (m > 0x60000000)) && (m >= pingRef)) {
-			addTelnetBuf(0);
+			static const uint8_t ping = 0;
+			addTelnetBuf(&ping, 1);
 			sendBlock();
 		}
 	}
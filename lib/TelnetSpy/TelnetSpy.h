@@ -134,6 +134,12 @@
  * Transfering data also via telnet will need more performance than the serial
  * port only. So time critical things may be influenced.
  *
+ * Writing only copies the data into the ring buffer: telnet blocks are sent
+ * by handle() without waiting on the socket, and serial data that does not fit
+ * the UART FIFO is held in a backlog which handle() (or the next write) moves
+ * on. When the ring buffer is full the oldest whole lines are dropped, a line
+ * which is part sent is always completed.
+ *
  * It is not possible to establish more than one telnet connection at the same
  * time. But its possible to use more than one instance of TelnetSpy.
  *
@@ -160,6 +166,9 @@
 #define TELNETSPY_CAPTURE_OS_PRINT true
 #define TELNETSPY_WELCOME_MSG "Connection established via TelnetSpy.\r\n"
 #define TELNETSPY_REJECT_MSG "TelnetSpy: Only one connection possible.\r\n"
+#define TELNETSPY_LINE_MARKS 128         // line starts remembered for dropping old lines, power of 2
+#define TELNETSPY_SERIAL_BACKLOG 1024    // serial data waiting for room in the UART FIFO, power of 2
+#define TELNETSPY_LINE_TAIL 256          // rest of a part sent line, held out of the ring buffer
 
 
 #ifdef ESP8266
@@ -168,6 +177,8 @@
 #define CRITCAL_SECTION_MUTEX
 #define CRITCAL_SECTION_START
 #define CRITCAL_SECTION_END
+#define SERIAL_SECTION_START
+#define SERIAL_SECTION_END
 #else // ESP32
 #include <WiFi.h>
 // add spinlock for ESP32
@@ -175,6 +186,9 @@
 // Non-static Data Member Initializers, see: https://web.archive.org/web/20160316174223/https://blogs.oracle.com/pcarlini/entry/c_11_tidbits_non_static
 #define CRITCAL_SECTION_START portENTER_CRITICAL(&AtomicMutex);
 #define CRITCAL_SECTION_END portEXIT_CRITICAL(&AtomicMutex);
+// serial output may block (on the UART driver's lock), so cannot use the spinlock
+#define SERIAL_SECTION_START if (serialMutex) xSemaphoreTake(serialMutex, portMAX_DELAY);
+#define SERIAL_SECTION_END if (serialMutex) xSemaphoreGive(serialMutex);
 #endif
 #include <WiFiClient.h>
 
@@ -222,6 +236,7 @@ class TelnetSpy : public Stream {
 		int availableForWrite(void);
 		void flush(void) override;
 		size_t write(uint8_t) override;
+		size_t write(const uint8_t* data, size_t len) override;
 		inline size_t write(unsigned long n) { return write((uint8_t) n); }
 		inline size_t write(long n) { return write((uint8_t) n); }
 		inline size_t write(unsigned int n) { return write((uint8_t) n); }
@@ -233,10 +248,12 @@ class TelnetSpy : public Stream {
 
 	protected:
 		CRITCAL_SECTION_MUTEX
-		void sendBlock(void);
-		void addTelnetBuf(char c);
-		char pullTelnetBuf();
-		char peekTelnetBuf();
+		bool sendBlock(void);
+		void addTelnetBuf(const uint8_t* data, size_t len);
+		void dropLines(size_t len);
+		void holdLineTail(void);
+		void writeSerial(const uint8_t* data, size_t len);
+		void drainSerial(bool wait);
 		int telnetAvailable();
 		WiFiServer* telnetServer;
 		WiFiClient client;
@@ -260,6 +277,19 @@ class TelnetSpy : public Stream {
 		uint16_t bufUsed;
 		uint16_t bufRdIdx;
 		uint16_t bufWrIdx;
+		uint32_t bufWrCount;                         // total bytes ever written to telnetBuf
+		uint32_t lineMarks[TELNETSPY_LINE_MARKS];    // bufWrCount at the start of each buffered line
+		uint16_t markHead;
+		uint16_t markTail;
+		uint8_t lineTail[TELNETSPY_LINE_TAIL];
+		uint16_t tailIdx;
+		uint16_t tailLen;
+		uint8_t serBuf[TELNETSPY_SERIAL_BACKLOG];
+		uint16_t serHead;
+		uint16_t serTail;
+#ifndef ESP8266
+		SemaphoreHandle_t serialMutex;
+#endif
 		bool connected;
 		void (*callbackConnect)();
 		void (*callbackDisconnect)();
@@ -493,66 +493,91 @@ void Adafruit_SH1106::sh1106_data(uint8_t c) {
 }
 
 void Adafruit_SH1106::display(void) {
-  if (sid != -1)
-  {
-
-  	for (int8_t i = (SH1106_LCDHEIGHT/8)-1; i >= 0; i--)
-  	{
-      sh1106_command(0xB0 + i);		// Set row
-      sh1106_command(SH1106_SETLOWCOLUMN);		// Set lower column address
-      sh1106_command(SH1106_SETHIGHCOLUMN); // Set higher column address
-      
-      // SPI
-      *csport |= cspinmask;
-      *dcport |= dcpinmask;
-      *csport &= ~cspinmask;
-    
-      for (uint16_t j = SH1106_LCDWIDTH; j > 0; j--)
-      {
-  		  fastSPIwrite(buffer[i*SH1106_LCDWIDTH+SH1106_LCDWIDTH-j]);
-      }
-      
-      *csport |= cspinmask;
-  	}
-  }
-  else
-  {
-    // save I2C bitrate
 #ifndef ESP32
 #ifndef __SAM3X8E__
-    uint8_t twbrbackup = TWBR;
-    TWBR = 12; // upgrade to 400KHz!
+  // save I2C bitrate
+  uint8_t twbrbackup = TWBR;
+  TWBR = 12; // upgrade to 400KHz!
 #endif
 #endif
-    //Serial.println(TWBR, DEC);
-    //Serial.println(TWSR & 0x3, DEC);
 
-    // I2C
-  	for (int8_t i = (SH1106_LCDHEIGHT/8)-1; i >= 0; i--)
-  	{
-      sh1106_command(0xB0 + i);		// Set row
-      sh1106_command(SH1106_SETLOWCOLUMN);		// Set lower column address
-      sh1106_command(SH1106_SETHIGHCOLUMN); // Set higher column address
-      
-      for (uint16_t j = SH1106_LCDWIDTH; j > 0; j--)
-      {
-        // send a bunch of data in one xmission
-        Wire.beginTransmission(_i2caddr);
-        WIRE_WRITE(0x40);
-        for (uint8_t x=0; x<16; x++) {
-          WIRE_WRITE(buffer[i*SH1106_LCDWIDTH+SH1106_LCDWIDTH-j]);
-          j--;
-        }
-        j++;
-        Wire.endTransmission();
-      }
-    }
+  for (int8_t i = (SH1106_LCDHEIGHT/8)-1; i >= 0; i--)
+  {
+    displayPage(i, 0, SH1106_LCDWIDTH);
+  }
+
 #ifndef ESP32
 #ifndef __SAM3X8E__
-    TWBR = twbrbackup;
+  TWBR = twbrbackup;
 #endif
 #endif
+}
+
+// send a span of one page (8 pixel rows) of the framebuffer to the panel
+// pFrame may supply an alternate frame, eg a snapshot, laid out as per the framebuffer
+// returns the number of bytes placed onto the bus
+int Adafruit_SH1106::displayPage(uint8_t page, uint8_t col, uint8_t len, const uint8_t* pFrame) {
+  if(page >= SH1106_LCDHEIGHT/8 || col >= SH1106_LCDWIDTH)
+    return 0;
+  if(len > SH1106_LCDWIDTH - col)
+    len = SH1106_LCDWIDTH - col;
+
+  // SH1106 RAM is 132 wide, the glass starts at column SH1106_SETLOWCOLUMN
+  uint8_t ramcol = col + SH1106_SETLOWCOLUMN;
+  if(pFrame == NULL)
+    pFrame = buffer;
+  const uint8_t* pData = &pFrame[page*SH1106_LCDWIDTH + col];
+  int bytes = 0;
+
+  if (sid != -1)
+  {
+    sh1106_command(0xB0 + page);                          // Set row
+    sh1106_command(ramcol & 0x0f);                        // Set lower column address
+    sh1106_command(SH1106_SETHIGHCOLUMN | (ramcol >> 4)); // Set higher column address
+
+    // SPI
+    *csport |= cspinmask;
+    *dcport |= dcpinmask;
+    *csport &= ~cspinmask;
+
+    for (uint8_t j = 0; j < len; j++)
+    {
+      fastSPIwrite(pData[j]);
+    }
+
+    *csport |= cspinmask;
+    bytes = 3 + len;
+  }
+  else
+  {
+    // I2C - all three addressing commands in the one transmission
+    Wire.beginTransmission(_i2caddr);
+    WIRE_WRITE(0x00);                                     // Co = 0, D/C = 0
+    WIRE_WRITE(0xB0 + page);                              // Set row
+    WIRE_WRITE(ramcol & 0x0f);                            // Set lower column address
+    WIRE_WRITE(SH1106_SETHIGHCOLUMN | (ramcol >> 4));     // Set higher column address
+    Wire.endTransmission();
+    bytes += 5;
+
+    while (len)
+    {
+      // send a bunch of data in one xmission
+      uint8_t chunk = len > SH1106_I2C_CHUNK ? SH1106_I2C_CHUNK : len;
+      Wire.beginTransmission(_i2caddr);
+      WIRE_WRITE(0x40);                                   // Co = 0, D/C = 1
+      for (uint8_t x = 0; x < chunk; x++) {
+        WIRE_WRITE(*pData++);
+      }
+      Wire.endTransmission();
+      bytes += 2 + chunk;
+      len -= chunk;
+    }
   }
+  return bytes;
+}
+
+uint8_t* Adafruit_SH1106::getBuffer(void) {
+  return buffer;
 }
 
 // clear everything
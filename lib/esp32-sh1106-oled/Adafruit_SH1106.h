@@ -104,6 +104,13 @@ All text above, and the splash screen must be included in any redistribution
 #define SH1106_SETLOWCOLUMN 0x02 //to use with SSD1306, set to 0x00
 #define SH1106_SETHIGHCOLUMN 0x10
 
+// data bytes per I2C transmission - AVR Wire buffers are only 32 bytes
+#ifdef ESP32
+#define SH1106_I2C_CHUNK 64
+#else
+#define SH1106_I2C_CHUNK 16
+#endif
+
 #define SH1106_SETSTARTLINE 0x40
 
 #define SH1106_MEMORYMODE 0x20
@@ -144,6 +151,8 @@ class Adafruit_SH1106 : public Adafruit_GFX {
   void clearDisplay(void);
   void invertDisplay(uint8_t i);
   void display();
+  int  displayPage(uint8_t page, uint8_t col, uint8_t len, const uint8_t* pFrame = NULL);
+  uint8_t* getBuffer(void);
 
   void startscrollright(uint8_t start, uint8_t stop);
   void startscrollleft(uint8_t start, uint8_t stop);
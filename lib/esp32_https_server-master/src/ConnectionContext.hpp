@@ -11,6 +11,7 @@
 namespace httpsserver {
 
 class WebsocketHandler;
+class EventStreamHandler;
 
 /**
  * \brief Internal class to handle the state of a connection
@@ -28,9 +29,11 @@ public:
   virtual size_t pendingBufferSize() = 0;
 
   virtual size_t writeBuffer(byte* buffer, size_t length) = 0;
+  virtual bool canWriteData() = 0;
 
   virtual bool isSecure() = 0;
   virtual void setWebsocketHandler(WebsocketHandler *wsHandler);
+  virtual void setEventStreamHandler(EventStreamHandler *esHandler) = 0;
   virtual IPAddress getClientIP() = 0;
 
   WebsocketHandler * _wsHandler;
@@ -0,0 +1,51 @@
+#include "EventStreamHandler.hpp"
+
+namespace httpsserver {
+
+EventStreamHandler::EventStreamHandler() {
+  _con = nullptr;
+  _closed = false;
+}
+
+EventStreamHandler::~EventStreamHandler() {
+
+}
+
+void EventStreamHandler::initialize(ConnectionContext * con) {
+  _con = con;
+}
+
+void EventStreamHandler::loop() {
+
+}
+
+void EventStreamHandler::onClose() {
+
+}
+
+bool EventStreamHandler::send(const char* data, size_t length) {
+  if (_closed || _con == nullptr) {
+    return false;
+  }
+  size_t written = _con->writeBuffer((byte*)data, length);
+  if (written != length) {
+    HTTPS_LOGW("Event stream write failed, closing");
+    _closed = true;
+    return false;
+  }
+  return true;
+}
+
+bool EventStreamHandler::canSend() {
+  return !_closed && _con != nullptr && _con->canWriteData();
+}
+
+void EventStreamHandler::close() {
+  _closed = true;
+}
+
+bool EventStreamHandler::closed() {
+  return _closed;
+}
+
+} /* namespace httpsserver */
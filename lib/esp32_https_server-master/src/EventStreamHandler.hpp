@@ -0,0 +1,60 @@
+#ifndef SRC_EVENTSTREAMHANDLER_HPP_
+#define SRC_EVENTSTREAMHANDLER_HPP_
+
+#include <Arduino.h>
+
+#include "HTTPSServerConstants.hpp"
+#include "ConnectionContext.hpp"
+
+namespace httpsserver {
+
+/**
+ * \brief Handler for a Server-Sent Events (text/event-stream) connection
+ * 
+ * A resource callback hands an instance to HTTPResponse::startEventStream(). The connection
+ * then stays open and loop() is called on every pass of the server, so events can be pushed
+ * from there. Anything the client sends is discarded. The server deletes the handler once
+ * the stream has been closed by either side.
+ */
+class EventStreamHandler {
+public:
+  EventStreamHandler();
+  virtual ~EventStreamHandler();
+
+  /**
+   * \brief Called on every server loop() pass whilst the stream is open
+   */
+  virtual void loop();
+
+  /**
+   * \brief Called once the client has gone, or the server is closing the connection
+   */
+  virtual void onClose();
+
+  /**
+   * \brief Writes raw event stream text, eg. "data: {...}\n\n"
+   * 
+   * Returns false if the data could not be written completely.
+   */
+  bool send(const char* data, size_t length);
+
+  /**
+   * \brief True if the client's socket will take more data without blocking
+   * 
+   * Check before sending, so one slow client cannot stall the server.
+   */
+  bool canSend();
+
+  void close();
+  bool closed();
+
+  void initialize(ConnectionContext * con);
+
+private:
+  ConnectionContext * _con;
+  bool _closed;
+};
+
+} /* namespace httpsserver */
+
+#endif /* SRC_EVENTSTREAMHANDLER_HPP_ */
@@ -18,6 +18,7 @@ HTTPConnection::HTTPConnection(ResourceResolver * resResolver):
   _lastTransmissionTS = millis();
   _shutdownTS = 0;
   _wsHandler = nullptr;
+  _esHandler = nullptr;
 }
 
 HTTPConnection::~HTTPConnection() {
@@ -142,6 +143,13 @@ void HTTPConnection::closeConnection() {
     delete _wsHandler;
     _wsHandler = NULL;
   }
+
+  if (_esHandler != nullptr) {
+    HTTPS_LOGD("Free event stream Handler");
+    _esHandler->onClose();
+    delete _esHandler;
+    _esHandler = NULL;
+  }
 }
 
 /**
@@ -236,6 +244,25 @@ bool HTTPConnection::canReadData() {
   return FD_ISSET(_socket, &sockfds);
 }
 
+bool HTTPConnection::canWriteData() {
+  fd_set sockfds;
+  FD_ZERO( &sockfds );
+  FD_SET(_socket, &sockfds);
+
+  // We define an immediate timeout (return immediately, if the socket cannot take data)
+  timeval timeout;
+  timeout.tv_sec  = 0;
+  timeout.tv_usec = 0;
+
+  select(_socket + 1, NULL, &sockfds, NULL, &timeout);
+
+  return FD_ISSET(_socket, &sockfds);
+}
+
+void HTTPConnection::setEventStreamHandler(EventStreamHandler *esHandler) {
+  _esHandler = esHandler;
+}
+
 size_t HTTPConnection::readBuffer(byte* buffer, size_t length) {
   updateBuffer();
   size_t bufferSize = _bufferUnusedIdx - _bufferProcessed;
@@ -522,6 +549,10 @@ void HTTPConnection::loop() {
             _wsHandler = ((WebsocketNode*)resolvedResource.getMatchingNode())->newHandler();
             _wsHandler->initialize(this);  // make websocket with this connection 
             _connectionState = STATE_WEBSOCKET;
+          } else if (_esHandler != nullptr) {
+            // The callback started an event stream, the connection stays open for it
+            HTTPS_LOGD("Event stream started, FID=%d", _socket);
+            _connectionState = STATE_EVENTSTREAM;
           } else {
             // Handling the request is done
             HTTPS_LOGD("Handler function done, request complete");
@@ -595,6 +626,26 @@ void HTTPConnection::loop() {
         _connectionState = STATE_CLOSING;
       }
       break;
+    case STATE_EVENTSTREAM: // Feed the event stream
+      refreshTimeout();  // don't timeout event stream connection
+      if(pendingBufferSize() > 0) {
+        // The client has nothing to say on an event stream, drop it
+        _bufferProcessed = _bufferUnusedIdx;
+      }
+
+      if (_clientState != CSTATE_CLOSED) {
+        _esHandler->loop();
+      }
+
+      // If the client or the handler has closed the stream, clean up and close the socket too
+      if (_esHandler->closed() || _clientState == CSTATE_CLOSED) {
+        HTTPS_LOGI("Event stream closed, freeing Handler, FID=%d", _socket);
+        _esHandler->onClose();
+        delete _esHandler;
+        _esHandler = nullptr;
+        _connectionState = STATE_CLOSING;
+      }
+      break;
     default:;
     }
   }
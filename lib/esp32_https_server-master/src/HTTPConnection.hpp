@@ -29,6 +29,7 @@
 
 #include "WebsocketHandler.hpp"
 #include "WebsocketNode.hpp"
+#include "EventStreamHandler.hpp"
 
 namespace httpsserver {
 
@@ -57,7 +58,9 @@ protected:
   virtual size_t writeBuffer(byte* buffer, size_t length);
   virtual size_t readBytesToBuffer(byte* buffer, size_t length);
   virtual bool canReadData();
+  virtual bool canWriteData();
   virtual size_t pendingByteCount();
+  virtual void setEventStreamHandler(EventStreamHandler *esHandler);
 
   // Timestamp of the last transmission action
   unsigned long _lastTransmissionTS;
@@ -94,6 +97,8 @@ protected:
     STATE_BODY_FINISHED,
     // The connection is in websocket mode
     STATE_WEBSOCKET,
+    // The response is a Server-Sent Events stream, kept open and fed by an EventStreamHandler
+    STATE_EVENTSTREAM,
     // The connection is about to close (and waiting for the client to send close notify)
     STATE_CLOSING,
     // The connection has been closed
@@ -160,6 +165,9 @@ private:
   //Websocket connection
   WebsocketHandler * _wsHandler;
 
+  // Server-Sent Events stream
+  EventStreamHandler * _esHandler;
+
 };
 
 void handleWebsocketHandshake(HTTPRequest * req, HTTPResponse * res);
@@ -103,6 +103,18 @@ size_t  HTTPResponse::write(uint8_t b) {
   return writeBytesInternal(ba, 1);
 }
 
+/**
+ * Sends the event stream headers and hands the connection over to the handler
+ */
+void HTTPResponse::startEventStream(EventStreamHandler * handler) {
+  setHeader("Content-Type", "text/event-stream");
+  setHeader("Cache-Control", "no-cache");
+  setHeader("Connection", "keep-alive");
+  printHeader();
+  handler->initialize(_con);
+  _con->setEventStreamHandler(handler);
+}
+
 /**
  *  If not already done, writes the header.
  */
@@ -16,6 +16,7 @@
 #include "ConnectionContext.hpp"
 #include "HTTPHeaders.hpp"
 #include "HTTPHeader.hpp"
+#include "EventStreamHandler.hpp"
 
 namespace httpsserver {
 
@@ -46,6 +47,15 @@ public:
   bool isResponseBuffered();
   void finalize();
 
+  /**
+   * \brief Turns this response into a Server-Sent Events stream
+   * 
+   * Writes the text/event-stream headers immediately. Once the resource callback returns,
+   * the connection stays open and the handler's loop() is called on every server pass.
+   * The server takes ownership of the handler.
+   */
+  void startEventStream(EventStreamHandler * handler);
+
   ConnectionContext * _con;
   
 private:
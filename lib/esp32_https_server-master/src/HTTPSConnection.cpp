@@ -2,6 +2,7 @@
 
 namespace httpsserver {
 
+HTTPSHandshakeStats HTTPSConnection::_handshakeStats = { 0, 0, 0, 0 };
 
 HTTPSConnection::HTTPSConnection(ResourceResolver * resResolver):
   HTTPConnection(resResolver) {
@@ -17,6 +18,14 @@ bool HTTPSConnection::isSecure() {
   return true;
 }
 
+const HTTPSHandshakeStats& HTTPSConnection::getHandshakeStats() {
+  return _handshakeStats;
+}
+
+void HTTPSConnection::resetHandshakeStats() {
+  memset(&_handshakeStats, 0, sizeof(_handshakeStats));
+}
+
 /**
  * Initializes the connection from a server socket.
  *
@@ -40,10 +49,19 @@ int HTTPSConnection::initialize(int serverSocketID, SSL_CTX * sslCtx, HTTPHeader
         if (success) {
 
           // Perform the handshake
+          unsigned long tStart = micros();
           success = SSL_accept(_ssl);
+          uint32_t tHandshake = micros() - tStart;
           if (success) {
+            _handshakeStats.count++;
+            _handshakeStats.totalUs += tHandshake;
+            if (tHandshake > _handshakeStats.maxUs) {
+              _handshakeStats.maxUs = tHandshake;
+            }
+            HTTPS_LOGD("SSL_accept took %u us. FID=%d", tHandshake, resSocket);
             return resSocket;
           } else {
+            _handshakeStats.failed++;
             HTTPS_LOGE("SSL_accept failed. Aborting handshake. FID=%d", resSocket);
           }
         } else {
@@ -26,6 +26,20 @@
 
 namespace httpsserver {
 
+/**
+ * \brief Accumulated TLS handshake timing, shared by all HTTPSConnections
+ */
+struct HTTPSHandshakeStats {
+  /** \brief Handshakes that completed */
+  uint32_t count;
+  /** \brief Handshakes that failed */
+  uint32_t failed;
+  /** \brief Total time spent in SSL_accept() for completed handshakes, in microseconds */
+  uint64_t totalUs;
+  /** \brief Longest completed handshake, in microseconds */
+  uint32_t maxUs;
+};
+
 /**
  * \brief Connection class for an open TLS-enabled connection to an HTTPSServer
  */
@@ -38,6 +52,12 @@ public:
   virtual void closeConnection();
   virtual bool isSecure();
 
+  /**
+   * \brief Returns the handshake timing collected since boot or the last reset
+   */
+  static const HTTPSHandshakeStats& getHandshakeStats();
+  static void resetHandshakeStats();
+
 protected:
   friend class HTTPRequest;
   friend class HTTPResponse;
@@ -51,6 +71,8 @@ private:
   // SSL context for this connection
   SSL * _ssl;
 
+  static HTTPSHandshakeStats _handshakeStats;
+
 };
 
 } /* namespace httpsserver */
@@ -87,9 +87,11 @@ uint8_t HTTPSServer::setupCert() {
     _cert->getCertData()
   );
 
-  // Then set the private key accordingly
+  // Then set the private key accordingly. The key type is taken from the DER
+  // data itself, so both RSA and EC keys are accepted
   if (ret) {
-    ret = SSL_CTX_use_RSAPrivateKey_ASN1(
+    ret = SSL_CTX_use_PrivateKey_ASN1(
+      0,
       _sslctx,
       _cert->getPKData(),
       _cert->getPKLength()
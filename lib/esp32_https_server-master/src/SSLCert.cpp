@@ -81,7 +81,8 @@ static int gen_key(SSLCert &certCtx, SSLKeySize keySize) {
   // Initialize the private key
   mbedtls_pk_context key;
   mbedtls_pk_init( &key );
-  int resPkSetup = mbedtls_pk_setup( &key, mbedtls_pk_info_from_type( MBEDTLS_PK_RSA ) );
+  mbedtls_pk_type_t pkType = (keySize == KEYSIZE_EC_P256) ? MBEDTLS_PK_ECKEY : MBEDTLS_PK_RSA;
+  int resPkSetup = mbedtls_pk_setup( &key, mbedtls_pk_info_from_type( pkType ) );
   if ( resPkSetup != 0) {
     mbedtls_ctr_drbg_free( &ctr_drbg );
     mbedtls_entropy_free( &entropy );
@@ -89,13 +90,23 @@ static int gen_key(SSLCert &certCtx, SSLKeySize keySize) {
   }
 
   // Actual key generation 
-  int resPkGen = mbedtls_rsa_gen_key(
-    mbedtls_pk_rsa( key ),
-    mbedtls_ctr_drbg_random,
-    &ctr_drbg,
-    keySize,
-    65537
-  );
+  int resPkGen;
+  if (pkType == MBEDTLS_PK_ECKEY) {
+    resPkGen = mbedtls_ecp_gen_key(
+      MBEDTLS_ECP_DP_SECP256R1,
+      mbedtls_pk_ec( key ),
+      mbedtls_ctr_drbg_random,
+      &ctr_drbg
+    );
+  } else {
+    resPkGen = mbedtls_rsa_gen_key(
+      mbedtls_pk_rsa( key ),
+      mbedtls_ctr_drbg_random,
+      &ctr_drbg,
+      keySize,
+      65537
+    );
+  }
   if ( resPkGen != 0) {
     mbedtls_pk_free( &key );
     mbedtls_ctr_drbg_free( &ctr_drbg );
@@ -6,6 +6,7 @@
 #ifndef HTTPS_DISABLE_SELFSIGNING
 #include <string>
 #include <mbedtls/rsa.h>
+#include <mbedtls/ecp.h>
 #include <mbedtls/entropy.h>
 #include <mbedtls/ctr_drbg.h>
 #include <mbedtls/pk.h>
@@ -152,7 +153,9 @@ enum SSLKeySize {
   /** \brief RSA key with 2048 bit */
   KEYSIZE_2048 = 2048,
   /** \brief RSA key with 4096 bit */
-  KEYSIZE_4096 = 4096
+  KEYSIZE_4096 = 4096,
+  /** \brief ECDSA key on the NIST P-256 curve (secp256r1) */
+  KEYSIZE_EC_P256 = 256
 };
 
 /**
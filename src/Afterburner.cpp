@@ -100,6 +100,11 @@
 #include "Utility/helpers.h" 
 #include "Utility/NVStorage.h"
 #include "Utility/DebugPort.h"
+#include "Utility/BinLog.h"
+#include "Utility/Profiler.h"
+#include "Utility/HeapMonitor.h"
+#include "Utility/StatusSnapshot.h"
+#include "Utility/BootSequence.h"
 #include "Utility/macros.h"
 #include "Utility/UtilClasses.h"
 #include "Utility/BTC_JSON.h"
@@ -107,6 +112,7 @@
 #include "Utility/BoardDetect.h"
 #include "Utility/FuelGauge.h"
 #include "OLED/ScreenManager.h"
+#include "Utility/I2CBus.h"
 #include "OLED/KeyPad.h"
 #include "Utility/TempSense.h"
 #include "Utility/DataFilter.h"
@@ -172,6 +178,7 @@ void showMainmenu();
 bool checkTemperatureSensors();
 void checkBlueWireEvents();
 void checkUHF();
+void checkBootComplete();
 
 // DS18B20 temperature sensor support
 // Uses the RMT timeslot driver to operate as a one-wire bus
@@ -205,7 +212,6 @@ CSecuritySetup SecurityMenu;
 
 TaskHandle_t handleWatchdogTask;
 TaskHandle_t handleBlueWireTask;
-extern TaskHandle_t handleWebServerTask;
 
 // these variables will persist over a soft reboot.
 __NOINIT_ATTR float persistentRunTime;
@@ -229,6 +235,8 @@ bool bUpdateDisplay = false;
 bool bHaveWebClient = false;
 bool bBTconnected = false;
 long BootTime;
+int bootNetwork = -1;      // parallel boot stages, loop() leaves them alone until done
+int bootBluetooth = -1;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 //               Bluetooth instantiation
@@ -282,6 +290,9 @@ CHeaterStorage& NVstore = actualNVstore;
 
 CBluetoothAbstract& getBluetoothClient() 
 {
+  static CBluetoothAbstract NoBluetooth;   // stands in whilst the module is still being probed
+  if(!BootSequence.isDone(bootBluetooth))
+    return NoBluetooth;
   return Bluetooth;
 }
 
@@ -296,6 +307,7 @@ void checkBlueWireEvents()
   // check for complted data exchange from the blue wire task
   if(BlueWireSemaphore && xSemaphoreTake(BlueWireSemaphore, 0)) {
     updateJSONclients(bReportJSONData);
+    updateJSONstatus();
     updateMQTT();
     NVstore.doSave();   // now is a good time to store to the NV storage, well away from any blue wire activity
   }
@@ -401,8 +413,36 @@ extern "C" unsigned long __wrap_millis() {
 }
 
 
+#if USE_WIFI == 1
+// boot stage, runs in its own task alongside loop()
+void bootNetworkStage()
+{
+  initWifi();   
+#if USE_OTA == 1
+  if(NVstore.getUserSettings().enableOTA) {
+    initOTA();
+  }
+#endif // USE_OTA
+#if USE_WEBSERVER == 1
+  initWebServer();
+#endif // USE_WEBSERVER
+  initFOTA();
+#if USE_MQTT == 1
+  mqttInit();
+#endif // USE_MQTT
+}
+#endif // USE_WIFI
+
+// boot stage, runs in its own task alongside loop()
+void bootBluetoothStage()
+{
+  Bluetooth.begin();
+}
+
 void setup() {
 
+  int bootStage = BootSequence.begin("Core");
+
   vTaskPrioritySet(NULL, TASK_PRIORITY_ARDUINO);   // elevate normal Arduino loop etc higher than the usual '1'
 
   // ensure cyclic mode is disabled after power on
@@ -433,6 +473,8 @@ void setup() {
                           ));
   DebugPort.setBufferSize(8192);
   DebugPort.begin(115200);
+  BinLog.begin();     // deferred logging from the real time tasks
+  StatusSnapshot.begin();   // before the first blue wire exchange, the web servers start later
   DebugPort.println("_______________________________________________________________");
 
   DebugPort.printf("Getting NVS stats\r\n");
@@ -443,20 +485,68 @@ void setup() {
   DebugPort.printf("Reset reason: core0:%d, core1:%d\r\n", rtc_get_reset_reason(0), rtc_get_reset_reason(0));
 //  DebugPort.printf("Previous user ON = %d\r\n", bUserON);   // state flag required for cyclic mode to persist properly after a WD reboot :-)
 
+  // OLED, RTC and BME280 share the I2C bus - serialise access, starts the I2C task for queued writes
+  I2CBus.begin();
+
   // initialise DS18B20 sensor interface
-  TempSensor.begin(DS18B20_Pin, 0x76);
-  TempSensor.startConvert();  // kick off initial temperature sample
+  TempSensor.begin(DS18B20_Pin, 0x76);  // starts the sensor acquisition task
 
 
   lastTemperatureTime = millis();
   lastAnimationTime = millis();
+
+  BootSequence.end(bootStage);
+
+  // the blue wire needs the NV settings, set points and a temperature - then it can start, 
+  // everything else comes up around it
+  bootStage = BootSequence.begin("NV store");
+  NVstore.init();
+  NVstore.load();
+  BootSequence.end(bootStage);
+
+  bootStage = BootSequence.begin("Blue wire");
+  pinMode(LED_Pin, OUTPUT);               // On board LED indicator
+  digitalWrite(LED_Pin, LOW);
+
+  FilteredSamples.ipVolts.setRounding(0.1);
+  FilteredSamples.GlowAmps.setRounding(0.01);
+  FilteredSamples.GlowVolts.setRounding(0.1);
+  FilteredSamples.Fan.setRounding(10);
+  FilteredSamples.Fan.setAlpha(0.7);
+  FilteredSamples.AmbientTemp.reset(-100.0);
+  FilteredSamples.FastipVolts.setRounding(0.1);
+  FilteredSamples.FastipVolts.setAlpha(0.7);
+  FilteredSamples.FastGlowAmps.setRounding(0.01);
+  FilteredSamples.FastGlowAmps.setAlpha(0.7);
   
+  RTC_Store.begin();
+  FuelGauge.init(RTC_Store.getFuelGauge());
+  DebugPort.printf("Previous user start = %d\r\n", RTC_Store.getUserStart());   // state flag required for cyclic mode to persist properly after a WD reboot :-)
+
+  pHourMeter = new CHourMeter(persistentRunTime, persistentGlowTime); // persistent vars passed by reference so they can be valid after SW reboots
+  pHourMeter->init(bESP32PowerUpInit || RTC_Store.getBootInit());     // ensure persistent memory variable are reset after powerup, or OTA update
+  RTC_Store.setBootInit(false);
+
+  // apply saved set points!
+  CDemandManager::reload();
+
+  // create task to run blue wire interface
+  xTaskCreate(BlueWireTask,              
+              "BlueWireTask",
+              1600,
+              NULL,
+              TASK_PRIORITY_HEATERCOMMS,
+             &handleBlueWireTask);
+  BootSequence.end(bootStage);
+
+  bootStage = BootSequence.begin("Peripherals");
   BoardRevision = BoardDetect();
   DebugPort.printf("Board revision: V%.1f\r\n", float(BoardRevision) * 0.1);
 
   DebugPort.printf("ESP32 IDF Version: %s\r\n", esp_get_idf_version());
   DebugPort.printf("NVS:  entries- free=%d used=%d total=%d namespace count=%d\r\n", nvs_stats.free_entries, nvs_stats.used_entries, nvs_stats.total_entries, nvs_stats.namespace_count);
 
+
  // Initialize SPIFFS
   if(!SPIFFS.begin(true)){
     DebugPort.println("An Error has occurred while mounting SPIFFS");
@@ -464,14 +554,13 @@ void setup() {
   else {
     DebugPort.println("Mounted SPIFFS OK");
     DebugPort.printf("SPIFFS usage: %d/%d\r\n", SPIFFS.usedBytes(), SPIFFS.totalBytes());
+#if BOOT_LIST_SPIFFS == 1
     DebugPort.println("Listing SPIFFS contents:");
     String report;
     listSPIFFS("/", 2, report);
+#endif
   }
 
-  NVstore.init();
-  NVstore.load();
-  
   initJSONMQTTmoderator();   // prevents JSON for MQTT unless requested
   initJSONIPmoderator();   // prevents JSON for IP unless requested
   initJSONTimermoderator();  // prevents JSON for timers unless requested
@@ -485,39 +574,32 @@ void setup() {
   Clock.begin();
 
   BootTime = Clock.get().secondstime();
+  BootSequence.end(bootStage);
   
+  bootStage = BootSequence.begin("Display");
   ScreenManager.begin();
   if(Clock.lostPower()) {
     ScreenManager.selectMenu(CScreenManager::BranchMenu, CScreenManager::SetClockUI);
   }
+  BootSequence.end(bootStage);    // the splash is held until setup() is done
 
+  // slow stages run in their own tasks, alongside loop() - see doStreaming()
 #if USE_WIFI == 1
-
-
   if(NVstore.getUserSettings().wifiMode) {
-    initWifi();   
-#if USE_OTA == 1
-    if(NVstore.getUserSettings().enableOTA) {
-      initOTA();
-    }
-#endif // USE_OTA
-#if USE_WEBSERVER == 1
-    initWebServer();
-#endif // USE_WEBSERVER
-    initFOTA();
-#if USE_MQTT == 1
-    mqttInit();
-#endif // USE_MQTT
+    bootNetwork = BootSequence.runParallel("Network", bootNetworkStage, TASK_STACK_BOOT_NET);
   }
-
 #endif // USE_WIFI
 
-  pinMode(LED_Pin, OUTPUT);               // On board LED indicator
-  digitalWrite(LED_Pin, LOW);
-
   bBTconnected = false;
+#if USE_HC05_BLUETOOTH == 1
+  bootBluetooth = BootSequence.runParallel("Bluetooth", bootBluetoothStage, TASK_STACK_BOOT_BT);   // HC-05 probing is slow
+#else
+  bootStage = BootSequence.begin("Bluetooth");
   Bluetooth.begin();
+  BootSequence.end(bootStage);
+#endif
 
+  bootStage = BootSequence.begin("Services");
   setupGPIO(); 
 
 #if USE_TWDT == 1
@@ -544,28 +626,6 @@ void setup() {
   JSONWatchdogTick = -1;
   WatchdogTick = -1;
 
-  FilteredSamples.ipVolts.setRounding(0.1);
-  FilteredSamples.GlowAmps.setRounding(0.01);
-  FilteredSamples.GlowVolts.setRounding(0.1);
-  FilteredSamples.Fan.setRounding(10);
-  FilteredSamples.Fan.setAlpha(0.7);
-  FilteredSamples.AmbientTemp.reset(-100.0);
-  FilteredSamples.FastipVolts.setRounding(0.1);
-  FilteredSamples.FastipVolts.setAlpha(0.7);
-  FilteredSamples.FastGlowAmps.setRounding(0.01);
-  FilteredSamples.FastGlowAmps.setAlpha(0.7);
-  
-  RTC_Store.begin();
-  FuelGauge.init(RTC_Store.getFuelGauge());
-  DebugPort.printf("Previous user start = %d\r\n", RTC_Store.getUserStart());   // state flag required for cyclic mode to persist properly after a WD reboot :-)
-
-  pHourMeter = new CHourMeter(persistentRunTime, persistentGlowTime); // persistent vars passed by reference so they can be valid after SW reboots
-  pHourMeter->init(bESP32PowerUpInit || RTC_Store.getBootInit());     // ensure persistent memory variable are reset after powerup, or OTA update
-  RTC_Store.setBootInit(false);
-
-  // apply saved set points!
-  CDemandManager::reload();
-  
   // Check for solo DS18B20
   // store it's serial number as the primary sensor
   // This allows seamless standard operation, and marks the iniital sensor 
@@ -577,8 +637,8 @@ void setup() {
   {   
     sHeaterTuning tuning = NVstore.getHeaterTuning();
     tuning.DS18B20probe[0].romCode = romCode;
-    tuning.DS18B20probe[1].romCode = {0};
-    tuning.DS18B20probe[2].romCode = {0};
+    for(int i=1; i<MAX_DS18B20_DEVICES; i++)
+      tuning.DS18B20probe[i].romCode = {0};
     tuning.DS18B20probe[0].offset = 0;
     NVstore.setHeaterTuning(tuning);
     NVstore.save();
@@ -592,25 +652,32 @@ void setup() {
                       romCode.fields.serial_number[0] 
                     );
   }
-  TempSensor.getDS18B20().mapSensor(0, NVstore.getHeaterTuning().DS18B20probe[0].romCode);
-  TempSensor.getDS18B20().mapSensor(1, NVstore.getHeaterTuning().DS18B20probe[1].romCode);
-  TempSensor.getDS18B20().mapSensor(2, NVstore.getHeaterTuning().DS18B20probe[2].romCode);
-
-  // create task to run blue wire interface
-  xTaskCreate(BlueWireTask,              
-              "BlueWireTask",
-              1600,
-              NULL,
-              TASK_PRIORITY_HEATERCOMMS,
-             &handleBlueWireTask);
+  TempSensor.mapRoles();
 
-  
   UHFremote.begin(Rx433MHz_pin, RMT_CHANNEL_4);
 
+#if USE_PROFILER == 1
+  // tasks listed by the profiler (when FreeRTOS cannot enumerate them itself)
+  Profiler.addTask("Arduino", xTaskGetCurrentTaskHandle());
+  Profiler.addTask("BlueWire", []() { return handleBlueWireTask; });
+  Profiler.addTask("Watchdog", []() { return handleWatchdogTask; });
+  Profiler.addTask("WS server", []() { return getWebServerTaskHandle(eWebSocketServer); });
+  Profiler.addTask("HTTP server", []() { return getWebServerTaskHandle(eHTTPServer); });
+  Profiler.addTask("HTTPS server", []() { return getWebServerTaskHandle(eHTTPSServer); });
+  Profiler.addTask("Sensors", []() { return TempSensor.getTaskHandle(); });
+  Profiler.addTask("Analogue", []() { return GPIOalg.getTaskHandle(); });
+  Profiler.addTask("433MHz", []() { return UHFremote.getTaskHandle(); });
+  Profiler.addTask("Log", []() { return BinLog.getTaskHandle(); });
+  Profiler.addTask("OLED flush", []() { return ScreenManager.getDisplayTaskHandle(); });
+  Profiler.addTask("I2C", []() { return I2CBus.getTaskHandle(); });
+#if defined(ESP32) && (USE_HC05_BLUETOOTH == 1 || USE_BLE_BLUETOOTH == 1 || USE_CLASSIC_BLUETOOTH == 1)
+  Profiler.addTask("Bluetooth", []() { return Bluetooth.getTaskHandle(); });
+#endif
+#endif
+  BootSequence.end(bootStage);
 
-  delay(1000); // just to hold the splash screeen for while
-
-  ScreenManager.clearDisplay();
+  BootSequence.setupDone();    // loop() completes the boot, see checkBootComplete()
+  ScreenManager.releaseSplash();   // the heater can be used from here, the network may still be coming up
 }
 
 
@@ -623,29 +690,44 @@ void loop()
 {
   // DebugPort.handle();    // keep telnet spy alive
 
+  PROFILE_LOOP_START();
+
   feedWatchdog(); // feed watchdog
+
+  checkBootComplete();
+
+  HeapMonitor.manage();
       
-  doStreaming();   // do wifi, BT tx etc 
+  PROFILE_STAGE(PROF_Streaming, doStreaming());   // do wifi, BT tx etc 
 
-  Clock.update();
+  PROFILE_STAGE(PROF_Clock, Clock.update());
 
-  if(checkTemperatureSensors())
-    ScreenManager.reqUpdate();
+  PROFILE_STAGE(PROF_Sensors, if(checkTemperatureSensors()) ScreenManager.reqUpdate());
 
-  checkDisplayUpdate();    
+  PROFILE_STAGE(PROF_Display, checkDisplayUpdate());    
 
-  checkBlueWireEvents();
+  PROFILE_STAGE(PROF_BlueWire, checkBlueWireEvents());
 
-  checkUHF();
+  PROFILE_STAGE(PROF_UHF, checkUHF());
+
+  PROFILE_LOOP_END();
 
   vTaskDelay(1);
 }  // loop
 
 
+// once setup() and the parallel boot stages have all finished
+void checkBootComplete()
+{
+  if(BootSequence.checkComplete()) {
+    HeapMonitor.bootComplete();   // steady state from here, the heap should be left alone
+    BootSequence.report();
+  }
+}
+
 bool checkTemperatureSensors()
 {
-  long tDelta = millis() - lastTemperatureTime;
-  if(tDelta > MIN_TEMPERATURE_INTERVAL) {  // maintain a minimum holdoff period
+  if(TempSensor.hasNewReadings()) {  // sensors are read by their own task, never wait on them here
     lastTemperatureTime = millis();    // reset time to observe temeprature        
 
     if(bReportStack) {
@@ -653,11 +735,20 @@ bool checkTemperatureSensors()
       DebugPort.printf("  Arduino: %d\r\n", uxTaskGetStackHighWaterMark(NULL));
       DebugPort.printf("  BlueWire: %d\r\n", uxTaskGetStackHighWaterMark(handleBlueWireTask));
       DebugPort.printf("  Watchdog: %d\r\n", uxTaskGetStackHighWaterMark(handleWatchdogTask));
-      DebugPort.printf("  SSL loop: %d\r\n", uxTaskGetStackHighWaterMark(handleWebServerTask));
+      for(int i = 0; i < eNumWebServers; i++) {
+        if(getWebServerTaskHandle(i))
+          DebugPort.printf("  %s: %d\r\n", pcTaskGetTaskName(getWebServerTaskHandle(i)), uxTaskGetStackHighWaterMark(getWebServerTaskHandle(i)));
+      }
+      DebugPort.printf("  Sensors: %d\r\n", uxTaskGetStackHighWaterMark(TempSensor.getTaskHandle()));
+      if(GPIOalg.getTaskHandle())
+        DebugPort.printf("  Analogue: %d\r\n", uxTaskGetStackHighWaterMark(GPIOalg.getTaskHandle()));
+      DebugPort.printf("  Log: %d\r\n", uxTaskGetStackHighWaterMark(BinLog.getTaskHandle()));
+#if defined(ESP32) && (USE_HC05_BLUETOOTH == 1 || USE_BLE_BLUETOOTH == 1 || USE_CLASSIC_BLUETOOTH == 1)
+      if(Bluetooth.getTaskHandle())
+        DebugPort.printf("  Bluetooth: %d\r\n", uxTaskGetStackHighWaterMark(Bluetooth.getTaskHandle()));
+#endif
     }
 
-    TempSensor.readSensors();
-
     float fTemperature;
     if(TempSensor.getTemperature(0, fTemperature)) {  // get Primary sensor temperature
       if(DS18B20holdoff) {
@@ -679,8 +770,6 @@ bool checkTemperatureSensors()
       FilteredSamples.AmbientTemp.reset(-100.0);
     }
 
-    TempSensor.startConvert();  // request a new conversion, will be ready by the time we loop back around
-
     return true;
   }
   return false;
@@ -979,6 +1068,39 @@ void checkDebugCommands()
           bReportRecyleEvents = false;
         DebugPort.printf("Toggled blue wire recycling event reporting %s\r\n", bReportRecyleEvents ? "ON" : "OFF");
       }
+      else if(rxVal == 'd') {
+        ScreenManager.toggleRefreshReporting();
+      }
+      else if(rxVal == 'u') {
+        I2CBus.report();
+      }
+      else if(rxVal == 'r') {
+        UHFremote.report();
+      }
+      else if(rxVal == 't') {
+        Bluetooth.report();
+      }
+      else if(rxVal == 'f') {
+        HeapMonitor.report();
+      }
+      else if(rxVal == 'e') {
+        BootSequence.report();
+      }
+      else if(rxVal == 'k') {
+        reportWebServers();
+      }
+#if USE_PROFILER == 1
+      else if(rxVal == 'l') {
+        Profiler.report();
+      }
+      else if(rxVal == ('l' & 0x1f)) {   // CTRL-L start/stop loop() profiling
+        Profiler.enable(!Profiler.isEnabled());
+        DebugPort.printf("loop() profiler %s\r\n", Profiler.isEnabled() ? "started" : "stopped");
+      }
+#endif
+      else if(rxVal == ('d' & 0x1f)) {   // CTRL-D dump OLED framebuffer
+        ScreenManager.dumpFrame();
+      }
       else if(rxVal == 'm') {
         MQTTmenu.setActive();
       }
@@ -1103,6 +1225,9 @@ void setupGPIO()
     CGPIOalg::Modes algMode = NVstore.getUserSettings().GPIO.algMode;
     if(BoardRevision == 20)  
       algMode = CGPIOalg::Disabled;      // force off analogue support in V2.0 PCBs
+    GPIOalg.setOversampling(NVstore.getUserSettings().GPIO.algOversample);
+    GPIOalg.setSampleInterval(NVstore.getUserSettings().GPIO.algInterval);
+    GPIOalg.setFilterTime(NVstore.getUserSettings().GPIO.algFilter);
     GPIOalg.begin(GPIOalg_pin, algMode);
   }
   else {
@@ -1246,7 +1371,8 @@ void doStreaming()
 {
 #if USE_WIFI == 1
 
-  if(NVstore.getUserSettings().wifiMode) {
+  if(NVstore.getUserSettings().wifiMode && BootSequence.isDone(bootNetwork)) {
+    PROFILE_SCOPE(PROF_WiFi);
     doWiFiManager();
 #if USE_OTA == 1
     doOTA();
@@ -1271,14 +1397,14 @@ void doStreaming()
   //CANNOT USE GPIO WITH JTAG DEBUG
   GPIOin.manage();
   GPIOout.manage(); 
-  GPIOalg.manage();
 #endif
 #endif
 
-  Bluetooth.check();    // check for Bluetooth activity
+  if(BootSequence.isDone(bootBluetooth))
+    PROFILE_STAGE(PROF_Bluetooth, Bluetooth.check());    // check for Bluetooth activity
 
   // manage changes in Bluetooth connection status
-  if(Bluetooth.isConnected()) {
+  if(getBluetoothClient().isConnected()) {
     if(!bBTconnected) {
       resetAllJSONmoderators();  // force full send upon BT client connect
     }
@@ -1445,14 +1571,28 @@ void showMainmenu()
   DebugPort.println("");
   DebugPort.printf("  <B> - toggle raw blue wire data reporting, currently %s\r\n", bReportBlueWireData ? "ON" : "OFF");
   DebugPort.printf("  <J> - toggle output JSON reporting, currently %s\r\n", bReportJSONData ? "ON" : "OFF");
+  DebugPort.printf("  <D> - toggle OLED render/refresh reporting, currently %s\r\n", ScreenManager.isReportingRefresh() ? "ON" : "OFF");
+  DebugPort.println("  <U> - report I2C bus utilisation since last report");
+  DebugPort.println("  <R> - report 433MHz remote decode statistics since last report");
+  DebugPort.println("  <T> - report Bluetooth statistics since last report");
+#if USE_PROFILER == 1
+  DebugPort.println("  <L> - report loop() stage timing and task stacks since last report");
+#endif
+  DebugPort.println("  <F> - report heap allocations and fragmentation since boot");
+  DebugPort.println("  <E> - report the boot timeline");
+  DebugPort.println("  <K> - report web server latency, throughput and TLS handshakes since last report");
   DebugPort.println("  <M> - configure MQTT");
   DebugPort.println("  <S> - configure Security");
   DebugPort.println("  <+> - request heater turns ON");
   DebugPort.println("  <-> - request heater turns OFF");
+  DebugPort.println("  <CTRL-D> - dump OLED framebuffer as a PBM image");
   DebugPort.println("  <CTRL-R> - restart the ESP");
   DebugPort.printf("  <CTRL-C> - toggle reporting of state machine transits %s\r\n", CommState.isReporting() ? "ON" : "OFF");        
   DebugPort.printf("  <CTRL-O> - toggle reporting of OEM resync event, currently %s\r\n", bReportOEMresync ? "ON" : "OFF");        
   DebugPort.printf("  <CTRL-W> - toggle reporting of blue wire timeout/recycling event, currently %s\r\n", bReportRecyleEvents ? "ON" : "OFF");
+#if USE_PROFILER == 1
+  DebugPort.printf("  <CTRL-L> - toggle loop() profiling, currently %s\r\n", Profiler.isEnabled() ? "ON" : "OFF");
+#endif
   DebugPort.println("");
   DebugPort.println("");
   DebugPort.println("");
@@ -47,6 +47,7 @@ public:
   virtual bool isConnected() { return false; };
   virtual const char* getMAC() { return "unknown"; };
   virtual bool test(char) { return false; };  // returns true whilst test mode is active
+  virtual void report() {};                    // transmit statistics, to the debug port
 };
 
 extern CBluetoothAbstract& getBluetoothClient();
@@ -24,6 +24,7 @@
 #include "../cfg/BTCConfig.h"
 #include "../Protocol/Protocol.h"
 #include "../Utility/DebugPort.h"
+#include "../Utility/macros.h"
 #include "BluetoothESP32.h"
 
 
@@ -35,10 +36,20 @@
 //                              |
 //                              V
 //
+
+static const uart_port_t HC05_UART = UART_NUM_2;    // Serial2
+
 CBluetoothESP32HC05::CBluetoothESP32HC05(int keyPin, int sensePin, int rxPin, int txPin) : CBluetoothHC05(keyPin, sensePin)
 {
   _rxPin = rxPin;
   _txPin = txPin;
+  _baudrate = 9600;
+  _uartQueue = NULL;
+  _cmdRing = NULL;
+  _bRxTruncated = false;
+  _taskHandle = NULL;
+  _runState = 0;
+  resetStats();
 
   digitalWrite(_txPin, HIGH);  // set high before making an output to avoid low glitch
   pinMode(_txPin, OUTPUT);
@@ -52,6 +63,249 @@ CBluetoothESP32HC05::_openSerial(int baudrate)
   // best to explicitly specify pins for the pin multiplexer!   
   HC05_SerialPort.begin(baudrate, SERIAL_8N1, _rxPin, _txPin);
   pinMode(_rxPin, INPUT_PULLUP);  // newer modules seem to be open drian - sort of - need a pullup to work properly anyway
+  _baudrate = baudrate;
+}
+
+void
+CBluetoothESP32HC05::begin()
+{
+  CBluetoothHC05::begin();   // module detection and setup via AT commands
+
+  _cmdRing = xRingbufferCreate(HC05_CMD_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+  _startDriver();
+}
+
+// take Serial2 from the Arduino HAL and hand it to the IDF UART driver,
+// at whatever baud rate the module was left in data mode
+void
+CBluetoothESP32HC05::_startDriver()
+{
+  if(_uartQueue || !_cmdRing)
+    return;
+
+  HC05_SerialPort.end();
+
+  uart_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.baud_rate = _baudrate;
+  cfg.data_bits = UART_DATA_8_BITS;
+  cfg.parity = UART_PARITY_DISABLE;
+  cfg.stop_bits = UART_STOP_BITS_1;
+  cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  uart_param_config(HC05_UART, &cfg);
+  uart_set_pin(HC05_UART, _txPin, _rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+  pinMode(_rxPin, INPUT_PULLUP);
+  if(uart_driver_install(HC05_UART, HC05_RX_BUFSIZE, HC05_TX_RING_SIZE, HC05_EVENT_DEPTH, &_uartQueue, 0) != ESP_OK) {
+    DebugPort.println("HC-05 UART driver install FAILED");
+    _uartQueue = NULL;
+    _openSerial(_baudrate);   // fall back to polling via the HAL
+    return;
+  }
+  // wake sooner than the driver's defaults (120 bytes or 10 idle byte times),
+  // a JSON command is often shorter than the FIFO threshold
+  uart_intr_config_t intr;
+  memset(&intr, 0, sizeof(intr));
+  intr.intr_enable_mask = UART_RXFIFO_FULL_INT_ENA_M | UART_RXFIFO_TOUT_INT_ENA_M | UART_FRM_ERR_INT_ENA_M
+                        | UART_RXFIFO_OVF_INT_ENA_M | UART_BRK_DET_INT_ENA_M | UART_PARITY_ERR_INT_ENA_M;
+  intr.rxfifo_full_thresh = HC05_RX_THRESHOLD;
+  intr.rx_timeout_thresh = HC05_RX_TIMEOUT;
+  uart_intr_config(HC05_UART, &intr);
+
+  _rxLine.clear();
+  _bRxTruncated = false;
+  _runState = 1;
+  xTaskCreate(_staticTask,
+              "HC05task",
+              TASK_STACK_HC05,
+              this,
+              TASK_PRIORITY_HC05,
+              &_taskHandle);
+}
+
+// stop the task and return Serial2 to the Arduino HAL, for AT commands or test mode
+void
+CBluetoothESP32HC05::_stopDriver()
+{
+  if(!_uartQueue)
+    return;
+
+  if(_runState == 1) {       // check task is running
+    _runState = 2;           // ask task to stop
+    uart_event_t wake;
+    memset(&wake, 0, sizeof(wake));
+    wake.type = UART_EVENT_MAX;
+    xQueueSend(_uartQueue, &wake, portMAX_DELAY);   // the task sleeps on the event queue
+    while(_runState != 0) {
+      vTaskDelay(1);
+    }
+    _taskHandle = NULL;
+  }
+
+  uart_wait_tx_done(HC05_UART, 100 / portTICK_PERIOD_MS);
+  uart_driver_delete(HC05_UART);
+  _uartQueue = NULL;
+  _rxLine.clear();
+  _bRxTruncated = false;
+
+  _openSerial(_baudrate);
+}
+
+void
+CBluetoothESP32HC05::_staticTask(void* arg)
+{
+  CBluetoothESP32HC05* pThis = (CBluetoothESP32HC05*)arg;
+
+  pThis->_task();
+
+  vTaskDelete(NULL);
+}
+
+void
+CBluetoothESP32HC05::_task()
+{
+  uint8_t data[128];
+
+  while(_runState == 1) {
+    // sleep until the driver reports activity - a FIFO threshold or a receive timeout
+    uart_event_t event;
+    if(!xQueueReceive(_uartQueue, &event, portMAX_DELAY) || _runState != 1)
+      continue;
+
+    switch(event.type) {
+      case UART_DATA: {
+        _stats.rxEvents++;
+        // read everything buffered, not just what this event announced
+        size_t avail = 0;
+        uart_get_buffered_data_len(HC05_UART, &avail);
+        while(avail) {
+          int len = uart_read_bytes(HC05_UART, data, avail < sizeof(data) ? avail : sizeof(data), 0);
+          if(len <= 0)
+            break;
+          _collectRxBlock((const char*)data, len);
+          avail -= len;
+        }
+        break;
+      }
+      case UART_FIFO_OVF:
+      case UART_BUFFER_FULL:
+        // data has been lost, the partial command is now garbage
+        _stats.overflows++;
+        uart_flush_input(HC05_UART);
+        xQueueReset(_uartQueue);
+        _rxLine.clear();
+        _bRxTruncated = false;
+        break;
+      default:
+        break;
+    }
+  }
+  _runState = 0;
+}
+
+// called from the task: split a block of received data into JSON commands
+void
+CBluetoothESP32HC05::_collectRxBlock(const char* data, int len)
+{
+  _stats.rxBytes += len;
+  while(len) {
+    const char* pEnd = (const char*)memchr(data, '}', len);   // "End of JSON Line"
+    int seg = pEnd ? (pEnd - data + 1) : len;
+    if(!_rxLine.append(data, seg))
+      _bRxTruncated = true;
+    if(pEnd) {
+      if(_bRxTruncated)
+        _stats.truncated++;      // lost its tail, not worth interpreting
+      // loop() interprets the command, the JSON handlers are not thread safe
+      else if(xRingbufferSend(_cmdRing, _rxLine.Line, _rxLine.Len + 1, 0))
+        _stats.commands++;
+      else
+        _stats.dropped++;
+      _rxLine.clear();
+      _bRxTruncated = false;
+    }
+    data += seg;
+    len -= seg;
+  }
+}
+
+void
+CBluetoothESP32HC05::check()
+{
+  if(!_uartQueue) {
+    CBluetoothHC05::check();   // HAL owns the port - legacy polling
+    return;
+  }
+
+  size_t len;
+  char* pCmd;
+  while((pCmd = (char*)xRingbufferReceive(_cmdRing, &len, 0)) != NULL) {
+    interpretJsonCommand(pCmd);
+    vRingbufferReturnItem(_cmdRing, pCmd);
+    foldbackDesiredTemp();   // rapid foldback if desired temp changes
+  }
+}
+
+bool
+CBluetoothESP32HC05::send(const char* Str)
+{
+  if(!_uartQueue)
+    return CBluetoothHC05::send(Str);
+
+  if(isConnected()) {
+    int len = strlen(Str);
+    // copied into the driver's TX ring, only waits if the ring is full
+    uart_write_bytes(HC05_UART, Str, len);
+    _stats.txMessages++;
+    _stats.txBytes += len;
+    return true;
+  }
+  return false;
+}
+
+const char*
+CBluetoothESP32HC05::getMAC()
+{
+  if(!_bGotMAC) {
+    _stopDriver();     // AT commands are driven via the HAL
+    CBluetoothHC05::getMAC();
+    _startDriver();
+  }
+  return CBluetoothHC05::getMAC();
+}
+
+bool
+CBluetoothESP32HC05::test(char val)
+{
+  if(val)
+    _stopDriver();     // test mode talks to the module via the HAL
+  bool retval = CBluetoothHC05::test(val);
+  if(!retval)
+    _startDriver();
+  return retval;
+}
+
+void
+CBluetoothESP32HC05::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void
+CBluetoothESP32HC05::report()
+{
+  if(!_uartQueue) {
+    DebugPort.println("HC-05 UART driver not running");
+    return;
+  }
+  size_t waiting = 0;
+  uart_get_buffered_data_len(HC05_UART, &waiting);
+  DebugPort.printf("HC-05 RX: %d bytes in %d reads, %d commands, %d bytes waiting\r\n",
+                   _stats.rxBytes, _stats.rxEvents, _stats.commands, waiting);
+  DebugPort.printf("  %d commands dropped, %d truncated, %d UART overflows\r\n",
+                   _stats.dropped, _stats.truncated, _stats.overflows);
+  DebugPort.printf("HC-05 TX: %d messages, %d bytes queued\r\n",
+                   _stats.txMessages, _stats.txBytes);
+  resetStats();
 }
 //                              ^
 //                              |
@@ -60,6 +314,117 @@ CBluetoothESP32HC05::_openSerial(int baudrate)
 
 #endif
 
+#if USE_CLASSIC_BLUETOOTH == 1 || USE_BLE_BLUETOOTH == 1
+/////////////////////////////////////////////////////////////////////////////////////////
+//              QUEUED TRANSMIT for ESP32 Classic / BLE
+//                              |
+//                              V
+
+CBluetoothESP32Queued::CBluetoothESP32Queued()
+{
+  _txRing = NULL;
+  _txTaskHandle = NULL;
+  resetStats();
+}
+
+void
+CBluetoothESP32Queued::_startTx(const char* taskName)
+{
+  _txRing = xRingbufferCreate(BT_TX_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+  xTaskCreate(_staticTxTask,
+              taskName,
+              2500,
+              this,
+              TASK_PRIORITY_BT_TX,
+              &_txTaskHandle);
+}
+
+bool 
+CBluetoothESP32Queued::send(const char* Str)
+{
+  if(isConnected() && _txRing) {
+
+#if BT_LED == 1     
+    digitalWrite(LED_Pin, !digitalRead(LED_Pin)); // toggle LED
+#endif
+    int len = strlen(Str);
+    // all or nothing, and never wait - a full ring means the link cannot keep up
+    if(!xRingbufferSend(_txRing, Str, len, 0)) {
+      _stats.overflows++;
+      return false;
+    }
+    _stats.messages++;
+    _stats.bytes += len;
+    return true;
+  }
+  else {
+    DebugPort.println("No Bluetooth client");
+#if BT_LED == 1     
+    digitalWrite(LED_Pin, 0);
+#endif
+    return false;
+  }
+}
+
+void
+CBluetoothESP32Queued::_staticTxTask(void* arg)
+{
+  CBluetoothESP32Queued* pThis = (CBluetoothESP32Queued*)arg;
+
+  pThis->_txTask();
+
+  vTaskDelete(NULL);
+}
+
+void
+CBluetoothESP32Queued::_txTask()
+{
+  for(;;) {
+    // sleep until data is queued, then take as much as the link accepts in one go
+    size_t len;
+    uint8_t* pData = (uint8_t*)xRingbufferReceiveUpTo(_txRing, &len, portMAX_DELAY, _getChunkSize());
+    if(pData) {
+      // the block was sized when the wait began, the link (MTU) may since have changed
+      for(size_t done = 0; done < len; ) {
+        int chunk = _getChunkSize();
+        UPPERLIMIT(chunk, int(len - done));
+        if(_sendChunk(pData + done, chunk)) {
+          _stats.chunks++;
+          LOWERLIMIT(_stats.maxChunk, chunk);
+        }
+        else {
+          _stats.discarded += chunk;   // client has gone
+        }
+        done += chunk;
+      }
+      vRingbufferReturnItem(_txRing, pData);
+    }
+  }
+}
+
+void
+CBluetoothESP32Queued::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void
+CBluetoothESP32Queued::report()
+{
+  int waiting = _txRing ? BT_TX_RING_SIZE - xRingbufferGetCurFreeSize(_txRing) : 0;
+  DebugPort.printf("Bluetooth TX: %d messages, %d bytes queued, %d blocks sent (largest %d), %d bytes waiting\r\n",
+                   _stats.messages, _stats.bytes, _stats.chunks, _stats.maxChunk, waiting);
+  DebugPort.printf("  %d messages overflowed, %d bytes discarded, %d congestion waits\r\n",
+                   _stats.overflows, _stats.discarded, _stats.congested);
+  resetStats();
+}
+
+//                              ^
+//                              |
+//              QUEUED TRANSMIT for ESP32 Classic / BLE
+/////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
 #if USE_CLASSIC_BLUETOOTH == 1
 /////////////////////////////////////////////////////////////////////////////////////////
 //                  CLASSIC BLUETOOTH on ESP32
@@ -75,6 +440,7 @@ CBluetoothESP32Classic::begin()
   if(!SerialBT.begin("ESPHEATER")) {
     DebugPort.println("An error occurred initialising Bluetooth");
   }
+  _startTx("BTtxTask");
 }
 
 void 
@@ -86,25 +452,16 @@ CBluetoothESP32Classic::check()
   }
 }
 
+// called from the TX task
+// BluetoothSerial queues the block for the SPP stack and itself waits out
+// any congestion (ESP_SPP_CONG_EVT)
 bool 
-CBluetoothESP32Classic::send(const char* Str)
+CBluetoothESP32Classic::_sendChunk(const uint8_t* data, int len)
 {
-  if(isConnected()) {
-
-#if BT_LED == 1     
-    digitalWrite(LED_Pin, !digitalRead(LED_Pin)); // toggle LED
-#endif
-    SerialBT.write((uint8_t*)Str, strlen(Str));
-    delay(10);
-    return true;
-  }
-  else {
-    DebugPort.println("No Bluetooth client");
-#if BT_LED == 1     
-    digitalWrite(LED_Pin, 0);
-#endif
+  if(!isConnected()) 
     return false;
-  }
+  SerialBT.write(data, len);
+  return true;
 }
 
 bool 
@@ -183,12 +540,17 @@ private:
 
 };
 
+CBluetoothESP32BLE* CBluetoothESP32BLE::_pInstance = NULL;
+
 CBluetoothESP32BLE::CBluetoothESP32BLE()
 {
   _pServer = NULL;
   _pTxCharacteristic = NULL;
   _deviceConnected = false;
   _oldDeviceConnected = false;
+  _MTU = ESP_GATT_DEF_BLE_MTU_SIZE;
+  _congested = false;
+  _txCredits = NULL;
 }
 
 CBluetoothESP32BLE::~CBluetoothESP32BLE()
@@ -202,6 +564,10 @@ CBluetoothESP32BLE::begin()
   DebugPort.println("Initialising ESP32 BLE");
   // create the BLE device
   BLEDevice::init("DieselHeater");
+  BLEDevice::setMTU(ESP_GATT_MAX_MTU_SIZE);     // allow the client to negotiate large notifications
+  _pInstance = this;
+  BLEDevice::setCustomGattsHandler(_gattsEvent);
+  _txCredits = xSemaphoreCreateCounting(BLE_TX_CREDITS, BLE_TX_CREDITS);
 
   // create the BLE server
   _pServer = BLEDevice::createServer();
@@ -228,64 +594,42 @@ CBluetoothESP32BLE::begin()
   pService->start();
   // start advertising
   _pServer->getAdvertising()->start();
+  _startTx("BLEtxTask");
   DebugPort.println("Awaiting a client to notify...");
 }
 
-/*void 
-CBluetoothESP32BLE::sendFrame(const char* pHdr, const CProtocol& Frame, bool lineterm)
-{
-  char fullMsg[32];
-
-  // report to debug port
-  CBluetoothAbstract::sendFrame(pHdr, Frame, lineterm);
-
-  delay(40);
-  if(isConnected()) {
-
-    if(Frame.verifyCRC()) {
-#if BT_LED == 1     
-      digitalWrite(LED_Pin, !digitalRead(LED_Pin)); // toggle LED
-#endif
-      std::string txData = pHdr;
-      txData.append((char*)Frame.Data, 24);
-
-      BLE_Send(txData);
-      delay(10);
-    }
-    else {
-      DebugPort.println("Data not sent to Bluetooth, CRC error!");
-    }
-  }
-  else {
-    DebugPort.println("No Bluetooth client");
-#if BT_LED == 1     
-    digitalWrite(LED_Pin, 0);
-#endif
-  }
-}
-*/
-bool 
-CBluetoothESP32BLE::send(const char* Str)
+// GATT server events, in the Bluetooth stack's task
+void
+CBluetoothESP32BLE::_gattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param)
 {
-  char fullMsg[32];
-
-  if(isConnected()) {
-
-#if BT_LED == 1     
-    digitalWrite(LED_Pin, !digitalRead(LED_Pin)); // toggle LED
-#endif
-    std::string txData = Str;
-
-    BLE_Send(txData);
-    delay(10);
-    return true;
-  }
-  else {
-    DebugPort.println("No Bluetooth client");
-#if BT_LED == 1     
-    digitalWrite(LED_Pin, 0);
-#endif
-    return false;
+  CBluetoothESP32BLE* pThis = _pInstance;
+  if(pThis == NULL) 
+    return;
+
+  switch(event) {
+    case ESP_GATTS_MTU_EVT:
+      pThis->_MTU = param->mtu.mtu;
+      break;
+    case ESP_GATTS_CONF_EVT:
+      // notification has been handed to L2CAP
+      if(param->conf.status == ESP_GATT_CONGESTED) 
+        pThis->_congested = true;
+      xSemaphoreGive(pThis->_txCredits);
+      break;
+    case ESP_GATTS_CONGEST_EVT:
+      pThis->_congested = param->congest.congested;
+      if(!pThis->_congested && pThis->_txTaskHandle) 
+        xTaskNotifyGive(pThis->_txTaskHandle);
+      break;
+    case ESP_GATTS_DISCONNECT_EVT:
+      pThis->_MTU = ESP_GATT_DEF_BLE_MTU_SIZE;
+      pThis->_congested = false;
+      while(xSemaphoreGive(pThis->_txCredits));   // restore all credits
+      if(pThis->_txTaskHandle) 
+        xTaskNotifyGive(pThis->_txTaskHandle);
+      break;
+    default:
+      break;
   }
 }
 
@@ -315,18 +659,31 @@ CBluetoothESP32BLE::check()
 
 }
 
-// break down supplied string into 20 byte chunks (or less)
-// BLE can only handle 20 bytes per packet!
-void 
-CBluetoothESP32BLE::BLE_Send(std::string Data)
-{
-  while(!Data.empty()) {
-    std::string substr = Data.substr(0, 20);
-    int len = substr.length();    
-    _pTxCharacteristic->setValue((uint8_t*)Data.data(), len);
-    _pTxCharacteristic->notify();
-    Data.erase(0, len);
+int
+CBluetoothESP32BLE::_getChunkSize()
+{
+  int size = _MTU - 3;    // ATT notification header
+  UPPERLIMIT(size, BT_TX_MAXCHUNK);
+  return size;
+}
+
+// called from the TX task, paced by the GATT server events
+bool
+CBluetoothESP32BLE::_sendChunk(const uint8_t* data, int len)
+{
+  if(!_deviceConnected) 
+    return false;
+
+  if(_congested) {
+    _stats.congested++;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BT_TX_TIMEOUT));   // until ESP_GATTS_CONGEST_EVT clears
   }
+  // limit the notifications queued inside the stack
+  xSemaphoreTake(_txCredits, pdMS_TO_TICKS(BT_TX_TIMEOUT));
+
+  _pTxCharacteristic->setValue((uint8_t*)data, len);
+  _pTxCharacteristic->notify();
+  return true;
 }
 
 //                              ^
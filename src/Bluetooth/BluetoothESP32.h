@@ -22,22 +22,106 @@
 
 #include "BluetoothHC05.h"
 #include "BluetoothSerial.h"
+#include "../cfg/BTCConfig.h"
 
+#include <driver/uart.h>
+#include <freertos/ringbuf.h>
+
+struct sHC05Stats {
+  uint32_t rxEvents;          // task wakeups with data
+  uint32_t rxBytes;           // bytes read from the UART driver
+  uint32_t commands;          // complete commands handed to loop()
+  uint32_t dropped;           // commands lost, loop() had fallen behind
+  uint32_t truncated;         // commands discarded, they overran the line buffer
+  uint32_t overflows;         // UART FIFO / buffer overflows
+  uint32_t txMessages;        // messages queued by send()
+  uint32_t txBytes;           // bytes queued by send()
+};
+
+// Once the HC-05 is in data mode the IDF UART driver owns Serial2.
+// A task sleeps on the driver's event queue, reads whatever has arrived in
+// one go and passes each complete JSON command to loop() via a ring buffer.
+// send() copies into the driver's TX ring, which the UART ISR drains.
+// AT commands and test mode hand the port back to the Arduino HAL.
 class CBluetoothESP32HC05 : public CBluetoothHC05 {
+private:
   int _rxPin, _txPin;
+  int _baudrate;
+  QueueHandle_t _uartQueue;         // UART driver events, NULL whilst the HAL owns the port
+  RingbufHandle_t _cmdRing;         // complete commands awaiting loop()
+  bool _bRxTruncated;               // the command being collected overran _rxLine
+  TaskHandle_t _taskHandle;
+  volatile int _runState;
+  sHC05Stats _stats;
+  static void _staticTask(void* arg);
+  void _task();
+  void _collectRxBlock(const char* data, int len);
+  void _startDriver();
+  void _stopDriver();
 public:
   CBluetoothESP32HC05(int keyPin, int sensePin, int rxPin, int txPin);
+  void begin();
+  bool send(const char* Str);
+  void check();
+  const char* getMAC();
+  bool test(char val);
+  void report();
+  const sHC05Stats& getStats() const { return _stats; };
+  void resetStats();
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
 protected:
   void _openSerial(int baudrate);
 };
 
+#if USE_CLASSIC_BLUETOOTH == 1 || USE_BLE_BLUETOOTH == 1
+
+#include <freertos/ringbuf.h>
+
+struct sBTtxStats {
+  uint32_t messages;          // messages queued by send()
+  uint32_t bytes;             // bytes queued by send()
+  uint32_t chunks;            // blocks handed to the stack
+  int      maxChunk;          // largest block handed to the stack
+  uint32_t overflows;         // messages dropped, TX ring was full
+  uint32_t discarded;         // queued bytes dropped as the client had gone
+  uint32_t congested;         // waits for the stack to clear congestion
+};
+
+// Transmit path shared by the ESP32's own Bluetooth stacks.
+// send() only copies the message into a byte ring, so loop() never waits on 
+// the radio. A task feeds the stack in the largest blocks the link accepts,
+// paced by the stack's events rather than fixed delays.
+class CBluetoothESP32Queued : public CBluetoothAbstract {
+  static void _staticTxTask(void* arg);
+  void _txTask();
+protected:
+  RingbufHandle_t _txRing;
+  TaskHandle_t _txTaskHandle;
+  sBTtxStats _stats;
+  void _startTx(const char* taskName);
+  virtual int  _getChunkSize() = 0;                          // largest block the link accepts now
+  virtual bool _sendChunk(const uint8_t* data, int len) = 0;  // false if no client
+public:
+  CBluetoothESP32Queued();
+  virtual bool send(const char* Str);
+  virtual void report();
+  const sBTtxStats& getStats() const { return _stats; };
+  void resetStats();
+  TaskHandle_t getTaskHandle() const { return _txTaskHandle; };
+};
+
+#endif
+
 #if USE_CLASSIC_BLUETOOTH == 1
 
-class CBluetoothESP32Classic : public CBluetoothAbstract {
+class CBluetoothESP32Classic : public CBluetoothESP32Queued {
+private:
   BluetoothSerial SerialBT;
+protected:
+  int  _getChunkSize() { return BT_TX_MAXCHUNK; };
+  bool _sendChunk(const uint8_t* data, int len);
 public:
   virtual void begin();
-  virtual bool send(const char* Str);
   virtual void check();
   virtual bool isConnected();
 };
@@ -51,7 +135,8 @@ public:
 #include <BLEUtils.h>
 #include <BLE2902.h>
 
-class CBluetoothESP32BLE : public CBluetoothAbstract {
+class CBluetoothESP32BLE : public CBluetoothESP32Queued {
+private:
   const char* SERVICE_UUID = "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"; // UART service UUID
   const char* CHARACTERISTIC_UUID_RX = "6E400002-B5A3-F393-E0A9-E50E24DCCA9E";
   const char* CHARACTERISTIC_UUID_TX = "6E400003-B5A3-F393-E0A9-E50E24DCCA9E";
@@ -59,12 +144,19 @@ class CBluetoothESP32BLE : public CBluetoothAbstract {
   BLECharacteristic* _pTxCharacteristic;
   volatile bool _deviceConnected;
   bool _oldDeviceConnected;
-  void BLE_Send(std::string Data);
+  // link state, from the GATT server events
+  volatile int _MTU;
+  volatile bool _congested;
+  SemaphoreHandle_t _txCredits;     // notifications the stack will take before we wait
+  static CBluetoothESP32BLE* _pInstance;
+  static void _gattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param);
+protected:
+  int  _getChunkSize();
+  bool _sendChunk(const uint8_t* data, int len);
 public:
   CBluetoothESP32BLE();
   virtual ~CBluetoothESP32BLE();
   virtual void begin();
-  virtual bool send(const char* Str);
   virtual void check();
   virtual bool isConnected();
 
@@ -44,7 +44,6 @@ class CBluetoothHC05 : public CBluetoothAbstract {
   CModerator foldbackModerator;
   char _MAC[32];
   bool _bTest;
-  bool _bGotMAC;
   int _BTbaudIdx;
 public:
   CBluetoothHC05(int keyPin, int sensePin);
@@ -55,6 +54,7 @@ public:
   const char* getMAC();
   virtual bool test(char);   // returns true whilst test mode is active
 protected:
+  bool _bGotMAC;
   virtual void _openSerial(int baudrate);
   virtual void _foldbackDesiredTemp();
   void _flush();
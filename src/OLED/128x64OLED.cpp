@@ -23,6 +23,7 @@
 #include "128x64OLED.h"
 #include "../Utility/DebugPort.h"
 #include "../Utility/UtilClasses.h"
+#include "../Utility/I2CBus.h"
 
 #define DBG DebugPort.print
 #define DBGln DebugPort.println
@@ -58,6 +59,10 @@
 C128x64_OLED::C128x64_OLED(int8_t DC, int8_t CS, int8_t RST) : OLED_BASE_CLASS(DC, CS, RST)
 {
 	m_pFontInfo = NULL;
+  clearDrawStats();
+#if USE_ADAFRUIT_SH1106 == 1
+  _init();
+#endif
 }
 
 // I2C constructor - note important difference in the parameters of the base classes here!!!
@@ -68,8 +73,245 @@ C128x64_OLED::C128x64_OLED(int8_t SDA, int8_t SCL) : Adafruit_SSD1306(128, 64)
 #endif
 {
 	m_pFontInfo = NULL;
+  clearDrawStats();
+#if USE_ADAFRUIT_SH1106 == 1
+  _init();
+#endif
+}
+
+#if USE_ADAFRUIT_SH1106 == 1
+
+void
+C128x64_OLED::_init()
+{
+  memset(_panel, 0, sizeof(_panel));
+  memset(&_last, 0, sizeof(_last));
+  memset(&_total, 0, sizeof(_total));
+  _bFullRefresh = true;   // panel RAM content is unknown after power up
+  _bReport = false;
+  _flushes = 0;
+  _reported = 0;
+#if USE_OLED_FLUSH_TASK == 1
+  _pFill = _slots[0];
+  _pPending = _slots[1];
+  _pWork = _slots[2];
+  _frameMux = portMUX_INITIALIZER_UNLOCKED;
+  _taskHandle = NULL;
+  _frameSeq = 0;
+  _sentSeq = 0;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Dirty region refresh
+//
+// Screens redraw from scratch every update (clearDisplay() then draw), so tracking writes 
+// into the framebuffer would flag almost everything as dirty. Instead the framebuffer is 
+// compared against a copy of what was last sent, and for each of the 8 pages only the span 
+// from the first to the last changed column is sent.
+// A blinking header icon now costs a handful of bytes rather than the entire 1kB.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+C128x64_OLED::display()
+{
+#if USE_OLED_FLUSH_TASK == 1
+  if(_taskHandle) {
+    _reportRefresh();     // the task's previous refresh
+    memcpy(_pFill, getBuffer(), sizeof(_slots[0]));    // the fill slot is only ours, no lock needed
+    portENTER_CRITICAL(&_frameMux);
+    uint8_t* pFrame = _pPending;    // latest frame always wins
+    _pPending = _pFill;
+    _pFill = pFrame;
+    _frameSeq++;
+    portEXIT_CRITICAL(&_frameMux);
+    xTaskNotifyGive(_taskHandle);
+    return;
+  }
+#endif
+  _flush(getBuffer());
+  _reportRefresh();
+}
+
+void
+C128x64_OLED::_flush(const uint8_t* pFrame)
+{
+  const int pageWidth = 128;
+  unsigned long tStart = micros();
+  sOLEDRefreshStats stats;
+
+  memset(&stats, 0, sizeof(stats));
+
+  for(int page = 0; page < 8; page++) {
+    const uint8_t* pNew = &pFrame[page * pageWidth];
+    uint8_t* pOld = &_panel[page * pageWidth];
+    int first = 0;
+    int last = pageWidth - 1;
+    if(!_bFullRefresh) {
+      while(first < pageWidth && pNew[first] == pOld[first]) 
+        first++;
+      if(first == pageWidth) 
+        continue;    // page unchanged
+      while(pNew[last] == pOld[last]) 
+        last--;
+    }
+    int len = last - first + 1;
+    {
+      CI2CLock lock(I2C_OLED);    // hold the bus per span, so RTC and BME280 accesses can interleave
+      stats.bytes += displayPage(page, first, len, pFrame);
+    }
+    stats.spans++;
+    memcpy(&pOld[first], &pNew[first], len);
+  }
+  _bFullRefresh = false;
+
+  stats.time_us = micros() - tStart;
+
+#if USE_OLED_FLUSH_TASK == 1
+  portENTER_CRITICAL(&_frameMux);
+#endif
+  _last = stats;
+  _total.bytes += stats.bytes;
+  _total.time_us += stats.time_us;
+  _total.spans += stats.spans;
+  _flushes++;
+#if USE_OLED_FLUSH_TASK == 1
+  portEXIT_CRITICAL(&_frameMux);
+#endif
+}
+
+// called from loop(), the flush task's stack is not sized for formatted output
+void
+C128x64_OLED::_reportRefresh()
+{
+  if(!_bReport)
+    return;
+
+#if USE_OLED_FLUSH_TASK == 1
+  portENTER_CRITICAL(&_frameMux);
+#endif
+  sOLEDRefreshStats stats = _last;
+  uint32_t flushes = _flushes;
+#if USE_OLED_FLUSH_TASK == 1
+  portEXIT_CRITICAL(&_frameMux);
+#endif
+
+  if(flushes != _reported) {
+    _reported = flushes;
+    if(stats.spans) {
+      DebugPort.printf("OLED refresh: %d spans, %d bytes, %dus\r\n", stats.spans, stats.bytes, stats.time_us);
+    }
+  }
+}
+
+#if USE_OLED_FLUSH_TASK == 1
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Display flush task
+//
+// display() snapshots the framebuffer and wakes this task, so loop() is never held up 
+// by the I2C transfer. Frames presented faster than they can be sent simply replace the 
+// pending snapshot.
+// Three snapshot slots rotate between loop(), the pending frame and the task, only 
+// the pointers are exchanged under the lock.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+C128x64_OLED::beginFlushTask()
+{
+  if(_taskHandle == NULL) {
+    xTaskCreate(_staticTask,
+                "OLEDflushTask",
+                TASK_STACK_OLED,
+                this,
+                TASK_PRIORITY_DISPLAY,
+                &_taskHandle);
+  }
+}
+
+void
+C128x64_OLED::_staticTask(void* arg)
+{
+  C128x64_OLED* pThis = (C128x64_OLED*)arg;
+  pThis->_task();
+  vTaskDelete(NULL);
+}
+
+void
+C128x64_OLED::_task()
+{
+  for(;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    portENTER_CRITICAL(&_frameMux);
+    uint32_t seq = _frameSeq;
+    bool fresh = (seq != _sentSeq);
+    if(fresh) {
+      uint8_t* pFrame = _pWork;
+      _pWork = _pPending;
+      _pPending = pFrame;
+    }
+    portEXIT_CRITICAL(&_frameMux);
+
+    if(fresh) 
+      _flush(_pWork);
+    _sentSeq = seq;
+  }
+}
+
+TaskHandle_t
+C128x64_OLED::getFlushTaskHandle() const
+{
+  return _taskHandle;
+}
+
+bool
+C128x64_OLED::isFlushing() const
+{
+  return _taskHandle && (_sentSeq != _frameSeq);
+}
+
+void
+C128x64_OLED::waitFlush(unsigned long timeout)
+{
+  unsigned long tStart = millis();
+  while(isFlushing() && (millis() - tStart) < timeout) {
+    vTaskDelay(1);
+  }
+}
+
+#else
+
+void
+C128x64_OLED::beginFlushTask()
+{
 }
 
+TaskHandle_t
+C128x64_OLED::getFlushTaskHandle() const
+{
+  return NULL;
+}
+
+bool
+C128x64_OLED::isFlushing() const
+{
+  return false;
+}
+
+void
+C128x64_OLED::waitFlush(unsigned long timeout)
+{
+}
+
+#endif
+
+#endif
+
 
 size_t C128x64_OLED::write(uint8_t c) 
 {
@@ -97,6 +339,30 @@ size_t C128x64_OLED::write(uint8_t c)
 #endif
 }
 
+#if USE_DRAW_STATS == 1
+// the base class primitives, counted
+void
+C128x64_OLED::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  _draws.pixels++;
+  OLED_BASE_CLASS::drawPixel(x, y, color);
+}
+
+void
+C128x64_OLED::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  _draws.lines++;
+  OLED_BASE_CLASS::drawFastVLine(x, y, h, color);
+}
+
+void
+C128x64_OLED::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  _draws.lines++;
+  OLED_BASE_CLASS::drawFastHLine(x, y, w, color);
+}
+#endif
+
 void C128x64_OLED::getTextExtents(const char* str, CRect& rect)
 {
   rect.width = 0;
@@ -132,6 +398,9 @@ C128x64_OLED::drawDotFactoryChar(int16_t x, int16_t y, uint8_t c, uint16_t color
 #endif
 
   if(c >= pFontDescriptor->StartChar && c <= pFontDescriptor->EndChar) {
+#if USE_DRAW_STATS == 1
+    _draws.glyphs++;
+#endif
 
 #ifdef DEBUG_FONT
   	char pr = c;
@@ -158,22 +427,101 @@ C128x64_OLED::drawDotFactoryChar(int16_t x, int16_t y, uint8_t c, uint16_t color
 	  delay(1000);
 #endif
 
-    uint8_t mask = 0x80;
-    uint8_t line = 0;
-	  for(int8_t j=0; j < xsize/*pCharInfo->Width*/; j++) {
-      for (int8_t i=0; i < ysize/*pCharInfo->Height*/; i++ ) {
-    	  if((i & 0x07) == 0) {
-	        line = pgm_read_byte(pBitmap++);
-    	  }
-        if(line & mask) {
-          drawPixel(x+j, y+i, color);
+    if(getRotation() != 0) {
+      // rotated displays are rare - use the generic pixel by pixel path
+      uint8_t mask = 0x80;
+      uint8_t line = 0;
+      for(int8_t j=0; j < xsize/*pCharInfo->Width*/; j++) {
+        for (int8_t i=0; i < ysize/*pCharInfo->Height*/; i++ ) {
+          if((i & 0x07) == 0) {
+            line = pgm_read_byte(pBitmap++);
+          }
+          if(line & mask) {
+            drawPixel(x+j, y+i, color);
+          }
+          else if(bg != color) {
+            drawPixel(x+j, y+i, bg);
+          }
+          line <<= 1;
+        }
+      }
+      return;
+    }
+
+    // Byte blitter
+    // Dot Factory bitmaps are column major, each column starting on a fresh byte with the 
+    // top pixel in the MSB. The framebuffer is page major with the top pixel in the LSB.
+    // Each bitmap byte is therefore an 8 pixel vertical strip: bit reverse it, then 
+    // shift it across the (up to) two pages it straddles when y is not page aligned.
+    uint8_t* pBuffer = getBuffer();
+    const int bytesPerCol = (ysize + 7) / 8;
+    for(int j = 0; j < xsize; j++, pBitmap += bytesPerCol) {
+      int xPos = x + j;
+      if(xPos < 0 || xPos >= WIDTH)
+        continue;
+      uint8_t* pCol = &pBuffer[xPos];
+      for(int k = 0; k < bytesPerCol; k++) {
+        int rows = ysize - k*8;
+        uint8_t strip = 0xff;                         // which pixels of this byte belong to the glyph
+        if(rows < 8) 
+          strip >>= (8 - rows);
+        uint8_t bits = _reverseBits(pgm_read_byte(&pBitmap[k])) & strip;
+        int yPos = y + k*8;
+        int page = yPos >> 3;                         // arithmetic shift - floors negative y
+        int shift = yPos & 0x07;
+        if(page >= 0 && page < HEIGHT/8) {
+          _blitByte(pCol[page*WIDTH], bits << shift, (strip & ~bits) << shift, color, bg);
         }
-        else if(bg != color) {
-          drawPixel(x+j, y+i, bg);
+        if(shift && (page+1) >= 0 && (page+1) < HEIGHT/8) {
+          _blitByte(pCol[(page+1)*WIDTH], bits >> (8-shift), (strip & ~bits) >> (8-shift), color, bg);
         }
-        line <<= 1;
-  	  }
-	  }
+      }
+    }
+  }
+}
+
+uint8_t
+C128x64_OLED::_reverseBits(uint8_t val)
+{
+  val = ((val & 0xf0) >> 4) | ((val & 0x0f) << 4);
+  val = ((val & 0xcc) >> 2) | ((val & 0x33) << 2);
+  val = ((val & 0xaa) >> 1) | ((val & 0x55) << 1);
+  return val;
+}
+
+// apply foreground and background pixels to a framebuffer byte, same rules as drawPixel()
+void
+C128x64_OLED::_blitByte(uint8_t& dest, uint8_t fgBits, uint8_t bgBits, uint16_t color, uint16_t bg)
+{
+  switch(color) {
+    case WHITE:   dest |= fgBits; break;
+    case BLACK:   dest &= ~fgBits; break;
+    case INVERSE: dest ^= fgBits; break;
+  }
+  if(bg != color) {
+    switch(bg) {
+      case WHITE:   dest |= bgBits; break;
+      case BLACK:   dest &= ~bgBits; break;
+      case INVERSE: dest ^= bgBits; break;
+    }
+  }
+}
+
+// Plain (P1) PBM - paste the capture into a .pbm file to view or diff screen layouts
+void
+C128x64_OLED::dumpPBM()
+{
+  const uint8_t* pBuffer = getBuffer();
+  char line[128 + 3];
+  DebugPort.printf("P1\r\n%d %d\r\n", WIDTH, HEIGHT);
+  for(int y = 0; y < HEIGHT; y++) {
+    const uint8_t* pPage = &pBuffer[(y >> 3) * WIDTH];
+    uint8_t mask = 0x01 << (y & 0x07);
+    for(int x = 0; x < WIDTH; x++) {
+      line[x] = (pPage[x] & mask) ? '1' : '0';
+    }
+    strcpy(&line[WIDTH], "\r\n");
+    DebugPort.print(line);
   }
 }
 
@@ -34,12 +34,54 @@
 #endif
 
 #include "fonts/FontTypes.h"
+#include <FreeRTOS.h>
 //#include "../Utility/UtilClasses.h"
 
 struct CRect;
 
+struct sOLEDRefreshStats {
+  uint32_t bytes;      // bytes placed onto the bus
+  uint32_t time_us;    // time spent on the bus
+  uint32_t spans;      // number of page spans sent
+};
+
+// what a screen's drawing cost in framebuffer operations, counted if USE_DRAW_STATS is 1
+// rectangles, fills and outlines arrive as lines, bitmaps as pixels
+struct sOLEDDrawStats {
+  uint32_t pixels;     // drawPixel() calls
+  uint32_t lines;      // fast horizontal and vertical lines
+  uint32_t glyphs;     // Dot Factory characters blitted
+};
+
 class C128x64_OLED : public OLED_BASE_CLASS {
 	const FONT_INFO* m_pFontInfo;
+  sOLEDDrawStats _draws;
+#if USE_ADAFRUIT_SH1106 == 1
+  uint8_t _panel[128 * 64 / 8];   // copy of what was last sent to the panel
+  bool _bFullRefresh;
+  bool _bReport;
+  sOLEDRefreshStats _last;
+  sOLEDRefreshStats _total;
+  uint32_t _flushes;              // refreshes completed
+  uint32_t _reported;             // refreshes reported
+  void _init();
+  void _flush(const uint8_t* pFrame);
+  void _reportRefresh();
+#if USE_OLED_FLUSH_TASK == 1
+  uint8_t _slots[3][128 * 64 / 8];  // snapshots, rotated by pointer between the roles below
+  uint8_t* _pFill;                // loop()'s, being copied from the framebuffer
+  uint8_t* _pPending;             // latest complete snapshot
+  uint8_t* _pWork;                // flush task's, being sent
+  portMUX_TYPE _frameMux;
+  TaskHandle_t _taskHandle;
+  volatile uint32_t _frameSeq;    // frames handed over
+  volatile uint32_t _sentSeq;     // frames sent
+  static void _staticTask(void* arg);
+  void _task();
+#endif
+#endif
+  static uint8_t _reverseBits(uint8_t val);
+  static void _blitByte(uint8_t& dest, uint8_t fgBits, uint8_t bgBits, uint16_t color, uint16_t bg);
 public:
   C128x64_OLED(int8_t DC, int8_t CS, int8_t RST);    // Hardware SPI constructor
   C128x64_OLED(int8_t SDA, int8_t SCL);              // I2C constructor
@@ -59,6 +101,29 @@ public:
   int  textHeight();
 
   size_t write(uint8_t c);
+#if USE_DRAW_STATS == 1
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+#endif
+  const sOLEDDrawStats& getDrawStats() const { return _draws; };
+  void clearDrawStats() { memset(&_draws, 0, sizeof(_draws)); };
+  void dumpPBM();      // send framebuffer to the debug port as a plain PBM image
+
+#if USE_ADAFRUIT_SH1106 == 1
+  // only sends the page column spans that differ from what is already on the panel
+  // with the flush task running this only snapshots the framebuffer, the task does the I2C
+  void display();
+  void beginFlushTask();
+  TaskHandle_t getFlushTaskHandle() const;
+  bool isFlushing() const;
+  void waitFlush(unsigned long timeout = 100);
+  void invalidate() { _bFullRefresh = true; };
+  const sOLEDRefreshStats& getLastRefresh() const { return _last; };
+  const sOLEDRefreshStats& getTotalRefresh() const { return _total; };
+  void reportRefresh(bool state) { _bReport = state; };
+  bool isReportingRefresh() const { return _bReport; };
+#endif
 };
 
 #endif  // __128x64OLED_H__
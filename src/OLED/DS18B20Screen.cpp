@@ -30,6 +30,7 @@
 CDS18B20Screen::CDS18B20Screen(C128x64_OLED& display, CScreenManager& mgr) : CPasswordScreen(display, mgr) 
 {
   _nNumSensors = 0;
+  _scanCount = -1;
   for(int i=0; i<3; i++) {
     _sensorRole[i] = -1;
     _Offset[i] = 0;
@@ -41,7 +42,7 @@ void
 CDS18B20Screen::onSelect()
 {
   CPasswordScreen::onSelect();
-  _nNumSensors = getTempSensor().getDS18B20().getNumSensors();
+  _nNumSensors = _getNumSensors();
   _readNV();
 }
 
@@ -58,6 +59,13 @@ CDS18B20Screen::show()
 {
   char msg[32];
 
+  if(_scanCount >= 0 && _scanCount != getTempSensor().getScanCount()) {
+    // requested rescan of the one wire bus has completed
+    _scanCount = -1;
+    _nNumSensors = _getNumSensors();
+    _readNV();
+  }
+
   _display.clearDisplay();
 
   if(!CPasswordScreen::show()) {  // for showing "saving settings"
@@ -100,7 +108,7 @@ CDS18B20Screen::show()
 
       if(_colSel == 0) {
         float temperature;
-        getTempSensor().getDS18B20().getTemperatureIdx(sensor, temperature, false);
+        getTempSensor().getTemperatureDS18B20Idx(sensor, temperature);
         sprintf(msg, "%.01f`C", temperature + _Offset[sensor]);
       }
       else {
@@ -176,10 +184,9 @@ CDS18B20Screen::keyHandler(uint8_t event)
       _keyHold++;
       if(_keyHold == 2) {
         if(event & key_Up) {
-          // rescan the one wire bus
-          getTempSensor().getDS18B20().find();
-          _nNumSensors = getTempSensor().getDS18B20().getNumSensors();
-          _readNV();
+          // rescan the one wire bus - performed by the sensor task, picked up in show()
+          _scanCount = getTempSensor().getScanCount();
+          getTempSensor().requestRescan();
         }
         if(event & key_Left) {
           _colSel = 0;
@@ -315,6 +322,15 @@ CDS18B20Screen::_testCancel()
 }
 
 
+int
+CDS18B20Screen::_getNumSensors()
+{
+  // this screen edits the Primary, Secondary and Tertiary roles of the first three probes
+  int numSensors = getTempSensor().getDS18B20().getNumSensors();
+  UPPERLIMIT(numSensors, 3);
+  return numSensors;
+}
+
 void
 CDS18B20Screen::_readNV() 
 {
@@ -323,7 +339,7 @@ CDS18B20Screen::_readNV()
 
   const sHeaterTuning& tuning = NVstore.getHeaterTuning();
   
-  for(int sensor = 0; sensor < getTempSensor().getDS18B20().getNumSensors(); sensor++) {
+  for(int sensor = 0; sensor < _nNumSensors; sensor++) {
     // read list of DS18B20s from temp sensor class
     OneWireBus_ROMCode romCode;
     getTempSensor().getDS18B20().getRomCodeIdx(sensor, romCode); // get rom code of each attached sensor
@@ -352,11 +368,16 @@ CDS18B20Screen::_saveNV()
     tuning.DS18B20probe[i].offset = 0;
   }
 
-  for(int sensor = 0; sensor < getTempSensor().getDS18B20().getNumSensors(); sensor++) { 
+  for(int sensor = 0; sensor < _nNumSensors; sensor++) { 
     int role = _sensorRole[sensor];  // role of probe determines placement in NV storage
     if(role != -1) {
       OneWireBus_ROMCode romCode;
       getTempSensor().getDS18B20().getRomCodeIdx(sensor, romCode); // get rom code of indexed sensor
+      for(int i=3; i<MAX_DS18B20_DEVICES; i++) {
+        // drop any role beyond those edited here that was held by this probe
+        if(memcmp(tuning.DS18B20probe[i].romCode.bytes, romCode.bytes, 8) == 0)
+          memset(tuning.DS18B20probe[i].romCode.bytes, 0, 8);
+      }
       memcpy(tuning.DS18B20probe[role].romCode.bytes, romCode.bytes, 8);
       tuning.DS18B20probe[role].offset = _Offset[sensor];
     }
@@ -364,10 +385,6 @@ CDS18B20Screen::_saveNV()
   NVstore.setHeaterTuning(tuning);
   NVstore.save();
 
-  getTempSensor().getDS18B20().mapSensor(-1);   // reset existing mapping
-  getTempSensor().getDS18B20().mapSensor(0, NVstore.getHeaterTuning().DS18B20probe[0].romCode);
-  getTempSensor().getDS18B20().mapSensor(1, NVstore.getHeaterTuning().DS18B20probe[1].romCode);
-  getTempSensor().getDS18B20().mapSensor(2, NVstore.getHeaterTuning().DS18B20probe[2].romCode);
-  getTempSensor().getDS18B20().mapSensor(-2);   // report mapping
+  getTempSensor().mapRoles();
 
 }
\ No newline at end of file
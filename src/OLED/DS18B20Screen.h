@@ -34,11 +34,13 @@ class CDS18B20Screen : public CPasswordScreen
   int  _keyHold;
   int  _scrollChar;
   int  _nNumSensors;
+  int  _scanCount;     // pending rescan completes when the sensor task's scan count moves on, -1 if none
   int  _sensorRole[3];
   float _Offset[3];
   void _initUI();
   void _testCancel();
   void _readNV();
+  int  _getNumSensors();
   void _saveNV();
 public:
   CDS18B20Screen(C128x64_OLED& display, CScreenManager& mgr);
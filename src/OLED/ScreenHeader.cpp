@@ -398,7 +398,7 @@ CScreenHeader::showTimers()
   int nextTimer = CTimerManager::getNextTimer();   // timer ID and repeat flag info of next scheduled timer
   if(nextTimer) {
     int xPos = X_TIMER_ICON;   
-    if(nextTimer & 0x80)
+    if(nextTimer & CTimerManager::_repeatFlag)
       _drawBitmap(xPos, Y_TIMER_ICON, TimerIconRptInfo);
     else
       _drawBitmap(xPos, Y_TIMER_ICON, TimerIconInfo);
@@ -407,12 +407,12 @@ CScreenHeader::showTimers()
       char msg[8];
       int activeTimer = CTimerManager::getActiveTimer();
       if(activeTimer) {
-        CTimerManager::getTimer((activeTimer - 1) & 0xf, timerInfo);
+        CTimerManager::getTimer((activeTimer & CTimerManager::_IDmask) - 1, timerInfo);
         sprintf(msg, "%02d:%02d", timerInfo.stop.hour, timerInfo.stop.min);
         _drawBitmap(xPos-5, Y_TIMER_ICON+12, miniStopIconInfo, WHITE, BLACK);
       }
       else {
-        CTimerManager::getTimer((nextTimer - 1) & 0xf, timerInfo);
+        CTimerManager::getTimer((nextTimer & CTimerManager::_IDmask) - 1, timerInfo);
         sprintf(msg, "%02d:%02d", timerInfo.start.hour, timerInfo.start.min);
         _drawBitmap(xPos-5, Y_TIMER_ICON+12, miniStartIconInfo, WHITE, BLACK);
       }
@@ -55,6 +55,7 @@
 #include "433MHzScreen.h"
 #include "LVCScreen.h"
 #include <Wire.h>
+#include "../Utility/I2CBus.h"
 #include "../cfg/pins.h"
 #include "../cfg/BTCConfig.h"
 #include "KeyPad.h"
@@ -89,6 +90,7 @@ struct sBMPhdr {
 #pragma pack (pop)
 
 extern CScreenManager ScreenManager;
+static portMUX_TYPE bootMsgMux = portMUX_INITIALIZER_UNLOCKED;   // boot messages are posted by other tasks
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // splash creen created using image2cpp http://javl.github.io/image2cpp/
@@ -294,18 +296,20 @@ CScreenManager::CScreenManager()
   _bDimmed = false;
   _bReload = true;
   _OTAholdoff = 0;
+  _splashHoldoff = 0;
+  _bSplashHold = false;
+  _bootMsg[0] = 0;
+  _bootWait = 0;
+  _bBootMsg = false;
+  _bootMsgTime = 0;
+  _useCount = 0;
+  memset(_screenState, 0, sizeof(_screenState));
+  memset(&_lastRender, 0, sizeof(_lastRender));
 }
 
 CScreenManager::~CScreenManager()
 {
-	for(int i=0; i < _Screens.size(); i++) {
-  	for(int j=0; j < _Screens[i].size(); j++) {
-  		if(_Screens[i][j]) {
-			  delete _Screens[i][j];
-			  _Screens[i][j] = NULL;
-		  }
-    }
-  }
+  _unloadScreens();
   if(_pDisplay) {
     delete _pDisplay; _pDisplay = NULL;
   }
@@ -329,135 +333,192 @@ CScreenManager::begin()
 
   // replace adafruit splash screen
   showSplash();
+  // held by checkUpdate() rather than a delay here, the boot carries on meanwhile
+  _bSplashHold = true;
 
-  delay(2000);
+  // from here on frames are sent to the OLED in the background
+  _pDisplay->beginFlushTask();
 
   _loadScreens();
 }
 
 void CScreenManager::_unloadScreens()
 {
-  for (auto menuloop  : _Screens) {
-    for(auto menu : menuloop) {
-      delete menu;
-    }
+  for(auto& entry : _cache) {
+    delete entry.pScreen;
   }
+  _cache.clear();
   _Screens.clear();
 }
 
+///////////////////////////////////////////////////////////////////////////
+//
+// Screen registry
+//
+// _Screens holds a factory for every screen in each menu loop, screens are 
+// only constructed when navigated to. The most recently used screens are
+// kept (OLED_SCREEN_CACHE), older ones are destroyed by _trimScreens().
+// Trimming is only performed outside of screen methods, as a screen's 
+// keyHandler() commonly navigates away then continues to use its members.
+//
+///////////////////////////////////////////////////////////////////////////
+
+template<class T> 
+CScreen* createScreen(C128x64_OLED& display, CScreenManager& mgr)
+{
+  return new T(display, mgr);
+}
+
+CScreen* createTimerChartScreen(C128x64_OLED& display, CScreenManager& mgr)
+{
+  return new CTimerChartScreen(display, mgr, 0);
+}
+
+CScreen* createSetTimerScreen(C128x64_OLED& display, CScreenManager& mgr)
+{
+  return new CSetTimerScreen(display, mgr, mgr.getScreenState(CScreenManager::TimerIDState));
+}
+
+CScreen* 
+CScreenManager::_getScreen(bool create)
+{
+  for(auto& entry : _cache) {
+    if(entry.menu == _menu && entry.subMenu == _subMenu) {
+      entry.lastUsed = ++_useCount;
+      return entry.pScreen;
+    }
+  }
+  if(!create)
+    return NULL;
+
+  sCachedScreen entry;
+  entry.menu = _menu;
+  entry.subMenu = _subMenu;
+  entry.lastUsed = ++_useCount;
+  entry.pScreen = _Screens[_menu][_subMenu](*_pDisplay, *this);
+  _cache.push_back(entry);
+  return entry.pScreen;
+}
+
+void 
+CScreenManager::_trimScreens()
+{
+  while(_cache.size() > OLED_SCREEN_CACHE) {
+    auto oldest = _cache.end();
+    for(auto it = _cache.begin(); it != _cache.end(); ++it) {
+      if(it->menu == _menu && it->subMenu == _subMenu)
+        continue;   // never the current screen
+      if(oldest == _cache.end() || it->lastUsed < oldest->lastUsed)
+        oldest = it;
+    }
+    if(oldest == _cache.end()) 
+      break;
+    delete oldest->pScreen;
+    _cache.erase(oldest);
+  }
+}
+
 void 
 CScreenManager::_loadScreens()
 {
   _unloadScreens();
 
   DebugPort.println("Creating Screens");
+  uint32_t heap = ESP.getFreeHeap();
 
-  std::vector<CScreen*> menuloop;
+  std::vector<tScreenFactory> menuloop;
   // create root menu loop
   if(NVstore.getUserSettings().menuMode == 0) {
-    menuloop.push_back(new CDetailedScreen(*_pDisplay, *this));         //  detail control
-    menuloop.push_back(new CBasicScreen(*_pDisplay, *this));            //  basic control
-    menuloop.push_back(new CClockScreen(*_pDisplay, *this));          //  clock
-    menuloop.push_back(new CPrimingScreen(*_pDisplay, *this));          //  mode / priming
+    menuloop.push_back(createScreen<CDetailedScreen>);         //  detail control
+    menuloop.push_back(createScreen<CBasicScreen>);            //  basic control
+    menuloop.push_back(createScreen<CClockScreen>);          //  clock
+    menuloop.push_back(createScreen<CPrimingScreen>);          //  mode / priming
     if(getBoardRevision() != 0 && getBoardRevision() != BRD_V2_NOGPIO)            // has GPIO support
-      menuloop.push_back(new CGPIOInfoScreen(*_pDisplay, *this));         //  GPIO info
-    menuloop.push_back(new CMenuTrunkScreen(*_pDisplay, *this));
+      menuloop.push_back(createScreen<CGPIOInfoScreen>);         //  GPIO info
+    menuloop.push_back(createScreen<CMenuTrunkScreen>);
   }
   else if(NVstore.getUserSettings().menuMode == 1) {
-    menuloop.push_back(new CMenuTrunkScreen(*_pDisplay, *this));
-    menuloop.push_back(new CBasicScreen(*_pDisplay, *this));            //  basic control
-    menuloop.push_back(new CClockScreen(*_pDisplay, *this));          //  clock
+    menuloop.push_back(createScreen<CMenuTrunkScreen>);
+    menuloop.push_back(createScreen<CBasicScreen>);            //  basic control
+    menuloop.push_back(createScreen<CClockScreen>);          //  clock
   }
   else if(NVstore.getUserSettings().menuMode == 2) {
-    menuloop.push_back(new CMenuTrunkScreen(*_pDisplay, *this));
-    menuloop.push_back(new CBasicScreen(*_pDisplay, *this));            //  basic control
-    menuloop.push_back(new CClockScreen(*_pDisplay, *this));          //  clock
+    menuloop.push_back(createScreen<CMenuTrunkScreen>);
+    menuloop.push_back(createScreen<CBasicScreen>);            //  basic control
+    menuloop.push_back(createScreen<CClockScreen>);          //  clock
     if(getBoardRevision() != 0 && getBoardRevision() != BRD_V2_NOGPIO)            // has GPIO support
-      menuloop.push_back(new CGPIOInfoScreen(*_pDisplay, *this));         //  GPIO info
+      menuloop.push_back(createScreen<CGPIOInfoScreen>);         //  GPIO info
   }
   _Screens.push_back(menuloop);
 
   // create timer screens loop
   menuloop.clear();
-  menuloop.push_back(new CTimerChartScreen(*_pDisplay, *this, 0)); // timer chart
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 0)); // set timer 1
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 1)); // set timer 2
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 2)); // set timer 3
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 3)); // set timer 4
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 4)); // set timer 5
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 5)); // set timer 6
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 6)); // set timer 7
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 7)); // set timer 8
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 8)); // set timer 9
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 9)); // set timer 10
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 10)); // set timer 11
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 11)); // set timer 12
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 12)); // set timer 13
-  menuloop.push_back(new CSetTimerScreen(*_pDisplay, *this, 13)); // set timer 14
+  menuloop.push_back(createTimerChartScreen); // timer chart
+  menuloop.push_back(createSetTimerScreen); // set timers, steps through all timers itself
   _Screens.push_back(menuloop);
 
   // create User Settings screens loop 
   menuloop.clear();
   if(NVstore.getUserSettings().menuMode == 0) {  // standard heater control menu set
-    menuloop.push_back(new CThermostatModeScreen(*_pDisplay, *this)); // thermostat settings screen
-    menuloop.push_back(new CFrostScreen(*_pDisplay, *this)); // frost mode screen
+    menuloop.push_back(createScreen<CThermostatModeScreen>); // thermostat settings screen
+    menuloop.push_back(createScreen<CFrostScreen>); // frost mode screen
     if(getTempSensor().getBME280().getCount()) {
-      menuloop.push_back(new CHumidityScreen(*_pDisplay, *this)); // humidity settings screen
+      menuloop.push_back(createScreen<CHumidityScreen>); // humidity settings screen
     }
-    menuloop.push_back(new CHomeMenuSelScreen(*_pDisplay, *this)); // Home menu settings screen
-    menuloop.push_back(new CTimeoutsScreen(*_pDisplay, *this)); // Other options screen
-    menuloop.push_back(new CMenuSelScreen(*_pDisplay, *this)); // Menu mode screen
+    menuloop.push_back(createScreen<CHomeMenuSelScreen>); // Home menu settings screen
+    menuloop.push_back(createScreen<CTimeoutsScreen>); // Other options screen
+    menuloop.push_back(createScreen<CMenuSelScreen>); // Menu mode screen
     if(getBoardRevision() != 0 && getBoardRevision() != BRD_V2_NOGPIO)   // has GPIO support ?
-      menuloop.push_back(new CGPIOSetupScreen(*_pDisplay, *this)); // GPIO settings screen
+      menuloop.push_back(createScreen<CGPIOSetupScreen>); // GPIO settings screen
   }
   else if(NVstore.getUserSettings().menuMode == 1) {  // "no fiddle" menu set
-    menuloop.push_back(new CMenuSelScreen(*_pDisplay, *this)); // Menu mode screen
+    menuloop.push_back(createScreen<CMenuSelScreen>); // Menu mode screen
   }
   else if(NVstore.getUserSettings().menuMode == 2) {  // no heater menu set
-    menuloop.push_back(new CNoHeaterHomeMenuSelScreen(*_pDisplay, *this)); // No Heater Home menu settings screen
-    menuloop.push_back(new CMenuSelScreen(*_pDisplay, *this)); // Menu mode screen
+    menuloop.push_back(createScreen<CNoHeaterHomeMenuSelScreen>); // No Heater Home menu settings screen
+    menuloop.push_back(createScreen<CMenuSelScreen>); // Menu mode screen
     // if(getBoardRevision() != 0 && getBoardRevision() != BRD_V2_NOGPIO)   // has GPIO support ?
-    //   menuloop.push_back(new CGPIOSetupScreen(*_pDisplay, *this)); // GPIO settings screen
+    //   menuloop.push_back(createScreen<CGPIOSetupScreen>); // GPIO settings screen
   }
   _Screens.push_back(menuloop);
 
   // create System Settings screens loop 
   if(NVstore.getUserSettings().menuMode == 0 || NVstore.getUserSettings().menuMode == 2) {
     menuloop.clear();
-    menuloop.push_back(new CVersionInfoScreen(*_pDisplay, *this)); // GPIO settings screen
-    menuloop.push_back(new CWebPageUpdateScreen(*_pDisplay, *this)); // Web Page update screen
+    menuloop.push_back(createScreen<CVersionInfoScreen>); // GPIO settings screen
+    menuloop.push_back(createScreen<CWebPageUpdateScreen>); // Web Page update screen
     if(NVstore.getUserSettings().menuMode == 0) {
-      menuloop.push_back(new CHourMeterScreen(*_pDisplay, *this)); // Hour Meter screen
-      menuloop.push_back(new CWiFiScreen(*_pDisplay, *this));
+      menuloop.push_back(createScreen<CHourMeterScreen>); // Hour Meter screen
+      menuloop.push_back(createScreen<CWiFiScreen>);
     }
-    menuloop.push_back(new CWiFiSTAScreen(*_pDisplay, *this));
-    menuloop.push_back(new CMQTTScreen(*_pDisplay, *this));
-    menuloop.push_back(new CBTScreen(*_pDisplay, *this));
-    menuloop.push_back(new C433MHzScreen(*_pDisplay, *this));
+    menuloop.push_back(createScreen<CWiFiSTAScreen>);
+    menuloop.push_back(createScreen<CMQTTScreen>);
+    menuloop.push_back(createScreen<CBTScreen>);
+    menuloop.push_back(createScreen<C433MHzScreen>);
     if(getTempSensor().getBME280().getCount()) {
-      menuloop.push_back(new CTempSensorScreen(*_pDisplay, *this));
-      menuloop.push_back(new CBME280Screen(*_pDisplay, *this));
+      menuloop.push_back(createScreen<CTempSensorScreen>);
+      menuloop.push_back(createScreen<CBME280Screen>);
     }
     else {
-      menuloop.push_back(new CDS18B20Screen(*_pDisplay, *this));
+      menuloop.push_back(createScreen<CDS18B20Screen>);
     }
     _Screens.push_back(menuloop);
   }
   
   // create heater tuning screens loop - password protected
   menuloop.clear();
-  menuloop.push_back(new CFuelMixtureScreen(*_pDisplay, *this));      //  mixture tuning
-  menuloop.push_back(new CHeaterSettingsScreen(*_pDisplay, *this));   // heater system tuning
-  menuloop.push_back(new CFuelCalScreen(*_pDisplay, *this));          // fuel pump calibration
-  menuloop.push_back(new CLVCScreen(*_pDisplay, *this));          // low volt cutout calibration
+  menuloop.push_back(createScreen<CFuelMixtureScreen>);      //  mixture tuning
+  menuloop.push_back(createScreen<CHeaterSettingsScreen>);   // heater system tuning
+  menuloop.push_back(createScreen<CFuelCalScreen>);          // fuel pump calibration
+  menuloop.push_back(createScreen<CLVCScreen>);          // low volt cutout calibration
   _Screens.push_back(menuloop);
 
   // create branch screens
   menuloop.clear();
-  menuloop.push_back(new CSetClockScreen(*_pDisplay, *this));         // clock set branch screen
-  menuloop.push_back(new CInheritSettingsScreen(*_pDisplay, *this));  // inherit OEM settings branch screen
-  menuloop.push_back(new CSettingsScreen(*_pDisplay, *this));         //  Tuning info
-  menuloop.push_back(new CDS18B20Screen(*_pDisplay, *this));
+  menuloop.push_back(createScreen<CSetClockScreen>);         // clock set branch screen
+  menuloop.push_back(createScreen<CInheritSettingsScreen>);  // inherit OEM settings branch screen
+  menuloop.push_back(createScreen<CSettingsScreen>);         //  Tuning info
+  menuloop.push_back(createScreen<CDS18B20Screen>);
   _Screens.push_back(menuloop);
 
   _menu = 0;
@@ -469,9 +530,11 @@ CScreenManager::_loadScreens()
   _subMenu = 1;
 #endif
   _bReload = false;
+  _cache.reserve(OLED_SCREEN_CACHE + 2);
   reqUpdate();
   _enterScreen();
   showSplash();
+  DebugPort.printf("Screens registered, heap used %d bytes\r\n", heap - ESP.getFreeHeap());
 }
 
 bool 
@@ -487,15 +550,55 @@ CScreenManager::_checkOTAholdoff()
   }
   return true;
 }
+bool 
+CScreenManager::_checkSplashHold()
+{
+  if(_bSplashHold || _splashHoldoff) {
+    long tDelta = millis() - _splashHoldoff;
+    if(_bSplashHold || tDelta < 0) {
+      if(_bBootMsg) {
+        _drawBootMsg();         // over the splash
+        _pDisplay->display();
+      }
+      return false;
+    }
+    _pDisplay->clearDisplay();
+    _pDisplay->display();   // blank screen
+    _splashHoldoff = 0;
+    reqUpdate();
+  }
+  return true;
+}
+
+// true whilst a boot message is to be drawn over the screens
+bool
+CScreenManager::_checkBootMsg()
+{
+  unsigned long now = millis();
+  portENTER_CRITICAL(&bootMsgMux);
+  bool expired = _bootMsgTime && !_bootWait && long(now - _bootMsgTime) >= BOOT_MSG_TIME;
+  if(expired)
+    _bootMsgTime = 0;
+  bool active = _bootMsgTime != 0;
+  portEXIT_CRITICAL(&bootMsgMux);
+  if(expired)
+    reqUpdate();    // redraw the screen without it
+  return active;
+}
+
 bool 
 CScreenManager::checkUpdate()
 {
-  if(!_checkOTAholdoff())
+  if(!_checkOTAholdoff() || !_checkSplashHold())
     return false;
 
+  bool bootMsg = _checkBootMsg();
+
   if(_bReload)
     _loadScreens();
 
+  _trimScreens();
+
   long dimTimeout = NVstore.getUserSettings().dimTime;
 
   // manage dimming or blanking the display, according to user defined inactivity interval
@@ -585,7 +688,13 @@ CScreenManager::checkUpdate()
       }
       else {
         if(_menu >= 0) {
-          _Screens[_menu][_subMenu]->show();
+          CScreen* pScreen = _getScreen();
+          _pDisplay->clearDrawStats();
+          unsigned long tStart = micros();
+          pScreen->show();
+          _reportRender("show", micros() - tStart);
+          if(bootMsg)
+            _drawBootMsg();
           _bReqUpdate = false;
           return true;
         }
@@ -604,7 +713,7 @@ CScreenManager::reqUpdate()
 bool 
 CScreenManager::animate()
 {
-  if(!_checkOTAholdoff())
+  if(!_checkOTAholdoff() || !_checkSplashHold())
     return false;
 
   if(_pRebootScreen) 
@@ -614,12 +723,47 @@ CScreenManager::animate()
     // no screen updates, we should be blanked!
     return false;
   
-  if(_menu >= 0) 
-    return _Screens[_menu][_subMenu]->animate();
+  if(_menu >= 0) {
+    CScreen* pScreen = _getScreen();
+    _pDisplay->clearDrawStats();
+    unsigned long tStart = micros();
+    bool retval = pScreen->animate();
+    if(retval) 
+      _reportRender("animate", micros() - tStart);
+    if(_checkBootMsg() && (retval || _bBootMsg)) {
+      _drawBootMsg();
+      retval = true;
+    }
+    return retval;
+  }
     
 	return false;
 }
 
+void
+CScreenManager::_reportRender(const char* action, unsigned long duration)
+{
+  _lastRender.menu = _menu;
+  _lastRender.subMenu = _subMenu;
+  _lastRender.time_us = duration;
+  _lastRender.draws = _pDisplay->getDrawStats();
+  if(isReportingRefresh()) {
+#if USE_DRAW_STATS == 1
+    DebugPort.printf("Screen %d.%d %s: %ldus, %d pixels, %d lines, %d glyphs\r\n", _menu, _subMenu, action, duration, 
+                     _lastRender.draws.pixels, _lastRender.draws.lines, _lastRender.draws.glyphs);
+#else
+    DebugPort.printf("Screen %d.%d %s: %ldus\r\n", _menu, _subMenu, action, duration);
+#endif
+  }
+}
+
+void
+CScreenManager::dumpFrame()
+{
+  if(_pDisplay) 
+    _pDisplay->dumpPBM();
+}
+
 void
 CScreenManager::refresh()
 {
@@ -627,11 +771,42 @@ CScreenManager::refresh()
 		_pDisplay->display();
 }
 
+TaskHandle_t
+CScreenManager::getDisplayTaskHandle()
+{
+  if(_pDisplay) 
+    return _pDisplay->getFlushTaskHandle();
+  return NULL;
+}
+
+void
+CScreenManager::toggleRefreshReporting()
+{
+#if USE_ADAFRUIT_SH1106 == 1
+  if(_pDisplay) {
+    _pDisplay->reportRefresh(!_pDisplay->isReportingRefresh());
+    const sOLEDRefreshStats& total = _pDisplay->getTotalRefresh();
+    DebugPort.printf("Toggled OLED refresh reporting %s (total %d bytes, %dms on bus)\r\n", 
+                     _pDisplay->isReportingRefresh() ? "ON" : "OFF", total.bytes, total.time_us / 1000);
+  }
+#endif
+}
+
+bool
+CScreenManager::isReportingRefresh()
+{
+#if USE_ADAFRUIT_SH1106 == 1
+  if(_pDisplay) 
+    return _pDisplay->isReportingRefresh();
+#endif
+  return false;
+}
+
 void 
 CScreenManager::_enterScreen()
 {
   if(_menu >= 0) 
-    _Screens[_menu][_subMenu]->onSelect();
+    _getScreen()->onSelect();
 		
   reqUpdate();
 }
@@ -639,8 +814,11 @@ CScreenManager::_enterScreen()
 void
 CScreenManager::_leaveScreen()
 {
-  if(_menu >= 0) 
-    _Screens[_menu][_subMenu]->onExit();
+  if(_menu >= 0) {
+    CScreen* pScreen = _getScreen(false);   // no need to construct a screen just to exit it
+    if(pScreen)
+      pScreen->onExit();
+  }
 
   _returnMenu = _menu;
   _returnSubMenu = _subMenu;
@@ -685,6 +863,9 @@ CScreenManager::prevMenu()
 void 
 CScreenManager::keyHandler(uint8_t event)
 {
+  if(_bSplashHold || _splashHoldoff)
+    return;   // still booting
+
   if(_bDimmed) {
     if(event & keyReleased) {
       _dim(false);
@@ -696,8 +877,10 @@ CScreenManager::keyHandler(uint8_t event)
   bumpTimeout();
 
   // call key handler for active screen
-  if(_menu >= 0) 
-    _Screens[_menu][_subMenu]->keyHandler(event);
+  if(_menu >= 0) {
+    _getScreen()->keyHandler(event);
+    _trimScreens();   // safe now the handler has returned
+  }
 }
 
 void
@@ -789,6 +972,7 @@ void
 CScreenManager::_dim(bool state)
 {
   _bDimmed = state;
+  CI2CLock lock(I2C_OLED);    // the flush task may be using the bus
   _pDisplay->dim(state);
 }
 
@@ -815,32 +999,62 @@ CScreenManager::showSplash()
   _pDisplay->display();
 }
 
+// The boot stages run in their own tasks, alongside loop(). They only post
+// their status here, loop() draws it - over the splash, then over the 
+// bottom line of the screens for BOOT_MSG_TIME.
 void
 CScreenManager::showBootMsg(const char* msg)
 {
+  unsigned long now = millis();
+  portENTER_CRITICAL(&bootMsgMux);
+  strncpy(_bootMsg, msg, sizeof(_bootMsg) - 1);
+  _bootMsg[sizeof(_bootMsg) - 1] = 0;
+  _bootMsgTime = now | 1;
+  _bBootMsg = true;
+  portEXIT_CRITICAL(&bootMsgMux);
+}
+
+void
+CScreenManager::showBootWait(int show)
+{
+  portENTER_CRITICAL(&bootMsgMux);
+  _bootWait = show ? (_bootWait & 0x03) + 1 : 0;   // frames 1 to 4
+  _bBootMsg = true;
+  portEXIT_CRITICAL(&bootMsgMux);
+}
+
+void
+CScreenManager::_drawBootMsg()
+{
+  char msg[sizeof(_bootMsg)];
+  portENTER_CRITICAL(&bootMsgMux);
+  strcpy(msg, _bootMsg);
+  int wait = _bootWait;
+  _bBootMsg = false;
+  portEXIT_CRITICAL(&bootMsgMux);
+
   CTransientFont AF(*_pDisplay, &arialItalic_7ptFontInfo);
   _pDisplay->fillRect(0, 50, 128, 14, BLACK);
   _pDisplay->setCursor(0, 50);
   _pDisplay->print(msg);
-  _pDisplay->display();
+  if(wait) {
+    BITMAP_INFO bitmap = hourGlassIcon0Info;
+    switch(wait) {
+      case 2: bitmap = hourGlassIcon1Info; break;
+      case 3: bitmap = hourGlassIcon2Info; break;
+      case 4: bitmap = hourGlassIcon3Info; break;
+    }
+    _pDisplay->fillRect(80, 50, bitmap.width, bitmap.height, BLACK);
+    _pDisplay->drawBitmap(80, 50, bitmap.pBitmap, bitmap.width, bitmap.height, WHITE); 
+  }
 }
 
+// from the end of setup(), the splash and key lock out stay for BOOT_SPLASH_TIME more
 void
-CScreenManager::showBootWait(int show)
+CScreenManager::releaseSplash()
 {
-  static int idx = 0;
-  // idx++;
-  BITMAP_INFO bitmap = hourGlassIcon0Info;
-  switch(idx++ & 0x03) {
-    case 0: bitmap = hourGlassIcon0Info; break;
-    case 1: bitmap = hourGlassIcon1Info; break;
-    case 2: bitmap = hourGlassIcon2Info; break;
-    case 3: bitmap = hourGlassIcon3Info; break;
-  }
-  _pDisplay->fillRect(80, 50, bitmap.width, bitmap.height, BLACK);
-  if(show)
-    _pDisplay->drawBitmap(80, 50, bitmap.pBitmap, bitmap.width, bitmap.height, WHITE); 
-  _pDisplay->display();
+  _splashHoldoff = (millis() + BOOT_SPLASH_TIME) | 1;
+  _bSplashHold = false;
 }
 
 void
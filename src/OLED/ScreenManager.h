@@ -23,17 +23,49 @@
 #define __SCREEN_MANAGER_H__
 
 #include <vector>
+#include <FreeRTOS.h>
 #include "../Utility/UtilClasses.h"
+#include "128x64OLED.h"
 
 class C128x64_OLED;
 class CScreen;
 class CRebootScreen;
+class CScreenManager;
+
+// the most recent show(), or animate() that redrew
+struct sScreenRender {
+  int menu;
+  int subMenu;
+  unsigned long time_us;
+  sOLEDDrawStats draws;
+};
+
+typedef CScreen* (*tScreenFactory)(C128x64_OLED& display, CScreenManager& mgr);
 
 class CScreenManager {
-  std::vector<std::vector<CScreen*>> _Screens;
+public:
+  // persistent screen state, survives the screen being destroyed
+  enum eScreenState { TimerIDState, NumScreenStates };
+private:
+  struct sCachedScreen {
+    int8_t menu;
+    int8_t subMenu;
+    uint32_t lastUsed;
+    CScreen* pScreen;
+  };
+  std::vector<std::vector<tScreenFactory>> _Screens;   // registry of screen factories
+  std::vector<sCachedScreen> _cache;                    // screens actually constructed
+  uint32_t _useCount;
+  uint8_t _screenState[NumScreenStates];
   CRebootScreen* _pRebootScreen;
   C128x64_OLED* _pDisplay;
   unsigned long _OTAholdoff;
+  unsigned long _splashHoldoff;   // splash time once setup() is done
+  bool _bSplashHold;              // held until releaseSplash(), at the end of setup()
+  char _bootMsg[24];              // posted by the boot stages, drawn by checkUpdate() / animate()
+  int _bootWait;                  // hourglass frame, 0 when not shown
+  volatile bool _bBootMsg;        // a new message or hourglass frame has been posted
+  unsigned long _bootMsgTime;     // when posted, the message stays over the screens for BOOT_MSG_TIME
   int _menu;
   int _subMenu;
   int _rootMenu;
@@ -44,18 +76,24 @@ class CScreenManager {
   unsigned long _DimTime_ms;
   unsigned long _MenuTimeout;
   bool _bReqUpdate;
+  sScreenRender _lastRender;
   void _enterScreen();
   void _leaveScreen();
   void _changeSubMenu(int dir);
   void _dim(bool state);
   void _loadScreens();
   void _unloadScreens();
+  CScreen* _getScreen(bool create = true);
+  void _trimScreens();
+  void _reportRender(const char* action, unsigned long duration);
   bool _checkOTAholdoff();
+  bool _checkSplashHold();
+  bool _checkBootMsg();
+  void _drawBootMsg();
 public:
   enum eUIMenuSets { RootMenuLoop, TimerMenuLoop, UserSettingsLoop, SystemSettingsLoop, TuningMenuLoop, BranchMenu };
   enum eUIRootMenus { DetailedControlUI, BasicControlUI, ClockUI, ModeUI, GPIOInfoUI, TrunkUI };
-  enum eUITimerMenus { TimerOverviewUI, Timer1UI, Timer2UI, Timer3UI, Timer4UI, Timer5UI, Timer6UI, Timer7UI,
-                       Timer8UI, Timer9UI, Timer10UI, Timer11UI, Timer12UI, Timer13UI, Timer14UI };
+  enum eUITimerMenus { TimerOverviewUI, SetTimerUI };
   enum eUITuningMenus { MixtureUI, HeaterSettingsUI, FuelCalUI };
   enum eUIUserSettingsMenus { ExThermostatUI, FrostUI, HomeMenuUI, TimeIntervalsUI, TempSensorUI, GPIOUI };
   enum eUIBranchMenus { SetClockUI, InheritSettingsUI, HtrSettingsUI, DS18B20UI };
@@ -75,13 +113,21 @@ public:
   void selectMenu(eUIMenuSets menuset, int specific = -1);   // use to select loop menus, including the root or branches
   void returnMenu();   // use to select loop menus, including the root or branches
   void showRebootMsg(const char* content[2], long delayTime);
-  void showBootMsg(const char* msg);
-  void showBootWait(int show);
+  void showBootMsg(const char* msg);      // any task, the message is drawn by loop()
+  void showBootWait(int show);            // any task, the hourglass is drawn by loop()
   void showOTAMessage(int percent, eOTAmodes updateType);
   void clearDisplay();
   void bumpTimeout();
   void showSplash();
+  void releaseSplash();
   void reqReload() { _bReload = true; };
+  int  getScreenState(eScreenState idx) const { return _screenState[idx]; };
+  void setScreenState(eScreenState idx, int val) { _screenState[idx] = val; };
+  void toggleRefreshReporting();
+  bool isReportingRefresh();
+  void dumpFrame();
+  const sScreenRender& getLastRender() const { return _lastRender; };
+  TaskHandle_t getDisplayTaskHandle();
 };
 
 #endif // __SCREEN_MANAGER_H__
@@ -195,7 +195,7 @@ CSetTimerScreen::keyHandler(uint8_t event)
     if(event & key_Left) {
       switch(_rowSel) {
         case 0:
-          _ScreenManager.prevMenu(); 
+          _selectTimer(-1); 
           break;
         case 1:
           // select previous field
@@ -213,7 +213,7 @@ CSetTimerScreen::keyHandler(uint8_t event)
     if(event & key_Right) {
       switch(_rowSel) {
         case 0:
-          _ScreenManager.nextMenu(); 
+          _selectTimer(+1); 
           break;
         case 1:
           // select next field
@@ -340,6 +340,44 @@ CSetTimerScreen::keyHandler(uint8_t event)
 }
 
 
+// a single screen steps through the timers in use, plus the first blank timer
+// so a new one can be added - unused slots are skipped.
+// Leaves to the neighbouring menus once we step past either end
+void
+CSetTimerScreen::_selectTimer(int dir)
+{
+  int ID = _findTimer(_timerID + dir, dir);
+  if(ID < 0) {
+    if(dir < 0) {
+      _timerID = _findTimer(MAX_TIMERS-1, -1);   // return via the chart will land on the last timer
+      _ScreenManager.prevMenu();
+    }
+    else {
+      _timerID = _findTimer(0, +1);              // return via the chart will land on the first timer
+      _ScreenManager.nextMenu();
+    }
+  }
+  else {
+    _timerID = ID;
+    NVstore.getTimerInfo(_timerID, _timerInfo);
+  }
+  _ScreenManager.setScreenState(CScreenManager::TimerIDState, _timerID);   // this screen is destroyed when we navigate away
+}
+
+// the first timer at or beyond from, in the direction given, that is either in use 
+// or the first blank timer. -1 if there is none
+// Uses the timer manager's record of which timers are in use, rebuilt whenever a timer is set
+int
+CSetTimerScreen::_findTimer(int from, int dir)
+{
+  int firstBlank = CTimerManager::getFirstBlank();
+  for(int ID = from; INBOUNDS(ID, 0, MAX_TIMERS-1); ID += dir) {
+    if(CTimerManager::isTimerInUse(ID) || ID == firstBlank)
+      return ID;
+  }
+  return -1;
+}
+
 void 
 CSetTimerScreen::_adjust(int dir)
 {
@@ -37,6 +37,8 @@ class CSetTimerScreen : public CUIEditScreen {
   int _conflictID;
   sTimer _timerInfo;
   void _adjust(int dir);
+  void _selectTimer(int dir);
+  int  _findTimer(int from, int dir);
   void _printEnabledTimers();
   void _showConflict(const char* str);
 public:
@@ -91,11 +91,11 @@ CTimerChartScreen::show()
     for(int interval = 0; interval < 120; interval++) {
       int IDcentre = 0;
       int ID = 0;
-      if(condensed[dow][interval] & 0xf) {
+      if(condensed[dow][interval] & CTimerManager::_IDmask) {
         if(blockStart == -1) {
           blockStart = interval;
         }
-        if((condensed[dow][interval] & 0x80) == 0) {  
+        if((condensed[dow][interval] & CTimerManager::_repeatFlag) == 0) {  
           // one shot timer - draw peppered
           for(int yscan = interval & 1; yscan < 6; yscan+=2)
             _display.drawPixel(interval+hour0, ypos+yscan, WHITE);   // peppered vertical bar
@@ -126,10 +126,10 @@ CTimerChartScreen::show()
       }
       if(IDcentre) {
         char str[8];
-        sprintf(str, "%d", ID & 0xf);
+        sprintf(str, "%d", ID & CTimerManager::_IDmask);
         int width = 4;
         IDcentre -= 1;
-        if((ID & 0xf) >= 10) {
+        if((ID & CTimerManager::_IDmask) >= 10) {
           IDcentre -= 2;
           width = 8;
         }
@@ -24,11 +24,29 @@
 #include "../Utility/macros.h"
 #include "../Utility/NVStorage.h"
 #include "../Utility/helpers.h" 
+#include "../cfg/BTCConfig.h"
 
 #define DEBUG_433MHz
 
 C433MHzRemote UHFremote;
 
+// Protocol table, tried in order. The first entry is the common PT2262 / EV1527 
+// fob, the encoding this remote was originally written for.
+const s433MHzProtocol protocols[] = {
+  // name              minT  maxT    sync      zero     one    bits  tol%
+  { "PT2262/EV1527",   200,  700,  { 1, 31 }, { 1, 3 }, { 3, 1 }, 24,  30 },
+  { "Short sync",      250,  600,  { 1,  6 }, { 1, 3 }, { 3, 1 }, 24,  30 },
+  { "1:2 pulse",       300,  900,  { 1, 10 }, { 1, 2 }, { 2, 1 }, 24,  30 },
+  { "HS2303",          100,  250,  { 2, 62 }, { 1, 6 }, { 6, 1 }, 24,  30 },
+};
+const int NUM_PROTOCOLS = sizeof(protocols) / sizeof(s433MHzProtocol);
+static_assert(NUM_PROTOCOLS <= UHF_MAX_PROTOCOLS, "433MHz protocol table too large");
+
+// The original decoder only kept the first 23 bits of a 32 transition frame.
+// Fobs paired that way have those codes in NV, so such frames still yield 23 bits.
+const int LEGACY_FRAME_ITEMS = 32;
+const int LEGACY_FRAME_BITS = 23;
+
 // static void IRAM_ATTR rmt_driver_isr_default(void *arg);
 
 
@@ -39,7 +57,10 @@ C433MHzRemote::C433MHzRemote()
   _runState = 0;
   _prevCode = 0;
   _timeout = 0;
+  _candidate = 0;
+  _repeats = 0;
   _debug = false;
+  resetStats();
 }
 
 C433MHzRemote::~C433MHzRemote()
@@ -64,8 +85,20 @@ C433MHzRemote::_task()
   rmt_rx_start(_rxCfg.channel, true);
   _runState = 1;
   while(_runState == 1) {
-    _doComms();
-    delay(1);
+    // sleep until the RMT delivers a frame, or a pending key release falls due
+    TickType_t wait = portMAX_DELAY;
+    if(_timeout) {
+      long tDelta = _timeout - xTaskGetTickCount();
+      wait = tDelta > 0 ? tDelta : 0;
+    }
+    size_t rx_size;
+    rmt_item32_t* rxItems = (rmt_item32_t *)xRingbufferReceive(_ringbuffer, &rx_size, wait);
+    if (rxItems) {
+      if(_runState == 1)
+        _decodeRxItems(rxItems, rx_size / 4);
+      vRingbufferReturnItem(_ringbuffer, (void *)rxItems);
+    }
+    _checkRelease();
   }
   rmt_rx_stop(_rxCfg.channel);
   _runState = 0;
@@ -73,24 +106,19 @@ C433MHzRemote::_task()
 
 
 void 
-C433MHzRemote::_doComms()
+C433MHzRemote::_checkRelease()
 {
-  // wait for ring buffer response, or time out
-  size_t rx_size;
-  rmt_item32_t* rxItems = (rmt_item32_t *)xRingbufferReceive(_ringbuffer, &rx_size, 45);
-
-  if (rxItems) {
-    _decodeRxItems(rxItems, rx_size / 4);
-    vRingbufferReturnItem(_ringbuffer, (void *)rxItems);
-  }
-
   if(_timeout) {
     long tDelta = xTaskGetTickCount() - _timeout;
     if(tDelta >= 0) {
       _timeout = 0;
-      _prevCode = 0;
-      if(_rxQueue) 
-        xQueueSend(_rxQueue, &_prevCode, 0);   // inject no button press
+      _candidate = 0;
+      _repeats = 0;
+      if(_prevCode) {
+        _prevCode = 0;
+        if(_rxQueue) 
+          xQueueSend(_rxQueue, &_prevCode, 0);   // inject no button press
+      }
     }
   }
 }
@@ -98,69 +126,122 @@ C433MHzRemote::_doComms()
 bool 
 C433MHzRemote::_decodeRxItems(const rmt_item32_t* rxItems, int size)
 {
-// #ifdef DEBUG_433MHz
-//   Serial.printf("433MHz RxItems = %d\r\n", size);
-//   for(int i=0; i<size; i++) {
-//     Serial.printf("[%d] %d:%5d  %d:%5d\r\n", i, rxItems[i].level0, rxItems[i].duration0, rxItems[i].level1, rxItems[i].duration1);
-//   }
-// #endif
-  int workingsize = 0;
-  unsigned long newCode = 0;
-  if(size == 32)
-    workingsize = 23;
-  else if(size == 25)
-    workingsize = 24;
-  else {
+  _stats.frames++;
+
+  // A code word may start a frame (the sync gap was long enough to end the previous
+  // RMT frame) or follow an in frame sync pulse. Long syncs also leave a trailing 
+  // sync high at the end of the frame, which never decodes and is ignored.
+  int nWords = 0;
+  int start = 0;
+  while(start < size) {
+    bool found = false;
+    for(int i = 0; i < NUM_PROTOCOLS && !found; i++) {
+      unsigned long code;
+      int T;
+      s433MHzProtocol proto = protocols[i];
+      if(start == 0 && size == LEGACY_FRAME_ITEMS)
+        proto.bits = LEGACY_FRAME_BITS;
+      if(_decodeWord(proto, &rxItems[start], size - start, start == 0, code, T)) {
+        found = true;
+        nWords++;
+        _stats.words++;
+        _stats.protocol[i]++;
+        _stats.lastProtocol = i;
+        _stats.lastT = T;
+        _onCodeWord(code);
+        start += proto.bits;
+      }
+    }
+    if(!found)
+      start++;    // resync on the next item, eg past an in frame sync pulse
+  }
+
+  if(nWords == 0) {
+    _stats.rejected++;
     if(_debug)
-      Serial.printf("433MHz remote incorrect number of transitions: %d?\r\n", size); 
-    return false;
+      Serial.printf("433MHz remote no valid code word in %d transitions\r\n", size); 
   }
-  // start OK, now read the 24 bit payload
-  int meanBitTime = 0;
-  for (int i = 0; i < workingsize; i++)
-  {
-    meanBitTime += rxItems[i].duration0 + rxItems[i].duration1;  // add 1st and 2nd part times
+  else if(_debug) {
+    Serial.printf("433MHz RxItems = %d, %s T=%dus\r\n", size, protocols[_stats.lastProtocol].name, _stats.lastT);
+    for(int i=0; i<size; i++) {
+      Serial.printf("[%2d] %d:%5d  %d:%5d (%d)\r\n", i, rxItems[i].level0, rxItems[i].duration0, rxItems[i].level1, rxItems[i].duration1, rxItems[i].duration0+rxItems[i].duration1);
+    }
   }
-  meanBitTime /= workingsize;
-
-  for (int i = 0; i < workingsize; i++)
-  {
-    int bitTime = rxItems[i].duration0 + rxItems[i].duration1;  // add 1st and 2nd part times
-    // if(INBOUNDS(bitTime, 900, 1700)    // confirm duration
-    if(INBOUNDS(bitTime, meanBitTime - 500, meanBitTime + 500)    // confirm duration
-        && rxItems[i].level0 == 1        // confirm 1st part is high
-        && rxItems[i].level1 == 0)       // confirm 2nd part is low
-    {
-
-      newCode <<= 1;
-
-      // OK, a 1 is accepted if high > 0.6ms
-      // if(rxItems[i].duration0 > 600)
-      if(rxItems[i].duration0 > meanBitTime/2)
-        newCode |= 0x0001;
+  return nWords != 0;
+}
+
+bool
+C433MHzRemote::_decodeWord(const s433MHzProtocol& proto, const rmt_item32_t* rxItems, int size, bool bFrameStart, unsigned long& code, int& T)
+{
+  if(size < proto.bits)
+    return false;
+
+  // estimate T from the bit periods, the last bit's low may be lost in the end of frame idle
+  const int bitPeriod = proto.zero.high + proto.zero.low;
+  int sum = 0;
+  int n = 0;
+  for(int i = 0; i < proto.bits; i++) {
+    if(rxItems[i].duration1) {
+      sum += rxItems[i].duration0 + rxItems[i].duration1;
+      n++;
     }
-    else {
-      // Serial.printf("433MHz remote @ transition %d: bitTime=%d lvl0=%d lvl1=%d?\r\n", i, bitTime, rxItems[i].level0, rxItems[i].level1); 
-      newCode = 0;
+  }
+  if(n == 0)
+    return false;
+  T = sum / (n * bitPeriod);
+  if(!INBOUNDS(T, proto.minT, proto.maxT))
+    return false;
+
+  const int period = T * bitPeriod;
+  const int slack = period * proto.tolerance / 100;
+  const int threshold = T * (proto.zero.high + proto.one.high) / 2;   // ones have the longer high
+  code = 0;
+  for(int i = 0; i < proto.bits; i++) {
+    const rmt_item32_t& item = rxItems[i];
+    if(item.level0 != 1 || (item.duration1 && item.level1 != 0))
+      return false;
+    if(item.duration1 == 0 && i != proto.bits-1)
+      return false;   // only the last bit may be cut short
+    if(item.duration1 && !INBOUNDS(item.duration0 + item.duration1, period - slack, period + slack))
+      return false;
+    if(item.duration0 < T/2)
+      return false;   // too short to be a real pulse
+    code <<= 1;
+    if(item.duration0 > threshold)
+      code |= 0x0001;
+  }
+
+  if(!bFrameStart) {
+    // not following the frame start idle, must follow this protocol's sync pulse
+    const rmt_item32_t& sync = rxItems[-1];
+    const int syncPeriod = T * (proto.sync.high + proto.sync.low);
+    const int syncSlack = syncPeriod * proto.tolerance / 100;
+    if(!INBOUNDS(sync.duration0 + sync.duration1, syncPeriod - syncSlack, syncPeriod + syncSlack)
+       || sync.duration0 > sync.duration1)
       return false;
-    }
   }
-  // Serial.printf("433MHz val = 0x%08lX (%d)\r\n", newCode, size);
-  if(_prevCode != newCode) {
-    _prevCode = newCode;
+  return true;
+}
+
+void
+C433MHzRemote::_onCodeWord(unsigned long code)
+{
+  // fobs repeat the code word while the key is held, require repeats to reject noise
+  if(code == _candidate) {
+    _repeats++;
+  }
+  else {
+    _candidate = code;
+    _repeats = 1;
+  }
+
+  if(_repeats >= UHF_MIN_REPEATS && _prevCode != code) {
+    _prevCode = code;
+    _stats.accepted++;
     if(_rxQueue)
-      xQueueSend(_rxQueue, &newCode, 0);   // queue new button press
-// #ifdef DEBUG_433MHz
-      if(_debug) {
-        Serial.printf("433MHz RxItems = %d (%d)\r\n", size, meanBitTime);
-        for(int i=0; i<size; i++) {
-          Serial.printf("[%2d] %d:%5d  %d:%5d (%d)\r\n", i, rxItems[i].level0, rxItems[i].duration0, rxItems[i].level1, rxItems[i].duration1, rxItems[i].duration0+rxItems[i].duration1);
-        }
-      }
-// #endif
+      xQueueSend(_rxQueue, &code, 0);   // queue new button press
   }
   _timeout = (xTaskGetTickCount() + 100) | 1;  // | 1 ensures non zero - timeout to allow injection of no button press
-  return true;
 }
 
 
@@ -200,6 +281,9 @@ C433MHzRemote::end()
   DebugPort.printf("Stopping UHF remote task %d\r\n", _runState);
   if(_runState == 1) {       // check task is running
     _runState = 2;           // ask task to stop
+    rmt_item32_t wake;
+    wake.val = 0;
+    xRingbufferSend(_ringbuffer, &wake, sizeof(wake), 0);   // the task sleeps on the ring buffer
     DebugPort.println("Stopping UHF remote task wait");
     while(_runState != 0) {
       vTaskDelay(1);
@@ -371,6 +455,37 @@ C433MHzRemote::manage()
   }
 }
 
+int
+C433MHzRemote::getProtocolCount()
+{
+  return NUM_PROTOCOLS;
+}
+
+const s433MHzProtocol& 
+C433MHzRemote::getProtocol(int idx)
+{
+  return protocols[idx];
+}
+
+void
+C433MHzRemote::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.lastProtocol = -1;
+}
+
+void
+C433MHzRemote::report()
+{
+  DebugPort.printf("433MHz remote: %d frames, %d code words, %d rejected, %d key presses\r\n",
+                   _stats.frames, _stats.words, _stats.rejected, _stats.accepted);
+  for(int i = 0; i < NUM_PROTOCOLS; i++) 
+    DebugPort.printf("  %-15s %d\r\n", protocols[i].name, _stats.protocol[i]);
+  if(_stats.lastProtocol >= 0)
+    DebugPort.printf("  last: %s, T=%dus\r\n", protocols[_stats.lastProtocol].name, _stats.lastT);
+  resetStats();
+}
+
 void 
 C433MHzRemote::enableISR(bool state)
 {
@@ -25,6 +25,30 @@
 #include "../Utility/UtilClasses.h"
 #include "driver/rmt.h"
 
+// Fob encodings, as multiples of the base pulse length T.
+// A bit is a high pulse followed by a low pulse, ones have the longer high.
+struct s433MHzProtocol {
+  const char* name;
+  uint16_t minT, maxT;        // us, plausible base pulse length
+  struct {
+    uint8_t high, low;
+  } sync, zero, one;
+  uint8_t bits;
+  uint8_t tolerance;          // %, allowed error of each bit period
+};
+
+const int UHF_MAX_PROTOCOLS = 8;
+
+struct s433MHzStats {
+  uint32_t frames;            // RMT frames received
+  uint32_t words;             // code words decoded, repeats included
+  uint32_t rejected;          // frames without a valid code word
+  uint32_t accepted;          // key presses confirmed by repeats
+  uint32_t protocol[UHF_MAX_PROTOCOLS];       // code words per protocol table entry
+  int lastProtocol;
+  int lastT;                  // us
+};
+
 class C433MHzRemote {
 protected:
   static void _staticTask(void* arg);
@@ -32,16 +56,21 @@ protected:
   RingbufHandle_t _ringbuffer;
   QueueHandle_t _rxQueue;
   TaskHandle_t _taskHandle;
-  int _runState;
+  volatile int _runState;
   unsigned long _prevCode;
   unsigned long _timeout;
+  unsigned long _candidate;   // code word awaiting repeats
+  int _repeats;
   unsigned long _rawCodes[3][4];
   bool _debug;
+  s433MHzStats _stats;
 
   void  _task();
 
-  void _doComms();
+  void _checkRelease();
   bool _decodeRxItems(const rmt_item32_t* rxItems, int size);
+  static bool _decodeWord(const s433MHzProtocol& proto, const rmt_item32_t* rxItems, int size, bool bFrameStart, unsigned long& code, int& T);
+  void _onCodeWord(unsigned long code);
   // NV storage
   void _readNV();
 
@@ -56,6 +85,12 @@ public:
   void manage();
 
   void getCodes(unsigned long codes[3][4]);
+  const s433MHzStats& getStats() const { return _stats; };
+  static int getProtocolCount();
+  static const s433MHzProtocol& getProtocol(int idx);
+  void resetStats();
+  void report();
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
 
   // NV storage
   int  saveNV(unsigned long codes[3][4]);
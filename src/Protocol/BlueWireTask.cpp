@@ -31,6 +31,8 @@
 #include "../Utility/FuelGauge.h"
 #include "../Utility/HourMeter.h"
 #include "../Utility/macros.h"
+#include "../Utility/BinLog.h"
+#include "../Utility/BootSequence.h"
 
 // Setup Serial Port Definitions
 #if defined(__arm__)
@@ -53,7 +55,6 @@ CProtocol HeaterFrame2;              // data packet received from heater in resp
 // CSmartError SmartError;
 CProtocolPackage reportHeaterData;
 CProtocolPackage primaryHeaterData;
-char dbgMsg[BLUEWIRE_MSGQUEUESIZE];
 
 static bool bHasOEMController = false;
 static bool bHasOEMLCDController = false;
@@ -109,6 +110,8 @@ void BlueWireTask(void*) {
 
   initBlueWireSerial();
 
+  BinLog.attachTask();   // lock free deferred logging from this task
+
   CommState.setCallback(pushDebugMsg);
   TxManage.setCallback(pushDebugMsg);
 
@@ -143,32 +146,31 @@ void BlueWireTask(void*) {
         if(RxTimeElapsed >= moderator) {
           moderator += 10;  
           if(bReportRecyleEvents) {
-            sprintf(dbgMsg, "%ldms - ", RxTimeElapsed);
-            pushDebugMsg(dbgMsg);
+            BINLOG(LOG_INFO, LOGF_RecycleTime, RxTimeElapsed);
           }
           if(CommState.is(CommStates::OEMCtrlRx)) {
             bHasOEMController = false;
             bHasOEMLCDController = false;
             if(bReportRecyleEvents) {
-              pushDebugMsg("Timeout collecting OEM controller data, returning to Idle State\r\n");
+              BINLOG(LOG_INFO, LOGF_Text, "Timeout collecting OEM controller data, returning to Idle State\r\n");
             }
           }
           else if(CommState.is(CommStates::HeaterRx1)) {
             bHasHtrData = false;
             if(bReportRecyleEvents) {
-              pushDebugMsg("Timeout collecting OEM heater response data, returning to Idle State\r\n");
+              BINLOG(LOG_INFO, LOGF_Text, "Timeout collecting OEM heater response data, returning to Idle State\r\n");
             }
           }
           else {
             bHasHtrData = false;
             if(bReportRecyleEvents) {
-              pushDebugMsg("Timeout collecting BTC heater response data, returning to Idle State\r\n");
+              BINLOG(LOG_INFO, LOGF_Text, "Timeout collecting BTC heater response data, returning to Idle State\r\n");
             }
           }
         }
 
         if(bReportRecyleEvents) {
-          pushDebugMsg("Recycling blue wire serial interface\r\n");
+          BINLOG(LOG_INFO, LOGF_Text, "Recycling blue wire serial interface\r\n");
         }
   #ifdef REBOOT_BLUEWIRE
         initBlueWireSerial();
@@ -208,8 +210,7 @@ void BlueWireTask(void*) {
         if(BlueWireRxData.available() && (RxTimeElapsed > (RX_DATA_TIMOUT+10))) {  
 
           if(bReportOEMresync) {
-            sprintf(dbgMsg, "Re-sync'd with OEM Controller. %ldms Idle time.\r\n", RxTimeElapsed);
-            pushDebugMsg(dbgMsg);
+            BINLOG(LOG_INFO, LOGF_OEMresync, RxTimeElapsed);
           }
 
           bHasHtrData = false;
@@ -281,11 +282,12 @@ void BlueWireTask(void*) {
           break;
         }
         bHasHtrData = true;
+        BootSequence.markFirstRx();
 
         HeaterFrame1.setTime();
 
         while(BlueWireSerial.available()) {
-          pushDebugMsg("DUMPED ROGUE RX DATA\r\n");
+          BINLOG(LOG_INFO, LOGF_Text, "DUMPED ROGUE RX DATA\r\n");
           BlueWireSerial.read();
         }
         BlueWireSerial.flush();
@@ -293,7 +295,7 @@ void BlueWireTask(void*) {
         // received heater frame (after controller message), report
         primaryHeaterData.set(HeaterFrame1, OEMCtrlFrame);  // OEM is always *the* controller
         if(bReportBlueWireData) {
-          primaryHeaterData.reportFrames(true, pushDebugMsg);
+          primaryHeaterData.reportFrames(true);
         }
         isBTCmaster = false;
         TxManage.PrepareFrame(OEMCtrlFrame, isBTCmaster);  // parrot OEM parameters, but block NV modes
@@ -353,6 +355,7 @@ void BlueWireTask(void*) {
           break;
         }
         bHasHtrData = true;
+        BootSequence.markFirstRx();
 
         // received heater frame (after our control message), report
 
@@ -367,7 +370,7 @@ void BlueWireTask(void*) {
         
         if(bReportBlueWireData) {  // debug or investigation purposes
           reportHeaterData.set(HeaterFrame2, TxManage.getFrame());
-          reportHeaterData.reportFrames(false, pushDebugMsg);
+          reportHeaterData.reportFrames(false);
         }
         CommState.set(CommStates::ExchangeComplete);
         break;
@@ -394,13 +397,10 @@ void BlueWireTask(void*) {
 
 bool validateFrame(const CProtocol& frame, const char* name)
 {
-  if(!frame.verifyCRC(pushDebugMsg)) {
+  if(!frame.verifyCRC(true)) {
     // Bad CRC - restart blue wire Serial port
-    sprintf(dbgMsg, "\007Bad CRC detected for %s frame - restarting blue wire's serial port\r\n", name);
-    pushDebugMsg(dbgMsg);
-    dbgMsg[0] = 0;  // empty string
-    DebugReportFrame("BAD CRC:", frame, "\r\n", dbgMsg);
-    pushDebugMsg(dbgMsg);
+    BINLOG(LOG_ERROR, LOGF_BadCRC, name);
+    BINLOG_DUMP(LOG_ERROR, LOGF_FrameBadCRC, frame.Data, 24);
 #ifdef REBOOT_BLUEWIRE
     initBlueWireSerial();
 #endif
@@ -25,6 +25,7 @@
 #include "../Utility/helpers.h"
 #include "../cfg/BTCConfig.h"
 #include "../Utility/macros.h"
+#include "../Utility/BinLog.h"
 
 
 void 
@@ -54,17 +55,15 @@ CProtocol::getCRC() const
 
 // return true for CRC match
 bool
-CProtocol::verifyCRC(std::function<void(const char*)> pushMsg) const
+CProtocol::verifyCRC(bool bReport) const
 {
-  char errmsg[32];
   CModBusCRC16 CRCengine;
   uint16_t CRC = CRCengine.process(22, Data);  // calculate CRC based on first 22 bytes of our data buffer
 
   uint16_t FrameCRC = getCRC();
   bool bOK = (FrameCRC == CRC);
-  if(!bOK) {
-    sprintf(errmsg, "verifyCRC FAILED: calc: %04X data: %04X\r\n", CRC, FrameCRC);
-    pushMsg(errmsg);
+  if(!bOK && bReport) {
+    BINLOG(LOG_ERROR, LOGF_CRCfail, CRC, FrameCRC);
   }
   return bOK;        // does it match the stored values?
 }
@@ -439,21 +438,18 @@ CProtocolPackage::setRefTime()
   _timeStamp.setRefTime();
 }*/
 
-char dbgFrameMsg[192];
-
 void  
-CProtocolPackage::reportFrames(bool isOEM, std::function<void(const char*)> pushMsg)
+CProtocolPackage::reportFrames(bool isOEM)
 {
-  dbgFrameMsg[0] = 0;
-  _timeStamp.report(dbgFrameMsg);   // absolute time
+  // raw frames are logged, the text is produced later by the log task
+  long tFrame = _timeStamp.elapsed();
   if(isOEM) {
-    DebugReportFrame("OEM:", Controller, TERMINATE_OEM_LINE ? "\r\n" : "   ", dbgFrameMsg);
+    BINLOG_DUMP(LOG_DEBUG, TERMINATE_OEM_LINE ? LOGF_FrameOEMline : LOGF_FrameOEM, tFrame, Controller.Data, 24);
   }
   else {
-    DebugReportFrame("BTC:", Controller, TERMINATE_BTC_LINE ? "\r\n" : "   ", dbgFrameMsg);
+    BINLOG_DUMP(LOG_DEBUG, TERMINATE_BTC_LINE ? LOGF_FrameBTCline : LOGF_FrameBTC, tFrame, Controller.Data, 24);
   }
-  DebugReportFrame("HTR:", Heater, "\r\n", dbgFrameMsg);
-  pushMsg(dbgFrameMsg);
+  BINLOG_DUMP(LOG_DEBUG, LOGF_FrameHTR, Heater.Data, 24);
 }
 
 int   
@@ -60,7 +60,7 @@ CSmartError::inhibit(bool reseterror)
 void
 CSmartError::monitor(const CProtocol& heaterFrame)
 {
-  if(heaterFrame.verifyCRC(NULL)) {  // check but don't report dodgy frames to debug
+  if(heaterFrame.verifyCRC(false)) {  // check but don't report dodgy frames to debug
     // only accept valid heater frames!
     _monitor(heaterFrame.getRunState());
     _monitorPriming(heaterFrame.getRunState(), heaterFrame.getPump_Actual());
@@ -23,6 +23,7 @@
 #include "../Utility/NVStorage.h"
 #include "../Utility/helpers.h"
 #include "../Utility/DemandManager.h"
+#include "../Utility/BootSequence.h"
 #include <FreeRTOS.h>
 
 //#define DEBUG_THERMOSTAT
@@ -346,6 +347,7 @@ CTxManage::CheckTx(unsigned long timenow)
       // it is then brought low by the timer alarm callback, which also cancels m_nStartTime
       m_bTxPending = false;
       m_BlueWireSerial.write(m_TxFrame.Data, 24);  // write native binary values
+      BootSequence.markFirstTx();
       timerWrite(m_HWTimer, 0);       //reset tx gate timeout  
       timerAlarmEnable(m_HWTimer);    // timeout will cause cessation of the Tx gate
     }
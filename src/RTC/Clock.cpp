@@ -28,6 +28,7 @@
 #include "../Utility/helpers.h"
 #include "../Utility/NVStorage.h"
 #include "../Utility/DebugPort.h"
+#include "../Utility/I2CBus.h"
 
 
 // create ONE of the RTClib supported real time clock classes
@@ -63,10 +64,24 @@ DebugPort.println("Using millis() based psuedo \"Real Time Clock\"");
   DateTime zero(2019, 1, 1);   // can be pushed along as seen fit!
   _rtc.begin(zero);
 #else
-  _rtc.begin();
+  {
+    CI2CLock lock(I2C_RTC);
+    _rtc.begin();
+  }
 #endif
 
-  _nextRTCfetch = millis();
+  _driftPPM = 0;
+  memset(_minuteCallbacks, 0, sizeof(_minuteCallbacks));
+  addMinuteCallback(_manageTimers);
+
+  // seed the software clock
+  DateTime now;
+  {
+    CI2CLock lock(I2C_RTC);
+    now = _rtc.now();
+  }
+  _seed(now, 500);   // sub second phase is unknown, halve the worst case error
+  _nextRTCfetch = millis() + RTC_RESYNC_INTERVAL;
 
   update();
 
@@ -74,26 +89,115 @@ DebugPort.println("Using millis() based psuedo \"Real Time Clock\"");
   CTimerManager::findNextTimer(_currentTime.hour(), _currentTime.minute(), _currentTime.dayOfTheWeek());
 }
 
+void
+CClock::_manageTimers(const BTCDateTime& now)
+{
+  CTimerManager::manageTime(now.hour(), now.minute(), now.dayOfTheWeek());
+}
+
 const BTCDateTime& 
 CClock::update()
 {
-  long deltaT = millis() - _nextRTCfetch;
+  uint32_t tick = millis();     // 32 bit tick arithmetic, whatever the width of unsigned long
+  int32_t deltaT = tick - _nextRTCfetch;
   if(deltaT >= 0) {
-    uint32_t origClock = Wire.getClock();
-    Wire.setClock(400000);
-    _currentTime = _rtc.now();             // moderate I2C accesses
-    Wire.setClock(origClock);
-    _nextRTCfetch = millis() + 500;
+    _resync();
+    _nextRTCfetch = tick + RTC_RESYNC_INTERVAL;
+  }
+
+  uint32_t nowSec = uint32_t(_softNow(tick) / 1000);
+  if(nowSec != _currentSec) {
+    _currentSec = nowSec;
+    _currentTime = DateTime(nowSec);
 
-    // check timers upon minute rollovers
+    // notify minute rollovers, eg timers
     if(_currentTime.minute() != _prevMinute) {
-      CTimerManager::manageTime(_currentTime.hour(), _currentTime.minute(), _currentTime.dayOfTheWeek());
       _prevMinute = _currentTime.minute();
+      for(int i = 0; i < 4; i++) {
+        if(_minuteCallbacks[i])
+          _minuteCallbacks[i](_currentTime);
+      }
     }
   }
   return _currentTime;
 }
 
+bool
+CClock::addMinuteCallback(tMinuteCallback pFunc)
+{
+  for(int i = 0; i < 4; i++) {
+    if(_minuteCallbacks[i] == NULL) {
+      _minuteCallbacks[i] = pFunc;
+      return true;
+    }
+  }
+  return false;
+}
+
+// unix time in ms, elapsed time is unsigned so millis() wrap is harmless
+uint64_t
+CClock::_softNow(uint32_t tick) const
+{
+  uint32_t elapsed = tick - _baseTick;
+  return _baseMs + elapsed + (int64_t(elapsed) * _driftPPM) / 1000000;
+}
+
+// move the base forward, elapsed times then never approach the millis() wrap
+void
+CClock::_rebase(uint32_t tick)
+{
+  _refElapsed += tick - _baseTick;
+  _baseMs = _softNow(tick);
+  _baseTick = tick;
+}
+
+void
+CClock::_seed(const DateTime& now, int subSec)
+{
+  _baseTick = millis();
+  _baseMs = uint64_t(now.unixtime()) * 1000 + subSec;
+  _currentSec = 0;
+  _refRTC = now.unixtime();
+  _refElapsed = 0;
+}
+
+void
+CClock::_resync()
+{
+  DateTime rtcNow;
+  {
+    CI2CLock lock(I2C_RTC);
+    rtcNow = _rtc.now();
+  }
+  uint32_t tick = millis();
+  _rebase(tick);
+
+  // the RTC only resolves seconds: true time lies within [rtcMs, rtcMs+1000)
+  // pull the software clock into that window if it has strayed
+  uint64_t rtcMs = uint64_t(rtcNow.unixtime()) * 1000;
+  int64_t error = 0;
+  if(_baseMs < rtcMs) 
+    error = rtcMs - _baseMs;
+  else if(_baseMs >= rtcMs + 1000) 
+    error = -int64_t(_baseMs - (rtcMs + 999));
+  _baseMs += error;
+
+  if(abs(error) > 5000) {
+    // RTC was stepped behind our back, eg set by another means - start afresh
+    _seed(rtcNow, 500);
+    DebugPort.printf("Clock: resync stepped %ldms\r\n", long(error));
+    return;
+  }
+
+  // estimate millis() drift against the RTC over a long span 
+  if(_refElapsed >= RTC_DRIFT_MIN_SPAN) {
+    int64_t rtcElapsed = int64_t(rtcNow.unixtime() - _refRTC) * 1000;
+    int64_t ppm = (rtcElapsed - int64_t(_refElapsed)) * 1000000 / int64_t(_refElapsed);
+    if(abs(ppm) <= RTC_DRIFT_LIMIT) 
+      _driftPPM = int32_t(ppm);
+  }
+}
+
 const BTCDateTime& 
 CClock::get() const
 {
@@ -103,30 +207,60 @@ CClock::get() const
 void 
 CClock::set(const DateTime& newTimeDate)
 {
-  _rtc.adjust(newTimeDate);
+  {
+    CI2CLock lock(I2C_RTC);
+    _rtc.adjust(newTimeDate);
+  }
+  _seed(newTimeDate, 0);    // RTC second starts now
+  _nextRTCfetch = millis() + RTC_RESYNC_INTERVAL;
+  update();
 }
 
+// RTC store writes are queued for the I2C task, loop() need not wait for them
 void 
 CClock::saveData(uint8_t* pData, int len, int ofs)
 {
+  sI2CTransaction txn;
+  txn.device = I2C_RTC;
+  txn.transfer = _writeData;
+  txn.complete = NULL;
+  txn.context = &_rtc;
+  txn.param = ofs;
+  txn.len = len;
+  if(len <= I2C_DATA_SIZE) {
+    memcpy(txn.data, pData, len);
+    if(I2CBus.submit(txn))
+      return;
+  }
+  CI2CLock lock(I2C_RTC);
   _rtc.writeData(pData, len, ofs);
 }
 
+bool
+CClock::_writeData(sI2CTransaction& txn)
+{
+  return ((RTC_DS3231Ex*)txn.context)->writeData(txn.data, txn.len, txn.param);
+}
+
 void 
 CClock::readData(uint8_t* pData, int len, int ofs)
 {
+  I2CBus.waitQueue();     // any queued writes land first
+  CI2CLock lock(I2C_RTC);
   _rtc.readData(pData, len, ofs);
 }
 
 bool
 CClock::lostPower()
 {
+  CI2CLock lock(I2C_RTC);
   return _rtc.lostPower();
 }
 
 void
 CClock::resetLostPower()
 {
+  CI2CLock lock(I2C_RTC);
   _rtc.resetLostPower();
 }
 
@@ -165,14 +299,14 @@ void setTime(const char* newTime)
 #define _I2C_WRITE write
 #define _I2C_READ  read
 
-void 
+bool 
 RTC_DS3231Ex::writeData(uint8_t* pData, int len, int ofs) {
   Wire.beginTransmission(DS3231_ADDRESS);
   Wire._I2C_WRITE((byte)(7+ofs)); // start at alarm bytes
   for(int i=0; i<len; i++) {
     Wire._I2C_WRITE(*pData++);
   }
-  Wire.endTransmission();
+  return Wire.endTransmission() == 0;
 }
 
 void 
@@ -25,16 +25,31 @@
 #include "../../lib/RTClib/RTClib.h"
 #include "BTCDateTime.h"
 #include "../cfg/BTCConfig.h"
+#include "../Utility/I2CBus.h"
 
 class RTC_DS3231Ex : public RTC_DS3231 {
 public:
-  void writeData(uint8_t* pData, int len, int ofs=0);
+  bool writeData(uint8_t* pData, int len, int ofs=0);
   void readData(uint8_t* pData, int len, int ofs=0);
   void resetLostPower();
 };
 
 
+typedef void (*tMinuteCallback)(const BTCDateTime& now);
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CClock
+//
+// A software clock based upon millis(), seeded from the RTC at boot then 
+// disciplined by reading the RTC every RTC_RESYNC_INTERVAL. 
+// get() and update() involve no I2C traffic between those reads.
+// Registered callbacks are called upon each minute rollover.
+//
+///////////////////////////////////////////////////////////////////////////
+
 class CClock {
+private:
   // allow use of ONE of the RTClib supported RTC chips
   // reference to the selected rtc stored here
 #if RTC_USE_DS3231 == 1
@@ -47,9 +62,23 @@ class CClock {
 #else
   RTC_Millis& _rtc;
 #endif
-  unsigned long _nextRTCfetch;
+  uint32_t _nextRTCfetch;
   BTCDateTime _currentTime;
   int _prevMinute;
+  // software clock
+  uint64_t _baseMs;           // unix time in ms at _baseTick
+  uint32_t _baseTick;         // millis() when _baseMs applied
+  uint32_t _currentSec;       // unix time of _currentTime
+  int32_t _driftPPM;          // millis() rate error, as measured against the RTC
+  uint32_t _refRTC;           // RTC unix time at start of drift measurement
+  uint64_t _refElapsed;       // millis() elapsed since _refRTC
+  tMinuteCallback _minuteCallbacks[4];
+  uint64_t _softNow(uint32_t tick) const;
+  void _rebase(uint32_t tick);
+  void _seed(const DateTime& now, int subSec);
+  void _resync();
+  static void _manageTimers(const BTCDateTime& now);
+  static bool _writeData(sI2CTransaction& txn);
 
 public:
   // constructors for ONE of the RTClib supported RTC chips
@@ -65,6 +94,8 @@ public:
 #endif
   void begin();
   const BTCDateTime& update();
+  bool addMinuteCallback(tMinuteCallback pFunc);
+  int  getDrift() const { return _driftPPM; };
   const BTCDateTime& get() const;
   void set(const DateTime& newTime);
   void saveData(uint8_t* pData, int len, int ofs);
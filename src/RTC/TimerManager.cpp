@@ -35,12 +35,13 @@
 #include "../Utility/helpers.h"
 #include "../RTC/RTCStore.h"
 #include "../Utility/DemandManager.h"
+#include "../Utility/BTC_JSON.h"
 #include "../Protocol/Protocol.h"
 
-// main array to hold information of which timer is active at any particular minute of the week
-// LSBs are used for the timerID + 1
-// MSB is set if the timer repeats
-uint8_t CTimerManager::_weekMap[7][CTimerManager::_dayMinutes];   // b[7] = repeat flag, b[3..0] = timer ID
+// sorted list of the intervals during the week when a timer is active.
+// Intervals never overlap - a later timer overwrites any earlier timer's time.
+// IDs hold the timerID + 1, MSB is set if the timer repeats
+std::vector<sTimerInterval> CTimerManager::_intervals;
 
 int  CTimerManager::_activeTimer = 0;
 int  CTimerManager::_cancelledTimer = 0;
@@ -48,172 +49,208 @@ int  CTimerManager::_activeDow = 0;
 int  CTimerManager::_nextTimer = 0;
 int  CTimerManager::_nextStart = 0;
 bool CTimerManager::_timerChanged = false;
-
-#define SET_MAPS() {                         \
-  if(pTimerMap) {                            \
-    pTimerMap[dayMinute] |= activeday;      \
-    if(pTimerIDs)                            \
-      pTimerIDs[dayMinute] |= timerBit;      \
-  }                                          \
-  else {                                     \
-    _weekMap[dow][dayMinute] = recordTimer;  \
-  }                                          \
-}
+uint32_t CTimerManager::_inUse[(MAX_TIMERS+31)/32];
+int  CTimerManager::_firstBlank = 0;
 
 #define START_ON_TEMPERATURE_DROP
 
-// create a bitmap that describes the pattern of on/off times
+// create the list of active intervals for the week, using the NV stored timer info
 void 
-CTimerManager::createMap(int timerMask, uint16_t* pTimerMap, uint16_t* pTimerIDs)
+CTimerManager::createMap()
 {
-  if(pTimerMap) {
-    memset(pTimerMap, 0, _dayMinutes*sizeof(uint16_t));
-    if(pTimerIDs) 
-      memset(pTimerIDs, 0, _dayMinutes*sizeof(uint16_t));
-  }
-  else {
-    DebugPort.println("Erasing weekMap");
-    memset(_weekMap, 0, _dayMinutes*7*sizeof(uint8_t));
+  DebugPort.println("Rebuilding timer intervals");
+  _intervals.clear();   // capacity is kept, rebuilds only allocate if more intervals are needed
+  memset(_inUse, 0, sizeof(_inUse));
+  _firstBlank = -1;
+
+  // reserve for the intervals to be painted. An overlap (conflict tests normally 
+  // prevent them) can split an interval, the list then grows as required
+  int total = 0;
+  for(int timerID=0; timerID < MAX_TIMERS; timerID++) {
+    sTimer timer;
+    NVstore.getTimerInfo(timerID, timer);
+    sTimerInterval intervals[_maxTimerIntervals];
+    total += createMap(timer, intervals);
+    if(!timer.isBlank())
+      _inUse[timerID / 32] |= 0x01UL << (timerID % 32);
+    else if(_firstBlank < 0)
+      _firstBlank = timerID;
   }
+  _intervals.reserve(total);
   
-  for(int timerID=0; timerID < 14; timerID++) {
-    // only process timer if it was nominated in supplied timerMask (bitfield), 
-    // timer0 = bit0 .. timerN = bitN
-    uint16_t timerBit = 0x0001 << timerID;
-    if(timerMask & timerBit) {
-      sTimer timer;
-      // get timer settings
-      NVstore.getTimerInfo(timerID, timer);
-      // and add info to map if enabled
-      createMap(timer, pTimerMap, pTimerIDs);
+  for(int timerID=0; timerID < MAX_TIMERS; timerID++) {
+    sTimer timer;
+    // get timer settings
+    NVstore.getTimerInfo(timerID, timer);
+    // and add its intervals to the week if enabled
+    sTimerInterval intervals[_maxTimerIntervals];
+    int count = createMap(timer, intervals);
+    for(int i = 0; i < count; i++) {
+      _paintInterval(intervals[i]);
     }
   }
 }
 
-// create a timer map, based only upon the supplied timer info
-// the other form of createMap uses the NV stored timer info
-void 
-CTimerManager::createMap(sTimer& timer, uint16_t* pTimerMap, uint16_t* pTimerIDs)
+bool
+CTimerManager::isTimerInUse(int ID)
+{
+  if(!INBOUNDS(ID, 0, MAX_TIMERS-1))
+    return false;
+  return (_inUse[ID / 32] & (0x01UL << (ID % 32))) != 0;
+}
+
+// create the active intervals, based only upon the supplied timer info
+// returns the number of intervals placed into the supplied array (up to _maxTimerIntervals)
+int 
+CTimerManager::createMap(const sTimer& timer, sTimerInterval* intervals)
 {
-  if(createOneShotMap(timer, pTimerMap, pTimerIDs)) {
-    return;
+  int count = 0;
+  if(_createOneShotMap(timer, intervals, count)) {
+    return count;
   }
 
   if(timer.enabled) {
     // create linear minutes of day values for start & stop
-    // note that if stop < start, the timer rolls over midnight
-    int timerBit = 0x0001 << timer.timerID;                   // bit required for timer ID map
+    // note that if stop <= start, the timer rolls over midnight
     int timestart = timer.start.hour * 60 + timer.start.min;  // linear minute of day
     int timestop = timer.stop.hour * 60 + timer.stop.min;
-    for(int dayMinute = 0; dayMinute < _dayMinutes; dayMinute++) {
-      for(int dow = 0; dow < 7; dow++) {
-        int dayBit = 0x01 << dow;
-        if(timer.enabled & dayBit || timer.enabled & 0x80) {  // specific or everyday
-          uint16_t activeday = dayBit;  // may also hold non repeat flag later
-          uint8_t recordTimer = (timer.timerID + 1) | (timer.repeat ? 0x80 : 0x00);  // full week timer ID map
-          if(!timer.repeat) {
-            // flag timers that should get cancelled
-            activeday |= (activeday << 8);  // combine one shot status in MS byte
-          }
-
-          // SET_MAPS() macro saves values as below:
-          //
-          //   activeday -> pTimerMap[dayMinute]           (if pTimerMap != NULL)
-          //   timerBit -> pTimerID[dayMinute]             (if pTimerMap != NULL AND pTimerID != NULL)
-          //   recordTimer -> weekMap[dow][dayMinute]      (if pTimerMap == NULL)
-          //
-          if(timestop > timestart) {
-            // treat normal start < stop times (within same day)
-            if((dayMinute >= timestart) && (dayMinute < timestop)) {
-              SET_MAPS();
-            }
-          }
-          else {  
-            // time straddles a day, start > stop, special treatment required
-            if(dayMinute >= timestart) {  
-              // true from start until midnight
-              SET_MAPS();
-            }
-            if(dayMinute < timestop) {
-              // after midnight, before stop time, i.e. next day
-              // adjust for next day, taking care to wrap week
-              if(dow == 6) {     // last day of week?
-                dow = 0;
-                // because activeday holds both cancel and day info, shift it 
-                activeday >>= 6;  // roll back to start of week - 
-              }
-              else {
-                dow++;
-                activeday <<= 1;  // next day
-              }
-              SET_MAPS();
-            } 
-          }
-        }
+    if(timestop <= timestart) 
+      timestop += _dayMinutes;   // finishes the following day
+    uint8_t ID = (timer.timerID + 1) | (timer.repeat ? _repeatFlag : 0x00);
+    for(int dow = 0; dow < 7; dow++) {
+      int dayBit = 0x01 << dow;
+      if(timer.enabled & dayBit || timer.enabled & 0x80) {  // specific or everyday
+        int dayStart = dow * _dayMinutes;
+        _addInterval(dayStart + timestart, dayStart + timestop, ID, intervals, count);
       }
     }
   }
+  return count;
 }
 
+// append an interval, splitting it if it rolls over the end of the week
+void
+CTimerManager::_addInterval(int start, int stop, uint8_t ID, sTimerInterval* intervals, int& count)
+{
+  if(stop > _weekMinutes) {
+    intervals[count].start = 0;
+    intervals[count].stop = stop - _weekMinutes;
+    intervals[count].ID = ID;
+    count++;
+    stop = _weekMinutes;
+  }
+  intervals[count].start = start;
+  intervals[count].stop = stop;
+  intervals[count].ID = ID;
+  count++;
+}
 
-void 
-CTimerManager::condenseMap(uint16_t timerMap[_dayMinutes], int factor)
+// insert an interval into the sorted week list.
+// Any existing intervals it overlaps are clipped or removed, ie last painted wins
+void
+CTimerManager::_paintInterval(const sTimerInterval& interval)
 {
-  int opIndex = 0;
-  for(int dayMinute = 0; dayMinute < _dayMinutes; ) {
-    uint16_t condense = 0;
-    for(int subInterval = 0; subInterval < factor; subInterval++) {
-      condense |= timerMap[dayMinute++];
-      if(dayMinute == _dayMinutes) {
-        break;
-      }
+  int i = 0;
+  while(i < (int)_intervals.size()) {
+    sTimerInterval& existing = _intervals[i];
+    if((existing.stop <= interval.start) || (existing.start >= interval.stop)) {
+      i++;  // no overlap
+    }
+    else if((existing.start < interval.start) && (existing.stop > interval.stop)) {
+      // new interval sits wholly within the existing one - split the existing interval
+      sTimerInterval tail = existing;
+      tail.start = interval.stop;
+      existing.stop = interval.start;
+      _intervals.insert(_intervals.begin() + i + 1, tail);
+      i += 2;
+    }
+    else if(existing.start < interval.start) {
+      existing.stop = interval.start;   // trim tail
+      i++;
+    }
+    else if(existing.stop > interval.stop) {
+      existing.start = interval.stop;   // trim head
+      i++;
+    }
+    else {
+      // wholly covered, remove existing interval
+      _intervals.erase(_intervals.begin() + i);
     }
-    timerMap[opIndex++] = condense;
   }
+
+  int pos = _findInterval(interval.start) + 1;
+  _intervals.insert(_intervals.begin() + pos, interval);
 }
 
-uint16_t otherTimers[CTimerManager::_dayMinutes];
-uint16_t selectedTimer[CTimerManager::_dayMinutes];
-uint16_t timerIDs[CTimerManager::_dayMinutes];
+// binary search for the last interval starting at or before the supplied minute of the week
+// returns -1 if there is no such interval
+int
+CTimerManager::_findInterval(int weekMinute)
+{
+  int lo = 0;
+  int hi = _intervals.size();
+  while(lo < hi) {
+    int mid = (lo + hi) / 2;
+    if(_intervals[mid].start <= weekMinute) 
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
 
+// return the ID (+ repeat flag) of the timer active at the supplied minute of the week, 0 if none
+int
+CTimerManager::_getTimerAt(int weekMinute)
+{
+  int idx = _findInterval(weekMinute);
+  if((idx >= 0) && (_intervals[idx].stop > weekMinute))
+    return _intervals[idx].ID;
+  return 0;
+}
 
 int  
 CTimerManager::conflictTest(sTimer& timerInfo)
 {
-  int selectedMask = 0x0001 << timerInfo.timerID;  // bit mask for timer we are testing
-  int othersMask = 0x3fff & ~selectedMask;
-
-  memset(selectedTimer, 0, sizeof(selectedTimer));
-
-  createMap(timerInfo, selectedTimer);            // create a usage map from the supplied timer info (under test)
-  createMap(othersMask, otherTimers, timerIDs);   // create a map for all other timers, and get their unique IDs
-
-  for(int i=0; i< _dayMinutes; i++) {
-    if(otherTimers[i] & selectedTimer[i]) {  // both have the same day bit set - CONFLICT!
-      uint16_t timerBit = timerIDs[i];
-      int ID = 0;
-      while(timerBit) {
-        timerBit >>= 1;
-        ID++;
+  sTimerInterval selected[_maxTimerIntervals];
+  sTimerInterval others[_maxTimerIntervals];
+
+  int numSelected = createMap(timerInfo, selected);   // intervals from the supplied timer info (under test)
+
+  for(int timerID = 0; timerID < MAX_TIMERS; timerID++) {
+    if(timerID == timerInfo.timerID)
+      continue;
+
+    sTimer timer;
+    NVstore.getTimerInfo(timerID, timer);
+    int numOthers = createMap(timer, others);
+    for(int i = 0; i < numSelected; i++) {
+      for(int j = 0; j < numOthers; j++) {
+        if((selected[i].start < others[j].stop) && (others[j].start < selected[i].stop)) {
+          return timerID + 1;   // overlapping intervals - CONFLICT!
+        }
       }
-      return ID;  
     }
   }
   return 0; // no conflicts :-)
  }
 
+// condense the week into 12 minute slots, for the timer chart
+// a slot holds the first timer ID found within that slot
 void
 CTimerManager::condenseMap(uint8_t timerMap[7][120])
 {
+  int idx = 0;
+  int numIntervals = _intervals.size();
   for(int dow = 0; dow < 7; dow++) {
-    int opIndex = 0;
-    for(int dayMinute = 0; dayMinute < _dayMinutes; ) {
-      uint8_t condense = 0;
-      for(int subInterval = 0; subInterval < 12; subInterval++, dayMinute++) {
-        if(!condense)
-          condense = _weekMap[dow][dayMinute];
-      }
-      timerMap[dow][opIndex++] = condense;
+    for(int slot = 0; slot < 120; slot++) {
+      int slotStart = dow * _dayMinutes + slot * 12;
+      while((idx < numIntervals) && (_intervals[idx].stop <= slotStart))
+        idx++;
+      if((idx < numIntervals) && (_intervals[idx].start < slotStart + 12))
+        timerMap[dow][slot] = _intervals[idx].ID;
+      else
+        timerMap[dow][slot] = 0;
     }
   }
   _timerChanged = false;
@@ -232,27 +269,26 @@ CTimerManager::manageTime(int _hour, int _minute, int _dow)
   if(!INBOUNDS(hour, 0, 23)) DebugPort.printf("CTimerManager::manageTime out of bounds hour : %d\r\n", hour);
 
   int retval = 0;
-  int dayMinute = (hour * 60) + minute;
-  int newID = _weekMap[dow][dayMinute];
+  int newID = _getTimerAt(dow*_dayMinutes + (hour * 60) + minute);
   if(_activeTimer != newID) {
     
-    DebugPort.printf("Timer ID change detected: %d", _activeTimer & 0x0f); 
-    if(_activeTimer & 0x80) DebugPort.print("(repeating)");
-    DebugPort.printf(" -> %d", newID & 0x0f);
-    if(newID & 0x80) DebugPort.print("(repeating)");
+    DebugPort.printf("Timer ID change detected: %d", _activeTimer & _IDmask); 
+    if(_activeTimer & _repeatFlag) DebugPort.print("(repeating)");
+    DebugPort.printf(" -> %d", newID & _IDmask);
+    if(newID & _repeatFlag) DebugPort.print("(repeating)");
     DebugPort.println("");
 
     if(_activeTimer) {  
       // deal with expired timer
       DebugPort.println("Handling expired timer cleanup");
 
-      if(_activeTimer & 0x80) {
+      if(_activeTimer & _repeatFlag) {
         DebugPort.println("Expired timer repeats, leaving definition alone");
       }
       else {  // non repeating timer
         // delete one shot timer - note that this may require ticking off each day as they appear
         DebugPort.printf("Expired timer does not repeat - Cancelling %d\r\n", _activeTimer);
-        int ID = _activeTimer & 0x0f;
+        int ID = _activeTimer & _IDmask;
         if(ID) {
           ID--;
           sTimer timer;
@@ -268,6 +304,7 @@ CTimerManager::manageTime(int _hour, int _minute, int _dow)
           }
           NVstore.setTimerInfo(ID, timer);
           NVstore.save();
+          resetJSONTimerModerator(ID+1);   // tell clients ahead of the round robin
           createMap();
         }
       }
@@ -277,7 +314,7 @@ CTimerManager::manageTime(int _hour, int _minute, int _dow)
       if(_cancelledTimer != newID) {
         sTimer timer;
         // get timer settings
-        int ID = (newID & 0xf) - 1;
+        int ID = (newID & _IDmask) - 1;
         NVstore.getTimerInfo(ID, timer);
         CDemandManager::setFromTimer(timer.temperature);
         DebugPort.printf("Start of timer interval, starting heater @ %dC\r\n", timer.temperature);
@@ -313,31 +350,31 @@ void
 CTimerManager::cancelActiveTimer()
 {
   if(_activeTimer)
-    DebugPort.printf("User off caused timer #%d cancellation\r\n", _activeTimer & 0xf);
+    DebugPort.printf("User off caused timer #%d cancellation\r\n", _activeTimer & _IDmask);
   _cancelledTimer = _activeTimer;
 }
 
+// find the timer that is either active, or will next become active
 int  
 CTimerManager::findNextTimer(int hour, int minute, int dow)
 {
-  int dayMinute = hour*60 + minute;
-
-  int limit = 24*60*7;  
-  while(limit--) {
-    if(_weekMap[dow][dayMinute] & 0x0f) {
-      _nextTimer = _weekMap[dow][dayMinute];
-      _nextStart = dow*_dayMinutes + dayMinute;
-      return _nextTimer;
+  int weekMinute = dow*_dayMinutes + hour*60 + minute;
+
+  _nextTimer = 0;
+  if(!_intervals.empty()) {
+    int idx = _findInterval(weekMinute);
+    if((idx >= 0) && (_intervals[idx].stop > weekMinute)) {
+      _nextStart = weekMinute;       // already inside a timer interval
     }
-    dayMinute++;
-    if(dayMinute == _dayMinutes) {
-      dayMinute = 0;
-      dow++;
-      WRAPUPPERLIMIT(dow, 6, 0);
+    else {
+      idx++;
+      if(idx == (int)_intervals.size()) 
+        idx = 0;                     // wrap to start of week
+      _nextStart = _intervals[idx].start;
     }
+    _nextTimer = _intervals[idx].ID;
   }
-  _nextTimer = 0;
-  return 0;
+  return _nextTimer;
 }
 
 int 
@@ -365,6 +402,7 @@ CTimerManager::setTimer(sTimer& timerInfo)
   if(!conflictTest(timerInfo)) {
     NVstore.setTimerInfo(timerInfo.timerID, timerInfo);
     NVstore.save();
+    resetJSONTimerModerator(timerInfo.timerID+1);   // tell clients ahead of the round robin
     createMap();
     manageTime(0,0,0);
     _timerChanged = true;
@@ -376,7 +414,7 @@ CTimerManager::setTimer(sTimer& timerInfo)
 int 
 CTimerManager::conflictTest(int ID)
 {
-  if(!(ID >= 0 && ID < 14))
+  if(!(ID >= 0 && ID < MAX_TIMERS))
     return 0;
 
   sTimer timerInfo;
@@ -394,13 +432,14 @@ CTimerManager::conflictTest(int ID)
 
 // special handling for next occurence of one-shot, non-repeating timers 
 bool
-CTimerManager::createOneShotMap(sTimer& timer, uint16_t* pTimerMap, uint16_t* pTimerIDs)
+CTimerManager::_createOneShotMap(const sTimer& timer, sTimerInterval* intervals, int& count)
 {
   if((timer.enabled == 0x80) && !timer.repeat) {  // on-shot next occurrence timer
     DebugPort.printf("One shot, next occurence timer #%d\r\n", timer.timerID+1);
-    int timerBit = 0x0001 << timer.timerID;                   // value required for full week map
     int timestart = timer.start.hour * 60 + timer.start.min;  // linear minute of day
     int timestop = timer.stop.hour * 60 + timer.stop.min;
+    if(timestop <= timestart) 
+      timestop += _dayMinutes;   // timer rolls over midnight
     // create masking based upon TODAY
     const BTCDateTime tNow = Clock.get();
     int dow = tNow.dayOfTheWeek();
@@ -410,41 +449,9 @@ CTimerManager::createOneShotMap(sTimer& timer, uint16_t* pTimerMap, uint16_t* pT
       dow++;
       WRAPUPPERLIMIT(dow, 6, 0);
     }
-    // create masks and record values for the assorted target arrays
-    uint16_t activeday = 1 << dow;  // set day bit
-    activeday |= activeday << 8;    // and set non repeat flag in MSB
-    uint8_t recordTimer = (timer.timerID + 1);
-
-    // SET_MAPS() macro saves values as below:
-    //
-    //   activeday -> pTimerMap[dayMinute]          (if pTimerMap != NULL)
-    //   timerBit -> pTimerID[dayMinute]            (if pTimerMap != NULL AND pTimerID != NULL)
-    //   recordTimer -> weekMap[dow][dayMinute]     (if pTimerMap == NULL)
-    //
-    if(timestart < timestop) {  
-      // timer does not wrap midnight - easy linear workout :-)
-      for(int dayMinute = timestart; dayMinute < timestop; dayMinute++) {
-        SET_MAPS();
-      }
-    }
-    else {  
-      // timer rolls over midnight
-      // fill map up from start time till end of day
-      for(int dayMinute = timestart; dayMinute < _dayMinutes; dayMinute++) {
-        SET_MAPS();
-      }
-      // advance to next day, wrapping if required
-      dow++;
-      WRAPUPPERLIMIT(dow, 6, 0);
-      activeday = 1 << dow;           // set day bit
-      activeday |= activeday << 8;    // and set non repeat flag in MSB
-      // complete map from midnight till stop time
-      for(int dayMinute = 0; dayMinute < timestop; dayMinute++) {
-        SET_MAPS();
-      }
-    }
+    int dayStart = dow * _dayMinutes;
+    _addInterval(dayStart + timestart, dayStart + timestop, timer.timerID + 1, intervals, count);
     return true;
   }
   return false;
 }
-
@@ -32,16 +32,27 @@
 #define __TIMERMANAGER_H__
 
 #include <stdint.h>
+#include <vector>
+#include "../cfg/BTCConfig.h"
 
 struct sTimer;
 
+// a contiguous run of minutes in the week owned by a single timer
+struct sTimerInterval {
+  uint16_t start;     // minute of week (Sunday 00:00 = 0), inclusive
+  uint16_t stop;      // minute of week, exclusive - never wraps, week rollovers are split
+  uint8_t  ID;        // b[7] = repeat flag, b[6..0] = timer ID + 1
+};
+
 class CTimerManager {
 public:
   static const int _dayMinutes = 24*60;
-  static bool createOneShotMap(sTimer& timer, uint16_t* timerMap = NULL, uint16_t* timerIDs = NULL);
-  static void createMap(int timermask = 0x3fff, uint16_t* timerMap = NULL, uint16_t* timerIDs = NULL);
-  static void createMap(sTimer& timer, uint16_t* timerMap = NULL, uint16_t* timerIDs = NULL);
-  static void condenseMap(uint16_t timerMap[_dayMinutes], int factor);
+  static const int _weekMinutes = 7*_dayMinutes;
+  static const int _maxTimerIntervals = 8;   // 7 days + split at week rollover
+  static const uint8_t _repeatFlag = 0x80;   // timer IDs: b[7] = repeat flag, b[6..0] = timer ID + 1
+  static const uint8_t _IDmask = 0x7f;
+  static void createMap();
+  static int  createMap(const sTimer& timer, sTimerInterval* intervals);
   static void condenseMap(uint8_t timerMap[7][120]);
   static int  conflictTest(sTimer& timer);
   static int  conflictTest(int ID);
@@ -52,16 +63,25 @@ public:
   static void getTimer(int idx, sTimer& timerInfo);
   static int  setTimer(sTimer& timerInfo);
   static bool hasTimerChanged() { return _timerChanged; };
+  static bool isTimerInUse(int ID);    // not blank, as of the last createMap()
+  static int  getFirstBlank() { return _firstBlank; };
   static void cancelActiveTimer();
 private:
+  static bool _createOneShotMap(const sTimer& timer, sTimerInterval* intervals, int& count);
+  static void _addInterval(int start, int stop, uint8_t ID, sTimerInterval* intervals, int& count);
+  static void _paintInterval(const sTimerInterval& interval);
+  static int  _findInterval(int weekMinute);
+  static int  _getTimerAt(int weekMinute);
   static int _activeTimer;
   static int _cancelledTimer;
   static int _activeDow;
   static int _prevState;
   static int _nextTimer;
   static int _nextStart;
-  static uint8_t _weekMap[7][_dayMinutes];   // b[7] = repeat flag, b[3..0] = timer ID
+  static std::vector<sTimerInterval> _intervals;   // sorted by start, non overlapping
   static bool _timerChanged;
+  static uint32_t _inUse[(MAX_TIMERS+31)/32];   // timers that are not blank, bit per timer
+  static int _firstBlank;                       // lowest blank timer, -1 if none
 };
 
 #endif //__TIMERMANAGER_H__
\ No newline at end of file
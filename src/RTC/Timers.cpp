@@ -33,7 +33,7 @@ void decodeJSONTimerDays(const char* ipStr)
   if(2 == sscanf(ipStr, "%d %31s", &timerIdx, dayInfo)) {
     dayInfo[31] = 0;
     timerIdx--;
-    if(INBOUNDS(timerIdx, 0, 13)) {
+    if(INBOUNDS(timerIdx, 0, MAX_TIMERS-1)) {
       sTimer timer;
       NVstore.getTimerInfo(timerIdx, timer);
       uint8_t days = 0;
@@ -60,7 +60,7 @@ void decodeJSONTimerTime(int stop, const char* ipStr)
   int timerIdx;
   if(3 == sscanf(ipStr, "%d %d:%d", &timerIdx, &hour, &min)) {
     timerIdx--;
-    if(INBOUNDS(timerIdx, 0, 13)) {
+    if(INBOUNDS(timerIdx, 0, MAX_TIMERS-1)) {
       sTimer timer;
       NVstore.getTimerInfo(timerIdx, timer);
       if(stop) {
@@ -82,7 +82,7 @@ void decodeJSONTimerNumeric(int valID, const char* ipStr)
   int timerIdx;
   if(2 == sscanf(ipStr, "%d %d", &timerIdx, &value)) {
     timerIdx--;
-    if(INBOUNDS(timerIdx, 0, 13)) {
+    if(INBOUNDS(timerIdx, 0, MAX_TIMERS-1)) {
       sTimer timer;
       NVstore.getTimerInfo(timerIdx, timer);
       switch(valID) {
@@ -100,7 +100,7 @@ void decodeTimerTemp(const char* ipStr)
   int timerIdx;
   if(2 == sscanf(ipStr, "%d %d", &timerIdx, &degC)) {
     timerIdx--;
-    if(INBOUNDS(timerIdx, 0, 13)) {
+    if(INBOUNDS(timerIdx, 0, MAX_TIMERS-1)) {
       sTimer timer;
       NVstore.getTimerInfo(timerIdx, timer);
       timer.temperature = degC;
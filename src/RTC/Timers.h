@@ -24,6 +24,7 @@
 
 #include "../Utility/NVCore.h"
 #include "../Utility/macros.h"
+#include "../cfg/BTCConfig.h"
 
 
 struct sHourMin {
@@ -43,6 +44,16 @@ struct sHourMin {
   }
 };
 
+// compact form of a timer, as held in RAM and NV storage
+struct sTimerRecord {
+  int8_t  startHour;
+  int8_t  startMin;
+  int8_t  stopHour;
+  int8_t  stopMin;
+  uint8_t enabled;     // each bit is a day of week flag, b[7] = next occurrence or everyday
+  uint8_t flags;       // b[7] = repeat, b[5..0] = temperature
+};
+
 struct sTimer : public CESP32_NVStorage {
   sHourMin start;      // start time
   sHourMin stop;       // stop time
@@ -75,6 +86,27 @@ struct sTimer : public CESP32_NVStorage {
     temperature = 22;
     timerID = idx;
   }
+  void pack(sTimerRecord& rec) const {
+    rec.startHour = start.hour;
+    rec.startMin = start.min;
+    rec.stopHour = stop.hour;
+    rec.stopMin = stop.min;
+    rec.enabled = enabled;
+    rec.flags = (repeat ? 0x80 : 0x00) | (temperature & 0x3f);
+  }
+  void unpack(const sTimerRecord& rec, int idx) {
+    start.hour = rec.startHour;
+    start.min = rec.startMin;
+    stop.hour = rec.stopHour;
+    stop.min = rec.stopMin;
+    enabled = rec.enabled;
+    repeat = (rec.flags & 0x80) ? 1 : 0;
+    temperature = rec.flags & 0x3f;
+    timerID = idx;
+  }
+  bool isBlank() const {   // never programmed, as left by init()
+    return !enabled && !start.hour && !start.min && !stop.hour && !stop.min;
+  }
   bool valid() {
     bool retval = true;
     retval &= INBOUNDS(start.hour, 0, 23);
@@ -89,6 +121,23 @@ struct sTimer : public CESP32_NVStorage {
   void save();
 };
 
+// all timers, stored as a single NV blob
+struct sTimerTable : public CESP32_NVStorage {
+  sTimerRecord timer[MAX_TIMERS];
+  bool changed;        // set when a record differs from NV storage
+  sTimerTable() {
+    changed = false;
+  }
+  sTimerTable& operator=(const sTimerTable& rhs) {
+    memcpy(timer, rhs.timer, sizeof(timer));
+    changed = rhs.changed;
+    return *this;
+  }
+  void init();
+  void load();
+  bool save();
+};
+
 const char* getTimerJSONStr(int timer, int param);
 void decodeJSONTimerDays(const char* str);
 void decodeJSONTimerTime(int stop, const char*);
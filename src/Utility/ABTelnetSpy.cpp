@@ -36,6 +36,14 @@ ABTelnetSpy::write(uint8_t val) {
   return 0;
 }
 
+size_t 
+ABTelnetSpy::write(const uint8_t* data, size_t len) {
+  if(_enabled) {
+    return TelnetSpy::write(data, len);
+  }
+  return 0;
+}
+
 void 
 ABTelnetSpy::enable(bool state)
 {
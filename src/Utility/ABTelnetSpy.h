@@ -29,6 +29,8 @@ class ABTelnetSpy : public TelnetSpy {
 public:
   ABTelnetSpy();
 	size_t write(uint8_t) override;
+  size_t write(const uint8_t* data, size_t len) override;
+  using TelnetSpy::write;
   void enable(bool);
   /// getch():
   //  typical problem we have with terminal software that may or may not send CR/LF
@@ -22,15 +22,62 @@
 #include "BTC_GPIO.h"
 #include "helpers.h"
 #include <driver/adc.h>
+#include <driver/ledc.h>
+#include <math.h>
+#include "macros.h"
+#include "../cfg/BTCConfig.h"
 #include "DebugPort.h"
 #include "../Protocol/Protocol.h"
 #include "../Utility/NVStorage.h"
 #include "../RTC/RTCStore.h"
 
-const int BREATHINTERVAL = 45;
-const int FADEAMOUNT = 3;
-const int FLASHPERIOD = 2000;
-const int ONFLASHINTERVAL = 50;
+// GPIO1 uses Arduino PWM channel 0, which is LEDC high speed channel 0
+const ledc_mode_t GPIO1_LEDC_MODE = LEDC_HIGH_SPEED_MODE;
+const ledc_channel_t GPIO1_LEDC_CHANNEL = LEDC_CHANNEL_0;
+const int LEDC_FULLON = 256;   // 8 bit PWM, a duty of 2^8 is solidly on
+
+// GPIO1 status patterns, played out by the LEDC fade engine.
+// Each step fades (or steps if fade is 0) to duty, then holds; patterns repeat.
+// The breathing knees follow the original software breathe, which stepped
+// the duty by (duty/32)+1 every 45ms for an exponential looking ramp.
+struct sLEDstep {
+  uint16_t duty;
+  uint16_t fade;   // ms
+  uint16_t hold;   // ms
+};
+struct sLEDpattern {
+  const sLEDstep* steps;
+  int nSteps;
+};
+
+const sLEDstep LEDoff[] = { 
+  { 0, 0, 0 } 
+};
+const sLEDstep LEDon[] = { 
+  { LEDC_FULLON, 0, 0 } 
+};
+const sLEDstep LEDbreatheUp[] = {     // starting: 3.7s sawtooth ramp up
+  { 5, 0, 0 }, { 32, 1215, 0 }, { 64, 720, 0 }, { 97, 495, 0 }, { 129, 360, 0 },
+  { 164, 315, 0 }, { 194, 225, 0 }, { 229, 225, 0 }, { 253, 180, 0 }
+};
+const sLEDstep LEDbreatheDown[] = {   // cooling down: 3.9s sawtooth ramp down
+  { 255, 0, 0 }, { 223, 180, 0 }, { 188, 225, 0 }, { 158, 225, 0 }, { 123, 315, 0 },
+  { 95, 315, 0 }, { 62, 495, 0 }, { 30, 720, 0 }, { 0, 1395, 0 }
+};
+const sLEDstep LEDsuspend[] = {       // suspended: brief flash every 2 seconds
+  { 0, 0, 1950 }, { LEDC_FULLON, 0, 50 }
+};
+
+// indexed by the status mode determined in CGPIOout1::_doStatus()
+const sLEDpattern LEDpatterns[] = {
+  { LEDoff, 1 },
+  { LEDbreatheUp, sizeof(LEDbreatheUp) / sizeof(sLEDstep) },
+  { LEDon, 1 },
+  { LEDbreatheDown, sizeof(LEDbreatheDown) / sizeof(sLEDstep) },
+  { LEDsuspend, sizeof(LEDsuspend) / sizeof(sLEDstep) },
+};
+// getState() values for the GPIO info screen: 0 off, 1 on, 2 breathe up, 3 breathe down, 4 suspend
+const uint8_t LEDuiState[] = { 0, 2, 1, 3, 4 };
 
 const char* GPIOin1Names[] = {
   "Disabled",
@@ -296,16 +343,16 @@ CGPIOin::getState(int channel)
     // index is in bounds 0 or 1
 
     // check for transient events
-    if(_eventList[channel].empty()) {
+    uint8_t event;
+    if(_eventList[channel].pop(event)) {
+      // emit transient events if they occured
+      retval = event != 0;
+    }
+    else {
       // read last actual state
       int mask = 0x01 << (channel & 0x01);
       retval = (_Debounce.getState() & mask) != 0; 
     }
-    else {
-      // emit transient events if they occured
-      retval = _eventList[channel].front() != 0;
-      _eventList[channel].pop_front();
-    }
   }
   return retval;
 }
@@ -332,9 +379,9 @@ CGPIOin::manage()
     
     // record possible sub sample transients - JSON usage especially
     if(keyChange & 0x01)
-      _eventList[0].push_back(newKey & 0x01);  // mask the channel bit
+      _eventList[0].push(newKey & 0x01);  // mask the channel bit
     if(keyChange & 0x02)
-      _eventList[1].push_back(newKey & 0x02);  // mask the channel bit
+      _eventList[1].push(newKey & 0x02);  // mask the channel bit
   }
   simulateKey(newKey);
 }
@@ -526,10 +573,15 @@ CGPIOout::getState(int channel)
 CGPIOout1::CGPIOout1() : CGPIOoutBase()
 {
   _Mode = Disabled;
-  _breatheDelay = 0;
-  _statusState = 0;
-  _statusDelay = 0;
   _prevState = -1;
+  _ledState = 0;
+  _patternTimer = NULL;
+  _reqPattern = -1;
+  _reqCount = 0;
+  _pattern = -1;
+  _playCount = 0;
+  _step = 0;
+  _attached = false;
 }
 
 void 
@@ -538,6 +590,9 @@ CGPIOout1::begin(int pin, CGPIOout1::Modes mode)
   CGPIOoutBase::begin(pin);
 
   ledcSetup(0, 500, 8);   // create PWM channel for GPIO1: 500Hz, 8 bits
+  ledc_fade_func_install(0);  // hardware fades for the status patterns (harmless if already installed)
+  if(_patternTimer == NULL)
+    _patternTimer = xTimerCreate("GPIO1pattern", 1, pdFALSE, this, _patternCallback);
 
   setMode(mode);
 }
@@ -548,8 +603,7 @@ CGPIOout1::setMode(CGPIOout1::Modes mode)
   if(mode >= Disabled && mode <= HtrActive) 
     _Mode = mode; 
   _prevState = -1;
-  if(_getPin())
-    ledcDetachPin(_getPin());     // ensure PWM detached from IO line
+  _requestPattern(-1);          // stop any status pattern, the timer callback detaches the PWM
 };
 
 CGPIOout1::Modes CGPIOout1::getMode() const
@@ -606,104 +660,75 @@ CGPIOout1::_doStatus()
       break;
   }
 
-  // change of mode typically requires changing from simple digital out 
-  // to PWM or vice versa
+  // the LEDC hardware plays the pattern, only a change of state needs any action here
   if(_prevState != statusMode) {
     _prevState = statusMode;
-    _statusState = 0;
-    _statusDelay = millis() + BREATHINTERVAL;
-    switch(statusMode) {
-      case 0:
-        ledcDetachPin(pin);     // detach PWM from IO line
-        _setPinState(LOW);
-        _ledState = 0;
-        break;
-      case 1:
-        ledcAttachPin(pin, 0);  // attach PWM to GPIO line
-        ledcWrite(0, _statusState);
-        _breatheDelay = millis() + BREATHINTERVAL; 
-        _ledState = 2;
-        break;
-      case 2:
-        ledcDetachPin(pin);     // detach PWM from IO line
-        _setPinState(HIGH);
-        _ledState = 1;
-        break;
-      case 3:
-        ledcAttachPin(pin, 0);  // attach PWM to GPIO line
-        _statusState = 255;
-        ledcWrite(0, _statusState);
-        _breatheDelay = millis() + BREATHINTERVAL; 
-        _ledState = 3;
-        break;
-      case 4:
-        ledcDetachPin(pin);     // detach PWM from IO line
-        _breatheDelay += (FLASHPERIOD - ONFLASHINTERVAL);  // extended off
-        _setPinState(LOW);
-        _ledState = 4;
-        break;
-    }  
-  }
-  switch(statusMode) {
-    case 1: _doStartMode(); break;
-    case 3: _doStopMode(); break;
-    case 4: _doSuspendMode(); break;
+    _ledState = LEDuiState[statusMode];
+    _requestPattern(statusMode);
   }
 }
 
-
-void 
-CGPIOout1::_doStartMode()   // breath up PWM
-{
-  long tDelta = millis() - _breatheDelay;
-  if(tDelta >= 0) {
-    _breatheDelay += BREATHINTERVAL;
-    int expo = ((_statusState >> 5) + 1);
-    _statusState += expo;
-    _statusState &= 0xff;
-    ledcWrite(0, _statusState);
+void
+CGPIOout1::_requestPattern(int pattern)
+{
+  _reqPattern = pattern;
+  _reqCount++;   // restart even if the same pattern is re-requested
+  if(_patternTimer) {
+    // all LEDC accesses happen in the timer callback, fire it ASAP to pick up the new pattern
+    xTimerChangePeriod(_patternTimer, 1, 0);
   }
-  _ledState = 2;
-}
-
-void 
-CGPIOout1::_doStopMode()   // breath down PWM
-{
-  long tDelta = millis() - _breatheDelay;
-  if(tDelta >= 0) {
-    _breatheDelay += BREATHINTERVAL;
-    int expo = ((_statusState >> 5) + 1);
-    _statusState -= expo;
-    _statusState &= 0xff;
-    ledcWrite(0, _statusState);
+  else if(pattern < 0 && _getPin()) {
+    ledcDetachPin(_getPin());   // no timer yet (setMode before begin), nothing is playing
   }
-  _ledState = 3;
 }
 
-void 
-CGPIOout1::_doSuspendMode()  // brief flash
+void
+CGPIOout1::_patternCallback(TimerHandle_t timer)
 {
-  static unsigned long stretch = 0;
+  CGPIOout1* pThis = (CGPIOout1*)pvTimerGetTimerID(timer);
+  pThis->_playPattern();
+}
 
-  long tDelta = millis() - _breatheDelay;
-  if(tDelta >= 0) {
-    _statusState++;
-    if(_statusState & 0x01) {
-      _breatheDelay += ONFLASHINTERVAL;  // brief flash on
-      _setPinState(HIGH);
-      stretch = (millis() + 250) | 1;   // pulse extend for UI purposes, ensure non zero
+void
+CGPIOout1::_playPattern()
+{
+  if(_playCount != _reqCount) {
+    _playCount = _reqCount;
+    _pattern = _reqPattern;
+    _step = 0;
+    // the PWM is attached to the GPIO line only while a status pattern plays
+    if(_pattern < 0) {
+      if(_getPin())
+        ledcDetachPin(_getPin());
+      _attached = false;
     }
-    else {
-      _breatheDelay += (FLASHPERIOD - ONFLASHINTERVAL);  // extended off
-      _setPinState(LOW);
+    else if(!_attached) {
+      ledcAttachPin(_getPin(), 0);
+      _attached = true;
     }
   }
-  if(stretch) {
-    tDelta = millis() - stretch;
-    if(tDelta >= 0)
-      stretch = 0;
+  if(_pattern < 0)
+    return;
+
+  const sLEDpattern& pattern = LEDpatterns[_pattern];
+  int period = 0;
+  // apply steps until one takes time, zero length steps are an immediate duty change
+  for(int i = 0; i < pattern.nSteps && period == 0; i++) {
+    const sLEDstep& step = pattern.steps[_step];
+    if(step.fade) {
+      ledc_set_fade_with_time(GPIO1_LEDC_MODE, GPIO1_LEDC_CHANNEL, step.duty, step.fade);
+      ledc_fade_start(GPIO1_LEDC_MODE, GPIO1_LEDC_CHANNEL, LEDC_FADE_NO_WAIT);
+    }
+    else {
+      ledc_set_duty(GPIO1_LEDC_MODE, GPIO1_LEDC_CHANNEL, step.duty);
+      ledc_update_duty(GPIO1_LEDC_MODE, GPIO1_LEDC_CHANNEL);
+    }
+    period = step.fade + step.hold;
+    if(++_step >= pattern.nSteps)
+      _step = 0;
   }
-  _ledState = 4;
+  if(period && pattern.nSteps > 1) 
+    xTimerChangePeriod(_patternTimer, pdMS_TO_TICKS(period), 0);   // single step patterns are static
 }
 
 uint8_t
@@ -786,21 +811,43 @@ CGPIOout2::getState()
 
 CGPIOalg::CGPIOalg()
 {
-  _expMean = 0;
   _Mode = Disabled;
+  _pin = ADC1_CHANNEL_5;
+  _taskHandle = NULL;
+  _fullScale = 0;
+  _oversample = ADC_OVERSAMPLE;
+  _sampleInterval = ADC_SAMPLE_INTERVAL;
+  _filterTime = ADC_FILTER_TIME;
+  _value = 0;
+  _millivolts = 0;
+  _filter.setRounding(1);
+  _updateAlpha();
 }
 
 void
 CGPIOalg::begin(adc1_channel_t pin, CGPIOalg::Modes mode)
 {
   _pin = pin;
-  _Mode = mode;
 
-  if(_Mode != CGPIOalg::Disabled) {
-    adc_gpio_init(ADC_UNIT_1, ADC_CHANNEL_5);
+  if(mode != CGPIOalg::Disabled) {
+    adc_gpio_init(ADC_UNIT_1, (adc_channel_t)_pin);
     adc1_config_width(ADC_WIDTH_BIT_12);
-    adc1_config_channel_atten(ADC1_CHANNEL_5, ADC_ATTEN_11db);
+    adc1_config_channel_atten(_pin, ADC_ATTEN_11db);
+    // per chip calibration from eFuse, corrects gain and the non linearity at the ends of the range
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_11db, ADC_WIDTH_BIT_12, ADC_DEFAULT_VREF, &_adcChars);
+    _fullScale = esp_adc_cal_raw_to_voltage(4095, &_adcChars);
+
+    if(_taskHandle == NULL) {
+      // the ADC is only read by this task, loop() picks up the filtered value
+      xTaskCreate(_staticTask,
+                  "AnalogTask",
+                  TASK_STACK_ANALOG,
+                  this,
+                  TASK_PRIORITY_ANALOG,
+                  &_taskHandle);
+    }
   }
+  _Mode = mode;
 }
 
 CGPIOalg::Modes CGPIOalg::getMode() const
@@ -808,23 +855,80 @@ CGPIOalg::Modes CGPIOalg::getMode() const
   return _Mode;
 };
 
+void
+CGPIOalg::setOversampling(int samples)
+{
+  BOUNDSLIMIT(samples, 1, 64);
+  _oversample = samples;
+}
 
-void CGPIOalg::manage()
+void
+CGPIOalg::setSampleInterval(int ms)
 {
-  const float fAlpha = 0.95;           // exponential mean alpha
+  BOUNDSLIMIT(ms, 1, 1000);
+  _sampleInterval = ms;
+  _updateAlpha();
+}
 
-  if(_Mode != CGPIOalg::Disabled) {
-    int read_raw;
-    char msg[32];
-    read_raw = adc1_get_raw( ADC1_CHANNEL_5);
-    sprintf(msg, "ADC: %d", read_raw );
-    _expMean = _expMean * fAlpha + (1-fAlpha) * float(read_raw);
-//    DebugPort.println(msg);
-  }
+void
+CGPIOalg::setFilterTime(int ms)
+{
+  BOUNDSLIMIT(ms, 0, 10000);
+  _filterTime = ms;
+  _updateAlpha();
 }
 
-int 
-CGPIOalg::getValue()
+void
+CGPIOalg::_updateAlpha()
 {
-  return _expMean;
+  // the filter runs at a fixed sample rate, so a time constant maps to a fixed alpha
+  float alpha = 0;
+  if(_filterTime)
+    alpha = exp(-float(_sampleInterval) / float(_filterTime));
+  _filter.setAlpha(alpha);
+}
+
+void
+CGPIOalg::_staticTask(void* arg)
+{
+  CGPIOalg* pThis = (CGPIOalg*)arg;
+
+  pThis->_task();
+
+  vTaskDelete(NULL);
+}
+
+void
+CGPIOalg::_task()
+{
+  TickType_t lastWake = xTaskGetTickCount();
+  for(;;) {
+    if(_Mode != CGPIOalg::Disabled) 
+      _acquire();
+    else
+      _filter.reset(0);   // start afresh when re-enabled
+
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(_sampleInterval));
+  }
+}
+
+void
+CGPIOalg::_acquire()
+{
+  // oversample and decimate: the average of a burst of conversions
+  int samples = _oversample;
+  uint32_t sum = 0;
+  for(int i = 0; i < samples; i++) 
+    sum += adc1_get_raw(_pin);
+  uint32_t raw = (sum + samples/2) / samples;
+
+  uint32_t mV = esp_adc_cal_raw_to_voltage(raw, &_adcChars);
+  _filter.update(float(mV));
+
+  int filtered = int(_filter.getValue());
+  _millivolts = filtered;
+  // keep the 0-4095 scale the users of getValue() expect, but linearised
+  int value = _fullScale ? (filtered * 4095 + _fullScale/2) / _fullScale : 0;
+  UPPERLIMIT(value, 4095);
+  _value = value;
 }
@@ -24,8 +24,12 @@
 
 #include <stdint.h>
 #include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
 #include "Debounce.h"
-#include <list>
+#include "EventRing.h"
+#include "DataFilter.h"
 
 extern const char* GPIOin1Names[];
 extern const char* GPIOin2Names[];
@@ -87,7 +91,7 @@ class CGPIOin {
   CGPIOin2 _Input2;
   CDebounce _Debounce;
   uint8_t _lastKey;
-  std::list<uint8_t> _eventList[2];
+  TEventRing<uint8_t, 8> _eventList[2];   // debounced edges, held until read by getState()
 public:
   CGPIOin();
   void setMode(CGPIOin1::Modes mode1, CGPIOin2::Modes mode2) { _Input1.setMode(mode1); _Input2.setMode(mode2); };
@@ -143,13 +147,18 @@ private:
   Modes _Mode;
   void _doStatus();
   int _prevState;
-  int _statusState;
-  int _statusDelay;
-  unsigned long _breatheDelay;
   uint8_t _ledState;
-  void _doStartMode();
-  void _doStopMode();
-  void _doSuspendMode();
+  // status patterns are played out by the LEDC fade hardware, stepped by a software timer
+  TimerHandle_t _patternTimer;
+  volatile int _reqPattern;   // pattern requested by manage(), -1 = none
+  volatile uint8_t _reqCount;
+  int _pattern;               // pattern being played, owned by the timer callback
+  uint8_t _playCount;
+  int _step;
+  bool _attached;             // PWM attached to the GPIO line, owned by the timer callback
+  void _requestPattern(int pattern);
+  void _playPattern();
+  static void _patternCallback(TimerHandle_t timer);
 };
 
 class CGPIOout2 : public CGPIOoutBase {
@@ -193,14 +202,29 @@ public:
   };
   CGPIOalg();
   void begin(adc1_channel_t pin, Modes mode);
-  void manage();
-  int getValue();
+  int getValue() const { return _value; };              // 0-4095, linearised by the ADC calibration
+  int getMillivolts() const { return _millivolts; };
   Modes getMode() const;
+  void setOversampling(int samples);
+  void setSampleInterval(int ms);
+  void setFilterTime(int ms);
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
 private:
-  Modes _Mode;
-  float _expMean;
+  volatile Modes _Mode;
   adc1_channel_t _pin;
-
+  TaskHandle_t _taskHandle;
+  esp_adc_cal_characteristics_t _adcChars;
+  uint32_t _fullScale;        // calibrated mV at a raw reading of 4095
+  int _oversample;
+  int _sampleInterval;
+  int _filterTime;
+  CExpMean _filter;           // only touched by the acquisition task
+  volatile int _value;
+  volatile int _millivolts;
+  void _updateAlpha();
+  static void _staticTask(void* arg);
+  void _task();
+  void _acquire();
 };
 
 struct sGPIOparams {
@@ -210,6 +234,9 @@ struct sGPIOparams {
   CGPIOout2::Modes out2Mode;
   CGPIOalg::Modes algMode;
   int8_t thresh[2];
+  uint8_t algOversample;   // raw conversions per sample, 1-64
+  uint16_t algInterval;    // ms, 1-1000
+  uint16_t algFilter;      // ms, 0-10000, 0 = unfiltered
 
   sGPIOparams& operator=(const sGPIOparams& rhs) {
     in1Mode = rhs.in1Mode;
@@ -219,6 +246,9 @@ struct sGPIOparams {
     algMode = rhs.algMode;
     thresh[0] = rhs.thresh[0];
     thresh[1] = rhs.thresh[1];
+    algOversample = rhs.algOversample;
+    algInterval = rhs.algInterval;
+    algFilter = rhs.algFilter;
     return *this;
   }
 };
@@ -40,6 +40,7 @@
 #include "BoardDetect.h"
 #include "DemandManager.h"
 #include "../OLED/ScreenManager.h"
+#include "StatusSnapshot.h"
 
 extern CModerator MQTTmoderator;
 extern CScreenManager ScreenManager;
@@ -52,15 +53,17 @@ CModerator MQTTJSONmoderator;
 CModerator IPmoderator;
 CModerator GPIOmoderator;
 CModerator SysModerator;
+CModerator StatusModerator;   // REST / event stream snapshot, never reset by clients
 bool bTriggerSysParams = false;
 bool bTriggerDateTime = false;
 
-void Expand(std::string& str);
 bool makeJSONString(CModerator& moderator, char* opStr, int len);
 bool makeJSONStringEx(CModerator& moderator, char* opStr, int len);
+bool makeJSONStringTemp(CModerator& moderator, int first, char* opStr, int len);
 bool makeJSONTimerString(int channel, char* opStr, int len);
 bool makeJSONStringGPIO( CModerator& moderator, char* opStr, int len);
 bool makeJSONStringSysInfo(CModerator& moderator, char* opStr, int len);
+bool makeJSONStringSysInfo(CModerator& moderator, bool dateTime, bool sysParams, char* opStr, int len);
 bool makeJSONStringMQTT(CModerator& moderator, char* opStr, int len);
 bool makeJSONStringIP(CModerator& moderator, char* opStr, int len);
 void DecodeCmd(const char* cmd, String& payload);
@@ -128,7 +131,7 @@ void interpretJsonCommand(char* pLine)
 void validateTimer(int ID)
 {
   ID--;  // supplied as +1
-  if(!INBOUNDS(ID, 0, 13))
+  if(!INBOUNDS(ID, 0, MAX_TIMERS-1))
     return;
 
   timerConflict = CTimerManager::conflictTest(ID);  // check targeted timer against other timers
@@ -259,6 +262,33 @@ bool makeJSONStringEx(CModerator& moderator, char* opStr, int len)
   return bSend;
 }
 
+// temperature sensors beyond the first four, TEMP_JSON_PAGE sensors per string
+bool makeJSONStringTemp(CModerator& moderator, int first, char* opStr, int len)
+{
+  StaticJsonBuffer<800> jsonBuffer;               // create a JSON buffer on the stack
+  JsonObject& root = jsonBuffer.createObject();   // create object to add JSON commands to
+
+	bool bSend = false;  // reset should send flag
+
+  int last = first + TEMP_JSON_PAGE;
+  UPPERLIMIT(last, getTempSensor().getNumSensors());
+  for(int usrIdx = first; usrIdx < last; usrIdx++) {
+    float tidyTemp;
+    if(getTempSensor().getTemperature(usrIdx, tidyTemp)) {
+      tidyTemp = int(tidyTemp * 10 + 0.5) * 0.1f;  // round to 0.1 resolution 
+      bSend |= moderator.addJson(CTempSense::getName(usrIdx, CTempSense::CurrentName), tidyTemp, root, 5000); 
+    }
+    bSend |= moderator.addJson(CTempSense::getName(usrIdx, CTempSense::OffsetName), getTempSensor().getOffset(usrIdx), root);     // degC offset
+    bSend |= moderator.addJson(CTempSense::getName(usrIdx, CTempSense::TypeName), getTempSensor().getID(usrIdx), root);     // BME280 vs DS18B20
+  }
+
+  if(bSend) {
+		root.printTo(opStr, len);
+  }
+
+  return bSend;
+}
+
 // the way the JSON timer strings are crafted, we have to iterate over each timer's parameters
 // individually, the JSON name is always the same for each timer, the payload IDs the specific
 // timer
@@ -307,6 +337,9 @@ bool makeJSONStringGPIO(CModerator& moderator, char* opStr, int len)
     if(getBoardRevision() != BRD_V2_GPIO_NOALG && getBoardRevision() != BRD_V3_GPIO_NOALG) {          // has GPIO support
       bSend |= moderator.addJson("GPanlg", info.algVal * 100 / 4096, root); 
       bSend |= moderator.addJson("GPmodeAnlg", GPIOalgNames[info.algMode], root); 
+      bSend |= moderator.addJson("GPalgOvrsmpl", NVstore.getUserSettings().GPIO.algOversample, root); 
+      bSend |= moderator.addJson("GPalgIntvl", NVstore.getUserSettings().GPIO.algInterval, root); 
+      bSend |= moderator.addJson("GPalgFilter", NVstore.getUserSettings().GPIO.algFilter, root); 
     }
     bSend |= moderator.addJson("ExtThermoTmout", (uint32_t)NVstore.getUserSettings().ExtThermoTimeout, root); 
     const char* stop = CDemandManager::getExtThermostatHoldTime();
@@ -350,10 +383,20 @@ bool makeJSONStringMQTT(CModerator& moderator, char* opStr, int len)
 
 
 bool makeJSONStringSysInfo(CModerator& moderator, char* opStr, int len)
+{
+  bool bSend = makeJSONStringSysInfo(moderator, bTriggerDateTime, bTriggerSysParams, opStr, len);
+
+  bTriggerSysParams = false;
+  bTriggerDateTime = false;
+
+  return bSend;
+}
+
+bool makeJSONStringSysInfo(CModerator& moderator, bool dateTime, bool sysParams, char* opStr, int len)
 {
 	bool bSend = false;  // reset should send flag
 
-  if(bTriggerSysParams || bTriggerDateTime) {
+  if(sysParams || dateTime) {
 
     StaticJsonBuffer<800> jsonBuffer;               // create a JSON buffer on the stack
     JsonObject& root = jsonBuffer.createObject();   // create object to add JSON commands to
@@ -364,7 +407,7 @@ bool makeJSONStringSysInfo(CModerator& moderator, char* opStr, int len)
     sprintf(str, "%d/%d/%d %02d:%02d:%02d", now.day(), now.month(), now.year(), now.hour(), now.minute(), now.second());
     bSend |= moderator.addJson("DateTime", str, root); 
     bSend |= moderator.addJson("Time12hr", NVstore.getUserSettings().clock12hr, root); 
-    if(bTriggerSysParams) {
+    if(sysParams) {
       bSend |= moderator.addJson("SysUpTime", sysUptime(), root); 
       bSend |= moderator.addJson("SysVer", getVersionStr(), root); 
       bSend |= moderator.addJson("SysDate", getVersionDate(), root); 
@@ -379,9 +422,6 @@ bool makeJSONStringSysInfo(CModerator& moderator, char* opStr, int len)
     }
   }
 
-  bTriggerSysParams = false;
-  bTriggerDateTime = false;
-
   return bSend;
 }
 
@@ -424,10 +464,24 @@ void updateJSONclients(bool report)
       sendJSONtext(jsonStr, report);
     }
   }
+  // update additional temperature sensors
+  for(int first = 4; first < getTempSensor().getNumSensors(); first += TEMP_JSON_PAGE) {
+    if(makeJSONStringTemp(JSONmoderator, first, jsonStr, sizeof(jsonStr))) {
+      sendJSONtext(jsonStr, report);
+    }
+  }
   // update timer parameters
+  // only a page of timers is examined per call, keeping the cost per loop independent of MAX_TIMERS.
+  // Timers known to have changed are taken first, the rest of the page continues the round robin
+  static int timerPage = 0;
   bool bNewTimerInfo = false;
-  for(int tmr=0; tmr<14; tmr++) 
+  for(int i=0; i<TIMER_JSON_PAGE; i++) 
   {
+    int tmr = TimerModerator.nextPending();
+    if(tmr < 0) {
+      tmr = timerPage++;
+      WRAPUPPERLIMIT(timerPage, MAX_TIMERS-1, 0);
+    }
     if(makeJSONTimerString(tmr, jsonStr, sizeof(jsonStr))) {
       sendJSONtext(jsonStr, report);
       bNewTimerInfo = true;
@@ -477,6 +531,42 @@ void updateJSONclients(bool report)
 
 }
 
+// Refresh the snapshot behind GET /api/status and /api/events.
+// It has its own moderator, so only changed values are merged and the 
+// clients' moderators are left alone.
+// Only whilst the web server is up and a status or event client is asking,
+// the next client to ask waits for a refresh (see CStatusSnapshot::request()).
+// Timers are not included as their moderator is shared by all clients, nor 
+// MQTT as it carries the broker password.
+void updateJSONstatus()
+{
+  if(!isWebServerRunning() || !StatusSnapshot.isWanted())
+    return;
+
+  char jsonStr[800];
+
+  if(makeJSONString(StatusModerator, jsonStr, sizeof(jsonStr))) {
+    StatusSnapshot.merge(jsonStr);
+  }
+  if(makeJSONStringEx(StatusModerator, jsonStr, sizeof(jsonStr))) {
+    StatusSnapshot.merge(jsonStr);
+  }
+  for(int first = 4; first < getTempSensor().getNumSensors(); first += TEMP_JSON_PAGE) {
+    if(makeJSONStringTemp(StatusModerator, first, jsonStr, sizeof(jsonStr))) {
+      StatusSnapshot.merge(jsonStr);
+    }
+  }
+  if(makeJSONStringIP(StatusModerator, jsonStr, sizeof(jsonStr))) {
+    StatusSnapshot.merge(jsonStr);
+  }
+  if(makeJSONStringSysInfo(StatusModerator, true, true, jsonStr, sizeof(jsonStr))) {
+    StatusSnapshot.merge(jsonStr);
+  }
+  if(makeJSONStringGPIO(StatusModerator, jsonStr, sizeof(jsonStr))) {
+    StatusSnapshot.merge(jsonStr);
+  }
+  StatusSnapshot.commit();
+}
 
 void resetAllJSONmoderators()
 {
@@ -516,36 +606,11 @@ void initJSONSysModerator()
 void initJSONTimermoderator()
 {
   char jsonStr[800];
-  for(int tmr=0; tmr<14; tmr++) 
+  for(int tmr=0; tmr<MAX_TIMERS; tmr++) 
     makeJSONTimerString(tmr, jsonStr, sizeof(jsonStr));
 }
 
 
-void Expand(std::string& str)
-{
-  const sUserSettings& userOptions = NVstore.getUserSettings();
-
-  if(userOptions.JSON.singleElement) {
-    size_t pos = str.find(",\"");
-    while(pos != std::string::npos) {
-      if(userOptions.JSON.LF)
-        str.replace(pos, 2, "}\n{\"");  // converts {"name":value,"name2":value"} to {"name":value}\n{"name2":value}
-      else
-        str.replace(pos, 2, "}{\"");   // converts {"name":value,"name2":value"} to {"name":value}{"name2":value}
-      pos = str.find(",\"");
-    }
-    if(userOptions.JSON.padding) {    // converts {"name":value} to {"name": value}
-      pos = str.find("\":");
-      while(pos != std::string::npos) {
-        str.replace(pos, 2, "\": ");
-        pos = str.find("\":", pos+1);
-      }
-    }
-    if(userOptions.JSON.LF)
-      str.append("\n");
-  }
-}
-
 void sendJSONtext(const char* jsonStr, bool report)
 {
   if (report) DebugPort.printf("JSON send: %s\r\n", jsonStr);
@@ -559,9 +624,9 @@ void sendJSONtext(const char* jsonStr, bool report)
   if(mqttPublishJSON(jsonStr))
     dest += "M";
   DebugPort.print("3");
-  std::string expand = jsonStr;
-  Expand(expand);
-  if(getBluetoothClient().send( expand.c_str() ))
+  char expand[1024];
+  const char* btStr = Expand(jsonStr, expand, sizeof(expand));
+  if(getBluetoothClient().send( btStr ))
     dest += "B";
 
   if(!dest.empty()) {
@@ -570,9 +635,8 @@ void sendJSONtext(const char* jsonStr, bool report)
 #else
   sendWebSocketString( jsonStr );
   mqttPublishJSON(jsonStr);
-  std::string expand = jsonStr;
-  Expand(expand);
-  getBluetoothClient().send( expand.c_str() );
+  char expand[1024];
+  getBluetoothClient().send( Expand(jsonStr, expand, sizeof(expand)) );
 #endif
 }
 
@@ -28,6 +28,7 @@
 extern char defaultJSONstr[64];
 
 void updateJSONclients(bool report);
+void updateJSONstatus();
 void initJSONMQTTmoderator();
 void initJSONIPmoderator();
 void initJSONTimermoderator();
@@ -42,6 +43,7 @@ void resetJSONMQTTmoderator();
 void validateTimer(int ID);
 void doJSONreboot(uint16_t code);
 void sendJSONtext(const char* JSONstr, bool report);
+const char* Expand(const char* src, char* dest, int size);   // Bluetooth client's JSON options
 
 template<class T>
 const char* createJSON(const char* name, T value)
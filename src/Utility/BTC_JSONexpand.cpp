@@ -0,0 +1,73 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2019  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <string.h>
+#include "BTC_JSON.h"
+#include "NVStorage.h"
+
+// One pass, heap free expansion for the Bluetooth client's options.
+// Returns src untouched unless single element mode is selected, or if the 
+// expanded string would not fit dest.
+const char* Expand(const char* src, char* dest, int size)
+{
+  const sUserSettings& userOptions = NVstore.getUserSettings();
+
+  if(!userOptions.JSON.singleElement) 
+    return src;
+
+  const char* pIn = src;
+  int len = 0;
+  size--;    // leave room for the terminator
+  while(*pIn) {
+    const char* insert = NULL;
+    int skip = 1;
+    if(pIn[0] == ',' && pIn[1] == '"') {
+      // converts {"name":value,"name2":value"} to {"name":value}\n{"name2":value}  
+      //                                      or {"name":value}{"name2":value}
+      insert = userOptions.JSON.LF ? "}\n{\"" : "}{\"";
+      skip = 2;
+    }
+    else if(userOptions.JSON.padding && pIn[0] == '"' && pIn[1] == ':') {
+      insert = "\": ";    // converts {"name":value} to {"name": value}
+      skip = 2;
+    }
+    if(insert) {
+      int inslen = strlen(insert);
+      if(len + inslen > size)
+        return src;
+      memcpy(&dest[len], insert, inslen);
+      len += inslen;
+    }
+    else {
+      if(len >= size)
+        return src;
+      dest[len++] = *pIn;
+    }
+    pIn += skip;
+  }
+  if(userOptions.JSON.LF) {
+    if(len >= size)
+      return src;
+    dest[len++] = '\n';
+  }
+  dest[len] = 0;
+  return dest;
+}
@@ -0,0 +1,257 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include <Arduino.h>
+#include "BinLog.h"
+#include "DebugPort.h"
+#include "macros.h"
+
+CBinLog BinLog;
+
+// indexed by eLogFmt
+static const char* LogFormats[] = {
+  "%s",                                                                        // LOGF_Text
+  "%ldms - ",                                                                  // LOGF_RecycleTime
+  "Re-sync'd with OEM Controller. %ldms Idle time.\r\n",                       // LOGF_OEMresync
+  "\007Bad CRC detected for %s frame - restarting blue wire's serial port\r\n", // LOGF_BadCRC
+  "verifyCRC FAILED: calc: %04X data: %04X\r\n",                               // LOGF_CRCfail
+  "BAD CRC:%H\r\n",                                                            // LOGF_FrameBadCRC
+  "%8ldms OEM:%H   ",                                                          // LOGF_FrameOEM
+  "%8ldms OEM:%H\r\n",                                                         // LOGF_FrameOEMline
+  "%8ldms BTC:%H   ",                                                          // LOGF_FrameBTC
+  "%8ldms BTC:%H\r\n",                                                         // LOGF_FrameBTCline
+  "HTR:%H\r\n",                                                                // LOGF_FrameHTR
+};
+static_assert(sizeof(LogFormats) / sizeof(LogFormats[0]) == LOGF_NumFormats, "LogFormats[] does not match eLogFmt");
+
+
+CBinLog::CBinLog()
+{
+  for(int i = 0; i < BINLOG_TASK_RINGS; i++) 
+    _owners[i] = NULL;
+  for(int i = 0; i <= BINLOG_TASK_RINGS; i++) {
+    _dropped[i] = 0;
+    _reported[i] = 0;
+  }
+  _sharedMux = portMUX_INITIALIZER_UNLOCKED;
+  _taskHandle = NULL;
+}
+
+void
+CBinLog::begin()
+{
+  // records are formatted and written out well away from the tasks that made them
+  xTaskCreate(_staticTask,
+              "LogTask",
+              3000,
+              this,
+              TASK_PRIORITY_LOG,
+              &_taskHandle);
+}
+
+bool
+CBinLog::attachTask()
+{
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  bool retval = false;
+  portENTER_CRITICAL(&_sharedMux);
+  for(int i = 0; i < BINLOG_TASK_RINGS; i++) {
+    if(_owners[i] == self || _owners[i] == NULL) {
+      _owners[i] = self;
+      retval = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&_sharedMux);
+  return retval;    // false: no free ring, the shared ring will be used
+}
+
+void
+CBinLog::_push(sLogRecord& record)
+{
+  record.time = millis();
+
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for(int i = 0; i < BINLOG_TASK_RINGS; i++) {
+    if(_owners[i] == self) {
+      // this task is the ring's only producer, no locking required
+      if(!_rings[i].push(record))
+        _dropped[i]++;
+      return;
+    }
+  }
+
+  // any other task shares the last ring
+  portENTER_CRITICAL(&_sharedMux);
+  if(!_rings[BINLOG_TASK_RINGS].push(record))
+    _dropped[BINLOG_TASK_RINGS]++;
+  portEXIT_CRITICAL(&_sharedMux);
+}
+
+void
+CBinLog::logDump(eLogFmt fmt, const void* data, int len)
+{
+  sLogRecord record;
+  UPPERLIMIT(len, int(sizeof(record.args)));
+  record.fmt = fmt;
+  memcpy(record.args, data, len);
+  record.len = len;
+  _push(record);
+}
+
+void
+CBinLog::logDump(eLogFmt fmt, long arg, const void* data, int len)
+{
+  sLogRecord record;
+  UPPERLIMIT(len, int(sizeof(record.args) - sizeof(logarg_t)));
+  record.fmt = fmt;
+  record.args[0] = arg;
+  memcpy(&record.args[1], data, len);
+  record.len = sizeof(logarg_t) + len;
+  _push(record);
+}
+
+uint32_t
+CBinLog::getDropped() const
+{
+  uint32_t total = 0;
+  for(int i = 0; i <= BINLOG_TASK_RINGS; i++) 
+    total += _dropped[i];
+  return total;
+}
+
+void
+CBinLog::_staticTask(void* arg)
+{
+  CBinLog* pThis = (CBinLog*)arg;
+
+  pThis->_task();
+
+  vTaskDelete(NULL);
+}
+
+void
+CBinLog::_task()
+{
+  char msg[192];
+  for(;;) {
+    // emit the oldest record of all the rings, until all are empty
+    for(;;) {
+      int oldest = -1;
+      uint32_t oldestTime = 0;
+      sLogRecord record;
+      for(int i = 0; i <= BINLOG_TASK_RINGS; i++) {
+        if(_rings[i].peek(record)) {
+          if(oldest < 0 || int32_t(record.time - oldestTime) < 0) {
+            oldest = i;
+            oldestTime = record.time;
+          }
+        }
+      }
+      if(oldest < 0)
+        break;
+      _rings[oldest].pop(record);
+      _render(record, msg, sizeof(msg));
+      DebugPort.print(msg);
+    }
+
+    for(int i = 0; i <= BINLOG_TASK_RINGS; i++) {
+      uint32_t dropped = _dropped[i];
+      if(dropped != _reported[i]) {
+        DebugPort.printf("*** %d log records dropped ***\r\n", dropped - _reported[i]);
+        _reported[i] = dropped;
+      }
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(BINLOG_DRAIN_INTERVAL));
+  }
+}
+
+void
+CBinLog::_render(const sLogRecord& record, char* out, int size)
+{
+  if(record.fmt >= LOGF_NumFormats) {
+    snprintf(out, size, "*** bad log format %d ***\r\n", record.fmt);
+    return;
+  }
+
+  const char* pFmt = LogFormats[record.fmt];
+  const uint8_t* pData = (const uint8_t*)record.args;
+  int offset = 0;   // of the next argument within args
+  int used = 0;
+  out[0] = 0;
+  while(*pFmt && used < size-1) {
+    if(*pFmt != '%') {
+      out[used++] = *pFmt++;
+      out[used] = 0;
+      continue;
+    }
+    // isolate a single conversion, eg %8ldms => %8ld
+    char spec[16];
+    int n = 0;
+    spec[n++] = *pFmt++;
+    while(*pFmt && strchr("-+ #0123456789.lh", *pFmt) && n < 14)
+      spec[n++] = *pFmt++;
+    char conv = *pFmt;
+    if(conv) 
+      pFmt++;
+    spec[n++] = conv;
+    spec[n] = 0;
+
+    logarg_t arg = 0;
+    if(conv != '%' && conv != 'H') {
+      if(offset + int(sizeof(logarg_t)) <= record.len) 
+        memcpy(&arg, &pData[offset], sizeof(logarg_t));
+      offset += sizeof(logarg_t);
+    }
+
+    int room = size - used;
+    switch(conv) {
+      case '%':
+        snprintf(&out[used], room, "%%");
+        break;
+      case 'H':   // hex dump the remaining argument bytes
+        for(; offset < record.len && used < size-4; offset++) 
+          used += snprintf(&out[used], size - used, " %02X", pData[offset]);
+        break;
+      case 's':
+        snprintf(&out[used], room, spec, arg ? (const char*)arg : "(null)");
+        break;
+      case 'f':
+      case 'e':
+      case 'g': {
+        float f;
+        uint32_t u = arg;
+        memcpy(&f, &u, 4);
+        snprintf(&out[used], room, spec, f);
+        break;
+      }
+      default:
+        if(strchr(spec, 'l'))
+          snprintf(&out[used], room, spec, long(arg));
+        else
+          snprintf(&out[used], room, spec, int(arg));
+        break;
+    }
+    used += strlen(&out[used]);
+  }
+}
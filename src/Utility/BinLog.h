@@ -0,0 +1,122 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef __BINLOG_H__
+#define __BINLOG_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include "EventRing.h"
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CBinLog
+//
+// Deferred debug logging for time critical tasks.
+// A log call only copies a format ID, a timestamp and the raw arguments into
+// a ring owned by the calling task - no formatting, no UART or telnet I/O.
+// A low priority task later formats the records into DebugPort.
+//
+// Arguments are ints, floats or pointers to persistent (literal) strings.
+// The format strings support the usual printf conversions, plus %H which
+// hex dumps the remaining argument bytes (eg a blue wire frame).
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define LOG_ERROR 0
+#define LOG_INFO  1
+#define LOG_DEBUG 2
+
+// calls above BINLOG_LEVEL are removed at compile time
+#define BINLOG(level, fmt, ...)  do { if((level) <= BINLOG_LEVEL) BinLog.log(fmt, ##__VA_ARGS__); } while(0)
+#define BINLOG_DUMP(level, fmt, ...)  do { if((level) <= BINLOG_LEVEL) BinLog.logDump(fmt, __VA_ARGS__); } while(0)
+
+// format IDs, must match LogFormats[] in BinLog.cpp
+enum eLogFmt {
+  LOGF_Text,
+  LOGF_RecycleTime,
+  LOGF_OEMresync,
+  LOGF_BadCRC,
+  LOGF_CRCfail,
+  LOGF_FrameBadCRC,
+  LOGF_FrameOEM,
+  LOGF_FrameOEMline,
+  LOGF_FrameBTC,
+  LOGF_FrameBTCline,
+  LOGF_FrameHTR,
+  LOGF_NumFormats
+};
+
+typedef intptr_t logarg_t;
+const int LOG_MAXARGS = 1 + 24 / sizeof(logarg_t);   // room for one argument and a 24 byte frame
+
+struct sLogRecord {
+  uint32_t time;              // millis()
+  uint8_t fmt;
+  uint8_t len;                // bytes used in args
+  logarg_t args[LOG_MAXARGS];
+};
+
+class CBinLog {
+private:
+  TEventRing<sLogRecord, BINLOG_RING_SIZE> _rings[BINLOG_TASK_RINGS+1];   // last ring is shared by all other tasks
+  TaskHandle_t _owners[BINLOG_TASK_RINGS];
+  volatile uint32_t _dropped[BINLOG_TASK_RINGS+1];
+  uint32_t _reported[BINLOG_TASK_RINGS+1];
+  portMUX_TYPE _sharedMux;
+  TaskHandle_t _taskHandle;
+
+  static logarg_t _arg(int val) { return val; };
+  static logarg_t _arg(unsigned val) { return val; };
+  static logarg_t _arg(long val) { return val; };
+  static logarg_t _arg(unsigned long val) { return val; };
+  static logarg_t _arg(const char* str) { return (logarg_t)str; };
+  static logarg_t _arg(double val) { float f = val; uint32_t u; memcpy(&u, &f, 4); return u; };
+  void _push(sLogRecord& record);
+  void _render(const sLogRecord& record, char* out, int size);
+  static void _staticTask(void* arg);
+  void _task();
+public:
+  CBinLog();
+  void begin();
+  bool attachTask();        // give the calling task its own lock free ring
+  template<typename... Args> 
+  void log(eLogFmt fmt, Args... args) {
+    sLogRecord record;
+    logarg_t packed[sizeof...(Args) + 1] = { _arg(args)... };
+    static_assert(sizeof...(Args) <= LOG_MAXARGS, "too many log arguments");
+    record.fmt = fmt;
+    record.len = sizeof...(Args) * sizeof(logarg_t);
+    memcpy(record.args, packed, record.len);
+    _push(record);
+  };
+  void logDump(eLogFmt fmt, const void* data, int len);             // dump only
+  void logDump(eLogFmt fmt, long arg, const void* data, int len);   // one leading argument, then the dump
+  uint32_t getDropped() const;
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
+};
+
+extern CBinLog BinLog;
+
+#endif
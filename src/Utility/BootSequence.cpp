@@ -0,0 +1,154 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#include "BootSequence.h"
+#include "DebugPort.h"
+
+CBootSequence BootSequence;
+
+
+CBootSequence::CBootSequence()
+{
+  _numStages = 0;
+  _firstTx = 0;
+  _firstRx = 0;
+  _setupEnd = 0;
+  _complete = 0;
+}
+
+int
+CBootSequence::_add(const char* name, bool parallel)
+{
+  if(_numStages >= BOOT_MAX_STAGES)
+    return -1;
+  sStage& stage = _stages[_numStages];
+  stage.name = name;
+  stage.start = millis();
+  stage.end = 0;
+  stage.parallel = parallel;
+  stage.done = false;
+  stage.fn = NULL;
+  return _numStages++;
+}
+
+// stages are only added by setup(), parallel stages just mark their end
+int 
+CBootSequence::begin(const char* name)
+{
+  return _add(name, false);
+}
+
+void
+CBootSequence::end(int stage)
+{
+  if(stage >= 0 && stage < _numStages) {
+    _stages[stage].end = millis();
+    _stages[stage].done = true;
+  }
+}
+
+int
+CBootSequence::runParallel(const char* name, bootFn fn, int stackSize)
+{
+  int stage = _add(name, true);
+  if(stage < 0) {
+    fn();     // no room to track it, just run it in line
+    return -1;
+  }
+  _stages[stage].fn = fn;
+  if(xTaskCreate(_staticTask, name, stackSize, (void*)(intptr_t)stage, TASK_PRIORITY_BOOT, NULL) != pdPASS) {
+    DebugPort.printf("Boot: cannot start \"%s\" task, running in line\r\n", name);
+    fn();
+    end(stage);
+  }
+  return stage;
+}
+
+void
+CBootSequence::_staticTask(void* arg)
+{
+  int stage = (int)(intptr_t)arg;
+
+  BootSequence._stages[stage].fn();
+  BootSequence.end(stage);
+
+  vTaskDelete(NULL);
+}
+
+bool
+CBootSequence::isDone(int stage) const
+{
+  if(stage < 0 || stage >= _numStages)
+    return true;
+  return _stages[stage].done;
+}
+
+void
+CBootSequence::setupDone()
+{
+  _setupEnd = millis();
+}
+
+bool
+CBootSequence::checkComplete()
+{
+  if(_complete || !_setupEnd)
+    return false;
+  for(int i = 0; i < _numStages; i++) {
+    if(!_stages[i].done)
+      return false;
+  }
+  _complete = millis();
+  return true;
+}
+
+void
+CBootSequence::report()
+{
+  DebugPort.println("Boot timeline, ms since application start");
+  DebugPort.printf("  %-18s %7s %7s %8s\r\n", "Stage", "Start", "End", "Duration");
+  for(int i = 0; i < _numStages; i++) {
+    const sStage& stage = _stages[i];
+    if(stage.done) {
+      DebugPort.printf("  %-18s %7lu %7lu %8lu%s\r\n", stage.name, stage.start, stage.end, 
+                       stage.end - stage.start, stage.parallel ? "  (parallel)" : "");
+    }
+    else {
+      DebugPort.printf("  %-18s %7lu running%s\r\n", stage.name, stage.start, stage.parallel ? "           (parallel)" : "");
+    }
+  }
+  if(_setupEnd)
+    DebugPort.printf("  %-18s %7lu\r\n", "setup() returned", _setupEnd);
+  if(_complete)
+    DebugPort.printf("  %-18s %7lu\r\n", "Boot complete", _complete);
+
+  if(_firstTx) {
+    DebugPort.printf("  %-18s %7lu, budget %dms%s\r\n", "First heater frame", _firstTx, BOOT_FIRST_FRAME_BUDGET,
+                     _firstTx > BOOT_FIRST_FRAME_BUDGET ? " EXCEEDED" : "");
+  }
+  else {
+    DebugPort.println("  First heater frame not yet sent");
+  }
+  if(_firstRx)
+    DebugPort.printf("  %-18s %7lu\r\n", "First heater reply", _firstRx);
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+
+#ifndef __BOOTSEQUENCE_H__
+#define __BOOTSEQUENCE_H__
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CBootSequence
+//
+// Timestamps each stage of the boot, in setup() or in a parallel task, and
+// when the first heater frame was sent and answered.
+// Stages run via runParallel() have their own task, loop() may test them
+// with isDone() before using what they bring up. checkComplete() returns
+// true once, when setup() and all parallel stages have finished.
+// Times are ms since the application started, the bootloader is not seen.
+//
+///////////////////////////////////////////////////////////////////////////
+
+typedef void (*bootFn)();
+
+class CBootSequence {
+  struct sStage {
+    const char* name;
+    unsigned long start;
+    unsigned long end;
+    bool parallel;
+    volatile bool done;
+    bootFn fn;
+  };
+  sStage _stages[BOOT_MAX_STAGES];
+  int _numStages;
+  volatile unsigned long _firstTx;
+  volatile unsigned long _firstRx;
+  unsigned long _setupEnd;
+  unsigned long _complete;
+  static void _staticTask(void* arg);
+  int _add(const char* name, bool parallel);
+public:
+  CBootSequence();
+  int  begin(const char* name);
+  void end(int stage);
+  int  runParallel(const char* name, bootFn fn, int stackSize);
+  bool isDone(int stage) const;    // true for stage -1, ie never started
+  void setupDone();
+  bool checkComplete();
+  bool isComplete() const { return _complete != 0; };
+  // from the blue wire task
+  void markFirstTx() { if(!_firstTx) _firstTx = millis(); };
+  void markFirstRx() { if(!_firstRx) _firstRx = millis(); };
+  void report();
+};
+
+extern CBootSequence BootSequence;
+
+#endif
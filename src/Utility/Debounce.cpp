@@ -25,7 +25,11 @@
 CDebounce::CDebounce()
 {
   _pinActiveState = LOW;
-  _prevPins = 0;
+  _nPins = 0;
+  _bOverflow = false;
+  _rawPins = 0;
+  _bSettling = false;
+  _debouncedPins = 0;
   _lastDebounceTime = 0;
   _debounceDelay = 50;
 }
@@ -33,9 +37,19 @@ CDebounce::CDebounce()
 void 
 CDebounce::addPin(int pin)
 {
-  if(pin && (_pins.size() < 8)) {
-    _pins.push_back(pin);
+  if(pin && (_nPins < 8)) {
+    for(int i = 0; i < _nPins; i++) {
+      if(_pins[i] == pin)
+        return;   // already registered, eg GPIO setup has been re-applied
+    }
     pinMode(pin, INPUT_PULLUP);   // GPIO input pin #1
+    _pins[_nPins++] = pin;
+    attachInterruptArg(pin, _edgeISR, this, CHANGE);
+
+    // pick up the current state, after the usual debounce delay
+    _rawPins = _scanInputs();
+    _lastDebounceTime = millis();
+    _bSettling = true;
   }
 }
 
@@ -51,36 +65,71 @@ CDebounce::getState()
   return _debouncedPins; 
 }
 
-uint8_t 
-CDebounce::manage() 
+void IRAM_ATTR
+CDebounce::_edgeISR(void* arg)
 {
-  return _scanInputs();
+  CDebounce* pThis = (CDebounce*)arg;
+
+  sEdge edge;
+  edge.time = xTaskGetTickCountFromISR();   // same time base as millis()
+  edge.pins = pThis->_scanInputs();
+  if(!pThis->_edges.push(edge))
+    pThis->_bOverflow = true;
 }
 
 uint8_t 
-CDebounce::_scanInputs()
+CDebounce::manage() 
 {
-  uint8_t newPins = 0;
-  uint8_t mask = 0x01;
-  for(int i = 0; i < _pins.size(); i++) {
-    if(digitalRead(_pins[i]) == _pinActiveState) 
-      newPins |= mask;
-    mask <<= 1;
+  // the last edge in the ring is the most recent change
+  sEdge edge;
+  while(_edges.peek(edge)) {
+    if(_bSettling && (long)(edge.time - _lastDebounceTime) > (long)_debounceDelay) {
+      // the pins had settled before this edge: a state not yet returned is returned 
+      // now, so a press is not lost when loop() is slower than it was held
+      _bSettling = false;
+      if(_debouncedPins != _rawPins) {
+        _debouncedPins = _rawPins;
+        return _debouncedPins;     // the later edges wait for the next call
+      }
+    }
+    _edges.pop(edge);
+    if(edge.pins != _rawPins) {
+      _rawPins = edge.pins;
+      _lastDebounceTime = edge.time;
+      _bSettling = true;
+    }
   }
-
-  if(newPins != _prevPins) {
+  if(_bOverflow) {
+    // edges were lost to a full ring (heavy contact bounce), resync from the pins
+    _bOverflow = false;
+    _edges.flush();
+    _rawPins = _scanInputs();
     _lastDebounceTime = millis();
-    _prevPins = newPins;
+    _bSettling = true;
   }
 
-  long elapsed = millis() - _lastDebounceTime;
-  if (elapsed > _debounceDelay) {
-    // whatever the reading is at, it's been there for longer than the debounce
-    // delay, so take it as the actual current state:
-    _debouncedPins = newPins;
+  if(_bSettling) {
+    long elapsed = millis() - _lastDebounceTime;
+    if (elapsed > _debounceDelay) {
+      // whatever the reading is at, it's been there for longer than the debounce
+      // delay, so take it as the actual current state:
+      _debouncedPins = _rawPins;
+      _bSettling = false;
+    }
   }
 
   return _debouncedPins;
 }
 
-
+uint8_t IRAM_ATTR
+CDebounce::_scanInputs()
+{
+  uint8_t newPins = 0;
+  uint8_t mask = 0x01;
+  for(int i = 0; i < _nPins; i++) {
+    if(digitalRead(_pins[i]) == _pinActiveState) 
+      newPins |= mask;
+    mask <<= 1;
+  }
+  return newPins;
+}
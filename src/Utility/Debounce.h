@@ -23,16 +23,28 @@
 #define __DEBOUNCE_H__
 
 #include <stdint.h>
-#include <vector>
+#include <Arduino.h>
+#include "EventRing.h"
 
+// Inputs are edge interrupt driven: the ISR timestamps the pin states into a ring,
+// manage() debounces from the timestamps. Nothing is read while the inputs are idle.
 class CDebounce {
+  struct sEdge {
+    unsigned long time;
+    uint8_t pins;
+  };
   int _pinActiveState;
-  std::vector<int> _pins;
-  uint8_t _prevPins;
+  int _pins[8];
+  int _nPins;
+  TEventRing<sEdge, 16> _edges;
+  volatile bool _bOverflow;
+  uint8_t _rawPins;
+  bool _bSettling;
   uint8_t _debouncedPins;
   unsigned long _lastDebounceTime;
   unsigned long _debounceDelay;
   uint8_t _scanInputs();
+  static void IRAM_ATTR _edgeISR(void* arg);
 public:
   CDebounce();
   void addPin(int pin);
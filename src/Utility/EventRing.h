@@ -0,0 +1,77 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef __EVENTRING_H__
+#define __EVENTRING_H__
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////
+//
+// TEventRing
+//
+// Fixed size, lock free, single producer / single consumer ring.
+// The producer may be an ISR: nothing allocates and push() never blocks.
+// N must be a power of 2.
+//
+///////////////////////////////////////////////////////////////////////////
+
+template<class T, int N>
+class TEventRing {
+  static_assert((N & (N-1)) == 0, "TEventRing size must be a power of 2");
+  T _buf[N];
+  volatile uint32_t _head;    // only written by the producer
+  volatile uint32_t _tail;    // only written by the consumer
+public:
+  TEventRing() { _head = _tail = 0; };
+  // producer side
+  inline __attribute__((always_inline)) bool push(const T& val) {
+    uint32_t head = _head;
+    if(head - _tail >= N)
+      return false;   // full
+    _buf[head & (N-1)] = val;
+    __sync_synchronize();   // entry must be visible before the index moves
+    _head = head + 1;
+    return true;
+  };
+  // consumer side
+  bool pop(T& val) {
+    uint32_t tail = _tail;
+    if(tail == _head)
+      return false;   // empty
+    val = _buf[tail & (N-1)];
+    __sync_synchronize();
+    _tail = tail + 1;
+    return true;
+  };
+  bool peek(T& val) const {
+    if(_tail == _head)
+      return false;
+    val = _buf[_tail & (N-1)];
+    return true;
+  };
+  void flush() { _tail = _head; };
+  bool isEmpty() const { return _tail == _head; };
+  int  getCount() const { return _head - _tail; };
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#include <new>
+#include "HeapMonitor.h"
+#include "DebugPort.h"
+#include "macros.h"
+
+// constant initialised, so usable before any static constructor has run
+CHeapMonitor HeapMonitor;
+static portMUX_TYPE heapMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+#if USE_HEAP_MONITOR == 1
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Global operator new / delete replacements
+//
+// Behave as the toolchain's versions built without exceptions - a failed
+// allocation aborts, only the nothrow forms return NULL. Everything using
+// new, the STL containers included, relies on that.
+//
+///////////////////////////////////////////////////////////////////////////
+
+static void*
+monitoredAlloc(size_t size, void* caller)
+{
+  void* ptr = malloc(size ? size : 1);
+  HeapMonitor.onAlloc(size, caller, ptr != NULL);
+  return ptr;
+}
+
+static uint32_t callerAddress(void* ret);
+
+// out of memory cannot be recovered from, report where rather than return NULL
+static void*
+monitoredNew(size_t size, void* caller)
+{
+  void* ptr = monitoredAlloc(size, caller);
+  if(ptr == NULL) {
+    ets_printf("operator new: %u bytes for 0x%08X failed, heap exhausted\r\n", (unsigned)size, callerAddress(caller));
+    abort();
+  }
+  return ptr;
+}
+
+static void
+monitoredFree(void* ptr)
+{
+  if(ptr) {
+    HeapMonitor.onFree();
+    free(ptr);
+  }
+}
+
+void* operator new(size_t size) 
+{ 
+  return monitoredNew(size, __builtin_return_address(0)); 
+}
+
+void* operator new[](size_t size) 
+{ 
+  return monitoredNew(size, __builtin_return_address(0)); 
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept 
+{ 
+  return monitoredAlloc(size, __builtin_return_address(0)); 
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept 
+{ 
+  return monitoredAlloc(size, __builtin_return_address(0)); 
+}
+
+void operator delete(void* ptr) noexcept 
+{ 
+  monitoredFree(ptr); 
+}
+
+void operator delete[](void* ptr) noexcept 
+{ 
+  monitoredFree(ptr); 
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept 
+{ 
+  monitoredFree(ptr); 
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept 
+{ 
+  monitoredFree(ptr); 
+}
+
+#endif
+
+
+// convert a return address to the address of the calling instruction
+static uint32_t
+callerAddress(void* ret)
+{
+  uint32_t addr = (uint32_t)(uintptr_t)ret;
+#ifdef ESP32
+  // Xtensa windowed ABI - the top 2 bits hold the window increment
+  addr = ((addr & 0x3fffffff) | 0x40000000) - 3;
+#endif
+  return addr;
+}
+
+static void
+countAlloc(sHeapCounts& counts, size_t size, bool ok)
+{
+  counts.allocs++;
+  counts.bytes += size;
+  if(!ok)
+    counts.failed++;
+}
+
+void
+CHeapMonitor::onAlloc(size_t size, void* caller, bool ok)
+{
+  portENTER_CRITICAL(&heapMux);
+  countAlloc(_counts, size, ok);
+  if(_booted) {
+    countAlloc(_postBoot, size, ok);
+    uint32_t addr = callerAddress(caller);
+    int i;
+    for(i = 0; i < _numSites; i++) {
+      if(_sites[i].caller == addr)
+        break;
+    }
+    if(i == _numSites && _numSites < HEAP_CALLSITES) {
+      _sites[i].caller = addr;
+      _numSites++;
+    }
+    if(i < _numSites) {
+      sHeapSite& site = _sites[i];
+      site.count++;
+      site.bytes += size;
+      LOWERLIMIT(site.maxSize, size);
+    }
+    else {
+      _untracked++;
+    }
+  }
+  portEXIT_CRITICAL(&heapMux);
+}
+
+void
+CHeapMonitor::onFree()
+{
+  portENTER_CRITICAL(&heapMux);
+  _counts.frees++;
+  if(_booted)
+    _postBoot.frees++;
+  portEXIT_CRITICAL(&heapMux);
+}
+
+void
+CHeapMonitor::_sample(sHeapSample& sample)
+{
+  sample.freeHeap = ESP.getFreeHeap();
+  sample.largest = ESP.getMaxAllocHeap();
+}
+
+void
+CHeapMonitor::bootComplete()
+{
+  _sample(_boot);
+  _trendIdx = 0;
+  _trendCount = 0;
+  _lastSample = _bootTime = millis();
+  portENTER_CRITICAL(&heapMux);
+  _booted = true;
+  portEXIT_CRITICAL(&heapMux);
+}
+
+void
+CHeapMonitor::getCounts(sHeapCounts& all, sHeapCounts& postBoot)
+{
+  portENTER_CRITICAL(&heapMux);
+  all = _counts;
+  postBoot = _postBoot;
+  portEXIT_CRITICAL(&heapMux);
+}
+
+void
+CHeapMonitor::manage()
+{
+  if(!_booted)
+    return;
+
+  unsigned long tDelta = millis() - _lastSample;
+  if(tDelta >= HEAP_TREND_INTERVAL) {
+    _lastSample += HEAP_TREND_INTERVAL;
+    _sample(_trend[_trendIdx]);
+    _trendIdx = (_trendIdx + 1) % HEAP_TREND_SAMPLES;
+    if(_trendCount < HEAP_TREND_SAMPLES)
+      _trendCount++;
+  }
+
+#if HEAP_GUARD == 1
+  // sites are only ever added, report any the guard has not yet seen
+  for(int i = 0; i < _numSites; i++) {
+    if(!_sites[i].reported) {
+      portENTER_CRITICAL(&heapMux);
+      sHeapSite site = _sites[i];
+      _sites[i].reported = true;
+      portEXIT_CRITICAL(&heapMux);
+      DebugPort.printf("HEAP GUARD: allocation after boot from 0x%08X, %d bytes\r\n", site.caller, site.maxSize);
+    }
+  }
+#endif
+}
+
+void
+CHeapMonitor::report()
+{
+  sHeapSample now;
+  _sample(now);
+  int frag = now.freeHeap ? 100 - (int)((uint64_t)now.largest * 100 / now.freeHeap) : 0;
+  DebugPort.printf("Heap: %d free, %d minimum, largest block %d, fragmentation %d%%\r\n", 
+                   now.freeHeap, ESP.getMinFreeHeap(), now.largest, frag);
+
+  if(!_booted) {
+    DebugPort.println("  boot not yet complete");
+    return;
+  }
+
+  sHeapCounts all, postBoot;
+  getCounts(all, postBoot);
+  sHeapSite sites[HEAP_CALLSITES];
+  portENTER_CRITICAL(&heapMux);
+  int numSites = _numSites;
+  uint32_t untracked = _untracked;
+  memcpy(sites, _sites, sizeof(sites));
+  portEXIT_CRITICAL(&heapMux);
+
+  DebugPort.printf("  At boot: %d free, largest block %d\r\n", _boot.freeHeap, _boot.largest);
+#if USE_HEAP_MONITOR == 1
+  DebugPort.printf("  Since power up: %d new (%d bytes), %d delete, %d failed\r\n", 
+                   all.allocs, all.bytes, all.frees, all.failed);
+  DebugPort.printf("  Since boot (%lds): %d new (%d bytes), %d delete, %d failed\r\n", 
+                   (millis() - _bootTime) / 1000, postBoot.allocs, postBoot.bytes, postBoot.frees, postBoot.failed);
+  if(numSites) {
+    DebugPort.println("  Call sites after boot (addr2line -pfiaC -e firmware.elf <addr>):");
+    DebugPort.println("     Address    Count      Bytes    Max");
+    for(int i = 0; i < numSites; i++) {
+      DebugPort.printf("  0x%08X %8d %10d %6d\r\n", sites[i].caller, sites[i].count, sites[i].bytes, sites[i].maxSize);
+    }
+    if(untracked)
+      DebugPort.printf("  plus %d from call sites beyond the table\r\n", untracked);
+  }
+#endif
+
+  if(_trendCount) {
+    DebugPort.printf("  Trend, every %ds - free/largest:\r\n", HEAP_TREND_INTERVAL / 1000);
+    int idx = (_trendIdx + HEAP_TREND_SAMPLES - _trendCount) % HEAP_TREND_SAMPLES;
+    for(int i = 0; i < _trendCount; i++) {
+      const sHeapSample& sample = _trend[idx];
+      DebugPort.printf("  %d/%d%s", sample.freeHeap, sample.largest, (i % 6 == 5) ? "\r\n" : "");
+      idx = (idx + 1) % HEAP_TREND_SAMPLES;
+    }
+    if(_trendCount % 6)
+      DebugPort.println("");
+  }
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+
+#ifndef __HEAPMONITOR_H__
+#define __HEAPMONITOR_H__
+
+#include <Arduino.h>
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CHeapMonitor
+//
+// Once setup() has completed the firmware should run without touching the
+// heap - a steady trickle of allocations is what slowly fragments it.
+// With USE_HEAP_MONITOR 1 the global operator new / delete are replaced so
+// C++ allocations are counted, and those made after bootComplete() are 
+// tagged by call site (resolve with addr2line against the firmware .elf).
+// malloc() and Arduino String are not seen, the free heap trend still
+// exposes them.
+// The free heap and largest free block are sampled periodically, their
+// ratio being the fragmentation.
+// HEAP_GUARD 1 reports each new post boot call site as it appears.
+//
+///////////////////////////////////////////////////////////////////////////
+
+struct sHeapCounts {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t bytes;             // total requested, not in use
+  uint32_t failed;            // allocations that returned NULL
+};
+
+struct sHeapSite {
+  uint32_t caller;            // return address into the calling code
+  uint32_t count;
+  uint32_t bytes;
+  uint32_t maxSize;
+  bool reported;              // by the guard
+};
+
+struct sHeapSample {
+  uint32_t freeHeap;          // bytes
+  uint32_t largest;           // bytes, largest free block
+};
+
+class CHeapMonitor {
+  // No constructor - operator new runs before static constructors, so all
+  // state relies upon zero initialisation.
+  volatile bool _booted;
+  unsigned long _bootTime;
+  sHeapCounts _counts;        // since power up
+  sHeapCounts _postBoot;      // since bootComplete()
+  sHeapSite _sites[HEAP_CALLSITES];
+  int _numSites;
+  uint32_t _untracked;        // post boot allocations beyond the call site table
+  sHeapSample _boot;
+  sHeapSample _trend[HEAP_TREND_SAMPLES];
+  int _trendIdx;
+  int _trendCount;
+  unsigned long _lastSample;
+  void _sample(sHeapSample& sample);
+public:
+  // from the operator new / delete replacements only
+  void onAlloc(size_t size, void* caller, bool ok);
+  void onFree();
+
+  void bootComplete();        // end of setup()
+  bool isBooted() const { return _booted; };
+  void manage();              // from loop()
+  void report();
+  void getCounts(sHeapCounts& all, sHeapCounts& postBoot);
+};
+
+extern CHeapMonitor HeapMonitor;
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2020  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "I2CBus.h"
+#include "DebugPort.h"
+
+CI2CBus I2CBus;
+
+CI2CBus::CI2CBus()
+{
+  _mux = portMUX_INITIALIZER_UNLOCKED;
+  _begun = false;
+  _owner = NULL;
+  _depth = 0;
+  _seq = 0;
+  memset(_waiters, 0, sizeof(_waiters));
+  memset(_queue, 0, sizeof(_queue));
+  _pending = 0;
+  _taskHandle = NULL;
+  _priority[I2C_OLED] = 0;       // frames are sent in page spans, the others' accesses are brief
+  _priority[I2C_RTC] = 2;        
+  _priority[I2C_BME280] = 1;     
+  _clock[I2C_OLED] = 800000;     // SH1106 copes well above the 400kHz spec
+  _clock[I2C_RTC] = 400000;      // DS3231 maximum
+  _clock[I2C_BME280] = 400000;   // BME280 fast mode
+  _lastDevice = -1;
+  _holder = I2C_OLED;
+  _holdStart = 0;
+  resetStats();
+}
+
+void
+CI2CBus::begin()
+{
+  if(_begun)
+    return;
+  for(int i = 0; i < I2C_MAX_WAITERS; i++) {
+    _waiters[i].grant = xSemaphoreCreateBinary();
+    _waiters[i].state = WaiterFree;
+  }
+  _begun = true;
+  xTaskCreate(_staticTask,
+              "I2CTask",
+              TASK_STACK_I2C,
+              this,
+              TASK_PRIORITY_I2C,
+              &_taskHandle);
+}
+
+bool
+CI2CBus::lock(eI2CDevice device, TickType_t wait)
+{
+  unsigned long tStart = micros();
+  TickType_t tickStart = xTaskGetTickCount();
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  sWaiter* pWaiter = NULL;
+  for(;;) {
+    portENTER_CRITICAL(&_mux);
+    if(_depth && _owner == self) {
+      // nested hold
+      _depth++;
+      portEXIT_CRITICAL(&_mux);
+      return true;
+    }
+    if(_depth == 0 || !_begun) {
+      // free (unlock() hands a held bus straight to any waiter), or still booting single threaded
+      _owner = self;
+      _depth++;
+      portEXIT_CRITICAL(&_mux);
+      _granted(device, tStart, 0);
+      return true;
+    }
+    pWaiter = _addWaiter(device, self);
+    portEXIT_CRITICAL(&_mux);
+    if(pWaiter)
+      break;
+    // every waiter slot in use, try again shortly
+    if(xTaskGetTickCount() - tickStart >= wait)
+      return false;
+    vTaskDelay(1);
+  }
+
+  if(xSemaphoreTake(pWaiter->grant, wait) != pdTRUE) {
+    portENTER_CRITICAL(&_mux);
+    bool withdrawn = pWaiter->state == WaiterWaiting;
+    if(withdrawn)
+      pWaiter->state = WaiterFree;
+    portEXIT_CRITICAL(&_mux);
+    if(withdrawn)
+      return false;
+    // granted as we timed out, the grant is given just after
+    xSemaphoreTake(pWaiter->grant, portMAX_DELAY);
+  }
+  int bypassed = pWaiter->ticket.bypassed;
+  portENTER_CRITICAL(&_mux);
+  pWaiter->state = WaiterFree;
+  portEXIT_CRITICAL(&_mux);
+  _granted(device, tStart, bypassed);
+  return true;
+}
+
+void
+CI2CBus::unlock()
+{
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&_mux);
+  if(_depth == 0 || (_begun && _owner != self)) {
+    portEXIT_CRITICAL(&_mux);
+    return;
+  }
+  if(--_depth) {
+    portEXIT_CRITICAL(&_mux);
+    return;
+  }
+  _stats[_holder].busy_us += micros() - _holdStart;
+  sWaiter* pNext = _nextWaiter();
+  if(pNext) {
+    // handed straight over, nobody can slip in between
+    _owner = pNext->task;
+    _depth = 1;
+    pNext->state = WaiterGranted;
+  }
+  else {
+    _owner = NULL;
+  }
+  portEXIT_CRITICAL(&_mux);
+  if(pNext)
+    xSemaphoreGive(pNext->grant);
+}
+
+// the bus is ours: account for the wait and apply the device's clock
+void
+CI2CBus::_granted(eI2CDevice device, unsigned long tStart, int bypassed)
+{
+  unsigned long now = micros();
+  unsigned long waited = now - tStart;
+  sI2CStats& stats = _stats[device];
+  stats.count++;
+  stats.wait_us += waited;
+  if(waited > stats.maxWait_us)
+    stats.maxWait_us = waited;
+  stats.bypassed += bypassed;
+  if(bypassed > (int)stats.maxBypassed)
+    stats.maxBypassed = bypassed;
+  _holder = device;
+  _holdStart = now;
+
+  if(device != _lastDevice) {
+    // Wire.begin() calls elsewhere can also change the clock - check actual value
+    if(Wire.getClock() != _clock[device])
+      Wire.setClock(_clock[device]);
+    _lastDevice = device;
+  }
+}
+
+// call within the critical section
+CI2CBus::sWaiter*
+CI2CBus::_addWaiter(eI2CDevice device, TaskHandle_t task)
+{
+  for(int i = 0; i < I2C_MAX_WAITERS; i++) {
+    sWaiter& waiter = _waiters[i];
+    if(waiter.state == WaiterFree) {
+      waiter.ticket.seq = _seq++;
+      waiter.ticket.priority = _priority[device];
+      waiter.ticket.bypassed = 0;
+      waiter.device = device;
+      waiter.task = task;
+      waiter.state = WaiterWaiting;
+      return &waiter;
+    }
+  }
+  return NULL;
+}
+
+// call within the critical section
+CI2CBus::sWaiter*
+CI2CBus::_nextWaiter()
+{
+  sTicket* tickets[I2C_MAX_WAITERS];
+  for(int i = 0; i < I2C_MAX_WAITERS; i++) 
+    tickets[i] = (_waiters[i].state == WaiterWaiting) ? &_waiters[i].ticket : NULL;
+  int next = _pickNext(tickets, I2C_MAX_WAITERS);
+  return (next < 0) ? NULL : &_waiters[next];
+}
+
+// Highest priority first, then oldest. Those passed over by a later arrival 
+// are charged a bypass, once they reach I2C_MAX_BYPASS they go first.
+int
+CI2CBus::_pickNext(sTicket* const* tickets, int count)
+{
+  int best = -1;
+  for(int i = 0; i < count; i++) {
+    const sTicket* pTicket = tickets[i];
+    if(pTicket == NULL)
+      continue;
+    if(best < 0) {
+      best = i;
+      continue;
+    }
+    const sTicket* pBest = tickets[best];
+    bool starved = pTicket->bypassed >= I2C_MAX_BYPASS;
+    bool bestStarved = pBest->bypassed >= I2C_MAX_BYPASS;
+    bool older = int32_t(pTicket->seq - pBest->seq) < 0;
+    if(starved != bestStarved) {
+      if(starved)
+        best = i;
+    }
+    else if(!starved && pTicket->priority != pBest->priority) {
+      if(pTicket->priority > pBest->priority)
+        best = i;
+    }
+    else if(older) {
+      best = i;
+    }
+  }
+  if(best >= 0) {
+    for(int i = 0; i < count; i++) {
+      if(tickets[i] && int32_t(tickets[i]->seq - tickets[best]->seq) < 0)
+        tickets[i]->bypassed++;
+    }
+  }
+  return best;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Queued transactions
+//
+///////////////////////////////////////////////////////////////////////////
+
+bool
+CI2CBus::submit(const sI2CTransaction& txn)
+{
+  if(_taskHandle == NULL) {
+    sI2CTransaction now = txn;
+    _perform(now);
+    return true;
+  }
+  portENTER_CRITICAL(&_mux);
+  for(int i = 0; i < I2C_QUEUE_SIZE; i++) {
+    sQueued& entry = _queue[i];
+    if(!entry.used) {
+      entry.ticket.seq = _seq++;
+      entry.ticket.priority = _priority[txn.device];
+      entry.ticket.bypassed = 0;
+      entry.txn = txn;
+      entry.used = true;
+      _pending++;
+      portEXIT_CRITICAL(&_mux);
+      xTaskNotifyGive(_taskHandle);
+      return true;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+  return false;
+}
+
+void
+CI2CBus::waitQueue(unsigned long timeout)
+{
+  if(xTaskGetCurrentTaskHandle() == _taskHandle)
+    return;
+  unsigned long tStart = millis();
+  while(_pending && (millis() - tStart) < timeout) {
+    vTaskDelay(1);
+  }
+}
+
+void
+CI2CBus::_perform(sI2CTransaction& txn)
+{
+  bool ok;
+  lock(txn.device);
+  ok = txn.transfer(txn);
+  unlock();
+  if(txn.complete)
+    txn.complete(txn, ok);
+}
+
+void
+CI2CBus::_staticTask(void* arg)
+{
+  CI2CBus* pThis = (CI2CBus*)arg;
+  pThis->_task();
+  vTaskDelete(NULL);
+}
+
+void
+CI2CBus::_task()
+{
+  for(;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for(;;) {
+      sI2CTransaction txn;
+      sTicket* tickets[I2C_QUEUE_SIZE];
+      portENTER_CRITICAL(&_mux);
+      for(int i = 0; i < I2C_QUEUE_SIZE; i++)
+        tickets[i] = _queue[i].used ? &_queue[i].ticket : NULL;
+      int next = _pickNext(tickets, I2C_QUEUE_SIZE);
+      if(next >= 0) {
+        txn = _queue[next].txn;
+        _queue[next].used = false;
+      }
+      portEXIT_CRITICAL(&_mux);
+      if(next < 0)
+        break;
+      _perform(txn);
+      portENTER_CRITICAL(&_mux);
+      _stats[txn.device].queued++;
+      _pending--;
+      portEXIT_CRITICAL(&_mux);
+    }
+  }
+}
+
+void
+CI2CBus::resetStats()
+{
+  memset(_stats, 0, sizeof(_stats));
+  _statsStart = millis();
+}
+
+void
+CI2CBus::report()
+{
+  static const char* names[I2C_NumDevices] = { "OLED", "RTC", "BME280" };
+  unsigned long elapsed = millis() - _statsStart;
+  if(elapsed == 0)
+    elapsed = 1;
+  uint32_t busy = 0;
+  DebugPort.printf("I2C bus usage over %ldms\r\n", elapsed);
+  for(int i = 0; i < I2C_NumDevices; i++) {
+    const sI2CStats& stats = _stats[i];
+    busy += stats.busy_us;
+    DebugPort.printf("  %-7s %6d grants (%d queued), busy %6dms (%4.1f%%), wait total %5dms, worst %5dus, bypassed %d (worst %d)\r\n", 
+                     names[i], stats.count, stats.queued, stats.busy_us / 1000, stats.busy_us * 0.1 / elapsed, 
+                     stats.wait_us / 1000, stats.maxWait_us, stats.bypassed, stats.maxBypassed);
+  }
+  DebugPort.printf("  Utilisation %.1f%%\r\n", busy * 0.1 / elapsed);
+  resetStats();
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2020  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef __BTC_I2CBUS_H__
+#define __BTC_I2CBUS_H__
+
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CI2CBus
+//
+// The OLED, DS3231 RTC and BME280 all share the one Wire bus, and the OLED 
+// is written from its own task. Every I2C access must hold the bus whilst
+// it performs its transactions. Holds nest, so a holder may lock again.
+//
+// Each device has its own bus clock, which is only applied when the bus is 
+// taken by a different device to the last holder.
+//
+// Waiters are granted the bus by their device's priority (RTC, then BME280,
+// then OLED), oldest first within a priority. A waiter passed over 
+// I2C_MAX_BYPASS times by later arrivals is served next regardless, so the
+// OLED flush task, which holds the bus for one page span at a time, cannot 
+// be starved.
+//
+// Transactions whose caller need not wait for them (RTC store writes) are
+// queued with submit(), the I2C task performs them in the same priority
+// order then calls their completion callback. Without the task running
+// submit() performs the transaction there and then.
+//
+///////////////////////////////////////////////////////////////////////////
+
+enum eI2CDevice { I2C_OLED, I2C_RTC, I2C_BME280, I2C_NumDevices };
+
+struct sI2CStats {
+  uint32_t count;        // bus grants
+  uint32_t busy_us;      // total time the bus was held
+  uint32_t wait_us;      // total time spent waiting for the bus
+  uint32_t maxWait_us;   // worst case wait for the bus
+  uint32_t bypassed;     // times passed over by later, higher priority, waiters
+  uint32_t maxBypassed;  // most times a single wait was passed over
+  uint32_t queued;       // transactions performed by the I2C task
+};
+
+struct sI2CTransaction;
+typedef bool (*tI2CTransfer)(sI2CTransaction& txn);             // the Wire calls, made whilst holding the bus
+typedef void (*tI2CComplete)(const sI2CTransaction& txn, bool ok);
+
+struct sI2CTransaction {
+  eI2CDevice device;
+  tI2CTransfer transfer;
+  tI2CComplete complete;     // optional, called from the I2C task
+  void* context;
+  int param;
+  uint8_t len;
+  uint8_t data[I2C_DATA_SIZE];
+};
+
+class CI2CBus {
+private:
+  // arrival order and priority of a waiter or queued transaction
+  struct sTicket {
+    uint32_t seq;
+    uint8_t priority;
+    uint8_t bypassed;
+  };
+  enum eWaiterState { WaiterFree, WaiterWaiting, WaiterGranted };
+  struct sWaiter {
+    sTicket ticket;
+    eI2CDevice device;
+    TaskHandle_t task;
+    SemaphoreHandle_t grant;
+    eWaiterState state;
+  };
+  struct sQueued {
+    sTicket ticket;
+    bool used;
+    sI2CTransaction txn;
+  };
+  portMUX_TYPE _mux;
+  bool _begun;
+  TaskHandle_t _owner;
+  int _depth;
+  uint32_t _seq;
+  sWaiter _waiters[I2C_MAX_WAITERS];
+  sQueued _queue[I2C_QUEUE_SIZE];
+  volatile int _pending;       // queued transactions not yet completed
+  TaskHandle_t _taskHandle;
+  uint8_t _priority[I2C_NumDevices];
+  uint32_t _clock[I2C_NumDevices];
+  sI2CStats _stats[I2C_NumDevices];
+  int _lastDevice;
+  eI2CDevice _holder;
+  unsigned long _holdStart;
+  unsigned long _statsStart;
+  sWaiter* _addWaiter(eI2CDevice device, TaskHandle_t task);
+  sWaiter* _nextWaiter();
+  void _granted(eI2CDevice device, unsigned long tStart, int bypassed);
+  void _perform(sI2CTransaction& txn);
+  static int _pickNext(sTicket* const* tickets, int count);
+  static void _staticTask(void* arg);
+  void _task();
+public:
+  CI2CBus();
+  void begin();
+  bool lock(eI2CDevice device, TickType_t wait = portMAX_DELAY);
+  void unlock();
+  bool submit(const sI2CTransaction& txn);    // false if the queue is full
+  void waitQueue(unsigned long timeout = 100);
+  bool isQueueEmpty() const { return _pending == 0; };
+  void setClock(eI2CDevice device, uint32_t clock) { _clock[device] = clock; };
+  void setPriority(eI2CDevice device, uint8_t priority) { _priority[device] = priority; };
+  const sI2CStats& getStats(eI2CDevice device) const { return _stats[device]; };
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
+  void resetStats();
+  void report();
+};
+
+extern CI2CBus I2CBus;
+
+// holds the I2C bus for the lifetime of the object
+class CI2CLock {
+public:
+  CI2CLock(eI2CDevice device) { I2CBus.lock(device); };
+  ~CI2CLock() { I2CBus.unlock(); };
+};
+
+#endif // __BTC_I2CBUS_H__
@@ -44,19 +44,24 @@ CTimerModerator::_getName(eType type)
 int 
 CTimerModerator::_shouldSend(int timer, const sTimer& toSend)
 {
+  sTimerRecord rec;
+  toSend.pack(rec);
+  sTimerRecord& mem = Memory[timer];
+
   int retval = 0;
-  if(Memory[timer].start != toSend.start)
+  if((mem.startHour != rec.startHour) || (mem.startMin != rec.startMin))
     retval |= (0x01 << eStart);
-  if(Memory[timer].stop != toSend.stop)
+  if((mem.stopHour != rec.stopHour) || (mem.stopMin != rec.stopMin))
     retval |= (0x01 << eStop);
-  if(Memory[timer].enabled != toSend.enabled)
+  if(mem.enabled != rec.enabled)
     retval |= (0x01 << eDays);
-  if(Memory[timer].repeat != toSend.repeat)
+  if((mem.flags ^ rec.flags) & 0x80)
     retval |= (0x01 << eRpt);
-  if(Memory[timer].temperature != toSend.temperature)
+  if((mem.flags ^ rec.flags) & 0x7f)
     retval |= (0x01 << eTemp);
 
-  Memory[timer] = toSend;
+  mem = rec;
+  _pending[timer / 32] &= ~(0x01UL << (timer % 32));
 
   return retval;
 }
@@ -77,41 +82,44 @@ CTimerModerator::addJson(int timer, const sTimer& toSend, JsonObject& root)
 void
 CTimerModerator::reset()
 {
-  for(int timer= 0; timer < 14; timer++) {
-    Memory[timer].start.hour = -1;  // force full update
-    Memory[timer].stop.hour = -1;  // force full update
-    Memory[timer].enabled = 0xff;  // invalid combination - force full update
-    Memory[timer].repeat = 0xff;    
-    Memory[timer].temperature = 0xff;  
-  } 
+  // invalid combination - force full update
+  memset(Memory, 0xff, sizeof(Memory));
+  memset(_pending, 0, sizeof(_pending));   // all are due, leave them to the round robin
 }
 
 void
 CTimerModerator::reset(int timer)
 {
-  if(INBOUNDS(timer, 0, 13)) {
-    Memory[timer].start.hour = -1;  // force full update
-    Memory[timer].stop.hour = -1;  // force full update
-    Memory[timer].enabled = 0xff;  // invalid combination - force full update
-    Memory[timer].repeat = 0xff;    
-    Memory[timer].temperature = 0xff;  
+  if(INBOUNDS(timer, 0, MAX_TIMERS-1)) {
+    memset(&Memory[timer], 0xff, sizeof(sTimerRecord));  // invalid combination - force full update
+    _pending[timer / 32] |= (0x01UL << (timer % 32));    // and send it ahead of the others
   } 
 }
 
+int
+CTimerModerator::nextPending()
+{
+  for(int i = 0; i < (MAX_TIMERS+31)/32; i++) {
+    if(_pending[i]) 
+      return i * 32 + __builtin_ctz(_pending[i]);
+  }
+  return -1;
+}
+
 
 const char* 
 CStringModerator::shouldSend(const char* name, const char* value) 
 {
-  std::string sValue = value;
+  // compare in place - an unchanged value must not build a temporary std::string (heap)
   auto it = Memory.find(name);
   if(it != Memory.end()) {
-    if(it->second == sValue)
+    if(it->second.compare(value) == 0)
       return NULL;    // unchanged
-    it->second = sValue;
+    it->second.assign(value);   // reuses the existing capacity where possible
     return it->second.c_str();
   }
   else {
-    return (Memory[name] = sValue).c_str();
+    return (Memory[name] = value).c_str();
   }
 }
 
@@ -129,9 +137,7 @@ CStringModerator::addJson(const char* name, const char* value, JsonObject& root)
 void 
 CStringModerator::reset() 
 {
- 	for(auto it = Memory.begin(); it != Memory.end(); ++it) {
-    Memory.erase(it);
-  } 
+  Memory.clear();   // erasing whilst iterating invalidated the iterator
 }
 
 void 
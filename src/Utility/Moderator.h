@@ -30,7 +30,8 @@
 
 
 class CTimerModerator {
-  sTimer Memory[14];
+  sTimerRecord Memory[MAX_TIMERS];
+  uint32_t _pending[(MAX_TIMERS+31)/32];   // timers reset since last sent, b[n] = timer n
   enum eType { eStart, eStop, eDays, eRpt, eTemp};
   const char* _getName(eType type);
   int _shouldSend(int channel, const sTimer& toSend);
@@ -39,6 +40,7 @@ public:
   bool addJson(int channel, const sTimer& toSend, JsonObject& root);
 	void reset();
 	void reset(int channel);
+  int  nextPending();                      // lowest reset timer not yet sent, -1 if none
 };
 
 
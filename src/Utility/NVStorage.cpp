@@ -33,7 +33,9 @@ sNVStore::valid()
   retval &= heaterTuning.valid();
   retval &= userSettings.valid();
   for(int i=0; i<2; i++) {
-    retval &= timer[i].valid();
+    sTimer timer;
+    timer.unpack(timers.timer[i], i);
+    retval &= timer.valid();
   }
   retval &= MQTT.valid();
   retval &= Credentials.valid();
@@ -46,9 +48,7 @@ sNVStore::init()
   heaterTuning.init();
   userSettings.init();
   
-  for(int i=0; i<14; i++) {
-    timer[i].init(i);
-  }
+  timers.init();
 
   MQTT.init();
   Credentials.init();
@@ -141,16 +141,21 @@ sHeaterTuning::getLVC() const
 void 
 CHeaterStorage::getTimerInfo(int idx, sTimer& timerInfo)
 {
-  if(INBOUNDS(idx, 0, 13)) {
-    timerInfo = _calValues.timer[idx];
+  if(INBOUNDS(idx, 0, MAX_TIMERS-1)) {
+    timerInfo.unpack(_calValues.timers.timer[idx], idx);
   }
 }
 
 void 
 CHeaterStorage::setTimerInfo(int idx, const sTimer& timerInfo)
 {
-  if(INBOUNDS(idx, 0, 13)) {
-    _calValues.timer[idx] = timerInfo;
+  if(INBOUNDS(idx, 0, MAX_TIMERS-1)) {
+    sTimerRecord rec;
+    timerInfo.pack(rec);
+    if(memcmp(&_calValues.timers.timer[idx], &rec, sizeof(rec))) {
+      _calValues.timers.timer[idx] = rec;
+      _calValues.timers.changed = true;
+    }
   }
 }
 
@@ -253,9 +258,7 @@ CESP32HeaterStorage::load()
 {
   DebugPort.println("Reading from NV storage");
   _calValues.heaterTuning.load();
-  for(int i=0; i<14; i++) {
-    _calValues.timer[i].load();
-  }
+  _calValues.timers.load();
   _calValues.userSettings.load();
   _calValues.MQTT.load();
   _calValues.Credentials.load();
@@ -272,9 +275,8 @@ CESP32HeaterStorage::doSave()
     _bShouldSave = false;
     DebugPort.println("Saving to NV storage");
     _calValues.heaterTuning.save();
-    for(int i=0; i<14; i++) {
-      _calValues.timer[i].save();
-    }
+    if(_calValues.timers.changed)
+      _calValues.timers.save();
     _calValues.userSettings.save();
     _calValues.MQTT.save();
     _calValues.Credentials.save();
@@ -311,15 +313,14 @@ sHeaterTuning::load()
   validatedLoad("pumpCal", pumpCal, 0.022, 0.001, 1);
   validatedLoad("maxFuelUsage", maxFuelUsage, 0, u16inBounds, 0, 10000);
   validatedLoad("warnFuelUsage", warnFuelUsage, 5, u16inBounds, 0, 100);
-  validatedLoad("tempOffset0", DS18B20probe[0].offset, 0.0, -10.0, +10.0);
-  validatedLoad("tempOffset1", DS18B20probe[1].offset, 0.0, -10.0, +10.0);
-  validatedLoad("tempOffset2", DS18B20probe[2].offset, 0.0, -10.0, +10.0);
-  memset(DS18B20probe[0].romCode.bytes, 0, 8);
-  memset(DS18B20probe[1].romCode.bytes, 0, 8);
-  memset(DS18B20probe[2].romCode.bytes, 0, 8);
-  validatedLoad("probeSerial0", DS18B20probe[0].romCode.bytes, 8);
-  validatedLoad("probeSerial1", DS18B20probe[1].romCode.bytes, 8);
-  validatedLoad("probeSerial2", DS18B20probe[2].romCode.bytes, 8);
+  for(int i=0; i<MAX_DS18B20_DEVICES; i++) {
+    char name[16];
+    sprintf(name, "tempOffset%d", i);
+    validatedLoad(name, DS18B20probe[i].offset, 0.0, -10.0, +10.0);
+    memset(DS18B20probe[i].romCode.bytes, 0, 8);
+    sprintf(name, "probeSerial%d", i);
+    validatedLoad(name, DS18B20probe[i].romCode.bytes, 8);
+  }
   validatedLoad("tempOffsetBME", BME280probe.offset, 0.0, -10.0, +10.0);
   validatedLoad("probeBMEPrmy", BME280probe.bPrimary, 0, u8inBounds, 0, 1);
   preferences.end();    
@@ -370,9 +371,13 @@ sHeaterTuning::save()
   saveFloat("pumpCal", pumpCal);
   preferences.putUShort("maxFuelUsage", maxFuelUsage);
   preferences.putUShort("warnFuelUsage", warnFuelUsage);
-  saveFloat("tempOffset0", DS18B20probe[0].offset);
-  saveFloat("tempOffset1", DS18B20probe[1].offset);
-  saveFloat("tempOffset2", DS18B20probe[2].offset);
+  for(int i=0; i<MAX_DS18B20_DEVICES; i++) {
+    char name[16];
+    sprintf(name, "tempOffset%d", i);
+    saveFloat(name, DS18B20probe[i].offset);
+    sprintf(name, "probeSerial%d", i);
+    preferences.putBytes(name, DS18B20probe[i].romCode.bytes, 8);
+  }
   // preferences.putFloat("pumpCal", pumpCal);
   // preferences.putFloat("tempOffset0", DS18B20probe[0].offset);
   // preferences.putFloat("tempOffset1", DS18B20probe[1].offset);
@@ -383,9 +388,6 @@ sHeaterTuning::save()
     DS18B20probe[0].romCode.bytes[i] = i;
   // END TESTO*/
 
-  preferences.putBytes("probeSerial0", DS18B20probe[0].romCode.bytes, 8);
-  preferences.putBytes("probeSerial1", DS18B20probe[1].romCode.bytes, 8);
-  preferences.putBytes("probeSerial2", DS18B20probe[2].romCode.bytes, 8);
   // preferences.putFloat("tempOffsetBME", BME280probe.offset);
   saveFloat("tempOffsetBME", BME280probe.offset);
   preferences.putUChar("probeBMEPrmy", BME280probe.bPrimary);
@@ -467,6 +469,90 @@ sTimer::save()
   preferences.end();    
 }
 
+void
+sTimerTable::init()
+{
+  for(int i=0; i<MAX_TIMERS; i++) {
+    sTimer blank;
+    blank.init(i);
+    blank.pack(timer[i]);
+  }
+  changed = false;
+}
+
+void
+sTimerTable::load()
+{
+  init();
+
+  // **** MAX LENGTH is 15 for names ****
+  preferences.begin("timers", false);
+  bool bPresent = preferences.hasBytes("table");
+  if(bPresent) {
+    // tolerate a table saved with a different MAX_TIMERS
+    size_t len = preferences.getBytesLength("table");
+    if(len <= sizeof(timer)) {
+      preferences.getBytes("table", timer, len);
+    }
+    else {
+      uint8_t* pTable = new uint8_t[len];
+      preferences.getBytes("table", pTable, len);
+      memcpy(timer, pTable, sizeof(timer));
+      delete[] pTable;
+    }
+  }
+  preferences.end();
+
+  if(!bPresent) {
+    // migrate timers from the original per timer namespaces
+    DebugPort.println("Migrating timers to packed table");
+    for(int i=0; i<LEGACY_TIMERS && i<MAX_TIMERS; i++) {
+      sTimer legacy;
+      legacy.init(i);
+      legacy.load();
+      legacy.pack(timer[i]);
+    }
+    changed = true;
+  }
+
+  for(int i=0; i<MAX_TIMERS; i++) {
+    sTimer check;
+    check.unpack(timer[i], i);
+    if(check.temperature == 0)
+      check.temperature = 22;  // 0 = use current set point
+    if(!check.valid()) {
+      DebugPort.printf("sTimerTable::load() timer %d invalid, reset to default\r\n", i+1);
+      check.init(i);
+      check.pack(timer[i]);
+      changed = true;
+    }
+  }
+
+  if(changed) {
+    if(save() && !bPresent) {
+      // the table now holds the migrated timers, release the original namespaces
+      for(int i=0; i<LEGACY_TIMERS; i++) {
+        char SectionName[16];
+        sprintf(SectionName, "timer%d", i+1);
+        preferences.begin(SectionName, false);
+        preferences.clear();
+        preferences.end();
+      }
+    }
+  }
+}
+
+bool
+sTimerTable::save()
+{
+  // **** MAX LENGTH is 15 for names ****
+  preferences.begin("timers", false);
+  bool bOK = preferences.putBytes("table", timer, sizeof(timer)) == sizeof(timer);
+  preferences.end();
+  changed = false;
+  return bOK;
+}
+
 void 
 sUserSettings::load()
 {
@@ -530,6 +616,9 @@ sUserSettings::load()
   validatedLoad("GPIOout1Thresh", GPIO.thresh[0], 0, s8inBounds, -50, 50); 
   validatedLoad("GPIOout2Thresh", GPIO.thresh[1], 0, s8inBounds, -50, 50); 
   validatedLoad("GPIOalgMode", tVal, 0, u8inBounds, 0, 2); GPIO.algMode = (CGPIOalg::Modes)tVal;
+  validatedLoad("GPIOalgOvrsmpl", GPIO.algOversample, ADC_OVERSAMPLE, u8inBounds, 1, 64);
+  validatedLoad("GPIOalgIntvl", GPIO.algInterval, ADC_SAMPLE_INTERVAL, u16inBounds, 1, 1000);
+  validatedLoad("GPIOalgFilter", GPIO.algFilter, ADC_FILTER_TIME, u16inBounds, 0, 10000);
   validatedLoad("MenuOnTimeout", HomeMenu.onTimeout, 0, u8inBounds, 0, 3);
   validatedLoad("MenuonStart", HomeMenu.onStart, 0, u8inBounds, 0, 3);
   validatedLoad("MenuonStop", HomeMenu.onStop, 0, u8inBounds, 0, 3);
@@ -573,6 +662,9 @@ sUserSettings::save()
   preferences.putChar("GPIOout1Thresh", GPIO.thresh[0]);
   preferences.putChar("GPIOout2Thresh", GPIO.thresh[1]);
   preferences.putUChar("GPIOalgMode", GPIO.algMode);
+  preferences.putUChar("GPIOalgOvrsmpl", GPIO.algOversample);
+  preferences.putUShort("GPIOalgIntvl", GPIO.algInterval);
+  preferences.putUShort("GPIOalgFilter", GPIO.algFilter);
   preferences.putUChar("MenuOnTimeout", HomeMenu.onTimeout);
   preferences.putUChar("MenuonStart", HomeMenu.onStart);
   preferences.putUChar("MenuonStop", HomeMenu.onStop);
@@ -56,7 +56,7 @@ struct sHeaterTuning : public CESP32_NVStorage {
   float     pumpCal;
   uint16_t  maxFuelUsage;
   uint16_t  warnFuelUsage;
-  sDS18B20ProbeTuning DS18B20probe[3];   // [0],[1],[2] - Primary, Secondary, Tertiary
+  sDS18B20ProbeTuning DS18B20probe[MAX_DS18B20_DEVICES];   // indexed by role: [0],[1],[2] - Primary, Secondary, Tertiary...
   sBM280tuning  BME280probe;
 
   bool valid() {
@@ -73,9 +73,8 @@ struct sHeaterTuning : public CESP32_NVStorage {
       retval &= INBOUNDS(lowVolts, 100, 125) || (lowVolts == 0);
     else 
       retval &= INBOUNDS(lowVolts, 200, 250 || (lowVolts == 0));
-    retval &= INBOUNDS(DS18B20probe[0].offset, -10, +10);
-    retval &= INBOUNDS(DS18B20probe[1].offset, -10, +10);
-    retval &= INBOUNDS(DS18B20probe[2].offset, -10, +10);
+    for(int i=0; i<MAX_DS18B20_DEVICES; i++)
+      retval &= INBOUNDS(DS18B20probe[i].offset, -10, +10);
     retval &= INBOUNDS(BME280probe.offset, -10, +10);
     return retval;
   };
@@ -91,12 +90,10 @@ struct sHeaterTuning : public CESP32_NVStorage {
     maxFuelUsage = 0;
     warnFuelUsage = 0;
     lowVolts = 115;
-    DS18B20probe[0].offset = 0;
-    DS18B20probe[1].offset = 0;
-    DS18B20probe[2].offset = 0;
-    memset(DS18B20probe[0].romCode.bytes, 0, sizeof(DS18B20probe[0].romCode));
-    memset(DS18B20probe[1].romCode.bytes, 0, sizeof(DS18B20probe[1].romCode));
-    memset(DS18B20probe[2].romCode.bytes, 0, sizeof(DS18B20probe[2].romCode));
+    for(int i=0; i<MAX_DS18B20_DEVICES; i++) {
+      DS18B20probe[i].offset = 0;
+      memset(DS18B20probe[i].romCode.bytes, 0, sizeof(DS18B20probe[i].romCode));
+    }
     BME280probe.offset = 0;
     BME280probe.bPrimary = false;
   };
@@ -114,12 +111,10 @@ struct sHeaterTuning : public CESP32_NVStorage {
     maxFuelUsage = rhs.maxFuelUsage;
     warnFuelUsage = rhs.warnFuelUsage;
     lowVolts = rhs.lowVolts;
-    DS18B20probe[0].offset = rhs.DS18B20probe[0].offset;
-    DS18B20probe[1].offset = rhs.DS18B20probe[1].offset;
-    DS18B20probe[2].offset = rhs.DS18B20probe[2].offset;
-    memcpy(DS18B20probe[0].romCode.bytes, rhs.DS18B20probe[0].romCode.bytes, 8);
-    memcpy(DS18B20probe[1].romCode.bytes, rhs.DS18B20probe[1].romCode.bytes, 8);
-    memcpy(DS18B20probe[2].romCode.bytes, rhs.DS18B20probe[2].romCode.bytes, 8);
+    for(int i=0; i<MAX_DS18B20_DEVICES; i++) {
+      DS18B20probe[i].offset = rhs.DS18B20probe[i].offset;
+      memcpy(DS18B20probe[i].romCode.bytes, rhs.DS18B20probe[i].romCode.bytes, 8);
+    }
     BME280probe.offset = rhs.BME280probe.offset;
     BME280probe.bPrimary = rhs.BME280probe.bPrimary;
     return *this;
@@ -343,6 +338,9 @@ struct sUserSettings : public CESP32_NVStorage {
     retval &= GPIO.in2Mode < 3;
     retval &= GPIO.out1Mode < 3;
     retval &= GPIO.out2Mode < 2;
+    retval &= INBOUNDS(GPIO.algOversample, 1, 64);
+    retval &= INBOUNDS(GPIO.algInterval, 1, 1000);
+    retval &= INBOUNDS(GPIO.algFilter, 0, 10000);
     retval &= INBOUNDS(FrameRate, 300, 1500);
     retval &= cyclic.valid();
     retval &= HomeMenu.valid();
@@ -368,6 +366,9 @@ struct sUserSettings : public CESP32_NVStorage {
     GPIO.algMode = CGPIOalg::Disabled;
     GPIO.thresh[0] = 0;
     GPIO.thresh[1] = 0;
+    GPIO.algOversample = ADC_OVERSAMPLE;
+    GPIO.algInterval = ADC_SAMPLE_INTERVAL;
+    GPIO.algFilter = ADC_FILTER_TIME;
     FrameRate = 1000;
     cyclic.init();
     HomeMenu.init();
@@ -414,7 +415,7 @@ struct sUserSettings : public CESP32_NVStorage {
 struct sNVStore {
   sHeaterTuning heaterTuning;
   sUserSettings userSettings;
-  sTimer timer[14];
+  sTimerTable timers;
   sMQTTparams MQTT;
   sCredentials Credentials;
   sHourMeter hourMeter;
@@ -423,8 +424,7 @@ struct sNVStore {
   sNVStore& operator=(const sNVStore& rhs) {
     heaterTuning = rhs.heaterTuning;
     userSettings = rhs.userSettings;
-    for(int i = 0; i < 14; i++)
-      timer[i] = rhs.timer[i];
+    timers = rhs.timers;
     MQTT = rhs.MQTT;
     Credentials = rhs.Credentials;
     hourMeter = rhs.hourMeter;
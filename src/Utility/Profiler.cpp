@@ -0,0 +1,230 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "Profiler.h"
+#include "DebugPort.h"
+#include "macros.h"
+
+#if USE_PROFILER == 1
+
+CProfiler Profiler;
+
+static const char* StageNames[PROF_Stages] = {
+  "Period",
+  "Body",
+  "Streaming",
+  "WiFi",
+  "Bluetooth",
+  "Clock",
+  "Sensors",
+  "Display",
+  "BlueWire",
+  "UHF",
+};
+
+static const char* BucketNames[PROFILE_BUCKETS] = {
+  "<16u", "<64u", "<256u", "<1m", "<4m", "<16m", "<64m", "more"
+};
+
+
+CProfiler::CProfiler()
+{
+  _enabled = false;
+  _loopValid = false;
+  _loopStart = 0;
+  _numTasks = 0;
+  resetStats();
+}
+
+void
+CProfiler::enable(bool state)
+{
+  _loopValid = false;
+  resetStats();
+  _enabled = state;
+}
+
+void
+CProfiler::resetStats()
+{
+  memset(_stages, 0, sizeof(_stages));
+  for(int i = 0; i < PROF_Stages; i++)
+    _stages[i].min = 0xffffffff;
+  _resetTime = millis();
+}
+
+void
+CProfiler::record(int stage, uint32_t us)
+{
+  sProfStage& stats = _stages[stage];
+  stats.count++;
+  stats.total += us;
+  UPPERLIMIT(stats.min, us);
+  LOWERLIMIT(stats.max, us);
+  // log4 bucket: 16us, 64us, 256us...
+  int bucket = ((31 - __builtin_clz(us | 1)) - 2) >> 1;
+  BOUNDSLIMIT(bucket, 0, PROFILE_BUCKETS-1);
+  stats.hist[bucket]++;
+}
+
+void
+CProfiler::addTask(const char* name, TaskHandle_t handle)
+{
+  if(_numTasks < PROFILER_MAX_TASKS) {
+    _tasks[_numTasks].name = name;
+    _tasks[_numTasks].handle = handle;
+    _tasks[_numTasks].getHandle = NULL;
+    _numTasks++;
+  }
+  else
+    DebugPort.printf("Profiler: no room for task %s, raise PROFILER_MAX_TASKS\r\n", name);
+}
+
+void
+CProfiler::addTask(const char* name, profTaskFn getHandle)
+{
+  if(_numTasks < PROFILER_MAX_TASKS) {
+    _tasks[_numTasks].name = name;
+    _tasks[_numTasks].handle = NULL;
+    _tasks[_numTasks].getHandle = getHandle;
+    _numTasks++;
+  }
+  else
+    DebugPort.printf("Profiler: no room for task %s, raise PROFILER_MAX_TASKS\r\n", name);
+}
+
+int
+CProfiler::_getTasks(sProfTaskInfo* info, int max)
+{
+  int count = 0;
+#if configUSE_TRACE_FACILITY == 1
+  // the kernel knows every task, including short lived ones such as SSLkeyTask
+  UBaseType_t numTasks = uxTaskGetNumberOfTasks() + 2;   // allow for tasks created meanwhile
+  TaskStatus_t* pStatus = (TaskStatus_t*)malloc(numTasks * sizeof(TaskStatus_t));
+  if(pStatus) {
+    uint32_t totalTime = 0;
+    numTasks = uxTaskGetSystemState(pStatus, numTasks, &totalTime);
+    totalTime /= 1000;   // permille
+    for(UBaseType_t i = 0; i < numTasks && count < max; i++) {
+      strncpy(info[count].name, pStatus[i].pcTaskName, sizeof(info[count].name) - 1);
+      info[count].name[sizeof(info[count].name) - 1] = 0;
+      info[count].priority = pStatus[i].uxCurrentPriority;
+      info[count].stackFree = pStatus[i].usStackHighWaterMark;
+#if configGENERATE_RUN_TIME_STATS == 1
+      info[count].cpu = totalTime ? pStatus[i].ulRunTimeCounter / totalTime : -1;
+#else
+      info[count].cpu = -1;
+#endif
+      count++;
+    }
+    free(pStatus);
+    return count;
+  }
+#endif
+  // otherwise only the registered tasks, and no CPU usage
+  for(int i = 0; i < _numTasks && count < max; i++) {
+    TaskHandle_t handle = _tasks[i].getHandle ? _tasks[i].getHandle() : _tasks[i].handle;
+    if(handle) {
+      strncpy(info[count].name, _tasks[i].name, sizeof(info[count].name) - 1);
+      info[count].name[sizeof(info[count].name) - 1] = 0;
+      info[count].priority = uxTaskPriorityGet(handle);
+      info[count].stackFree = uxTaskGetStackHighWaterMark(handle);
+      info[count].cpu = -1;
+      count++;
+    }
+  }
+  return count;
+}
+
+void
+CProfiler::report()
+{
+  unsigned long elapsed = millis() - _resetTime;
+  if(_enabled) {
+    const sProfStage& body = _stages[PROF_Body];
+    DebugPort.printf("loop() profile over %lums, %d loops, body busy %.1f%%\r\n",
+                     elapsed, _stages[PROF_Period].count, elapsed ? body.total * 0.1 / elapsed : 0.0);
+    DebugPort.print("  Stage      Count    Min   Mean    Max (us)");
+    for(int b = 0; b < PROFILE_BUCKETS; b++)
+      DebugPort.printf(" %6s", BucketNames[b]);
+    DebugPort.println("");
+    for(int i = 0; i < PROF_Stages; i++) {
+      const sProfStage& stats = _stages[i];
+      if(stats.count == 0)
+        continue;
+      DebugPort.printf("  %-9s %6d %6d %6d %6d     ", StageNames[i], stats.count, stats.min, int(stats.total / stats.count), stats.max);
+      for(int b = 0; b < PROFILE_BUCKETS; b++)
+        DebugPort.printf(" %6d", stats.hist[b]);
+      DebugPort.println("");
+    }
+  }
+  else {
+    DebugPort.println("loop() profiler stopped, <CTRL-L> to start");
+  }
+
+  sProfTaskInfo info[PROFILER_MAX_TASKS * 2];
+  int count = _getTasks(info, PROFILER_MAX_TASKS * 2);
+  DebugPort.println("  Task             Prio  Stack free   CPU");
+  for(int i = 0; i < count; i++) {
+    DebugPort.printf("  %-16s %4d %11d", info[i].name, info[i].priority, info[i].stackFree);
+    if(info[i].cpu >= 0)
+      DebugPort.printf("  %3d.%d%%\r\n", info[i].cpu / 10, info[i].cpu % 10);
+    else
+      DebugPort.println("     -");
+  }
+
+  resetStats();
+}
+
+// live view for the /profile web page - does not reset the statistics
+void
+CProfiler::printJSON(Print& out)
+{
+  out.printf("{\"Enabled\":%s,\"Elapsed\":%lu,\"Buckets\":[", _enabled ? "true" : "false", millis() - _resetTime);
+  for(int b = 0; b < PROFILE_BUCKETS; b++)
+    out.printf("%s\"%s\"", b ? "," : "", BucketNames[b]);
+  out.print("],\"Stages\":[");
+  bool first = true;
+  for(int i = 0; i < PROF_Stages; i++) {
+    sProfStage stats = _stages[i];   // copy, loop() keeps recording meanwhile
+    if(stats.count == 0)
+      continue;
+    out.printf("%s{\"Name\":\"%s\",\"Count\":%u,\"Min\":%u,\"Mean\":%u,\"Max\":%u,\"Hist\":[",
+               first ? "" : ",", StageNames[i], stats.count, stats.min, uint32_t(stats.total / stats.count), stats.max);
+    for(int b = 0; b < PROFILE_BUCKETS; b++)
+      out.printf("%s%u", b ? "," : "", stats.hist[b]);
+    out.print("]}");
+    first = false;
+  }
+  out.print("],\"Tasks\":[");
+  sProfTaskInfo info[PROFILER_MAX_TASKS * 2];
+  int count = _getTasks(info, PROFILER_MAX_TASKS * 2);
+  for(int i = 0; i < count; i++) {
+    out.printf("%s{\"Name\":\"%s\",\"Priority\":%d,\"StackFree\":%u", i ? "," : "", info[i].name, info[i].priority, info[i].stackFree);
+    if(info[i].cpu >= 0)
+      out.printf(",\"CPU\":%d.%d", info[i].cpu / 10, info[i].cpu % 10);
+    out.print("}");
+  }
+  out.print("]}");
+}
+
+#endif
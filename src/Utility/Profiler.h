@@ -0,0 +1,158 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CProfiler
+//
+// Run time profiling of loop() and the FreeRTOS tasks.
+// Each profiled loop() stage keeps a call count, min / mean / max and a
+// histogram of its execution time. The loop() period and body are kept the
+// same way, so late stages show up as a long tail in the period.
+// Tasks are listed with their free stack, and their share of the CPU when
+// FreeRTOS run time stats are configured.
+//
+// With USE_PROFILER 0 the PROFILE macros compile to nothing. Compiled in
+// but stopped, a stage costs the test of a flag.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// loop() stages, must match StageNames[] in Profiler.cpp
+enum eProfStage {
+  PROF_Period,          // loop() start to start
+  PROF_Body,            // loop() start to end, excludes the closing vTaskDelay
+  PROF_Streaming,       // doStreaming(), includes WiFi and Bluetooth
+  PROF_WiFi,
+  PROF_Bluetooth,
+  PROF_Clock,
+  PROF_Sensors,
+  PROF_Display,
+  PROF_BlueWire,
+  PROF_UHF,
+  PROF_Stages
+};
+
+#define PROFILE_BUCKETS 8   // <16us, then every factor of 4 up to >=64ms
+
+#if USE_PROFILER == 1
+
+#define PROFILE_LOOP_START()     Profiler.loopStart()
+#define PROFILE_LOOP_END()       Profiler.loopEnd()
+#define PROFILE_SCOPE(stage)     CProfileScope _profScope(stage)
+#define PROFILE_STAGE(stage, ...)  do { CProfileScope _profScope(stage); __VA_ARGS__; } while(0)
+
+#else
+
+#define PROFILE_LOOP_START()
+#define PROFILE_LOOP_END()
+#define PROFILE_SCOPE(stage)
+#define PROFILE_STAGE(stage, ...)  do { __VA_ARGS__; } while(0)
+
+#endif
+
+struct sProfStage {
+  uint32_t count;
+  uint32_t min;               // us
+  uint32_t max;               // us
+  uint64_t total;             // us
+  uint32_t hist[PROFILE_BUCKETS];
+};
+
+struct sProfTaskInfo {
+  char name[16];
+  int priority;
+  uint32_t stackFree;         // bytes, high water mark
+  int cpu;                    // permille of CPU time since boot, -1 if unknown
+};
+
+typedef TaskHandle_t (*profTaskFn)();
+
+class CProfiler {
+  struct sTask {
+    const char* name;
+    TaskHandle_t handle;      // fixed handle, or
+    profTaskFn getHandle;     // fetch the current one, NULL whilst the task is not running
+  };
+  bool _enabled;
+  bool _loopValid;            // _loopStart has been set since enabling
+  uint32_t _loopStart;
+  unsigned long _resetTime;
+  sProfStage _stages[PROF_Stages];
+  sTask _tasks[PROFILER_MAX_TASKS];
+  int _numTasks;
+  int _getTasks(sProfTaskInfo* info, int max);
+public:
+  CProfiler();
+  void enable(bool state);
+  bool isEnabled() const { return _enabled; };
+  void loopStart() {
+    if(_enabled) {
+      uint32_t now = micros();
+      if(_loopValid)
+        record(PROF_Period, now - _loopStart);
+      _loopStart = now;
+      _loopValid = true;
+    }
+  };
+  void loopEnd() {
+    if(_enabled && _loopValid)
+      record(PROF_Body, micros() - _loopStart);
+  };
+  void record(int stage, uint32_t us);
+  void addTask(const char* name, TaskHandle_t handle);
+  void addTask(const char* name, profTaskFn getHandle);
+  const sProfStage& getStage(int stage) const { return _stages[stage]; };
+  void resetStats();
+  void report();
+  void printJSON(Print& out);
+};
+
+extern CProfiler Profiler;
+
+// times the enclosing scope as a loop() stage
+class CProfileScope {
+  int _stage;
+  uint32_t _start;
+  bool _active;
+public:
+  CProfileScope(int stage) {
+    _active = Profiler.isEnabled();
+    if(_active) {
+      _stage = stage;
+      _start = micros();
+    }
+  };
+  ~CProfileScope() {
+    if(_active)
+      Profiler.record(_stage, micros() - _start);
+  };
+};
+
+#endif
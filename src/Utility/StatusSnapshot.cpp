@@ -0,0 +1,213 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "StatusSnapshot.h"
+#include "DebugPort.h"
+#include "macros.h"
+#include "../../lib/ArduinoJson/ArduinoJson.h"
+
+CStatusSnapshot StatusSnapshot;
+
+
+CStatusSnapshot::CStatusSnapshot()
+{
+  _numItems = 0;
+  _poolUsed = 0;
+  _version = 0;
+  _pending = false;
+  _mutex = NULL;
+  _merges = 0;
+  _changes = 0;
+  _rejected = 0;
+  _truncated = 0;
+  _lastMerge = 0;
+  _bRequested = false;
+  _lastRequest = 0;
+  _refreshes = 0;
+  _requestStart = 0;
+}
+
+void
+CStatusSnapshot::begin()
+{
+  if(_mutex == NULL)
+    _mutex = xSemaphoreCreateMutex();
+}
+
+sStatusItem*
+CStatusSnapshot::_find(const char* name)
+{
+  for(int i = 0; i < _numItems; i++) {
+    if(strcmp(_items[i].name, name) == 0)
+      return &_items[i];
+  }
+  return NULL;
+}
+
+sStatusItem*
+CStatusSnapshot::_add(const char* name)
+{
+  int len = strlen(name) + 1;
+  if(_numItems >= STATUS_MAX_ITEMS || _poolUsed + len > STATUS_NAME_POOL)
+    return NULL;
+
+  sStatusItem* pItem = &_items[_numItems++];
+  pItem->name = &_namePool[_poolUsed];
+  memcpy(&_namePool[_poolUsed], name, len);
+  _poolUsed += len;
+  pItem->version = 0;
+  pItem->value[0] = 0;
+  return pItem;
+}
+
+// Values that differ from those held are stamped with the next version,
+// which is published by commit() - a refresh takes several merges, clients
+// wake once for all of them.
+void
+CStatusSnapshot::merge(char* json)
+{
+  if(_mutex == NULL)
+    return;
+
+  StaticJsonBuffer<1024> jsonBuffer;               // create a JSON buffer on the stack
+  JsonObject& root = jsonBuffer.parseObject(json);
+  if(!root.success()) {
+    _rejected++;
+    return;
+  }
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  uint32_t newVersion = _version + 1;
+  for(JsonObject::iterator it = root.begin(); it != root.end(); ++it) {
+    char value[STATUS_VALUE_LEN + 1];
+    int len = it->value.printTo(value, sizeof(value));
+    if(len >= STATUS_VALUE_LEN) {
+      _rejected++;       // better absent than cut short into invalid JSON
+      continue;
+    }
+    sStatusItem* pItem = _find(it->key);
+    if(pItem == NULL)
+      pItem = _add(it->key);
+    if(pItem == NULL) {
+      _rejected++;
+      continue;
+    }
+    if(pItem->version == 0 || strcmp(pItem->value, value) != 0) {
+      strcpy(pItem->value, value);
+      pItem->version = newVersion;
+      _pending = true;
+      _changes++;
+    }
+  }
+  _merges++;
+  _lastMerge = millis();
+  xSemaphoreGive(_mutex);
+}
+
+void
+CStatusSnapshot::commit()
+{
+  if(_mutex == NULL)
+    return;
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  if(_pending) 
+    _version++;
+  _pending = false;
+  _refreshes++;
+  xSemaphoreGive(_mutex);
+}
+
+bool
+CStatusSnapshot::isWanted() const
+{
+  return _bRequested && (millis() - _lastRequest) < STATUS_REQUEST_HOLD;
+}
+
+// A snapshot nobody has asked for lags the heater, the first client to ask
+// may wait up to wait ms for loop() to refresh it.
+bool
+CStatusSnapshot::request(unsigned long wait)
+{
+  if(!isWanted())
+    _requestStart = _refreshes;     // lagging from here until loop() next refreshes it
+  _lastRequest = millis();
+  _bRequested = true;
+
+  unsigned long tStart = millis();
+  while(_refreshes == _requestStart) {
+    if(millis() - tStart >= wait)
+      return false;
+    vTaskDelay(10);
+  }
+  return true;
+}
+
+// Renders {"name":value,...} for the items changed after version since, 
+// since = 0 renders them all.
+// Returns the version a client is up to date with once it has the document.
+// Items that do not fit are left out, and the version returned is held back 
+// so they are rendered again for the next document. Uncommitted changes may
+// be rendered, they are rendered again once committed.
+uint32_t
+CStatusSnapshot::print(char* buf, int size, uint32_t since)
+{
+  int len = 0;
+  buf[len++] = '{';
+
+  uint32_t upTo = 0;
+  if(_mutex) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    upTo = _version;
+    for(int i = 0; i < _numItems; i++) {
+      const sStatusItem& item = _items[i];
+      if(item.version <= since)
+        continue;
+      int need = strlen(item.name) + strlen(item.value) + 4;   // ,"name":value
+      if(len + need + 2 > size) {                              // room for } and the terminator
+        UPPERLIMIT(upTo, item.version - 1);
+        continue;
+      }
+      len += sprintf(&buf[len], "%s\"%s\":%s", len > 1 ? "," : "", item.name, item.value);
+    }
+    if(upTo != _version)
+      _truncated++;
+    xSemaphoreGive(_mutex);
+  }
+
+  buf[len++] = '}';
+  buf[len] = 0;
+  return upTo;
+}
+
+void
+CStatusSnapshot::report()
+{
+  DebugPort.printf("Status snapshot: %d/%d items, %d/%d name bytes, version %u, last merge %lums ago\r\n", 
+                   _numItems, STATUS_MAX_ITEMS, _poolUsed, STATUS_NAME_POOL, _version, millis() - _lastMerge);
+  if(isWanted())
+    DebugPort.printf("  refreshed for clients, last asked %lums ago\r\n", millis() - _lastRequest);
+  else
+    DebugPort.println("  not refreshed, no client has asked recently");
+  DebugPort.printf("  %u merges, %u changes, %u values rejected, %u documents truncated\r\n", 
+                   _merges, _changes, _rejected, _truncated);
+}
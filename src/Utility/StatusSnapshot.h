@@ -0,0 +1,88 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef __STATUSSNAPSHOT_H__
+#define __STATUSSNAPSHOT_H__
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CStatusSnapshot
+//
+// The latest value of every JSON status item, for the REST and Server-Sent
+// Events endpoints. loop() merges the JSON it builds after each blue wire
+// exchange then commits it, the web server tasks render it. Serving a
+// client never touches loop(), nor the moderators of the websocket,
+// Bluetooth and MQTT clients.
+// Each item remembers the snapshot version at which it last changed, so a
+// client holding version N need only be sent the items newer than N.
+// loop() only refreshes the snapshot whilst a client is asking for it, 
+// request() keeps it refreshed for STATUS_REQUEST_HOLD.
+// Fixed tables, no heap.
+//
+///////////////////////////////////////////////////////////////////////////
+
+struct sStatusItem {
+  const char* name;           // held in the name pool
+  uint32_t version;           // snapshot version when last changed
+  char value[STATUS_VALUE_LEN];   // as JSON, strings quoted
+};
+
+class CStatusSnapshot {
+  sStatusItem _items[STATUS_MAX_ITEMS];
+  int _numItems;
+  char _namePool[STATUS_NAME_POOL];
+  int _poolUsed;
+  volatile uint32_t _version;
+  bool _pending;              // merged changes awaiting commit()
+  SemaphoreHandle_t _mutex;
+  uint32_t _merges;
+  uint32_t _changes;
+  uint32_t _rejected;         // values that did not fit the tables
+  uint32_t _truncated;        // documents that could not hold every item asked for
+  unsigned long _lastMerge;
+  volatile bool _bRequested;     // a client has asked since begin()
+  volatile unsigned long _lastRequest;
+  volatile uint32_t _refreshes;   // commit() calls
+  uint32_t _requestStart;         // _refreshes when asked for after none had
+  sStatusItem* _find(const char* name);
+  sStatusItem* _add(const char* name);
+public:
+  CStatusSnapshot();
+  void begin();
+  void merge(char* json);     // parsed in place
+  void commit();              // publish the merged changes as a new version
+  uint32_t getVersion() const { return _version; };
+  // by the status and event clients
+  bool request(unsigned long wait = 0);   // true once the snapshot is current, waits up to wait ms
+  bool isWanted() const;                  // asked for within STATUS_REQUEST_HOLD
+  uint32_t getRefreshes() const { return _refreshes; };
+  uint32_t print(char* buf, int size, uint32_t since = 0);
+  void report();
+};
+
+extern CStatusSnapshot StatusSnapshot;
+
+#endif
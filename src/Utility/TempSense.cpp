@@ -25,6 +25,8 @@
 #include "DebugPort.h"
 #include "macros.h"
 #include "NVStorage.h"
+#include "I2CBus.h"
+#include "../cfg/BTCConfig.h"
 
 CSensor::CSensor() 
 {
@@ -39,8 +41,10 @@ CSensor::update(float val)
   if(_holdoff) {
     _holdoff--;
     _reading = -100;
-    if(_holdoff == 0)
+    if(_holdoff == 0) {
       _filter.reset(val);
+      _reading = val;     // valid from here, raw as well as filtered
+    }
     return false;
   }
   else {
@@ -84,7 +88,7 @@ CSensor::getTemperature(float& tempReading, bool filtered)
 
 CDS18B20probe::CDS18B20probe() : CSensor()
 {
-  pSensorInfo = NULL;
+  _bAttached = false;
   init();
 }
 
@@ -92,16 +96,24 @@ void
 CDS18B20probe::init()
 {
   release();
-  reset();
   error = DS18B20_ERROR_UNKNOWN;
 } 
 
+void
+CDS18B20probe::attach(const DS18B20_Info& info)
+{
+  // filter state and the requested resolution carry over if the same probe is re-attached
+  _info = info;
+  _bAttached = true;
+}
+
 void
 CDS18B20probe::release()
 {
-  if(pSensorInfo)
-    ds18b20_free(&pSensorInfo);
-  pSensorInfo = NULL;
+  _bAttached = false;
+  memset(&_info, 0, sizeof(_info));
+  _resolution = DS18B20_RESOLUTION(DS18B20_DEFAULT_RESOLUTION);   // settings go with the probe
+  reset();
 }
 
 bool
@@ -110,7 +122,7 @@ CDS18B20probe::readSensor()
   bool retval = false;
   float temperature;
 
-  error = ds18b20_read_temp(pSensorInfo, &temperature);   
+  error = ds18b20_read_temp(getSensorInfo(), &temperature);   
   if(error == DS18B20_OK) {
     retval = update(temperature);
     if(!retval) {
@@ -135,8 +147,8 @@ CDS18B20probe::getReading(bool filtered)
 OneWireBus_ROMCode 
 CDS18B20probe::getROMcode() const 
 { 
-  if(pSensorInfo)
-    return pSensorInfo->rom_code; 
+  if(_bAttached)
+    return _info.rom_code; 
   else {
     OneWireBus_ROMCode nullROM = {0};
     return nullROM;
@@ -144,10 +156,10 @@ CDS18B20probe::getROMcode() const
 }
 
 bool 
-CDS18B20probe::matchROMcode(uint8_t test[8])
+CDS18B20probe::matchROMcode(const uint8_t test[8]) const
 {
-  if(pSensorInfo)
-    return memcmp(pSensorInfo->rom_code.bytes, test, 8) == 0;
+  if(_bAttached)
+    return memcmp(_info.rom_code.bytes, test, 8) == 0;
   return false;
 }
 
@@ -158,11 +170,13 @@ CDS18B20SensorSet::CDS18B20SensorSet()
 {
   _owb = NULL;
   _nNumSensors = 0;
-  for(int i=0; i< MAX_DS18B20_DEVICES; i++)
+  _mux = portMUX_INITIALIZER_UNLOCKED;
+  for(int i=0; i< MAX_DS18B20_DEVICES; i++) {
     _Sensors[i].init();
-
-  for(int i=0; i<3; i++)
-  	_sensorMap[i] = -1;
+    _order[i] = i;
+    memset(_roleROM[i].bytes, 0, 8);
+  	_roleIdx[i] = -1;
+  }
 
   _bReportFind = true;
 }
@@ -184,36 +198,26 @@ CDS18B20SensorSet::begin(int pin)
 bool
 CDS18B20SensorSet::readSensors()
 {
+  // called by the acquisition task once the conversion time has elapsed
+  // one convert_all started every probe, so each costs just an addressed scratchpad read here
   bool retval = false;
 
-  if(_nNumSensors == 0) {
-
-    bool found = find();
-
-    if(found) {
-      DebugPort.println("Found DS18B20 device(s)");
-
-      startConvert();  // request a new conversion,
-      waitConvertDone();
-    }
-  }
-
   if(_nNumSensors) {
     for (int i = 0; i < MAX_DS18B20_DEVICES; ++i) {
       _Sensors[i].setError(DS18B20_ERROR_UNKNOWN);
     }
 
     for (int i = 0; i < _nNumSensors; ++i) {
-      _Sensors[i].readSensor();
+      _Sensors[_order[i]].readSensor();
     }
 
 #ifdef REPORT_READINGS
     DebugPort.println("\nTemperature readings (degrees C)");
 #endif
     for (int i = 0; i < _nNumSensors; ++i) {
-      if(_Sensors[i].OK()) {
+      if(_Sensors[_order[i]].OK()) {
 #ifdef REPORT_READINGS
-        DebugPort.printf("  %d: %.1f    OK\r\n", i, _Readings[i]);
+        DebugPort.printf("  %d: %.1f    OK\r\n", i, _Sensors[_order[i]].getReading(false));
 #endif
         retval = true;  // at least one sensor read OK
       }
@@ -228,6 +232,16 @@ CDS18B20SensorSet::readSensors()
   return retval;
 }
 
+int
+CDS18B20SensorSet::_findSlot(const OneWireBus_ROMCode& romCode) const
+{
+  for(int slot = 0; slot < MAX_DS18B20_DEVICES; slot++) {
+    if(_Sensors[slot].matchROMcode(romCode.bytes))
+      return slot;
+  }
+  return -1;
+}
+
 bool 
 CDS18B20SensorSet::find()
 {
@@ -237,65 +251,117 @@ CDS18B20SensorSet::find()
   OneWireBus_ROMCode rom_codes[MAX_DS18B20_DEVICES];
   memset(&rom_codes, 0, sizeof(rom_codes));
 
-  _nNumSensors = 0;
+  int nFound = 0;
   OneWireBus_SearchState search_state = {0};
 
   bool found = false;
   owb_search_first(_owb, &search_state, &found);
   while(found) {
+    if(nFound == MAX_DS18B20_DEVICES) {
+      DebugPort.printf("More than %d DS18B20 devices, ignoring the remainder\r\n", MAX_DS18B20_DEVICES);
+      break;
+    }
     char rom_code_s[17];
     owb_string_from_rom_code(search_state.rom_code, rom_code_s, sizeof(rom_code_s));
     if(_bReportFind)
-      DebugPort.printf("  %d : %s\r\n", _nNumSensors, rom_code_s);
+      DebugPort.printf("  %d : %s\r\n", nFound, rom_code_s);
 
-    rom_codes[_nNumSensors] = search_state.rom_code;
-    _nNumSensors++;
+    rom_codes[nFound] = search_state.rom_code;
+    nFound++;
     owb_search_next(_owb, &search_state, &found);
   }
   if(_bReportFind)
-    DebugPort.printf("Found %d DS18B20 device%s\r\n", _nNumSensors, _nNumSensors==1 ? "" : "s");
+    DebugPort.printf("Found %d DS18B20 device%s\r\n", nFound, nFound==1 ? "" : "s");
 
-  // Create DS18B20 devices on the 1-Wire bus
-  for (int i = 0; i < MAX_DS18B20_DEVICES; ++i) {
-    _Sensors[i].release();
-  }
-  for (int i = 0; i < _nNumSensors; ++i)
+  // Set up the DS18B20 devices on the 1-Wire bus
+  // This talks to each probe, so is done to one side of the table
+  DS18B20_Info infos[MAX_DS18B20_DEVICES];
+  for (int i = 0; i < nFound; ++i)
   {
-    DS18B20_Info * ds18b20_info = ds18b20_malloc();  // heap allocation
-    _Sensors[i].assign(ds18b20_info);
-
-    if (_nNumSensors == 1)
+    if (nFound == 1)
     {
-      DebugPort.print("DS18B20 Single device optimisations enabled\n");
-      ds18b20_init_solo(ds18b20_info, _owb);          // only one device on bus
-      ds18b20_info->rom_code = rom_codes[0];  // added, for GUI setup!!
+      if(_bReportFind)
+        DebugPort.print("DS18B20 Single device optimisations enabled\n");
+      ds18b20_init_solo(&infos[0], _owb);          // only one device on bus
+      infos[0].rom_code = rom_codes[0];  // added, for GUI setup!!
     }
     else
     {
-      ds18b20_init(ds18b20_info, _owb, rom_codes[i]); // associate with bus and device
+      ds18b20_init(&infos[i], _owb, rom_codes[i]); // associate with bus and device
+    }
+    ds18b20_use_crc(&infos[i], true);           // enable CRC check for temperature readings
+  }
+
+  // Then update the table in one step, probes still present keep their slot
+  portENTER_CRITICAL(&_mux);
+  int8_t slots[MAX_DS18B20_DEVICES];
+  bool inUse[MAX_DS18B20_DEVICES] = { false };
+  for (int i = 0; i < nFound; ++i) {
+    slots[i] = _findSlot(rom_codes[i]);
+    if(slots[i] >= 0)
+      inUse[slots[i]] = true;
+  }
+  for (int slot = 0; slot < MAX_DS18B20_DEVICES; ++slot) {
+    if(!inUse[slot] && _Sensors[slot].isAttached())
+      _Sensors[slot].release();    // probe has gone
+  }
+  int freeSlot = 0;
+  for (int i = 0; i < nFound; ++i) {
+    if(slots[i] < 0) {
+      while(inUse[freeSlot]) 
+        freeSlot++;
+      slots[i] = freeSlot;
+      inUse[freeSlot] = true;
     }
-    ds18b20_use_crc(ds18b20_info, true);           // enable CRC check for temperature readings
-    ds18b20_set_resolution(ds18b20_info, DS18B20_RESOLUTION_12_BIT);
+    _Sensors[slots[i]].attach(infos[i]);
+    _order[i] = slots[i];
   }
+  _nNumSensors = nFound;
+  _resolveRoles();
+  portEXIT_CRITICAL(&_mux);
+
+  applyResolution();
 
   _bReportFind = false;
 
-  return found;
+  return nFound != 0;
 }
 
 void 
 CDS18B20SensorSet::startConvert()
 {
-  // kick off the initial temperature conversion
-  if(_Sensors[0].getSensorInfo())
+  // a single broadcast starts every probe on the bus converting
+  if(_nNumSensors)
     ds18b20_convert_all(_owb);
 }
 
 void
-CDS18B20SensorSet::waitConvertDone()
+CDS18B20SensorSet::applyResolution()
 {
-  if(_Sensors[0].getSensorInfo())
-    ds18b20_wait_for_conversion(_Sensors[0].getSensorInfo());
+  // only the acquisition task talks to the one-wire bus, so requests are held in each probe until now
+  for (int i = 0; i < _nNumSensors; ++i) {
+    CDS18B20probe& probe = _Sensors[_order[i]];
+    DS18B20_Info* pInfo = probe.getSensorInfo();
+    if(pInfo && pInfo->resolution != probe.getResolution()) {
+      if(ds18b20_set_resolution(pInfo, probe.getResolution()))
+        DebugPort.printf("DS18B20 #%d set to %d bit resolution\r\n", i, pInfo->resolution);
+    }
+  }
+}
+
+unsigned long
+CDS18B20SensorSet::getConversionTime() const
+{
+  // convert_all starts every probe, the slowest (highest resolution) sets the wait
+  int bits = 0;
+  for (int i = 0; i < _nNumSensors; ++i) {
+    const DS18B20_Info* pInfo = _Sensors[_order[i]].getSensorInfo();
+    if(pInfo && pInfo->resolution > bits)
+      bits = pInfo->resolution;
+  }
+  if(!INBOUNDS(bits, DS18B20_RESOLUTION_9_BIT, DS18B20_RESOLUTION_12_BIT))
+    return 0;
+  return 750 >> (DS18B20_RESOLUTION_12_BIT - bits);   // 94, 188, 375, 750ms
 }
 
 int 
@@ -316,63 +382,133 @@ CDS18B20SensorSet::checkNumSensors() const
   return numSensors;
 }
 
+void
+CDS18B20SensorSet::_resolveRoles()
+{
+  // caller holds _mux
+  // roles follow their assigned ROM code, 
+  // roles without an attached probe take the unassigned probes in bus order
+  bool taken[MAX_DS18B20_DEVICES] = { false };
+  static const uint8_t nullROM[8] = { 0 };
+  for(int role = 0; role < MAX_DS18B20_DEVICES; role++) {
+    _roleIdx[role] = -1;
+    if(memcmp(_roleROM[role].bytes, nullROM, 8) == 0)
+      continue;
+    for(int i = 0; i < _nNumSensors; i++) {
+      if(_Sensors[_order[i]].matchROMcode(_roleROM[role].bytes)) {
+        _roleIdx[role] = i;
+        taken[i] = true;
+        break;
+      }
+    }
+  }
+  int next = 0;
+  for(int role = 0; role < MAX_DS18B20_DEVICES; role++) {
+    if(_roleIdx[role] < 0) {
+      while(next < _nNumSensors && taken[next])
+        next++;
+      if(next < _nNumSensors) {
+        _roleIdx[role] = next;
+        taken[next] = true;
+      }
+    }
+  }
+}
+
 bool 
 CDS18B20SensorSet::mapSensor(int idx, OneWireBus_ROMCode romCode)
 {
   if(idx == -1) {
-    _sensorMap[0] = _sensorMap[1] = _sensorMap[2] = -1;
+    portENTER_CRITICAL(&_mux);
+    for(int i = 0; i < MAX_DS18B20_DEVICES; i++) 
+      memset(_roleROM[i].bytes, 0, 8);
+    _resolveRoles();
+    portEXIT_CRITICAL(&_mux);
     return false;
   }
   if(idx == -2) {
-      DebugPort.printf("Sensor Map: %d %d %d\r\n",
-                       _sensorMap[0], _sensorMap[1], _sensorMap[2]);
+    DebugPort.print("Sensor Map:");
+    for(int i = 0; i < MAX_DS18B20_DEVICES; i++) 
+      DebugPort.printf(" %d", _roleIdx[i]);
+    DebugPort.println("");
     return false;
   }
 
-  if(!INBOUNDS(idx, 0, 2))
+  if(!INBOUNDS(idx, 0, MAX_DS18B20_DEVICES-1))
     return false;
 
-  for(int i = 0; i < _nNumSensors; i++) {
-    if(_Sensors[i].matchROMcode(romCode.bytes)) {
-      _sensorMap[idx] = i;
-      DebugPort.printf("Mapped DS18B20 %02X:%02X:%02X:%02X:%02X:%02X as role %d\r\n",
-                        romCode.fields.serial_number[5], 
-                        romCode.fields.serial_number[4], 
-                        romCode.fields.serial_number[3], 
-                        romCode.fields.serial_number[2], 
-                        romCode.fields.serial_number[1], 
-                        romCode.fields.serial_number[0], 
-                        idx
-                      );
-      return true;
-    }
-  }
-  return false;
+  portENTER_CRITICAL(&_mux);
+  _roleROM[idx] = romCode;
+  _resolveRoles();
+  bool bAttached = _findSlot(romCode) >= 0;
+  portEXIT_CRITICAL(&_mux);
+
+  if(!bAttached)
+    return false;
+
+  DebugPort.printf("Mapped DS18B20 %02X:%02X:%02X:%02X:%02X:%02X as role %d\r\n",
+                    romCode.fields.serial_number[5], 
+                    romCode.fields.serial_number[4], 
+                    romCode.fields.serial_number[3], 
+                    romCode.fields.serial_number[2], 
+                    romCode.fields.serial_number[1], 
+                    romCode.fields.serial_number[0], 
+                    idx
+                  );
+  return true;
 }
 
-bool
-CDS18B20SensorSet::getTemperature(int usrIdx, float& temperature, bool filtered) 
+int
+CDS18B20SensorSet::getMapIdx(int usrIdx) const
 {
-  int snsIdx = _sensorMap[usrIdx];
+  int snsIdx = INBOUNDS(usrIdx, 0, MAX_DS18B20_DEVICES-1) ? _roleIdx[usrIdx] : -1;
   if(snsIdx < 0) 
     snsIdx = 0;  // default to sensor 0 if not mapped
+  return snsIdx;
+}
 
-  return getTemperatureIdx(snsIdx, temperature, filtered);  
+bool
+CDS18B20SensorSet::getTemperature(int usrIdx, float& temperature, bool filtered) 
+{
+  return getTemperatureIdx(getMapIdx(usrIdx), temperature, filtered);  
+}
+
+bool
+CDS18B20SensorSet::setResolution(int usrIdx, int bits)
+{
+  if(!INBOUNDS(bits, DS18B20_RESOLUTION_9_BIT, DS18B20_RESOLUTION_12_BIT))
+    return false;
+  _Sensors[_order[getMapIdx(usrIdx)]].setResolution(DS18B20_RESOLUTION(bits));  // applied by the acquisition task
+  return true;
+}
+
+int
+CDS18B20SensorSet::getResolution(int usrIdx) const
+{
+  return _Sensors[_order[getMapIdx(usrIdx)]].getResolution();
 }
 
 bool
 CDS18B20SensorSet::getTemperatureIdx(int snsIdx, float& temperature, bool filtered) 
 {
-  return _Sensors[snsIdx].getTemperature(temperature, filtered);
+  if(!INBOUNDS(snsIdx, 0, _nNumSensors-1)) {
+    temperature = -100;
+    return false;
+  }
+  return _Sensors[_order[snsIdx]].getTemperature(temperature, filtered);
 }
 
 bool 
 CDS18B20SensorSet::getRomCodeIdx(int snsIdx, OneWireBus_ROMCode& romCode) const
 {
-  if(snsIdx >= _nNumSensors)
-    return false;
-  romCode = _Sensors[snsIdx].getROMcode();
-  return true;
+  bool retval = false;
+  portENTER_CRITICAL(&_mux);
+  if(snsIdx < _nNumSensors) {
+    romCode = _Sensors[_order[snsIdx]].getROMcode();
+    retval = true;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return retval;
 }
 
 
@@ -396,6 +532,7 @@ bool
 CBME280Sensor::begin(int ID)
 {
   _count = 0;
+  CI2CLock lock(I2C_BME280);
   bool status = _bme.begin(ID);  
   if (!status) {
     DebugPort.println("Could not find a valid BME280 sensor, check wiring!");
@@ -442,6 +579,7 @@ bool
 CBME280Sensor::getAltitude(float& reading, bool fresh)
 {
   if(fresh) {
+    CI2CLock lock(I2C_BME280);
     _fAltitude = _bme.readAltitude(1013.25);  //use  standard atmosphere as reference
   }
   reading = _fAltitude;
@@ -452,6 +590,7 @@ bool
 CBME280Sensor::getHumidity(float& reading, bool fresh)
 {
   if(fresh) {
+    CI2CLock lock(I2C_BME280);
     _fHumidity = _bme.readHumidity();
   }
   reading = _fHumidity;
@@ -461,8 +600,12 @@ CBME280Sensor::getHumidity(float& reading, bool fresh)
 int 
 CBME280Sensor::getAllReadings(bme280_readings& readings) 
 {
-  _bme.takeForcedMeasurement();
-  int retval = _bme.readAll(readings);
+  int retval;
+  {
+    CI2CLock lock(I2C_BME280);
+    _bme.takeForcedMeasurement();
+    retval = _bme.readAll(readings);
+  }
   _fAltitude = readings.altitude;
   _fHumidity = readings.humidity;
   update(readings.temperature);
@@ -488,6 +631,22 @@ CBME280Sensor::getID()
 
 CTempSense::CTempSense()
 {
+  _taskHandle = NULL;
+  _sampleInterval = MIN_TEMPERATURE_INTERVAL;
+  _lastRescan = 0;
+  _bRescan = false;
+  _scanCount = 0;
+  _seq = 0;
+  _consumed = 0;
+  _snapMux = portMUX_INITIALIZER_UNLOCKED;
+  for(int i = 0; i < MAX_DS18B20_DEVICES; i++) {
+    _snapshot.DS18B20[i].raw = _snapshot.DS18B20[i].filtered = -100;
+    _snapshot.DS18B20[i].valid = false;
+  }
+  _snapshot.BME280.raw = _snapshot.BME280.filtered = -100;
+  _snapshot.BME280.valid = false;
+  _snapshot.humidity = 0;
+  _snapshot.altitude = 0;
 }
 
 void
@@ -495,32 +654,170 @@ CTempSense::begin(int oneWirePin, int I2CID)
 {
   DS18B20.begin(oneWirePin);
   BME280.begin(I2CID);
+  _lastRescan = millis();
+
+  // all sensor bus traffic happens in this task, loop() only picks up the published readings
+  xTaskCreate(_staticTask,
+              "SensorTask",
+              TASK_STACK_SENSORS,
+              this,
+              TASK_PRIORITY_SENSORS,
+              &_taskHandle);
 }
 
-int  
-CTempSense::getNumSensors() const
+void
+CTempSense::_staticTask(void* arg)
 {
-  int retval = 0;
+  CTempSense* pThis = (CTempSense*)arg;
 
-  retval += DS18B20.getNumSensors();
-  retval += BME280.getCount();
+  pThis->_task();
 
-  return retval;
+  vTaskDelete(NULL);
 }
 
-void 
-CTempSense::startConvert()
+void
+CTempSense::_task()
 {
+  for(;;) {
+    unsigned long tStart = millis();
+
+    _acquire();
+    _publish();
+
+    long tRemain = _sampleInterval - (millis() - tStart);
+    vTaskDelay(tRemain > 0 ? pdMS_TO_TICKS(tRemain) : 1);
+  }
+}
+
+void
+CTempSense::_acquire()
+{
+  // rescan when asked, or periodically if no probes are attached - an empty search is slow
+  long tDelta = millis() - _lastRescan;
+  if(_bRescan || (DS18B20.getNumSensors() == 0 && tDelta > DS18B20_RESCAN_INTERVAL)) {
+    _bRescan = false;
+    _lastRescan = millis();
+    if(DS18B20.find()) 
+      DebugPort.println("Found DS18B20 device(s)");
+    _scanCount++;
+  }
+  DS18B20.applyResolution();
+
+  // start: all probes convert together
+  unsigned long tStart = millis();
   DS18B20.startConvert();
+
+  // the BME280 forced measurement is taken while the DS18B20s convert
+  if(BME280.getCount()) {
+    bme280_readings readings;
+    BME280.getAllReadings(readings);
+  }
+
+  // wait: out the remainder of the slowest probe's conversion time
+  long tWait = DS18B20.getConversionTime() - (millis() - tStart);
+  if(tWait > 0)
+    vTaskDelay(pdMS_TO_TICKS(tWait) + 1);
+
+  // read
+  DS18B20.readSensors();
+}
+
+void
+CTempSense::_publish()
+{
+  sTempSnapshot snapshot;
+  for(int i = 0; i < MAX_DS18B20_DEVICES; i++) {
+    sTempSnapshot::sReading& reading = snapshot.DS18B20[i];
+    DS18B20.getTemperatureIdx(i, reading.raw, false);
+    reading.valid = DS18B20.getTemperatureIdx(i, reading.filtered, true) && i < DS18B20.getNumSensors();
+  }
+  BME280.getTemperature(snapshot.BME280.raw, false);
+  snapshot.BME280.valid = BME280.getTemperature(snapshot.BME280.filtered, true);
+  BME280.getHumidity(snapshot.humidity);
+  BME280.getAltitude(snapshot.altitude);
+
+  // Odd sequence marks the update in progress.
+  // The critical section stops this task being preempted mid copy, 
+  // which would leave a higher priority reader on this core spinning.
+  portENTER_CRITICAL(&_snapMux);
+  _seq++;
+  __sync_synchronize();
+  _snapshot = snapshot;
+  __sync_synchronize();
+  _seq++;
+  portEXIT_CRITICAL(&_snapMux);
+}
+
+void
+CTempSense::_getSnapshot(sTempSnapshot& snapshot) const
+{
+  // readers never block, they retry if an update overlapped the copy
+  uint32_t seq;
+  do {
+    seq = _seq;
+    __sync_synchronize();
+    snapshot = _snapshot;
+    __sync_synchronize();
+  } while((seq & 1) || seq != _seq);
+}
+
+bool
+CTempSense::_getReading(const sTempSnapshot::sReading& reading, float& tempReading, bool filtered)
+{
+  tempReading = filtered ? reading.filtered : reading.raw;
+  return reading.valid;
 }
 
 bool
-CTempSense::readSensors()
+CTempSense::hasNewReadings()
 {
-  bme280_readings readings;
-  getBME280().getAllReadings(readings);
+  uint32_t seq = _seq;
+  if((seq & 1) || seq == _consumed)
+    return false;
+  _consumed = seq;
+  return true;
+}
 
-  return DS18B20.readSensors();
+void 
+CTempSense::setSampleInterval(unsigned long ms)
+{
+  BOUNDSLIMIT(ms, 100, 60000);
+  _sampleInterval = ms;
+}
+
+bool
+CTempSense::setResolution(int usrIdx, int bits)
+{
+  switch(getSensorType(usrIdx)) {
+    case 1:
+      return DS18B20.setResolution(usrIdx, bits);  
+    case 2:
+      return DS18B20.setResolution(usrIdx-1, bits);  
+  }
+  return false;  // BME280
+}
+
+int
+CTempSense::getResolution(int usrIdx)
+{
+  switch(getSensorType(usrIdx)) {
+    case 1:
+      return DS18B20.getResolution(usrIdx);  
+    case 2:
+      return DS18B20.getResolution(usrIdx-1);  
+  }
+  return 0;  // BME280
+}
+
+int  
+CTempSense::getNumSensors() const
+{
+  int retval = 0;
+
+  retval += DS18B20.getNumSensors();
+  retval += BME280.getCount();
+
+  return retval;
 }
 
 float
@@ -532,7 +829,7 @@ CTempSense::getOffset(int usrIdx)
     case 2:  // DS18B20 - AFTER BME280 - bump index down
       usrIdx--;
     case 1:  // DS18B20
-      if(INBOUNDS(usrIdx, 0, 2)) {
+      if(INBOUNDS(usrIdx, 0, MAX_DS18B20_DEVICES-1)) {
         return NVstore.getHeaterTuning().DS18B20probe[usrIdx].offset;
       }
       break;
@@ -552,7 +849,7 @@ CTempSense::setOffset(int usrIdx, float offset)
 
   if(BME280.getCount() == 0) {
     // no BME280 present - simply apply to DS18B20 list
-    if(INBOUNDS(usrIdx, 0, 2))
+    if(INBOUNDS(usrIdx, 0, MAX_DS18B20_DEVICES-1))
       ht.DS18B20probe[usrIdx].offset = offset;
   }
   else {
@@ -565,7 +862,7 @@ CTempSense::setOffset(int usrIdx, float offset)
       }
       else {
         usrIdx--;
-        if(INBOUNDS(usrIdx, 0, 2))
+        if(INBOUNDS(usrIdx, 0, MAX_DS18B20_DEVICES-1))
           ht.DS18B20probe[usrIdx].offset = offset;
       }
     }
@@ -577,7 +874,7 @@ CTempSense::setOffset(int usrIdx, float offset)
         ht.BME280probe.offset = offset;
       }
       else {
-        if(INBOUNDS(usrIdx, 0, 2))
+        if(INBOUNDS(usrIdx, 0, MAX_DS18B20_DEVICES-1))
           ht.DS18B20probe[usrIdx].offset = offset;
       }
     }
@@ -590,19 +887,22 @@ CTempSense::setOffset(int usrIdx, float offset)
 bool
 CTempSense::getTemperature(int usrIdx, float& temperature, bool filtered) 
 {
+  sTempSnapshot snapshot;
+  _getSnapshot(snapshot);
+
   bool bRetVal = false;
   float offset = 0;
   switch(getSensorType(usrIdx)) {
     case 0:
-      bRetVal = BME280.getTemperature(temperature, filtered);
+      bRetVal = _getReading(snapshot.BME280, temperature, filtered);
       offset = getOffset(usrIdx);  
       break;
     case 1:
-      bRetVal = DS18B20.getTemperature(usrIdx, temperature, filtered);  
+      bRetVal = _getReading(snapshot.DS18B20[DS18B20.getMapIdx(usrIdx)], temperature, filtered);  
       offset = getOffset(usrIdx);  
       break;
     case 2:
-      bRetVal = DS18B20.getTemperature(usrIdx-1, temperature, filtered);  
+      bRetVal = _getReading(snapshot.DS18B20[DS18B20.getMapIdx(usrIdx-1)], temperature, filtered);  
       offset = getOffset(usrIdx-1);  
       break;
   }
@@ -640,6 +940,81 @@ CTempSense::getID(int usrIdx)
     return "BME280";
 }
 
+void
+CTempSense::mapRoles()
+{
+  // apply the probe roles held in NV storage
+  DS18B20.mapSensor(-1);   // reset existing mapping
+  for(int role = 0; role < MAX_DS18B20_DEVICES; role++) 
+    DS18B20.mapSensor(role, NVstore.getHeaterTuning().DS18B20probe[role].romCode);
+  DS18B20.mapSensor(-2);   // report mapping
+}
+
+bool 
+CTempSense::assignRole(int usrIdx, const char* romCode)
+{
+  int role;
+  switch(getSensorType(usrIdx)) {
+    case 1: role = usrIdx; break;
+    case 2: role = usrIdx-1; break;
+    default: return false;   // BME280
+  }
+  if(!INBOUNDS(role, 0, MAX_DS18B20_DEVICES-1))
+    return false;
+
+  // ROM code as reported when finding probes, 16 hex digits, family code last. Empty clears the role.
+  OneWireBus_ROMCode rom = {0};
+  int len = strlen(romCode);
+  if(len) {
+    if(len != 16)
+      return false;
+    for(int i = 0; i < 8; i++) {
+      char hex[3] = { romCode[i*2], romCode[i*2+1], 0 };
+      char* pEnd;
+      rom.bytes[7-i] = strtol(hex, &pEnd, 16);
+      if(*pEnd)
+        return false;
+    }
+  }
+
+  sHeaterTuning ht = NVstore.getHeaterTuning();
+  for(int i = 0; i < MAX_DS18B20_DEVICES; i++) {
+    if(len && memcmp(ht.DS18B20probe[i].romCode.bytes, rom.bytes, 8) == 0) 
+      memset(ht.DS18B20probe[i].romCode.bytes, 0, 8);   // a probe only fills one role
+  }
+  ht.DS18B20probe[role].romCode = rom;
+  NVstore.setHeaterTuning(ht);
+  NVstore.save();
+
+  mapRoles();
+  return true;
+}
+
+const char*
+CTempSense::getName(int usrIdx, eTempName which)
+{
+  // JSON and MQTT moderators key on the name pointer, so the names must persist
+  static const char* const fixedNames[4][NumTempNames] = {
+    { "TempCurrent",  "TempOffset",  "TempType"  },
+    { "Temp2Current", "Temp2Offset", "Temp2Type" },
+    { "Temp3Current", "Temp3Offset", "Temp3Type" },
+    { "Temp4Current", "Temp4Offset", "Temp4Type" },
+  };
+  static char names[MAX_TEMP_SENSORS-4][NumTempNames][14];
+
+  if(!INBOUNDS(usrIdx, 0, MAX_TEMP_SENSORS-1) || !INBOUNDS(which, 0, NumTempNames-1))
+    return NULL;
+  if(usrIdx < 4)
+    return fixedNames[usrIdx][which];
+
+  char* pName = names[usrIdx-4][which];
+  if(pName[0] == 0) {
+    static const char* const fields[NumTempNames] = { "Current", "Offset", "Type" };
+    sprintf(pName, "Temp%d%s", usrIdx+1, fields[which]);
+  }
+  return pName;
+}
+
 void
 CTempSense::format(char* msg, float fTemp) 
 {
@@ -655,24 +1030,43 @@ CTempSense::format(char* msg, float fTemp)
 bool
 CTempSense::getTemperatureBME280(float& reading)
 {
-  return BME280.getTemperature(reading, false);
+  sTempSnapshot snapshot;
+  _getSnapshot(snapshot);
+  return _getReading(snapshot.BME280, reading, false);
 }
 
 bool
-CTempSense::getAltitude(float& reading, bool fresh)
+CTempSense::getTemperatureDS18B20Idx(int sensIdx, float& reading)
+{
+  if(!INBOUNDS(sensIdx, 0, MAX_DS18B20_DEVICES-1))
+    return false;
+  sTempSnapshot snapshot;
+  _getSnapshot(snapshot);
+  return _getReading(snapshot.DS18B20[sensIdx], reading, false);
+}
+
+bool
+CTempSense::getAltitude(float& reading)
 {
   if(BME280.getCount()) {
-    return BME280.getAltitude(reading, fresh);
+    sTempSnapshot snapshot;
+    _getSnapshot(snapshot);
+    reading = snapshot.altitude;
+    return true;
   }
   else
     return false;
 }
 
 bool
-CTempSense::getHumidity(float& reading, bool fresh)
+CTempSense::getHumidity(float& reading)
 {
-  if(BME280.getCount())
-    return BME280.getHumidity(reading, fresh);
+  if(BME280.getCount()) {
+    sTempSnapshot snapshot;
+    _getSnapshot(snapshot);
+    reading = snapshot.humidity;
+    return true;
+  }
   else
     return false;
 }
\ No newline at end of file
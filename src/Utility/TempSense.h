@@ -25,10 +25,13 @@
 #include "../../lib/esp32-ds18b20/ds18b20.h"
 #include "../../lib/Adafruit_BME280_Library/Adafruit_BME280.h"
 #include "DataFilter.h"
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
 
 //#define SINGLE_DS18B20_SENSOR
 
-const int MAX_DS18B20_DEVICES = 3;
+const int MAX_DS18B20_DEVICES = DS18B20_MAX_PROBES;    // probes on the bus, also the number of probe roles
+const int MAX_TEMP_SENSORS = MAX_DS18B20_DEVICES + 1;  // plus the BME280
 
 class CSensor {
   float _reading;
@@ -44,31 +47,44 @@ public:
 };
 
 class CDS18B20probe : public CSensor {
-  DS18B20_Info * pSensorInfo;
+  DS18B20_Info _info;               // held in place, rescans re-initialise rather than going to the heap
+  bool _bAttached;
   DS18B20_ERROR error;
+  DS18B20_RESOLUTION _resolution;   // requested, applied by the acquisition task
 public:
   CDS18B20probe();
   void init();
-  void assign(DS18B20_Info *pInfo) { pSensorInfo = pInfo; };
+  void attach(const DS18B20_Info& info);
   void release();
   bool readSensor();
   void setError(DS18B20_ERROR err) { error = err; };
   bool OK() { return error == DS18B20_OK; };
+  bool isAttached() const { return _bAttached; };
   OneWireBus_ROMCode getROMcode() const;
-  DS18B20_Info* getSensorInfo() { return pSensorInfo; };
+  DS18B20_Info* getSensorInfo() { return _bAttached ? &_info : NULL; };
+  const DS18B20_Info* getSensorInfo() const { return _bAttached ? &_info : NULL; };
   float getReading(bool filtered);
-  bool matchROMcode(uint8_t test[8]);
+  bool matchROMcode(const uint8_t test[8]) const;
+  void setResolution(DS18B20_RESOLUTION res) { _resolution = res; };
+  DS18B20_RESOLUTION getResolution() const { return _resolution; };
 };
 
 class CDS18B20SensorSet  {
   OneWireBus * _owb;
   owb_rmt_driver_info _rmt_driver_info;
 
+  // Probes keep their slot, and so their filter and resolution, for as long as their ROM code stays on the bus.
+  // _order lists the occupied slots in bus (discovery) order, which is how probes are indexed outside this class.
   CDS18B20probe _Sensors[MAX_DS18B20_DEVICES];
+  int8_t _order[MAX_DS18B20_DEVICES];
   int _nNumSensors;
   bool _bReportFind;
-  int _sensorMap[MAX_DS18B20_DEVICES];
+  OneWireBus_ROMCode _roleROM[MAX_DS18B20_DEVICES];   // probe assigned to each role, zero if unassigned
+  int8_t _roleIdx[MAX_DS18B20_DEVICES];               // resolved bus index of each role
+  mutable portMUX_TYPE _mux;   // guards the slot table and role map against a rescan by the acquisition task
   bool _discover();
+  void _resolveRoles();
+  int _findSlot(const OneWireBus_ROMCode& romCode) const;
 
 public:
   CDS18B20SensorSet();
@@ -76,12 +92,16 @@ public:
   bool find();
   bool readSensors();
   void startConvert();
-  void waitConvertDone();
+  void applyResolution();
+  unsigned long getConversionTime() const;
   int  checkNumSensors() const;
   bool getTemperature(int mapIdx, float& tempReading, bool filtered);
   bool getTemperatureIdx(int sensIdx, float& tempReading, bool filtered) ;      // index is sensor discovery order on one-wire bus
   bool getRomCodeIdx(int sensIdx, OneWireBus_ROMCode& romCode) const; // index is sensor discovery order on one-wire bus
   bool mapSensor(int idx, OneWireBus_ROMCode romCode = { 0 } );
+  int  getMapIdx(int usrIdx) const;
+  bool setResolution(int usrIdx, int bits);
+  int  getResolution(int usrIdx) const;
   int  getNumSensors() const { return _nNumSensors; };
   const char* getID();
 };
@@ -103,17 +123,59 @@ public:
   int getCount() const { return _count; };
 };
 
+// Readings published by the acquisition task.
+// Written under a sequence count, readers retry if they overlap an update.
+struct sTempSnapshot {
+  struct sReading {
+    float raw;
+    float filtered;
+    bool valid;
+  };
+  sReading DS18B20[MAX_DS18B20_DEVICES];   // index is sensor discovery order on one-wire bus
+  sReading BME280;
+  float humidity;
+  float altitude;
+};
+
 class CTempSense {
+public:
+  enum eTempName { CurrentName, OffsetName, TypeName, NumTempNames };
+private:
 
   CDS18B20SensorSet DS18B20;
   CBME280Sensor BME280;
-  
+
+  TaskHandle_t _taskHandle;
+  unsigned long _sampleInterval;
+  unsigned long _lastRescan;
+  volatile bool _bRescan;
+  volatile int _scanCount;
+  sTempSnapshot _snapshot;
+  volatile uint32_t _seq;     // odd while _snapshot is being written
+  portMUX_TYPE _snapMux;
+  uint32_t _consumed;         // _seq when last checked by hasNewReadings()
+
   bool _discover();
+  static void _staticTask(void* arg);
+  void _task();
+  void _acquire();
+  void _publish();
+  void _getSnapshot(sTempSnapshot& snapshot) const;
+  static bool _getReading(const sTempSnapshot::sReading& reading, float& tempReading, bool filtered);
 public:
   CTempSense();
   void begin(int oneWirePin, int I2CID);
-  bool readSensors();
-  void startConvert();
+  bool hasNewReadings();
+  void requestRescan() { _bRescan = true; };
+  int  getScanCount() const { return _scanCount; };
+  void setSampleInterval(unsigned long ms);
+  unsigned long getSampleInterval() const { return _sampleInterval; };
+  bool setResolution(int usrIdx, int bits);
+  int  getResolution(int usrIdx);
+  TaskHandle_t getTaskHandle() const { return _taskHandle; };
+  void mapRoles();
+  bool assignRole(int usrIdx, const char* romCode);
+  static const char* getName(int usrIdx, eTempName which);
   int getSensorType(int usrIdx);
   const char* getID(int usrIdx);
   bool getTemperature(int usrIdx, float& tempReading, bool filtered=true) ;   // indexed as mapped by user
@@ -122,8 +184,8 @@ public:
   bool getTemperatureBME280(float& tempReading) ;      // index is sensor discovery order on one-wire bus
   bool getTemperatureDS18B20Idx(int sensIdx, float& tempReading) ;      // index is sensor discovery order on one-wire bus
   int  getNumSensors() const;
-  bool getAltitude(float& reading, bool fresh=false);
-  bool getHumidity(float& reading, bool fresh=false);
+  bool getAltitude(float& reading);
+  bool getHumidity(float& reading);
   CBME280Sensor& getBME280() { return BME280; };
   CDS18B20SensorSet& getDS18B20() { return DS18B20; };
   static void format(char* msg, float fTemp);
@@ -358,6 +358,36 @@ void DecodeCmd(const char* cmd, String& payload)
       NVstore.save();
     }
   }
+  else if(strcmp("GPalgOvrsmpl", cmd) == 0) {
+    int val = payload.toInt();   // raw ADC conversions averaged per sample
+    if(INBOUNDS(val, 1, 64)) {
+      sUserSettings us = NVstore.getUserSettings();
+      us.GPIO.algOversample = val;
+      NVstore.setUserSettings(us);
+      NVstore.save();
+      setupGPIO();
+    }
+  }
+  else if(strcmp("GPalgIntvl", cmd) == 0) {
+    int val = payload.toInt();   // ms between samples
+    if(INBOUNDS(val, 1, 1000)) {
+      sUserSettings us = NVstore.getUserSettings();
+      us.GPIO.algInterval = val;
+      NVstore.setUserSettings(us);
+      NVstore.save();
+      setupGPIO();
+    }
+  }
+  else if(strcmp("GPalgFilter", cmd) == 0) {
+    int val = payload.toInt();   // ms, filter time constant, 0 = unfiltered
+    if(INBOUNDS(val, 0, 10000)) {
+      sUserSettings us = NVstore.getUserSettings();
+      us.GPIO.algFilter = val;
+      NVstore.setUserSettings(us);
+      NVstore.save();
+      setupGPIO();
+    }
+  }
   else if(strcmp("JSONpack", cmd) == 0) {
     sUserSettings us = NVstore.getUserSettings();
     uint8_t packed = payload.toInt() ? 0x00 : 0x01;
@@ -414,6 +444,26 @@ void DecodeCmd(const char* cmd, String& payload)
   else if(strcmp("Temp4Offset", cmd) == 0) {
     getTempSensor().setOffset(3, payload.toFloat());
   }
+  else if(strcmp("TempRes", cmd) == 0) {      // DS18B20 resolution, 9-12 bits, not persisted
+    getTempSensor().setResolution(0, payload.toInt());
+  }
+  else if(strcmp("TempProbe", cmd) == 0) {    // assign DS18B20 ROM code to role, "" to clear
+    getTempSensor().assignRole(0, payload.c_str());
+  }
+  else if(strncmp("Temp", cmd, 4) == 0 && isdigit(cmd[4])) {
+    // indexed sensors, Temp2xxx onwards
+    char* pField;
+    int usrIdx = strtol(cmd+4, &pField, 10) - 1;
+    if(strcmp("Offset", pField) == 0) 
+      getTempSensor().setOffset(usrIdx, payload.toFloat());
+    else if(strcmp("Res", pField) == 0) 
+      getTempSensor().setResolution(usrIdx, payload.toInt());
+    else if(strcmp("Probe", pField) == 0) 
+      getTempSensor().assignRole(usrIdx, payload.c_str());
+  }
+  else if(strcmp("TempInterval", cmd) == 0) {  // sensor sample interval, ms, not persisted
+    getTempSensor().setSampleInterval(payload.toInt());
+  }
   else if(strcmp("LowVoltCutout", cmd) == 0) {
     float fCal = payload.toFloat();
     bool bOK = false;
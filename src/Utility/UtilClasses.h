@@ -114,6 +114,19 @@ struct sRxLine {
     }
     return false;
   }
+  bool append(const char* data, int len) {
+    // block append, keeps what fits - false if truncated
+    bool retval = true;
+    int room = sizeof(Line) - 1 - Len;
+    if(len > room) {
+      len = room;
+      retval = false;
+    }
+    memcpy(&Line[Len], data, len);
+    Len += len;
+    Line[Len] = 0;
+    return retval;
+  }
   void clear() {
     Line[0] = 0;
     Len = 0;
@@ -133,6 +146,10 @@ public:
   void setRefTime() { 
     refTime = millis(); 
   };
+  long elapsed() {      // as per report(), but just the value
+    prevTime = millis();
+    return prevTime - refTime;
+  };
   void report(bool isDelta, char* msg=NULL) {
     if(isDelta) {
       long delta = millis() - prevTime;
@@ -339,6 +339,15 @@ void updateMQTT()
       else
         pubTopic("Temp4Current", "n/a"); 
     }
+    for(int usrIdx = 4; usrIdx < getTempSensor().getNumSensors(); usrIdx++) {
+      const char* name = CTempSense::getName(usrIdx, CTempSense::CurrentName);
+      if(getTempSensor().getTemperature(usrIdx, tidyTemp)) {
+        tidyTemp = int(tidyTemp * 10 + 0.5) * 0.1f;  // round to 0.1 resolution 
+        pubTopic(name, tidyTemp); 
+      }
+      else
+        pubTopic(name, "n/a"); 
+    }
   }
   pubTopic("TempDesired", CDemandManager::getDemand()); 
   pubTopic("TempBody", getHeaterInfo().getTemperature_HeatExchg()); 
@@ -26,6 +26,8 @@
 #include <Arduino.h>
 #include "BTCWifi.h"
 #include "BTCWebServer.h"
+#include "WebSocketQueue.h"
+#include "StatusEvents.h"
 #include "BTCota.h"
 #include "../Utility/DebugPort.h"
 #include "../Protocol/TxManage.h"
@@ -34,6 +36,9 @@
 #include "../cfg/BTCConfig.h"
 #include "../Utility/BTC_JSON.h"
 #include "../Utility/Moderator.h"
+#include "../Utility/Profiler.h"
+#include "../Utility/macros.h"
+#include "../Utility/StatusSnapshot.h"
 #include "../../lib/WiFiManager-dev/WiFiManager.h"
 #include <SPIFFS.h>
 #include "../Utility/NVStorage.h"
@@ -52,7 +57,9 @@
 #include <HTTPMultipartBodyParser.hpp>
 #include <HTTPURLEncodedBodyParser.hpp>
 #include <WebsocketHandler.hpp>
+#include <EventStreamHandler.hpp>
 #include <FreeRTOS.h>
+#include <freertos/ringbuf.h>
 #include "../OLED/ScreenManager.h"
 #include "esp_task_wdt.h"
 
@@ -75,18 +82,47 @@ extern void checkSplashScreenUpdate();
 
 size_t streamFileSSL(fs::File &file, const String& contentType, httpsserver::HTTPResponse* pSSL);
 void streamFileCoreSSL(const size_t fileSize, const String & fileName, const String & contentType);
-void processWebsocketQueue();
 
-QueueHandle_t webSocketQueue = NULL;
-QueueHandle_t JSONcommandQueue = NULL;
-TaskHandle_t handleWebServerTask;
+// Each server is serviced by its own task, so a TLS handshake or file transfer
+// on one server never holds up websocket traffic on another.
+// Websocket messages are copied to the ring of each server with a client, each 
+// task only sends to its own clients - connections are never touched by another task.
+struct sWebServerTask {
+  const char* name;
+  HTTPServer* pServer;
+  CWebSocketQueue* pTxQueue;  // websocket messages for this server's clients
+  char* pStatusDoc;           // /api/status and /api/events documents, rendered by this server's task only
+  TaskHandle_t taskHandle;
+  CStatusStreamLimit sseStreams;   // open /api/events streams
+  sWebServerStats stats;
+};
+
+// static rather than on the server tasks' stacks, the port 81 server has no status endpoints
+static char HTTPstatusDoc[STATUS_EVENT_SIZE];
+#if USE_HTTPS == 1
+static char HTTPSstatusDoc[STATUS_EVENT_SIZE];
+#else
+#define HTTPSstatusDoc NULL
+#endif
+
+sWebServerTask WebServers[eNumWebServers] = {
+  { "WS server",    NULL, &WebSocketQueues[eWebSocketServer], NULL }, 
+  { "HTTP server",  NULL, &WebSocketQueues[eHTTPServer],      HTTPstatusDoc }, 
+  { "HTTPS server", NULL, &WebSocketQueues[eHTTPSServer],     HTTPSstatusDoc }
+};
+
+void processWebsocketQueue(sWebServerTask& srv);
+sWebServerTask* currentWebServer();
+
+// messages are copied into (allocation free) byte rings rather than heap blocks
+RingbufHandle_t JSONcommandRing = NULL;
 #if USE_HTTPS == 1
 SSLCert* pCert;
 HTTPSServer * secureServer;
 #endif
 HTTPServer * insecureServer;
 HTTPServer * WSserver;
-void SSLloopTask(void *);
+void webServerTask(void* arg);
 
 sBrowserUpload BrowserUpload;
 #ifdef OLD_SERVER
@@ -119,6 +155,9 @@ void onUploadProgression(HTTPRequest* req, HTTPResponse* res);
 void onUploadCompletion(HTTPRequest* req, HTTPResponse* res);
 void onWMConfig(HTTPRequest* req, HTTPResponse* res);
 void onResetWifi(HTTPRequest* req, HTTPResponse* res);
+void onProfile(HTTPRequest* req, HTTPResponse* res);
+void onStatus(HTTPRequest* req, HTTPResponse* res);
+void onEvents(HTTPRequest* req, HTTPResponse* res);
 void doDefaultWebHandler(HTTPRequest * req, HTTPResponse * res);
 void build404Response(HTTPRequest * req, String& content, String file);
 void build500Response(String& content, String file);
@@ -142,8 +181,11 @@ public:
 };
 
 
-// Simple array to store the active clients:
+// Simple array to store the active clients, and the server task each belongs to.
+// Slots are claimed and released by the server tasks, under clientMux
 JSONHandler* activeClients[MAX_CLIENTS];
+sWebServerTask* clientServer[MAX_CLIENTS];
+static portMUX_TYPE clientMux = portMUX_INITIALIZER_UNLOCKED;
 
 
 // In the create function of the handler, we create a new Handler and keep track
@@ -151,57 +193,115 @@ JSONHandler* activeClients[MAX_CLIENTS];
 WebsocketHandler * JSONHandler::create() {
   DebugPort.println("Creating new JSON client!");
   JSONHandler * handler = new JSONHandler();
+  sWebServerTask* pServer = currentWebServer();   // called from the server's own task
+  portENTER_CRITICAL(&clientMux);
   for(int i = 0; i < MAX_CLIENTS; i++) {
     if (activeClients[i] == nullptr) {
       activeClients[i] = handler;
+      clientServer[i] = pServer;
+      if(pServer)
+        pServer->pTxQueue->addClient();   // messages are now queued for this server
       break;
     }
   }
+  portEXIT_CRITICAL(&clientMux);
   return handler;
 }
 
 // When the websocket is closing, we remove the client from the array
 void 
 JSONHandler::onClose() {
+  portENTER_CRITICAL(&clientMux);
   for(int i = 0; i < MAX_CLIENTS; i++) {
     if (activeClients[i] == this) {
+      if(clientServer[i])
+        clientServer[i]->pTxQueue->removeClient();
       activeClients[i] = nullptr;
+      clientServer[i] = NULL;
     }
   }
+  portEXIT_CRITICAL(&clientMux);
 }
 
 void 
 JSONHandler::onMessage(WebsocketInputStreambuf * inbuf) {
-  // Get the input message
-  std::ostringstream ss;
-  std::string msg;
-  ss << inbuf;
-  msg = ss.str();
+  // Get the input message, straight into a fixed buffer
+  char msg[WEB_RX_MAXMSG];
+  if(inbuf->getRecordSize() >= sizeof(msg)) {
+    DebugPort.printf("JSONHandler: %d byte message ignored\r\n", (int)inbuf->getRecordSize());
+    return;    // the unread record is discarded by the stream
+  }
+  int len = inbuf->sgetn(msg, sizeof(msg)-1);
+  msg[len] = 0;
 
   bRxWebData = true;
 
   // use a queue to hand over messages - ensures any commands that affect the I2C bus 
   // (typ. various RTC operations) are performed in line with all other accesses
-  addRxJSONcommand(msg.c_str());
+  addRxJSONcommand(msg);
+}
+
+// Server-Sent Events (GET /api/events): each client is sent the status
+// snapshot items that changed since its previous event, the whole snapshot
+// first (see CStatusEventStream). A client whose socket is full is skipped, 
+// its changes coalesce into the next event it can take.
+class CStatusEventHandler : public EventStreamHandler {
+  sWebServerTask* _pServer;
+  CStatusEventStream _stream;
+public:
+  CStatusEventHandler(sWebServerTask* pServer);
+  ~CStatusEventHandler();
+  void loop();
+};
+
+CStatusEventHandler::CStatusEventHandler(sWebServerTask* pServer)
+{
+  _pServer = pServer;
+}
+
+// streams are counted per server, by onEvents() and as each handler is deleted
+CStatusEventHandler::~CStatusEventHandler()
+{
+  _pServer->sseStreams.release();
+}
+
+void
+CStatusEventHandler::loop()
+{
+  if(!_stream.due())
+    return;
+  if(!canSend()) {
+    _pServer->stats.sseDeferred++;
+    return;
+  }
+
+  const char* pEvent;
+  int len = _stream.render(_pServer->pStatusDoc, STATUS_EVENT_SIZE, pEvent);   // this server's, its handlers run one at a time
+  if(send(pEvent, len)) {
+    _pServer->stats.sseEvents++;
+    _pServer->stats.sseBytes += len;
+    _stream.sent();
+  }
 }
 
 bool addRxJSONcommand(const char* str)
 {
-  if(JSONcommandQueue) {
-    char *pMsg = new char[strlen(str)+1];
-    strcpy(pMsg, str);
-    xQueueSend(JSONcommandQueue, &pMsg, 0);
-    return true;
+  if(JSONcommandRing) {
+    return xRingbufferSend(JSONcommandRing, str, strlen(str)+1, 0) == pdTRUE;
   }
   return false;
 }
 
 bool checkRxJSONcommand() 
 {
-  char* pMsg = NULL;
-  if(xQueueReceive(JSONcommandQueue, &pMsg, 0)) {
-    interpretJsonCommand(pMsg);
-    delete[] pMsg;
+  if(JSONcommandRing == NULL)
+    return false;
+
+  size_t len;
+  char* pMsg = (char*)xRingbufferReceive(JSONcommandRing, &len, 0);
+  if(pMsg) {
+    interpretJsonCommand(pMsg);    // parses in place, the item is ours until returned
+    vRingbufferReturnItem(JSONcommandRing, pMsg);
     return true;
   }
   return false;
@@ -346,15 +446,31 @@ const char* getWebContent(bool start) {
 
 SemaphoreHandle_t SSLSemaphore = NULL;
 
+#if USE_HTTPS_ECDSA == 1
+const SSLKeySize SSLkeyType = KEYSIZE_EC_P256;
+#else
+const SSLKeySize SSLkeyType = KEYSIZE_2048;
+#endif
+
+struct sSSLkeyInfo {
+  SSLKeySize keyType;         // key type of the certificate in use
+  bool generated;             // created this boot, otherwise loaded from NV
+  unsigned long setupTime;    // ms to create, or load, the certificate
+} SSLkeyInfo;
+
 void SSLkeyTask(void *) {
   DebugPort.println("SSL creation starting");
+  unsigned long tStart = millis();
 
   pCert = new SSLCert();
 
   ABpreferences  SSLkeyStore;
   SSLkeyStore.begin("SSLkeys");
 
-  if(SSLkeyStore.hasBytes("Certificate")) {
+  // certificates stored before the key type was recorded are RSA 2048
+  SSLKeySize storedType = (SSLKeySize)SSLkeyStore.getUShort("KeyType", KEYSIZE_2048);
+
+  if(SSLkeyStore.hasBytes("Certificate") && storedType == SSLkeyType) {
     ScreenManager.showBootMsg("Loading SSL cert.");
 
     DebugPort.println("Using stored SSL certificate");
@@ -370,26 +486,31 @@ void SSLkeyTask(void *) {
     SSLkeyStore.getBytes("PrivateKey", pPKData, len);
     pCert->setPK(pPKData, len);
 
+    SSLkeyInfo.generated = false;
     // vTaskDelay(10000);  // TEST
   }
   else {
-    DebugPort.println("Creating SSL certificate - this may take a while...");
+    DebugPort.printf("Creating %s SSL certificate - this may take a while...\r\n", SSLkeyType == KEYSIZE_EC_P256 ? "ECDSA P-256" : "RSA 2048");
     ScreenManager.showBootMsg("Creating SSL cert.");
 
     int createCertResult = createSelfSignedCert(
                           *pCert,
-                          KEYSIZE_2048,
+                          SSLkeyType,
                           "CN=myesp.local,O=acme,C=US");
  
-    DebugPort.println("SSL certificate created");
+    DebugPort.printf("SSL certificate created in %lums\r\n", millis() - tStart);
     if (createCertResult != 0) {
       DebugPort.printf("Error generating certificate");
     }
     else {
       SSLkeyStore.putBytes("Certificate", pCert->getCertData(), pCert->getCertLength());
       SSLkeyStore.putBytes("PrivateKey", pCert->getPKData(), pCert->getPKLength());
+      SSLkeyStore.putUShort("KeyType", SSLkeyType);
     }
+    SSLkeyInfo.generated = true;
   }
+  SSLkeyInfo.keyType = SSLkeyType;
+  SSLkeyInfo.setupTime = millis() - tStart;
   SSLkeyStore.end();
       DebugPort.printf("Certificate: length = %d\r\n", pCert->getCertLength());
       hexDump(pCert->getCertData(), pCert->getCertLength(), 32);
@@ -405,6 +526,26 @@ void SSLkeyTask(void *) {
 
 #endif
 
+void reportHTTPS()
+{
+#if USE_HTTPS == 1
+  DebugPort.printf("HTTPS certificate: %s, %s in %lums\r\n", 
+                   SSLkeyInfo.keyType == KEYSIZE_EC_P256 ? "ECDSA P-256" : "RSA 2048",
+                   SSLkeyInfo.generated ? "created" : "loaded",
+                   SSLkeyInfo.setupTime);
+  const HTTPSHandshakeStats& stats = HTTPSConnection::getHandshakeStats();
+  DebugPort.printf("TLS handshakes: %u completed, %u failed\r\n", stats.count, stats.failed);
+  if(stats.count) {
+    uint32_t meanUs = stats.totalUs / stats.count;
+    DebugPort.printf("  SSL_accept() mean %.1fms, max %.1fms => %.1f handshakes/s\r\n", 
+                     meanUs * 0.001, stats.maxUs * 0.001, 1e6 / meanUs);
+  }
+  HTTPSConnection::resetHandshakeStats();
+#else
+  DebugPort.println("HTTPS is disabled");
+#endif
+}
+
 void initWebServer(void) {
 
   if (MDNS.begin("Afterburner")) {
@@ -422,7 +563,7 @@ void initWebServer(void) {
              16384,
              NULL,
              TASK_PRIORITY_SSL_CERT,   // low priority as this blocks BIG time
-             &handleWebServerTask);
+             NULL);
 
   while(!xSemaphoreTake(SSLSemaphore, 250)) {
     ScreenManager.showBootWait(1);
@@ -463,6 +604,11 @@ void initWebServer(void) {
   ResourceNode * updateNode = new ResourceNode("/update", "", &onUpload);
   ResourceNode * wmconfigNode = new ResourceNode("/wmconfig", "GET", &onWMConfig);
   ResourceNode * resetwifiNode = new ResourceNode("/resetwifi", "GET", &onResetWifi);
+#if USE_PROFILER == 1
+  ResourceNode * profileNode = new ResourceNode("/profile", "GET", &onProfile);
+#endif
+  ResourceNode * statusNode = new ResourceNode("/api/status", "GET", &onStatus);
+  ResourceNode * eventsNode = new ResourceNode("/api/events", "GET", &onEvents);
   ResourceNode * defaultGet = new ResourceNode("/", "GET", &doDefaultWebHandler);
   
   insecureServer->registerNode(rebootNode);     
@@ -471,6 +617,11 @@ void initWebServer(void) {
   insecureServer->registerNode(WebsktUpdateNode);
   insecureServer->registerNode(resetwifiNode);
   insecureServer->registerNode(wmconfigNode);
+#if USE_PROFILER == 1
+  insecureServer->registerNode(profileNode);
+#endif
+  insecureServer->registerNode(statusNode);
+  insecureServer->registerNode(eventsNode);
   insecureServer->setDefaultNode(defaultGet);
 
 #if USE_HTTPS == 1
@@ -480,6 +631,11 @@ void initWebServer(void) {
   secureServer->registerNode(WebsktUpdateNode);
   secureServer->registerNode(resetwifiNode);
   secureServer->registerNode(wmconfigNode);
+#if USE_PROFILER == 1
+  secureServer->registerNode(profileNode);
+#endif
+  secureServer->registerNode(statusNode);
+  secureServer->registerNode(eventsNode);
   secureServer->setDefaultNode(defaultGet);
 #endif
 
@@ -491,42 +647,51 @@ void initWebServer(void) {
 
   DebugPort.println("HTTPS started");
 
-  JSONcommandQueue = xQueueCreate(50, sizeof(char*) );
+  JSONcommandRing = xRingbufferCreate(WEB_RX_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
   
-  // setup task to handle webserver
-  webSocketQueue = xQueueCreate(50, sizeof(char*) );
+  // setup a task to handle each webserver, websockets on port 81 take precedence
+  WebServers[eWebSocketServer].pServer = WSserver;
+  WebServers[eHTTPServer].pServer = insecureServer;
+#if USE_HTTPS == 1
+  WebServers[eHTTPSServer].pServer = secureServer;
+#endif
   bStopWebServer = false;
-  xTaskCreate(SSLloopTask,
-             "Web server task",
-             8192,
-            //  16384,
-             NULL,
-             TASK_PRIORITY_SSL_LOOP,   // low priority as this potentially blocks BIG time
-             &handleWebServerTask);
+  for(int i = 0; i < eNumWebServers; i++) {
+    sWebServerTask& srv = WebServers[i];
+    if(srv.pServer == NULL)
+      continue;
+    bool isWS = (i == eWebSocketServer);
+    srv.pTxQueue->begin(isWS ? WEB_TX_RING_SIZE : WEB_TX_RING_SMALL, srv.stats);
+    xTaskCreate(webServerTask,
+                srv.name,
+                isWS ? TASK_STACK_WEBSOCKET : TASK_STACK_WEBSERVER,
+                &srv,
+                isWS ? TASK_PRIORITY_WEBSOCKET : TASK_PRIORITY_WEBSERVER,   // file servers potentially block BIG time
+                &srv.taskHandle);
+  }
 
-  DebugPort.println("HTTP task started");
+  DebugPort.println("HTTP tasks started");
 }
 
-void SSLloopTask(void *) {
+void webServerTask(void* arg) {
+  sWebServerTask& srv = *(sWebServerTask*)arg;
   
   while(!bStopWebServer) {
-    WSserver->loop();
-    insecureServer->loop();
-#if USE_HTTPS == 1
-    secureServer->loop();
-#endif
-    processWebsocketQueue();
+    unsigned long tStart = micros();
+    srv.pServer->loop();
+    uint32_t tBusy = micros() - tStart;
+
+    srv.stats.passes++;
+    srv.stats.busyTotal += tBusy;
+    LOWERLIMIT(srv.stats.busyMax, tBusy);
+
+    processWebsocketQueue(srv);
     vTaskDelay(1);   
   }
 
-  WSserver->stop();
-  insecureServer->stop();
-#if USE_HTTPS == 1
-  secureServer->stop();
-#endif
-
+  srv.pServer->stop();
+  srv.taskHandle = NULL;
   vTaskDelete(NULL);
-  bStopWebServer = false;
 }
 
 // called by main sketch loop()
@@ -538,6 +703,17 @@ bool doWebServer(void)
   return true;
 }
 
+bool isWebServerRunning()
+{
+  if(bStopWebServer)
+    return false;
+  for(int i = 0; i < eNumWebServers; i++) {
+    if(WebServers[i].taskHandle)
+      return true;
+  }
+  return false;
+}
+
 void stopWebServer()
 {
   DebugPort.println("Requesting web server stop");
@@ -702,6 +878,9 @@ bool handleFileRead(String path, HTTPResponse *res) { // send the right file to
 
       length = file.read(buffer, 256);
     } 
+    sWebServerTask* pServer = currentWebServer();
+    if(pServer)
+      pServer->stats.fileBytes += done;
     return done;
   }
 
@@ -1100,48 +1279,141 @@ void onResetWifi(HTTPRequest * req, httpsserver::HTTPResponse * res)
 }
 
 
+#if USE_PROFILER == 1
+// loop() stage timing and task stacks, as JSON - start the profiler from the debug menu
+void onProfile(HTTPRequest * req, httpsserver::HTTPResponse * res)
+{
+  res->setHeader("Content-Type", "application/json");
+  Profiler.printJSON(*res);
+}
+#endif
+
+// the latest status, as one JSON object - from the snapshot, so a poll costs loop() nothing
+void onStatus(HTTPRequest * req, httpsserver::HTTPResponse * res)
+{
+  // a poll after none for a while waits for loop() to refresh the snapshot, it is stale
+  // until then. Not refreshed within STATUS_REQUEST_WAIT the blue wire exchanges have
+  // stalled, say so rather than serve stale values.
+  if(!StatusSnapshot.request(STATUS_REQUEST_WAIT)) {
+    res->setStatusCode(503);
+    res->setStatusText("Service Unavailable");
+    res->setHeader("Retry-After", "5");
+    res->print("Status not refreshed");
+    return;
+  }
+  char* doc = currentWebServer()->pStatusDoc;      // this server's, called from its own task
+  StatusSnapshot.print(doc, STATUS_DOC_SIZE);
+  res->setHeader("Content-Type", "application/json");
+  res->setHeader("Cache-Control", "no-cache");
+  res->print(doc);
+}
+
+// status changes as they happen, as Server-Sent Events (EventSource in a browser)
+void onEvents(HTTPRequest * req, httpsserver::HTTPResponse * res)
+{
+  // every stream holds one of the server's connections, leave some for everything else
+  sWebServerTask* pServer = currentWebServer();   // called from the server's own task
+  if(!pServer->sseStreams.acquire()) {
+    res->setStatusCode(503);
+    res->setStatusText("Service Unavailable");
+    res->setHeader("Retry-After", "10");
+    res->print("Too many event streams");
+    return;
+  }
+  res->startEventStream(new CStatusEventHandler(pServer));
+}
+
+
 void rootRedirect(HTTPRequest * req, httpsserver::HTTPResponse * res)
 {
   res->setHeader("Location","/");      // reselect the update page
   res->setStatusCode(303);
 }
 
-// pass new data for websocket send via a queue
-bool sendWebSocketString(const char* Str)
+// send queued messages to this server's websocket clients
+void processWebsocketQueue(sWebServerTask& srv)
 {
-  if(webSocketQueue) {
-    char* pMsg = new char[strlen(Str)+1];
-    strcpy(pMsg, Str);
-    xQueueSend(webSocketQueue, &pMsg, 0);
-    return true;
+  uint32_t tQueued;
+  const char* pMsg;
+  while((pMsg = srv.pTxQueue->get(tQueued)) != NULL) {
+    size_t len = strlen(pMsg);            // item holds the terminator
+    for(int i=0; i< MAX_CLIENTS; i++) {
+      // only this task claims or releases its own slots
+      if(clientServer[i] == &srv && activeClients[i]) {
+        bTxWebData = true;              // OLED tx data animation flag
+        // send the raw bytes - the std::string overload copies each message to the heap
+        activeClients[i]->send((uint8_t*)pMsg, len, WebsocketHandler::SEND_TYPE_TEXT);
+        srv.stats.wsSent++;
+        srv.stats.wsBytes += len;
+      }
+    }
+    uint32_t tWait = micros() - tQueued;
+    srv.stats.wsQueued++;
+    srv.stats.wsLatencyTotal += tWait;
+    LOWERLIMIT(srv.stats.wsLatencyMax, tWait);
+    srv.pTxQueue->release(pMsg);
   }
-  return false;
 }
 
-// query queue for new messages to send to websocket(s)
-void processWebsocketQueue()
+sWebServerTask* currentWebServer()
 {
-  char* pMsg;
-  if(webSocketQueue) {
-    if(xQueueReceive(webSocketQueue, &pMsg, 0)) {
-      if(pMsg == NULL) {
-        // DebugPort.println("websocket send NULL averted");
-      }
-      else {
-        // DebugPort.printf("websocket len=%d\r\n", strlen(pMsg));
-        for(int i=0; i< MAX_CLIENTS; i++) {
-          if(activeClients[i]) {
-            bTxWebData = true;              // OLED tx data animation flag
-            activeClients[i]->send(pMsg, WebsocketHandler::SEND_TYPE_TEXT);
-            // DebugPort.println("->");
-          }
-        }
-        delete[] pMsg;
-      }
-    }
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for(int i = 0; i < eNumWebServers; i++) {
+    if(WebServers[i].taskHandle == self)
+      return &WebServers[i];
   }
+  return NULL;
+}
+
+const sWebServerStats* getWebServerStats(int server)
+{
+  if(server < 0 || server >= eNumWebServers || WebServers[server].pServer == NULL)
+    return NULL;
+  return &WebServers[server].stats;
 }
 
+TaskHandle_t getWebServerTaskHandle(int server)
+{
+  if(server < 0 || server >= eNumWebServers)
+    return NULL;
+  return WebServers[server].taskHandle;
+}
+
+void reportWebServers()
+{
+  int sseClients = 0;
+  uint32_t sseRefused = 0;
+  uint32_t sseEvents = 0;
+  uint32_t sseBytes = 0;
+  uint32_t sseDeferred = 0;
+  DebugPort.println("Web servers since last report:");
+  DebugPort.println("  Server        Passes  Busy max  Busy %  WS msgs  Wait avg  Wait max  Drop   WS bytes  File bytes");
+  for(int i = 0; i < eNumWebServers; i++) {
+    sWebServerTask& srv = WebServers[i];
+    if(srv.pServer == NULL)
+      continue;
+    sWebServerStats& stats = srv.stats;
+    sseClients += srv.sseStreams.getOpen();
+    sseRefused += srv.sseStreams.getRefused();
+    sseEvents += stats.sseEvents;
+    sseBytes += stats.sseBytes;
+    sseDeferred += stats.sseDeferred;
+    uint32_t waitAvg = stats.wsQueued ? (uint32_t)(stats.wsLatencyTotal / stats.wsQueued) : 0;
+    static unsigned long lastReport[eNumWebServers];
+    unsigned long period = millis() - lastReport[i];
+    lastReport[i] = millis();
+    DebugPort.printf("  %-12s %7u %7.1fms %6.1f%% %8u %7.1fms %7.1fms %5u %10u %11u\r\n", 
+                     srv.name, stats.passes, stats.busyMax * 0.001, 
+                     period ? stats.busyTotal * 0.1 / period : 0.0,
+                     stats.wsQueued, waitAvg * 0.001, stats.wsLatencyMax * 0.001, stats.wsDropped,
+                     stats.wsBytes, stats.fileBytes);
+    memset(&stats, 0, sizeof(stats));
+  }
+  DebugPort.printf("  Event streams: %d open, %u refused, %u events (%u bytes), %u deferred\r\n", 
+                   sseClients, sseRefused, sseEvents, sseBytes, sseDeferred);
+  StatusSnapshot.report();
+  reportHTTPS();
+}
 
 bool isWebSocketClientChange() 
 {
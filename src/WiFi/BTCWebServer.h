@@ -25,9 +25,35 @@
 #ifndef _BTCWEBSERVER_h
 #define _BTCWEBSERVER_h
 
+#include <stdint.h>
+
+enum eWebServers {
+  eWebSocketServer,   // port 81, websockets only
+  eHTTPServer,        // port 80
+  eHTTPSServer,       // port 443
+  eNumWebServers
+};
+
+struct sWebServerStats {
+  uint32_t passes;            // server loop() passes
+  uint32_t busyMax;           // us, longest loop() pass - the worst wait seen by another client
+  uint64_t busyTotal;         // us, time spent in loop()
+  uint32_t wsQueued;          // websocket messages taken from this server's ring
+  uint32_t wsDropped;         // websocket messages lost, larger than WEB_TX_MAXMSG or this server's ring was full
+  uint32_t wsLatencyMax;      // us, longest wait from queued to sent
+  uint64_t wsLatencyTotal;    // us, queued to sent, all messages
+  uint32_t wsSent;            // messages sent, once per client
+  uint32_t wsBytes;           // bytes sent to websocket clients
+  uint32_t fileBytes;         // bytes streamed from SPIFFS
+  uint32_t sseEvents;         // status events sent to /api/events clients
+  uint32_t sseBytes;          // bytes sent to /api/events clients
+  uint32_t sseDeferred;       // events held back, the client's socket was full
+};
+
 void initWebServer();
 bool doWebServer();
 void stopWebServer();
+bool isWebServerRunning();
 
 bool sendWebSocketString(const char* Str);
 bool isWebSocketClientChange(); 
@@ -36,6 +62,10 @@ void listSPIFFS(const char * dirname, uint8_t levels, String& HTMLreport, int wi
 const char* getWebContent(bool start); 
 void getWebContent(const char* filename); 
 bool checkWebSocketSend();
+void reportHTTPS();
+void reportWebServers();
+const sWebServerStats* getWebServerStats(int server);
+TaskHandle_t getWebServerTaskHandle(int server);
 
 #endif
 
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#include "StatusEvents.h"
+#include "../Utility/StatusSnapshot.h"
+
+static portMUX_TYPE streamMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+CStatusEventStream::CStatusEventStream()
+{
+  _version = 0;
+  _rendered = 0;
+  _lastSend = millis() - SSE_KEEPALIVE;
+}
+
+// The changes since this client's version are due SSE_MIN_INTERVAL after its
+// last event, a keepalive comment once SSE_KEEPALIVE passes without one.
+// Asking keeps the snapshot refreshed, nothing is due until it is current.
+bool
+CStatusEventStream::due()
+{
+  if(!StatusSnapshot.request())
+    return false;
+
+  unsigned long tDelta = millis() - _lastSend;
+  if(tDelta < SSE_MIN_INTERVAL)
+    return false;
+  return StatusSnapshot.getVersion() != _version || tDelta >= SSE_KEEPALIVE;
+}
+
+// Renders "id: <version>\ndata: {changed items}\n\n", or ": keepalive\n\n", 
+// into buf. Returns its length, pEvent is set to its start.
+int
+CStatusEventStream::render(char* buf, int size, const char*& pEvent)
+{
+  _rendered = _version;
+  if(StatusSnapshot.getVersion() == _version) {
+    pEvent = buf;
+    return sprintf(buf, ": keepalive\n\n");
+  }
+
+  // render the data, then slot the event id in ahead of it
+  char* pData = &buf[24];             // room for "id: 4294967295\ndata: "
+  _rendered = StatusSnapshot.print(pData, size - 24 - 3, _version);
+  char header[24];
+  int headerLen = sprintf(header, "id: %u\ndata: ", _rendered);
+  char* pStart = pData - headerLen;
+  memcpy(pStart, header, headerLen);
+  int len = headerLen + strlen(pData);
+  pStart[len++] = '\n';
+  pStart[len++] = '\n';
+  pStart[len] = 0;
+  pEvent = pStart;
+  return len;
+}
+
+void
+CStatusEventStream::sent()
+{
+  _version = _rendered;
+  _lastSend = millis();
+}
+
+
+CStatusStreamLimit::CStatusStreamLimit()
+{
+  _open = 0;
+  _refused = 0;
+}
+
+bool
+CStatusStreamLimit::acquire()
+{
+  portENTER_CRITICAL(&streamMux);
+  bool bAccept = _open < SSE_MAX_CLIENTS;
+  if(bAccept)
+    _open++;
+  else
+    _refused++;
+  portEXIT_CRITICAL(&streamMux);
+  return bAccept;
+}
+
+void
+CStatusStreamLimit::release()
+{
+  portENTER_CRITICAL(&streamMux);
+  _open--;
+  portEXIT_CRITICAL(&streamMux);
+}
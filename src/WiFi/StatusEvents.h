@@ -0,0 +1,70 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#ifndef __STATUSEVENTS_H__
+#define __STATUSEVENTS_H__
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#include "../cfg/BTCConfig.h"
+
+#define STATUS_EVENT_SIZE (STATUS_DOC_SIZE + 32)    /* a status document, with its event framing */
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CStatusEventStream
+//
+// One /api/events client: the status snapshot version it holds and when
+// it was last sent an event. The web server's handler asks due() on each
+// server pass, renders the event once the client's socket can take it,
+// then calls sent() once it has. An event not sent is rendered afresh
+// next time, changes in between coalesce into it.
+//
+///////////////////////////////////////////////////////////////////////////
+
+class CStatusEventStream {
+  uint32_t _version;          // snapshot version this client holds
+  uint32_t _rendered;         // version it holds once the rendered event is sent
+  unsigned long _lastSend;
+public:
+  CStatusEventStream();
+  bool due();
+  int render(char* buf, int size, const char*& pEvent);
+  void sent();
+  uint32_t getVersion() const { return _version; };
+};
+
+// Every stream holds one of its server's connections, each server takes 
+// SSE_MAX_CLIENTS streams and refuses any more.
+class CStatusStreamLimit {
+  int _open;
+  uint32_t _refused;
+public:
+  CStatusStreamLimit();
+  bool acquire();             // false once the server has its SSE_MAX_CLIENTS
+  void release();
+  int getOpen() const { return _open; };
+  uint32_t getRefused() const { return _refused; };
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#include "WebSocketQueue.h"
+#include "../cfg/BTCConfig.h"
+
+CWebSocketQueue WebSocketQueues[eNumWebServers];
+
+// a queued item is the time queued, then the message and its terminator
+static const int stampSize = sizeof(uint32_t);
+
+
+CWebSocketQueue::CWebSocketQueue()
+{
+  _ring = NULL;
+  _clients = 0;
+  _pStats = NULL;
+}
+
+void 
+CWebSocketQueue::begin(int size, sWebServerStats& stats)
+{
+  _pStats = &stats;
+  if(_ring == NULL)
+    _ring = xRingbufferCreate(size, RINGBUF_TYPE_NOSPLIT);
+}
+
+bool 
+CWebSocketQueue::put(const char* item, int size)
+{
+  if(_ring == NULL || _clients == 0)
+    return false;     // nobody to send it to
+
+  if(size > stampSize + WEB_TX_MAXMSG || xRingbufferSend(_ring, item, size, 0) != pdTRUE) {
+    _pStats->wsDropped++;
+    return false;
+  }
+  return true;
+}
+
+const char* 
+CWebSocketQueue::get(uint32_t& tQueued)
+{
+  if(_ring == NULL)
+    return NULL;
+
+  size_t len;
+  char* pItem = (char*)xRingbufferReceive(_ring, &len, 0);
+  if(pItem == NULL) 
+    return NULL;
+  memcpy(&tQueued, pItem, stampSize);
+  return &pItem[stampSize];
+}
+
+void 
+CWebSocketQueue::release(const char* msg)
+{
+  vRingbufferReturnItem(_ring, (void*)(msg - stampSize));
+}
+
+
+// pass new data for websocket send via a queue per server, 
+// stamped so each server task can tell how long it waited
+bool sendWebSocketString(const char* Str)
+{
+  int len = strlen(Str) + 1;
+  char item[stampSize + WEB_TX_MAXMSG];
+  uint32_t tQueued = micros();
+  memcpy(item, &tQueued, stampSize);
+  if(len <= WEB_TX_MAXMSG)
+    memcpy(&item[stampSize], Str, len);
+
+  bool retval = false;
+  for(int i = 0; i < eNumWebServers; i++) {
+    if(WebSocketQueues[i].put(item, stampSize + len))
+      retval = true;
+  }
+  return retval;
+}
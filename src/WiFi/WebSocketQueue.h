@@ -0,0 +1,63 @@
+/*
+ * This file is part of the "bluetoothheater" distribution 
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater) 
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+
+#ifndef __WEBSOCKETQUEUE_H__
+#define __WEBSOCKETQUEUE_H__
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include "BTCWebServer.h"
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CWebSocketQueue
+//
+// JSON messages awaiting send to one web server's websocket clients, 
+// copied into an allocation free byte ring, stamped with the time queued.
+// sendWebSocketString() (loop) only queues to the servers which have a
+// client, the server's own task takes them off with get() and release().
+// A message larger than WEB_TX_MAXMSG, or one the ring cannot take, is
+// counted in wsDropped.
+//
+///////////////////////////////////////////////////////////////////////////
+
+class CWebSocketQueue {
+  RingbufHandle_t _ring;
+  volatile int _clients;        // this server's websocket clients
+  sWebServerStats* _pStats;
+public:
+  CWebSocketQueue();
+  void begin(int size, sWebServerStats& stats);
+  // by the server's task, under the web server's client lock
+  void addClient() { _clients++; };
+  void removeClient() { if(_clients) _clients--; };
+  int  getClients() const { return _clients; };
+  bool put(const char* item, int size);        // as built by sendWebSocketString()
+  const char* get(uint32_t& tQueued);          // next message or NULL, release() it once sent
+  void release(const char* msg);
+};
+
+extern CWebSocketQueue WebSocketQueues[eNumWebServers];
+
+#endif
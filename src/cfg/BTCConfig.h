@@ -31,10 +31,28 @@
 // ** Recommended to use HC-05 for now **
 // If none are enabled, we'll use an abstract class that only reports 
 // to the debug port what would  have been sent
+// A build may instead choose with -D (the host tests build Classic and BLE)
 //
+#ifndef USE_HC05_BLUETOOTH
 #define USE_HC05_BLUETOOTH     1
 #define USE_BLE_BLUETOOTH      0
 #define USE_CLASSIC_BLUETOOTH  0
+#endif
+
+// ESP32 Classic / BLE transmit queue
+#define BT_TX_RING_SIZE    4096   /* bytes held for the Bluetooth client */
+#define BT_TX_MAXCHUNK     512    /* largest block handed to the stack at once */
+#define BLE_TX_CREDITS     4      /* notifications in flight before waiting on the stack */
+#define BT_TX_TIMEOUT      100    /* ms, longest wait on the stack before sending regardless */
+
+// ESP32 HC-05 UART driver (data mode)
+#define HC05_RX_BUFSIZE    1024   /* UART driver receive buffer */
+#define HC05_TX_RING_SIZE  2048   /* UART driver transmit ring, drained by the UART ISR */
+#define HC05_CMD_RING_SIZE 2064   /* complete JSON commands awaiting loop(), largest item is half less the 8 byte header: the 1024 byte line */
+#define HC05_EVENT_DEPTH   16     /* UART driver event queue length */
+#define HC05_RX_THRESHOLD  32     /* bytes in the UART FIFO before the task is woken */
+#define HC05_RX_TIMEOUT    3      /* idle byte times before a part filled FIFO wakes the task */
+#define TASK_STACK_HC05    2500   /* UART event task: splits received blocks into commands */
 
 //////////////////////////////////////////////////////////////////////////////
 // Configure WiFi options
@@ -48,6 +66,7 @@
 #define USE_WEBSERVER 1
 #define USE_MQTT      1
 #define USE_HTTPS     0
+#define USE_HTTPS_ECDSA 1     /* 1: ECDSA P-256 certificate, 0: RSA 2048 - changing this regenerates the stored certificate */
 
 #define USE_PORTAL_TRIGGER_PIN 0
 
@@ -79,7 +98,103 @@
 ///////////////////////////////////////////////////////////////////////////////
 //  DS18B20 temperature sensing
 //
-#define MIN_TEMPERATURE_INTERVAL 750  // max conversion time for 12 bit DS18B20
+// Sensors are read by a background task, loop() picks up the latest readings
+#define MIN_TEMPERATURE_INTERVAL   750   /* ms, default sample interval - max conversion time for 12 bit DS18B20 */
+#define DS18B20_DEFAULT_RESOLUTION 12    /* bits, 9 to 12: 94, 188, 375 or 750ms conversion time */
+#define DS18B20_RESCAN_INTERVAL    5000  /* ms, one wire bus search rate when no probes are attached */
+#define DS18B20_MAX_PROBES         16    /* probes (and probe roles) supported on the one wire bus */
+#define TEMP_JSON_PAGE             4     /* sensors per JSON string, beyond the first four */
+#define TASK_STACK_SENSORS         3500  /* SensorTask: one wire bus and BME280 transactions */
+
+///////////////////////////////////////////////////////////////////////////////
+//  GPIO analogue input
+//
+// The analogue input is sampled by a background task, getValue() returns the latest filtered value
+#define ADC_SAMPLE_INTERVAL   10    /* ms, decimated sample rate */
+#define ADC_OVERSAMPLE        16    /* raw ADC conversions averaged per decimated sample */
+#define ADC_FILTER_TIME       250   /* ms, time constant of the exponential mean */
+#define ADC_DEFAULT_VREF      1100  /* mV, only used if the eFuse holds no ADC calibration */
+#define TASK_STACK_ANALOG     1500  /* AnalogTask: ADC reads and the filter only */
+
+///////////////////////////////////////////////////////////////////////////////
+//  Deferred (binary) debug logging
+//
+#define BINLOG_LEVEL          2     /* 0: errors, 1: info, 2: debug - higher level calls are compiled out */
+#define BINLOG_TASK_RINGS     2     /* tasks that may own a private lock free log ring */
+#define BINLOG_RING_SIZE      32    /* records per ring, must be a power of 2 */
+#define BINLOG_DRAIN_INTERVAL 20    /* ms, log task formatting rate */
+
+///////////////////////////////////////////////////////////////////////////////
+//  Run time profiling of loop() stages and tasks
+//
+#define USE_PROFILER          1     /* 0: profiling calls are compiled out, 1: available, started via the debug menu */
+#define PROFILER_MAX_TASKS    16    /* tasks registered for stack (and CPU) reporting, setup() registers 13 */
+
+///////////////////////////////////////////////////////////////////////////////
+//  Heap monitoring
+//
+// Steady state operation (after setup()) should not need the heap, these track 
+// C++ allocations and fragmentation so any regression is visible
+#define USE_HEAP_MONITOR      1     /* 1: count operator new/delete, with call sites after boot */
+#ifndef HEAP_GUARD                  /* a debug build may set it with -D */
+#define HEAP_GUARD            0     /* 1: debug builds - report each call site that allocates after boot */
+#endif
+#define HEAP_CALLSITES        16    /* distinct post boot call sites tracked */
+#define HEAP_TREND_INTERVAL   60000 /* ms, free heap and largest free block sample rate */
+#define HEAP_TREND_SAMPLES    32    /* samples held for the trend report */
+
+///////////////////////////////////////////////////////////////////////////////
+//  Boot sequencing
+//
+// The blue wire starts as soon as the NV settings are loaded, the network and
+// Bluetooth module come up in parallel tasks whilst loop() is running
+#define BOOT_MAX_STAGES       16    /* stages held in the boot timeline */
+#define BOOT_FIRST_FRAME_BUDGET 1000  /* ms, app start to the first heater frame sent - warned if exceeded */
+#define BOOT_SPLASH_TIME      3000  /* ms, splash screen and key lock out once setup() is done */
+#define BOOT_MSG_TIME         2000  /* ms, a boot stage's message stays over the screens once the splash has gone */
+#define BOOT_LIST_SPIFFS      0     /* 1: list the SPIFFS contents whilst booting (slow) */
+#define TASK_STACK_BOOT_NET   8192  /* network bring up, WiFiManager is stack hungry */
+#define TASK_STACK_BOOT_BT    3000  /* HC-05 probe */
+
+///////////////////////////////////////////////////////////////////////////////
+//  Web server message hand over
+//
+// Each server (websocket port 81, HTTP and HTTPS) runs in its own task, the 
+// port 81 websocket task above the file servers
+#define WEB_RX_RING_SIZE      2048  /* bytes, received JSON commands awaiting loop() */
+#define WEB_TX_RING_SIZE      4096  /* bytes, JSON awaiting send to the port 81 websocket clients */
+#define WEB_TX_RING_SMALL     2560  /* bytes, as above for the HTTP and HTTPS servers, holds 2 of WEB_TX_MAXMSG */
+#define WEB_RX_MAXMSG         1024  /* bytes, largest websocket JSON command accepted */
+#define WEB_TX_MAXMSG         1024  /* bytes, largest JSON message queued for the websocket clients */
+#define TASK_STACK_WEBSOCKET  5120  /* port 81 websocket server */
+#define TASK_STACK_WEBSERVER  8192  /* HTTP / HTTPS servers, file transfers and TLS handshakes */
+
+///////////////////////////////////////////////////////////////////////////////
+//  REST status and Server-Sent Events
+//
+// GET /api/status and GET /api/events are served from a snapshot refreshed
+// after each blue wire exchange, each event stream client is sent what changed
+#define STATUS_MAX_ITEMS      96    /* values held in the status snapshot */
+#define STATUS_VALUE_LEN      40    /* bytes, longest JSON value held, quotes included */
+#define STATUS_NAME_POOL      1536  /* bytes, value names */
+#define STATUS_DOC_SIZE       3072  /* bytes, largest status document or event, rendered into a static buffer per server */
+#define STATUS_REQUEST_HOLD   30000 /* ms, the snapshot is refreshed for this long after a status or event client asks */
+#define STATUS_REQUEST_WAIT   1500  /* ms, longest a client waits for a refresh of a snapshot nobody had asked for */
+#define SSE_MAX_CLIENTS       2     /* /api/events streams per server, each holds one of its connections (HTTP 8, HTTPS 4) */
+#define SSE_MIN_INTERVAL      250   /* ms, minimum time between events to a client, changes in between coalesce */
+#define SSE_KEEPALIVE         15000 /* ms, comment line sent to an idle stream */
+
+///////////////////////////////////////////////////////////////////////////////
+//  433MHz remote
+//
+#define UHF_MIN_REPEATS       2     /* identical code words needed before a key press is accepted */
+
+///////////////////////////////////////////////////////////////////////////////
+// Timers
+//
+#define MAX_TIMERS      64    /* user programmable timers, 127 max (7 bit ID) */
+#define LEGACY_TIMERS   14    /* timers held in the original per timer NV namespaces */
+#define TIMER_JSON_PAGE 8     /* timers examined per JSON client update */
 
 ///////////////////////////////////////////////////////////////////////////////
 // Real Time Clock support
@@ -91,6 +206,11 @@
 #define RTC_USE_DS1307  0
 #define RTC_USE_PCF8523 0
   
+// The clock runs from millis(), the RTC chip is only read to discipline it
+#define RTC_RESYNC_INTERVAL  600000     /* ms, 10 minutes */
+#define RTC_DRIFT_MIN_SPAN   14400000   /* ms, 4 hours - minimum span to estimate drift against the 1 second resolution RTC */
+#define RTC_DRIFT_LIMIT      500        /* ppm, ignore drift estimates beyond this */
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Blue wire handling
@@ -107,6 +227,23 @@
 //
 #define USE_ADAFRUIT_SH1106  1    
 #define USE_ADAFRUIT_SSD1306 0
+#define USE_OLED_FLUSH_TASK  1    /* 1=send frames to the OLED from a background task, 0=from loop() */
+#define TASK_STACK_OLED      2048 /* OLED flush task: I2C only, refresh reports are printed from loop() */
+#define OLED_SCREEN_CACHE    2    /* number of constructed screens kept, minimum of 1 (the current screen) */
+#ifndef USE_DRAW_STATS            /* the host tests set it with -D */
+#define USE_DRAW_STATS       0    /* 1=count framebuffer draw calls per screen render, 0=draw calls go straight to the base class */
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// I2C bus arbitration
+//
+// The OLED, DS3231 and BME280 share the one bus, see Utility/I2CBus.h
+#define I2C_MAX_WAITERS      4    /* tasks waiting for the bus at once: loop(), OLED flush, sensors, I2C queue */
+#define I2C_MAX_BYPASS       4    /* times a waiter may be passed over by higher priority devices before it is served */
+#define I2C_QUEUE_SIZE       8    /* queued transactions awaiting the I2C task */
+#define I2C_DATA_SIZE        8    /* bytes, payload carried by a queued transaction */
+#define TASK_STACK_I2C       2048 /* I2C transaction task: Wire only */
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -124,4 +261,13 @@
 #define TASK_PRIORITY_ARDUINO  3
 #define TASK_PRIORITY_HEATERCOMMS 4
 #define TASK_PRIORITY_SSL_CERT 1
-#define TASK_PRIORITY_SSL_LOOP 1
\ No newline at end of file
+#define TASK_PRIORITY_WEBSOCKET 2
+#define TASK_PRIORITY_WEBSERVER 1
+#define TASK_PRIORITY_DISPLAY 2
+#define TASK_PRIORITY_I2C 2
+#define TASK_PRIORITY_SENSORS 2
+#define TASK_PRIORITY_ANALOG 2
+#define TASK_PRIORITY_LOG 1
+#define TASK_PRIORITY_BT_TX 2
+#define TASK_PRIORITY_HC05 2
+#define TASK_PRIORITY_BOOT 1
\ No newline at end of file
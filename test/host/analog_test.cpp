@@ -0,0 +1,155 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// GPIO analogue input acquisition
+//
+// CGPIOalg's AnalogTask runs on host ticks against a host ADC producing a
+// step with +-40 counts of noise on every conversion. The filtered output
+// is polled each millisecond, as loop() would read getValue(), for its 63%
+// step response, the ripple once settled and the final value.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <atomic>
+#include <random>
+#include "HostTest.h"
+#include "cfg/BTCConfig.h"
+#define private public
+#include "Utility/BTC_GPIO.h"
+#undef private
+
+static const int LowRaw = 1000;
+static const int HighRaw = 3000;
+static const int Noise = 40;
+
+static std::atomic<int> Level(LowRaw);
+static std::mt19937 NoiseGen(38);
+
+// only the AnalogTask converts
+static int
+noisyStep(adc1_channel_t channel)
+{
+  std::uniform_int_distribution<int> noise(-Noise, Noise);
+  int raw = Level + noise(NoiseGen);
+  return constrain(raw, 0, 4095);
+}
+
+static CGPIOalg& 
+analogue()
+{
+  static CGPIOalg alg;
+  static bool begun = false;
+  hostSimTicks(false);
+  if(!begun) {
+    hostSetADC(noisyStep);
+    alg.begin(ADC1_CHANNEL_5, CGPIOalg::HeatDemand);
+    begun = true;
+  }
+  return alg;
+}
+
+// start the filter afresh at the low level
+static void
+restart(CGPIOalg& alg, int interval)
+{
+  Level = LowRaw;
+  alg._Mode = CGPIOalg::Disabled;
+  delay(2 * interval + 5);
+  alg.setSampleInterval(interval);
+  alg._Mode = CGPIOalg::HeatDemand;
+  delay(5 * interval);
+}
+
+static int
+mV(int raw)
+{
+  return esp_adc_cal_raw_to_voltage(raw, &analogue()._adcChars);
+}
+
+TEST(step_response_any_interval)
+{
+  CGPIOalg& alg = analogue();
+  CHECK(alg.getTaskHandle() != NULL);
+  const int intervals[] = { 5, 10, 20, 50 };
+  for(int interval : intervals) {
+    restart(alg, interval);
+    // the 63% point of the step
+    int threshold = mV(LowRaw) + (mV(HighRaw) - mV(LowRaw)) * 632 / 1000;
+    unsigned long tStep = millis();
+    Level = HighRaw;
+    long t63 = -1;
+    while(millis() - tStep < 2000) {
+      if(alg.getMillivolts() >= threshold) {
+        t63 = millis() - tStep;
+        break;
+      }
+      delay(1);
+    }
+    // the step lands up to an interval before a sample, and the 63% point falls
+    // on the sample either side of the time constant (it is 63.2% at 50ms),
+    // allow for polling and host scheduling
+    CHECK(t63 >= ADC_FILTER_TIME - interval - 3);
+    CHECK(t63 <= ADC_FILTER_TIME + interval + 5);
+
+    // settled to within 0.3 counts, hold for 2 time constants
+    delay(9 * ADC_FILTER_TIME - t63);
+    int lo = 4095, hi = 0;
+    long sum = 0, n = 0;
+    unsigned long tHold = millis();
+    while(millis() - tHold < 2 * ADC_FILTER_TIME) {
+      int value = alg.getValue();
+      lo = std::min(lo, value);
+      hi = std::max(hi, value);
+      sum += value;
+      n++;
+      delay(1);
+    }
+    int ripple = hi - lo;
+    int mean = (sum + n/2) / n;
+    // noise free, the step's calibrated value
+    int target = (mV(HighRaw) * 4095 + alg._fullScale/2) / alg._fullScale;
+    // the 16 conversion average has 5.8 counts rms of noise, the filter passes
+    // 10% of it at 5ms samples, 32% at 50ms, the mV step adds 1.3 counts
+    CHECK(ripple <= 10);
+    CHECK(abs(mean - target) <= 1);
+    REPORT("%2dms samples: 63%% at %3ldms, held ripple %d counts, final %d (target %d)", 
+           interval, t63, ripple, mean, target);
+  }
+  alg.setSampleInterval(ADC_SAMPLE_INTERVAL);
+}
+
+// no filter time passes each sample straight through
+TEST(unfiltered)
+{
+  CGPIOalg& alg = analogue();
+  alg.setFilterTime(0);
+  restart(alg, ADC_SAMPLE_INTERVAL);
+  Level = HighRaw;
+  delay(3 * ADC_SAMPLE_INTERVAL);
+  CHECK(abs(alg.getValue() - HighRaw) <= Noise);
+  alg.setFilterTime(ADC_FILTER_TIME);
+}
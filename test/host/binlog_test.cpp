@@ -0,0 +1,313 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Deferred binary logging
+//
+// Every blue wire message moved to CBinLog must render as the text the
+// old sprintf / DebugReportFrame code produced (oracle/BlueWireLog_old).
+// The cost at the call site, which is what the blue wire task now pays,
+// is compared with the old message building. Ring ownership, drops and
+// the log task's merge by time stamp are checked through DebugPort.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "HostTest.h"
+#include "oracle/BlueWireLog_old.h"
+#include "Protocol/Protocol.h"
+#define private public
+#include "Utility/BinLog.h"
+#undef private
+
+static const int SharedRing = BINLOG_TASK_RINGS;
+
+// a plausible blue wire exchange
+static void
+makeFrames(CProtocol& controller, CProtocol& heater)
+{
+  controller.Init(CProtocol::CtrlMode);
+  controller.setHeaterDemand(22);
+  controller.setTemperature_Actual(19);
+  controller.setCRC();
+  heater.Init(CProtocol::HeatMode);
+  heater.setRunState(5);
+  heater.setVoltage_Supply(12.6);
+  heater.setFan_Actual(2800);
+  heater.setCRC();
+}
+
+static void
+flushRings()
+{
+  for(int i = 0; i <= BINLOG_TASK_RINGS; i++) 
+    BinLog._rings[i].flush();
+}
+
+// render and remove everything queued on a ring
+static std::string
+renderRing(int ring)
+{
+  std::string text;
+  sLogRecord record;
+  char msg[192];
+  while(BinLog._rings[ring].pop(record)) {
+    BinLog._render(record, msg, sizeof(msg));
+    text += msg;
+  }
+  return text;
+}
+
+TEST(renders_as_before)
+{
+  hostSimTicks(true);
+  hostSetTicks(123456);
+  flushRings();
+  char old[256];
+  CProtocol controller, heater;
+  makeFrames(controller, heater);
+
+  // the package's reference time is never set, frames are stamped with millis()
+  CProtocolPackage package;
+  package.set(heater, controller);
+  for(int isOEM = 0; isOEM < 2; isOEM++) {
+    package.reportFrames(isOEM);
+    oldReportFrames(isOEM, 123456, controller, heater, old);
+    CHECK_STREQ(std::string(old), renderRing(SharedRing));
+  }
+
+  const long elapsed[] = { 0, 7, 1234, 123456789 };
+  for(long t : elapsed) {
+    BINLOG(LOG_INFO, LOGF_RecycleTime, t);
+    oldRecycleTime(t, old);
+    CHECK_STREQ(std::string(old), renderRing(SharedRing));
+    BINLOG(LOG_INFO, LOGF_OEMresync, t);
+    oldOEMresync(t, old);
+    CHECK_STREQ(std::string(old), renderRing(SharedRing));
+  }
+
+  BINLOG(LOG_INFO, LOGF_Text, "Recycling blue wire serial interface\r\n");
+  CHECK_STREQ(std::string("Recycling blue wire serial interface\r\n"), renderRing(SharedRing));
+
+  CProtocol bad = heater;
+  bad.Data[7] ^= 0x40;
+  CHECK(!bad.verifyCRC(true));
+  oldVerifyCRC(bad, old);
+  CHECK(strlen(old) > 0);
+  CHECK_STREQ(std::string(old), renderRing(SharedRing));
+  CHECK(heater.verifyCRC(true));
+  CHECK_STREQ(std::string(""), renderRing(SharedRing));
+
+  // validateFrame()
+  BINLOG(LOG_ERROR, LOGF_BadCRC, "Heater");
+  BINLOG_DUMP(LOG_ERROR, LOGF_FrameBadCRC, bad.Data, 24);
+  oldBadCRC("Heater", bad, old);
+  CHECK_STREQ(std::string(old), renderRing(SharedRing));
+}
+
+TEST(render_conversions)
+{
+  flushRings();
+  BinLog.log(LOGF_Text, "plain");
+  CHECK_STREQ(std::string("plain"), renderRing(SharedRing));
+  sLogRecord record;
+  record.fmt = LOGF_NumFormats;
+  record.len = 0;
+  char msg[64];
+  BinLog._render(record, msg, sizeof(msg));
+  CHECK_STREQ(std::string("*** bad log format 11 ***\r\n"), std::string(msg));
+  // a short buffer truncates rather than overruns
+  uint8_t frame[24];
+  for(int i = 0; i < 24; i++)
+    frame[i] = i;
+  BinLog.logDump(LOGF_FrameHTR, frame, 24);
+  CHECK(BinLog._rings[SharedRing].pop(record));
+  char small[20];
+  memset(small, 0x55, sizeof(small));
+  BinLog._render(record, small, 16);
+  CHECK(strlen(small) < 16);
+  CHECK_EQ(0x55, small[16]);
+}
+
+// the blue wire task's cost per message, old and new
+TEST(call_site_cost)
+{
+  hostSimTicks(false);
+  flushRings();
+  CProtocol controller, heater;
+  makeFrames(controller, heater);
+  CProtocolPackage package;
+  package.set(heater, controller);
+  char old[256];
+
+  // the old messages were queued for loop() to print
+  QueueHandle_t msgQueue = xQueueCreate(4, sizeof(old));
+  char msg[sizeof(old)];
+  const int batches = 8000;
+  const int batch = 4;                         // the old message queue's depth
+  double newFrames = 0, oldFrames = 0, newRecycle = 0, oldRecycle = 0;
+  for(int b = 0; b < batches; b++) {
+    double t0 = hostNow_us();
+    for(int i = 0; i < batch; i++)
+      package.reportFrames(true);
+    newFrames += hostNow_us() - t0;
+    flushRings();
+
+    t0 = hostNow_us();
+    for(int i = 0; i < batch; i++) {
+      oldReportFrames(true, i, controller, heater, old);
+      xQueueSend(msgQueue, old, 0);
+    }
+    oldFrames += hostNow_us() - t0;
+    while(xQueueReceive(msgQueue, msg, 0));
+
+    t0 = hostNow_us();
+    for(int i = 0; i < batch; i++)
+      BINLOG(LOG_INFO, LOGF_RecycleTime, long(i));
+    newRecycle += hostNow_us() - t0;
+    flushRings();
+
+    t0 = hostNow_us();
+    for(int i = 0; i < batch; i++) {
+      oldRecycleTime(i, old);
+      xQueueSend(msgQueue, old, 0);
+    }
+    oldRecycle += hostNow_us() - t0;
+    while(xQueueReceive(msgQueue, msg, 0));
+  }
+  const int calls = batches * batch;
+  CHECK_EQ(0, BinLog.getDropped());
+  CHECK(newFrames * 4 < oldFrames);
+  CHECK(newRecycle < oldRecycle);
+  REPORT("frame pair: %.0fns logged, %.0fns sprintf + DebugReportFrame + queued", newFrames * 1000 / calls, oldFrames * 1000 / calls);
+  REPORT("recycle:    %.0fns logged, %.0fns sprintf + queued", newRecycle * 1000 / calls, oldRecycle * 1000 / calls);
+  vQueueDelete(msgQueue);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// rings and the log task
+
+static std::string Captured;
+static std::mutex CaptureMutex;
+
+static void
+capture(const uint8_t* buf, size_t size)
+{
+  std::lock_guard<std::mutex> lock(CaptureMutex);
+  Captured.append((const char*)buf, size);
+}
+
+struct sLogger {
+  int id;
+  int count;
+  bool attached;
+  volatile bool done;
+};
+
+static void
+loggerTask(void* arg)
+{
+  sLogger* pLogger = (sLogger*)arg;
+  pLogger->attached = BinLog.attachTask();
+  for(int i = 0; i < pLogger->count; i++) {
+    BinLog.log(LOGF_RecycleTime, pLogger->id * 100000 + long(millis() % 100000));
+    delay(2);
+  }
+  pLogger->done = true;
+  vTaskDelete(NULL);
+}
+
+TEST(full_ring_drops)
+{
+  flushRings();
+  uint32_t dropped = BinLog.getDropped();
+  for(int i = 0; i < BINLOG_RING_SIZE + 3; i++)
+    BinLog.log(LOGF_RecycleTime, long(i));
+  CHECK_EQ(BINLOG_RING_SIZE, BinLog._rings[SharedRing].getCount());
+  CHECK_EQ(dropped + 3, BinLog.getDropped());
+  flushRings();
+}
+
+// attached tasks log into their own rings, the log task merges all by time
+TEST(log_task_merges_by_time)
+{
+  hostSimTicks(false);
+  flushRings();
+  for(int i = 0; i <= BINLOG_TASK_RINGS; i++)
+    BinLog._reported[i] = BinLog._dropped[i];
+  Captured.clear();
+  hostCaptureSerial(capture);
+  BinLog.begin();
+
+  sLogger loggers[2] = { { 1, 20, false, false }, { 2, 20, false, false } };
+  xTaskCreate(loggerTask, "logger1", 4096, &loggers[0], 1, NULL);
+  delay(1);
+  xTaskCreate(loggerTask, "logger2", 4096, &loggers[1], 1, NULL);
+  for(int i = 0; i < 20; i++) {
+    BinLog.log(LOGF_RecycleTime, long(millis() % 100000));      // the shared ring
+    delay(2);
+  }
+  while(!loggers[0].done || !loggers[1].done)
+    delay(1);
+  CHECK(loggers[0].attached);
+  CHECK(loggers[1].attached);
+  // the shared ring overflows whilst the log task sleeps
+  delay(3 * BINLOG_DRAIN_INTERVAL);
+  for(int i = 0; i < BINLOG_RING_SIZE + 5; i++)
+    BinLog.log(LOGF_Text, "x");
+  delay(3 * BINLOG_DRAIN_INTERVAL);
+  hostCaptureSerial(NULL);
+
+  std::string text;
+  {
+    std::lock_guard<std::mutex> lock(CaptureMutex);
+    text = Captured;
+  }
+  // each message carries its producer and time, all must come out in time order
+  int found = 0, perProducer[3] = { 0, 0, 0 }, outOfOrder = 0;
+  long prevTime = 0;
+  size_t pos = 0;
+  long value;
+  int used;
+  while(pos < text.size() && sscanf(text.c_str() + pos, "%ldms - %n", &value, &used) == 1) {
+    long t = value % 100000;
+    perProducer[value / 100000]++;
+    // a producer may be preempted between reading the time and pushing
+    if(t + 1 < prevTime)
+      outOfOrder++;
+    prevTime = std::max(prevTime, t);
+    found++;
+    pos += used;
+  }
+  CHECK_EQ(60, found);
+  for(int count : perProducer)
+    CHECK_EQ(20, count);
+  CHECK_EQ(0, outOfOrder);
+  CHECK(text.find("*** 5 log records dropped ***") != std::string::npos);
+  REPORT("%d records from 3 rings merged in time order, %d bytes written", found, (int)text.size());
+}
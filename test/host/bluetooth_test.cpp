@@ -0,0 +1,229 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Queued Bluetooth transmit, ESP32 Classic and BLE
+//
+// BluetoothESP32.cpp is built here with both of the ESP32's own stacks
+// enabled (the firmware builds one, or the HC-05). The host stacks are in
+// support/: BLE carries 4 packets per 15ms connection event, costs 150us
+// per notify() and reports congestion above 8 queued (see BLEDevice.h).
+// JSON deltas of 80 bytes are sent in fan outs of 8, as loop() sends them
+// when the heater state changes, through the queued send() and through
+// the old send paths (oracle/BluetoothESP32_old). The time loop() spends
+// in send() is measured, and the bytes the client receives are compared
+// with those sent.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <BluetoothSerial.h>
+#include <BLEDevice.h>
+#include <string>
+#include "HostTest.h"
+#include "oracle/BluetoothESP32_old.h"
+#define USE_HC05_BLUETOOTH     0
+#define USE_BLE_BLUETOOTH      1
+#define USE_CLASSIC_BLUETOOTH  1
+#define private public
+#define protected public
+#include "Bluetooth/BluetoothESP32.cpp"
+#undef protected
+#undef private
+
+static CBluetoothESP32Classic Classic;
+static CBluetoothESP32BLE BLE;
+
+static const int MsgLen = 80;
+static const int FanOut = 8;
+
+static void
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(false);
+  if(!begun) {
+    Classic.begin();
+    BLE.begin();
+    begun = true;
+  }
+  hostBTReset();
+  hostBLEReset();
+  Classic.resetStats();
+  BLE.resetStats();
+}
+
+static std::string
+makeDelta(int seq)
+{
+  char msg[MsgLen + 1];
+  int n = snprintf(msg, sizeof(msg), "{\"seq\":%d,\"TempCurrent\":%.1f,\"Pad\":\"", seq, 18.0 + (seq % 50) / 10.0);
+  while(n < MsgLen - 2)
+    msg[n++] = 'a' + (seq + n) % 26;
+  msg[n++] = '"';
+  msg[n++] = '}';
+  return std::string(msg, MsgLen);
+}
+
+// until the TX ring has been emptied and the stack has carried everything
+static bool
+drained(CBluetoothESP32Queued& bt, int timeout_ms = 5000)
+{
+  for(int i = 0; i < timeout_ms; i++) {
+    if(xRingbufferGetCurFreeSize(bt._txRing) == BT_TX_RING_SIZE && hostBLEIdle()) {
+      delay(30);     // the last connection event
+      return true;
+    }
+    delay(1);
+  }
+  return false;
+}
+
+// fan outs of 8 deltas, <interval> ms apart, returns the time spent in send
+template<typename tSend> static double
+fanOuts(int count, int interval, std::string& sent, tSend send)
+{
+  double stall = 0;
+  int seq = 0;
+  for(int fan = 0; fan < count; fan++) {
+    double next = hostNow_us() + interval * 1000.0;
+    double t = hostNow_us();
+    for(int i = 0; i < FanOut; i++) {
+      std::string msg = makeDelta(seq++);
+      sent += msg;
+      send(msg.c_str());
+    }
+    stall += hostNow_us() - t;
+    while(hostNow_us() < next)
+      delay(1);
+  }
+  return stall;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+TEST(classic_fan_out)
+{
+  setup();
+  hostBTClient(true);
+  std::string sent, oldSent;
+  double stall = fanOuts(1, 0, sent, [](const char* msg) { CHECK(Classic.send(msg)); });
+  CHECK(drained(Classic));
+  sHostBTLink link = hostBTLink();
+  CHECK(link.received == sent);
+  int blocks = link.blocks.size(), maxBlock = 0;
+  for(int size : link.blocks)
+    maxBlock = std::max(maxBlock, size);
+  CHECK(maxBlock <= BT_TX_MAXCHUNK);
+
+  hostBTReset();
+  double oldStall = fanOuts(1, 0, oldSent, [](const char* msg) { oldClassicSend(Classic.SerialBT, msg); });
+  CHECK(hostBTLink().received == oldSent);
+  CHECK(stall < oldStall / 100);
+  REPORT("fan out of %d x %d bytes: loop() stall %.3fms (was %.1fms), %d blocks to SPP (was %d)",
+         FanOut, MsgLen, stall / 1000, oldStall / 1000, blocks, FanOut);
+  hostBTClient(false);
+  CHECK(!Classic.send("{}"));
+}
+
+TEST(ble_fan_out)
+{
+  setup();
+  hostBLEConnect(247);
+  std::string sent, oldSent;
+  double stall = fanOuts(1, 0, sent, [](const char* msg) { CHECK(BLE.send(msg)); });
+  CHECK(drained(BLE));
+  CHECK(hostBLELink().received == sent);
+
+  hostBLEReset();
+  double oldStall = fanOuts(1, 0, oldSent, [](const char* msg) { oldBLESend(BLE._pTxCharacteristic, msg); });
+  CHECK(drained(BLE));
+  CHECK(hostBLELink().received == oldSent);
+  CHECK(stall < oldStall / 100);
+  REPORT("fan out of %d x %d bytes: loop() stall %.3fms (was %.1fms)", FanOut, MsgLen, stall / 1000, oldStall / 1000);
+  hostBLEDisconnect();
+}
+
+// 160 deltas, a fan out every 100ms, which is more than the old 20 byte
+// notifications can carry
+static void
+sustained(int MTU, sHostBLELink& now, sHostBLELink& old, sBTtxStats& stats)
+{
+  setup();
+  hostBLEConnect(MTU);
+  std::string sent, oldSent;
+  fanOuts(20, 100, sent, [](const char* msg) { CHECK(BLE.send(msg)); });
+  CHECK(drained(BLE));
+  now = hostBLELink();
+  stats = BLE.getStats();
+  CHECK(now.received == sent);
+  CHECK_EQ(0, now.lost);
+  CHECK_EQ(0, stats.overflows);
+
+  hostBLEReset();
+  fanOuts(20, 100, oldSent, [](const char* msg) { oldBLESend(BLE._pTxCharacteristic, msg); });
+  CHECK(drained(BLE));
+  old = hostBLELink();
+  hostBLEDisconnect();
+}
+
+TEST(ble_large_mtu)
+{
+  sHostBLELink now, old;
+  sBTtxStats stats;
+  sustained(247, now, old, stats);
+  CHECK_EQ(160 * MsgLen / 20, old.notifies);
+  CHECK(now.notifies * 4 < old.notifies);
+  REPORT("MTU 247: %d notifications (was %d), largest %d bytes, %d congestion waits", now.notifies, old.notifies, stats.maxChunk, stats.congested);
+  REPORT("lost in the stack %d (was %d), most queued %d (was %d)", now.lost, old.lost, now.maxQueued, old.maxQueued);
+}
+
+TEST(ble_default_mtu_paced)
+{
+  sHostBLELink now, old;
+  sBTtxStats stats;
+  sustained(ESP_GATT_DEF_BLE_MTU_SIZE, now, old, stats);
+  // the block waiting since the last test was sized for MTU 247, it is
+  // split to fit, which can leave one short notification
+  CHECK(now.notifies >= old.notifies && now.notifies <= old.notifies + 1);
+  CHECK(stats.congested > 0);
+  REPORT("MTU 23: %d notifications (was %d), %d congestion waits", now.notifies, old.notifies, stats.congested);
+  REPORT("lost in the stack %d (was %d), most queued %d (was %d)", now.lost, old.lost, now.maxQueued, old.maxQueued);
+}
+
+TEST(ble_disconnect_discards)
+{
+  setup();
+  hostBLEConnect(ESP_GATT_DEF_BLE_MTU_SIZE);
+  std::string sent;
+  fanOuts(3, 0, sent, [](const char* msg) { CHECK(BLE.send(msg)); });
+  delay(30);
+  hostBLEDisconnect();
+  CHECK(!BLE.send("{}"));
+  CHECK(drained(BLE, 1000));
+  const sBTtxStats& stats = BLE.getStats();
+  CHECK(stats.discarded > 0);
+  CHECK(stats.discarded < stats.bytes);
+  REPORT("%d of %d bytes discarded when the client went", stats.discarded, stats.bytes);
+}
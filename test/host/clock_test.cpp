@@ -0,0 +1,175 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CClock software clock, disciplined by a simulated DS3231
+//
+// millis() is wrapped onto the simulated FreeRTOS tick, so days pass in
+// moments, and the 2^32 ms tick wrap can be crossed at will. The fake RTC
+// runs fast or slow of the tick by a given ppm.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <stdlib.h>
+#include "HostTest.h"
+#include "DS3231_fake.h"
+#define private public
+#include "RTC/Clock.h"
+#undef private
+#include "Utility/NVStorage.h"
+
+static CFakeDS3231 FakeRTC;
+static int MinuteCalls;
+static int MinuteErrors;
+static uint32_t LastMinute;
+
+static void
+countMinute(const BTCDateTime& now)
+{
+  uint32_t minute = now.unixtime() / 60;
+  // each minute once, in order (a pull forward may skip its second 0)
+  if(MinuteCalls && minute != LastMinute + 1)
+    MinuteErrors++;
+  LastMinute = minute;
+  MinuteCalls++;
+}
+
+static const uint32_t Start = 1578220200;     // Sun 5 Jan 2020 10:30:00
+static const uint32_t Hour = 3600000;
+
+// ticks and the RTC are set, then the clock seeded from the RTC
+static void
+setup(TickType_t ticks, double ppm)
+{
+  static bool begun = false;
+  hostSimTicks(true);
+  if(!begun) {
+    FakeRTC.attach(Wire);
+    NVstore.init();
+    begun = true;
+  }
+  hostSetTicks(ticks);
+  FakeRTC.set(Start);
+  FakeRTC.setSkew(ppm);
+  Clock.begin();
+  Clock.addMinuteCallback(countMinute);
+  MinuteCalls = 0;
+  MinuteErrors = 0;
+}
+
+// step the tick, updating the clock each second as loop() does, returns the worst error against the RTC
+static int
+run(uint32_t duration, uint32_t step = 1000)
+{
+  int worst = 0;
+  for(uint32_t t = 0; t < duration; t += step) {
+    hostAdvanceTicks(step);
+    const BTCDateTime& now = Clock.update();
+    int error = int(now.unixtime() - FakeRTC.unixtime());
+    if(abs(error) > abs(worst))
+      worst = error;
+  }
+  return worst;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// 48 hours, starting 3 hours before the tick wraps
+TEST(tracks_rtc_across_tick_wrap)
+{
+  const double skews[] = { 0, 50, -120 };
+  for(double ppm : skews) {
+    setup(TickType_t(0) - 3 * Hour, ppm);
+    uint32_t readsBefore = FakeRTC.timeReads();
+    int worst = run(48 * Hour);
+    uint32_t reads = FakeRTC.timeReads() - readsBefore;
+    CHECK(abs(worst) <= 1);                              // the RTC only resolves seconds
+    CHECK_EQ(Clock.get().unixtime() / 60 - Start / 60, MinuteCalls);
+    CHECK_EQ(0, MinuteErrors);
+    // one RTC second over the measurement span
+    int resolution = int(1e9 / Clock._refElapsed) + 1;
+    CHECK(abs(Clock.getDrift() - ppm) <= resolution);
+    CHECK_EQ(48 * Hour / RTC_RESYNC_INTERVAL, reads);    // get() and update() read nothing
+    REPORT("RTC %+4.0f ppm: worst error %ds, drift estimate %+d ppm (resolution %d), %d minute callbacks, %u RTC reads", 
+           ppm, worst, Clock.getDrift(), resolution, MinuteCalls, reads);
+  }
+}
+
+// until RTC_DRIFT_MIN_SPAN the RTC's 1s resolution swamps a crystal's error, no estimate is made
+TEST(drift_needs_min_span)
+{
+  setup(0, 200);
+  run(RTC_DRIFT_MIN_SPAN - RTC_RESYNC_INTERVAL, 10000);
+  CHECK_EQ(0, Clock.getDrift());
+  run(2 * RTC_RESYNC_INTERVAL, 10000);
+  CHECK(abs(Clock.getDrift() - 200) <= int(1e9 / Clock._refElapsed) + 1);
+}
+
+// estimates beyond RTC_DRIFT_LIMIT are not believed
+TEST(drift_limit)
+{
+  setup(0, RTC_DRIFT_LIMIT * 3);
+  run(RTC_DRIFT_MIN_SPAN + 2 * RTC_RESYNC_INTERVAL, 10000);
+  CHECK_EQ(0, Clock.getDrift());
+}
+
+// a small step of the RTC is pulled in, one beyond 5s re-seeds the clock
+TEST(rtc_step_resync)
+{
+  setup(0, 0);
+  run(Hour);
+  CHECK(Clock._refElapsed > 0);
+
+  uint32_t now = FakeRTC.unixtime();
+  FakeRTC.set(now + 3);
+  run(RTC_RESYNC_INTERVAL);
+  CHECK(abs(int(Clock.get().unixtime() - FakeRTC.unixtime())) <= 1);
+  CHECK(Clock._refElapsed >= Hour);                  // the drift measurement carries on
+
+  now = FakeRTC.unixtime();
+  FakeRTC.set(now + 3600);
+  run(RTC_RESYNC_INTERVAL);
+  CHECK(abs(int(Clock.get().unixtime() - FakeRTC.unixtime())) <= 1);
+  CHECK(Clock._refElapsed < RTC_RESYNC_INTERVAL);    // re-seeded, the drift measurement restarts
+
+  now = FakeRTC.unixtime();
+  FakeRTC.set(now - 600);                            // backwards too
+  run(RTC_RESYNC_INTERVAL);
+  CHECK(abs(int(Clock.get().unixtime() - FakeRTC.unixtime())) <= 1);
+}
+
+// set() writes the RTC and takes effect at once, without waiting for a resync
+TEST(set_takes_effect)
+{
+  setup(0, 0);
+  run(60000);
+  Clock.set(DateTime(2021, 6, 1, 12, 0, 0));
+  CHECK_EQ(DateTime(2021, 6, 1, 12, 0, 0).unixtime(), Clock.get().unixtime());
+  CHECK_EQ(DateTime(2021, 6, 1, 12, 0, 0).unixtime(), FakeRTC.unixtime());
+  int calls = MinuteCalls;
+  run(60000);
+  CHECK_EQ(calls + 1, MinuteCalls);
+}
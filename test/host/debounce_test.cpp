@@ -0,0 +1,281 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Interrupt driven input debounce
+//
+// Pin changes run CDebounce's edge ISR, as the GPIO interrupts do on the
+// target, which timestamps them into its TEventRing; manage() is called 
+// by a synthetic loop() whose period is random up to 50, 100 or 200ms.
+// Presses bounce for up to 8ms on both edges and are held 60-400ms.
+// The press to debounced state latency ("callback", the keypad and GPIO
+// inputs act on the state manage() returns) is reported for CDebounce 
+// and the polled debouncer it replaced (oracle/Debounce_old), along with
+// presses that were never seen. Clean, bouncy and glitch edges, and a
+// ring overflowed by bounce, are checked against the debounce delay.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "HostTest.h"
+#include "Utility/Debounce.h"
+#include "Utility/EventRing.h"
+#include "oracle/Debounce_old.h"
+
+static const int PinA = 12;
+static const int PinB = 13;
+static const int DebounceDelay = 50;    // ms, CDebounce's
+
+static std::mt19937 Rand(39);
+
+static void
+setPin(int pin, bool pressed)
+{
+  hostSetPin(pin, pressed ? LOW : HIGH);
+}
+
+// manage() every ms for ms, returns the debounced state after each
+static std::vector<uint8_t>
+run(CDebounce& debounce, int ms)
+{
+  std::vector<uint8_t> states;
+  for(int i = 0; i < ms; i++) {
+    hostAdvanceTicks(1);
+    states.push_back(debounce.manage());
+  }
+  return states;
+}
+
+// ms at which the state first became want, -1 if never
+static int
+firstAt(const std::vector<uint8_t>& states, uint8_t want)
+{
+  for(size_t i = 0; i < states.size(); i++) {
+    if(states[i] == want)
+      return i + 1;
+  }
+  return -1;
+}
+
+static int
+changes(const std::vector<uint8_t>& states, uint8_t initial)
+{
+  int count = 0;
+  for(uint8_t state : states) {
+    count += state != initial;
+    initial = state;
+  }
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+TEST(ring_fifo_and_full)
+{
+  TEventRing<int, 8> ring;
+  int val;
+  CHECK(ring.isEmpty());
+  CHECK(!ring.pop(val));
+  // wrap the indices several times round
+  for(int round = 0; round < 5; round++) {
+    for(int i = 0; i < 8; i++)
+      CHECK(ring.push(round * 10 + i));
+    CHECK(!ring.push(99));                  // full, the entry is refused
+    CHECK_EQ(8, ring.getCount());
+    CHECK(ring.peek(val));
+    CHECK_EQ(round * 10, val);
+    for(int i = 0; i < 8; i++) {
+      CHECK(ring.pop(val));
+      CHECK_EQ(round * 10 + i, val);
+    }
+    CHECK(ring.isEmpty());
+  }
+  ring.push(1);
+  ring.push(2);
+  ring.flush();
+  CHECK(ring.isEmpty());
+  CHECK(!ring.pop(val));
+}
+
+// taken DebounceDelay after the edge, released likewise, both pins independent
+TEST(clean_edges)
+{
+  hostSimTicks(true);
+  CDebounce debounce;
+  debounce.addPin(PinA);
+  debounce.addPin(PinB);
+  debounce.addPin(PinA);                    // GPIO setup re-applied, not a third pin
+  run(debounce, 100);
+  CHECK_EQ(0, debounce.getState());
+
+  setPin(PinA, true);
+  std::vector<uint8_t> states = run(debounce, 100);
+  CHECK_EQ(DebounceDelay + 1, firstAt(states, 0x01));
+  CHECK_EQ(1, changes(states, 0x00));
+  setPin(PinB, true);
+  states = run(debounce, 100);
+  CHECK_EQ(DebounceDelay + 1, firstAt(states, 0x03));
+  setPin(PinA, false);
+  setPin(PinB, false);
+  states = run(debounce, 100);
+  CHECK_EQ(DebounceDelay + 1, firstAt(states, 0x00));
+  CHECK_EQ(1, changes(states, 0x03));
+}
+
+// bounce delays the state until it has settled, a glitch is never seen
+TEST(bounce_and_glitch)
+{
+  hostSimTicks(true);
+  CDebounce debounce;
+  debounce.addPin(PinA);
+  run(debounce, 100);
+  // 8ms of bounce, 1ms per level
+  for(int i = 0; i < 8; i++) {
+    setPin(PinA, (i & 1) == 0);
+    run(debounce, 1);
+  }
+  setPin(PinA, true);
+  std::vector<uint8_t> states = run(debounce, 100);
+  CHECK_EQ(DebounceDelay + 1, firstAt(states, 0x01));
+  CHECK_EQ(1, changes(states, 0x00));
+  // a 10ms spike to released
+  setPin(PinA, false);
+  run(debounce, 10);
+  setPin(PinA, true);
+  states = run(debounce, 200);
+  CHECK_EQ(0, changes(states, 0x01));
+  setPin(PinA, false);
+  run(debounce, 100);
+}
+
+// more edges than the ring holds between manage() calls, the pins are resampled
+TEST(ring_overflow_resyncs)
+{
+  hostSimTicks(true);
+  CDebounce debounce;
+  debounce.addPin(PinA);
+  run(debounce, 100);
+  for(int i = 0; i < 41; i++)
+    setPin(PinA, (i & 1) == 0);             // ends pressed, loop() stalled meanwhile
+  std::vector<uint8_t> states = run(debounce, 100);
+  CHECK_EQ(1 + DebounceDelay + 1, firstAt(states, 0x01));   // from the resync by the first manage()
+  setPin(PinA, false);
+  states = run(debounce, 100);
+  CHECK_EQ(DebounceDelay + 1, firstAt(states, 0x00));
+}
+
+static void
+bounce(int pin, bool pressed, std::vector<std::pair<int, bool>>& edges, int at)
+{
+  std::uniform_int_distribution<int> bounceTime(0, 8);
+  int end = at + bounceTime(Rand);
+  bool level = pressed;
+  for(int t = at; t < end; t++) {
+    edges.push_back({ t, level });
+    level = !level;
+  }
+  edges.push_back({ end, pressed });
+}
+
+static double
+percentile(std::vector<int>& values, int pc)
+{
+  if(values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * pc / 100)];
+}
+
+// press to debounced state, under random loop() periods
+TEST(latency_under_loop_load)
+{
+  hostSimTicks(true);
+  const int maxPeriods[] = { 50, 100, 200 };
+  const int Presses = 500;
+  for(int maxPeriod : maxPeriods) {
+    CDebounce debounce;
+    COldDebounce polled;
+    debounce.addPin(PinA);
+    polled.addPin(PinA);
+    setPin(PinA, false);
+
+    // the presses and their bounce, on a 1ms time line
+    std::vector<std::pair<int, bool>> edges;
+    std::vector<int> pressTimes;
+    std::uniform_int_distribution<int> hold(60, 400), gap(100, 600);
+    int t = 1000;
+    for(int i = 0; i < Presses; i++) {
+      pressTimes.push_back(t);
+      bounce(PinA, true, edges, t);
+      t += hold(Rand);
+      bounce(PinA, false, edges, t);
+      t += gap(Rand);
+    }
+    int end = t + 1000;
+
+    // each press is the next rise of CDebounce's state, edges left in its ring are a backlog
+    std::uniform_int_distribution<int> period(1, maxPeriod);
+    std::vector<int> newLatency, oldLatency;
+    uint8_t newPrev = 0, oldPrev = 0;
+    int oldSeen = -1;
+    size_t next = 0;
+    int nextLoop = 0;
+    unsigned long tBase = millis();
+    for(int now = 0; now < end; now++) {
+      while(next < edges.size() && edges[next].first == now) {
+        setPin(PinA, edges[next].second);
+        next++;
+      }
+      if(now == nextLoop) {
+        uint8_t state = debounce.manage() & 0x01;
+        if(state && !newPrev && newLatency.size() < pressTimes.size())
+          newLatency.push_back(now - pressTimes[newLatency.size()]);
+        newPrev = state;
+        // the polled debouncer has no backlog, its rise is the latest press
+        state = polled.manage() & 0x01;
+        int latest = std::upper_bound(pressTimes.begin(), pressTimes.end(), now) - pressTimes.begin() - 1;
+        if(state && !oldPrev && latest > oldSeen) {
+          oldLatency.push_back(now - pressTimes[latest]);
+          oldSeen = latest;
+        }
+        oldPrev = state;
+        nextLoop = now + period(Rand);
+      }
+      hostSetTicks(tBase + now + 1);
+    }
+    int newMissed = Presses - newLatency.size();
+    int oldMissed = Presses - oldLatency.size();
+
+    CHECK_EQ(0, newMissed);
+    CHECK(percentile(newLatency, 50) <= percentile(oldLatency, 50));
+    REPORT("loop 1-%3dms: interrupt p50 %3.0fms p95 %3.0fms max %3.0fms, %3d missed", maxPeriod,
+           percentile(newLatency, 50), percentile(newLatency, 95), percentile(newLatency, 100), newMissed);
+    REPORT("              polled    p50 %3.0fms p95 %3.0fms max %3.0fms, %3d missed",
+           percentile(oldLatency, 50), percentile(oldLatency, 95), percentile(oldLatency, 100), oldMissed);
+  }
+}
@@ -0,0 +1,186 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <Arduino.h>
+#include "Fakes.h"
+#include "Utility/NVStorage.h"
+#include "Utility/DebugPort.h"
+#include "Utility/DemandManager.h"
+#include "Utility/BTC_GPIO.h"
+#include "RTC/RTCStore.h"
+#include "Protocol/Protocol.h"
+#include "Utility/helpers.h"
+#include "Utility/Moderator.h"
+#include "Utility/DataFilter.h"
+#include "Utility/FuelGauge.h"
+#include "Utility/HourMeter.h"
+#include "Utility/TempSense.h"
+#include "Utility/BoardDetect.h"
+#include "Protocol/SmartError.h"
+#include "Protocol/TxManage.h"
+#include "Bluetooth/BluetoothAbstract.h"
+
+ABTelnetSpy DebugPort;
+CESP32HeaterStorage actualNVstore;
+CHeaterStorage& NVstore = actualNVstore;
+CRTC_Store RTC_Store;
+CGPIOin GPIOin;
+CProtocolPackage BlueWireData;
+CGPIOout GPIOout;
+CGPIOalg GPIOalg;
+bool pair433MHz = false;
+sFilteredData FilteredSamples;
+CSmartError SmartError;
+CTxManage TxManage(-1, Serial1);
+CFuelGauge FuelGauge; 
+CTempSense TempSensor;
+static float runTime = 0;
+static float glowTime = 0;
+static CHourMeter HourMeter(runTime, glowTime);
+CHourMeter* pHourMeter = &HourMeter;
+static CBluetoothAbstract Bluetooth;    // no module fitted
+
+sFakeHeater FakeHeater;
+sFakeSystem FakeSystem;
+
+void 
+sFakeHeater::reset()
+{
+  onRequests = 0;
+  offRequests = 0;
+  runState = 0;
+  temperature = 20;
+  batteryVoltage = 12.6;
+  primeRequests = 0;
+}
+
+void 
+sFakeSystem::reset()
+{
+  boardRevision = BRD_V2_FULLGPIO;
+  uptime = 3600;
+  updateAvailable = 0;
+  OEMLCDcontroller = false;
+}
+
+// a canned exchange with a heater running at part load, the run state and
+// supply voltage follow FakeHeater
+const CProtocolPackage& getHeaterInfo()
+{
+  CProtocol heater, controller;
+  controller.setHeaterDemand(22);
+  controller.setTemperature_Actual(19);
+  controller.setTemperature_Min(8);
+  controller.setTemperature_Max(35);
+  controller.setPump_Min(1.4);
+  controller.setPump_Max(4.3);
+  controller.setFan_Min(1450);
+  controller.setFan_Max(4500);
+  controller.setSystemVoltage(12);
+  controller.setAltitude(3500, true);
+  heater.setRunState(FakeHeater.runState);
+  heater.setVoltage_Supply(FakeHeater.batteryVoltage);
+  heater.setFan_Actual(2800);
+  heater.setFan_Voltage(9.8);
+  heater.setTemperature_HeatExchg(105);
+  heater.setPump_Actual(3.2);
+  heater.setPump_Fixed(3.2);
+  heater.setGlowPlug_Current(0);
+  heater.setGlowPlug_Voltage(0);
+  BlueWireData.set(heater, controller);
+  return BlueWireData;
+}
+
+CDemandManager::eStartCode requestOn()
+{
+  FakeHeater.onRequests++;
+  return CDemandManager::eStartOK;
+}
+
+void requestOff()
+{
+  FakeHeater.offRequests++;
+}
+
+float getTemperatureSensor(int source)
+{
+  return FakeHeater.temperature;
+}
+
+int getBlueWireStat() { return 0; }
+const char* getBlueWireStatStr() { return "OK"; }
+int getFanSpeed() { return 2800; }
+float getGlowVolts() { return 0; }
+float getGlowCurrent() { return 0; }
+void getGPIOinfo(sGPIO& info) {}
+int getSmartError() { return 0; }
+bool isCyclicStopStartActive() { return false; }
+bool hasOEMcontroller() { return false; }
+void reqHeaterCalUpdate() {}
+void requestMQTTrestart() {}
+void resetFuelGauge() {}
+bool hasOEMLCDcontroller() { return FakeSystem.OEMLCDcontroller; }
+float getBatteryVoltage(bool fast) { return FakeHeater.batteryVoltage; }
+int sysUptime() { return FakeSystem.uptime; }
+int getBoardRevision() { return FakeSystem.boardRevision; }
+void BoardRevisionReset() {}
+const char* getVersionStr(bool beta) { return beta ? "" : "V0.0.0"; }
+const char* getVersionDate() { return "1 Jan 2020"; }
+int isUpdateAvailable(bool test) { return FakeSystem.updateAvailable; }
+void checkFOTA() {}
+void setupGPIO() {}
+bool getGPIOout(int channel) { return GPIOout.getState(channel); }
+bool toggleGPIOout(int channel) { return false; }
+CTempSense& getTempSensor() { return TempSensor; }
+CBluetoothAbstract& getBluetoothClient() { return Bluetooth; }
+
+void reqPumpPrime(bool on)
+{
+  if(on)
+    FakeHeater.primeRequests++;
+}
+
+// BTC_JSON.cpp is only built by temp_test, the definitions here that it
+// also makes are weak
+
+// JSON commands from a client are not interpreted on the host, a test may
+// watch them arrive
+void (*FakeJsonCommand)(const char* pLine) = NULL;
+
+__attribute__((weak)) void interpretJsonCommand(char* pLine) 
+{
+  if(FakeJsonCommand)
+    FakeJsonCommand(pLine);
+}
+
+// BTC_JSON.cpp's timer moderator
+
+__attribute__((weak)) CTimerModerator TimerModerator;
+
+__attribute__((weak)) void resetJSONTimerModerator(int timerID)
+{
+  if(timerID)
+    TimerModerator.reset(timerID-1);
+  else 
+    TimerModerator.reset();
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "BME280_fake.h"
+
+static void 
+put16(uint8_t* p, int16_t val)
+{
+  p[0] = val & 0xff;
+  p[1] = (val >> 8) & 0xff;
+}
+
+CFakeBME280::CFakeBME280()
+{
+  memset(_regs, 0, sizeof(_regs));
+  _ptr = 0;
+  _measurements = 0;
+  _regs[0xd0] = 0x60;             // chip ID
+  // temperature and pressure trimming, datasheet worked example
+  const int16_t TP[12] = { (int16_t)27504, 26435, -1000, (int16_t)36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000 };
+  for(int i = 0; i < 12; i++) 
+    put16(&_regs[0x88 + i*2], TP[i]);
+  // humidity trimming: H1 75, H2 362, H3 0, H4 324, H5 50, H6 30
+  _regs[0xa1] = 75;
+  put16(&_regs[0xe1], 362);
+  _regs[0xe3] = 0;
+  _regs[0xe4] = 324 >> 4;
+  _regs[0xe5] = (324 & 0x0f) | ((50 & 0x0f) << 4);
+  _regs[0xe6] = 50 >> 4;
+  _regs[0xe7] = 30;
+  setRaw(519888, 415148, 27000);
+}
+
+void
+CFakeBME280::attach(TwoWire& bus, uint8_t address)
+{
+  bus.hostAttach(address, this);
+}
+
+void
+CFakeBME280::detach(TwoWire& bus, uint8_t address)
+{
+  bus.hostAttach(address, NULL);
+}
+
+void
+CFakeBME280::setRaw(uint32_t adcT, uint32_t adcP, uint16_t adcH)
+{
+  _regs[0xf7] = adcP >> 12;
+  _regs[0xf8] = adcP >> 4;
+  _regs[0xf9] = adcP << 4;
+  _regs[0xfa] = adcT >> 12;
+  _regs[0xfb] = adcT >> 4;
+  _regs[0xfc] = adcT << 4;
+  _regs[0xfd] = adcH >> 8;
+  _regs[0xfe] = adcH;
+}
+
+// register address, then data to successive registers
+void 
+CFakeBME280::onWrite(const uint8_t* data, size_t len)
+{
+  if(len == 0)
+    return;
+  _ptr = data[0];
+  for(size_t i = 1; i < len; i++) {
+    uint8_t reg = _ptr++;
+    if(reg == 0xe0 || reg == 0xd0)
+      continue;                   // soft reset, chip ID
+    _regs[reg] = data[i];
+    if(reg == 0xf4 && (data[i] & 0x03) == 0x01) 
+      _measurements++;            // forced measurement, complete at once
+  }
+}
+
+void 
+CFakeBME280::onRead(uint8_t* data, size_t len)
+{
+  for(size_t i = 0; i < len; i++)
+    data[i] = _regs[_ptr++];
+}
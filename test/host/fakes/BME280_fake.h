@@ -0,0 +1,57 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CFakeBME280
+//
+// A BME280 on the host Wire bus: chip ID, the trimming parameters of the 
+// datasheet's worked example (section 8.1) and fixed raw readings, which
+// the driver compensates to 25.08C and 1006.5hPa. The humidity trimming 
+// is a typical part's.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __FAKE_BME280_H__
+#define __FAKE_BME280_H__
+
+#include <Wire.h>
+
+class CFakeBME280 : public CHostI2CDevice {
+  uint8_t _regs[256];
+  uint8_t _ptr;
+  uint32_t _measurements;
+public:
+  CFakeBME280();
+  void attach(TwoWire& bus, uint8_t address = 0x76);
+  void detach(TwoWire& bus, uint8_t address = 0x76);
+  // 20 bit temperature and pressure, 16 bit humidity ADC readings
+  void setRaw(uint32_t adcT, uint32_t adcP, uint16_t adcH);
+  uint32_t measurements() const { return _measurements; };
+  // CHostI2CDevice
+  void onWrite(const uint8_t* data, size_t len);
+  void onRead(uint8_t* data, size_t len);
+};
+
+#endif
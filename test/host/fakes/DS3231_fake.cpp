@@ -0,0 +1,120 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <Arduino.h>
+#include <math.h>
+#include "DS3231_fake.h"
+#include "../../../lib/RTClib/RTClib.h"
+
+static uint8_t bin2bcd(int val) { return val + 6 * (val / 10); }
+static int bcd2bin(uint8_t val) { return val - 6 * (val >> 4); }
+
+CFakeDS3231::CFakeDS3231()
+{
+  memset(_regs, 0, sizeof(_regs));
+  _ptr = 0;
+  _ppm = 0;
+  _reads = 0;
+  set(DateTime(2020, 1, 1).unixtime());
+}
+
+void
+CFakeDS3231::attach(TwoWire& bus)
+{
+  bus.hostAttach(DS3231_ADDRESS, this);
+}
+
+void
+CFakeDS3231::_advance()
+{
+  uint32_t tick = xTaskGetTickCount();
+  uint32_t elapsed = tick - _tick;   // unsigned, survives the tick wrap
+  _ms += elapsed * (1.0 + _ppm * 1e-6);
+  _tick = tick;
+}
+
+void
+CFakeDS3231::set(uint32_t unixTime, int ms)
+{
+  _tick = xTaskGetTickCount();
+  _ms = double(unixTime) * 1000 + ms;
+}
+
+uint32_t
+CFakeDS3231::unixtime()
+{
+  _advance();
+  return uint32_t(floor(_ms / 1000));
+}
+
+void
+CFakeDS3231::_toRegs()
+{
+  DateTime now(unixtime());
+  _regs[0] = bin2bcd(now.second());
+  _regs[1] = bin2bcd(now.minute());
+  _regs[2] = bin2bcd(now.hour());
+  _regs[3] = now.dayOfTheWeek() + 1;
+  _regs[4] = bin2bcd(now.day());
+  _regs[5] = bin2bcd(now.month());
+  _regs[6] = bin2bcd(now.year() - 2000);
+}
+
+// writing the seconds register restarts the chip's one second countdown
+void
+CFakeDS3231::_fromRegs()
+{
+  DateTime now(2000 + bcd2bin(_regs[6]), bcd2bin(_regs[5]), bcd2bin(_regs[4]),
+               bcd2bin(_regs[2] & 0x3f), bcd2bin(_regs[1]), bcd2bin(_regs[0] & 0x7f));
+  set(now.unixtime());
+}
+
+void
+CFakeDS3231::onWrite(const uint8_t* data, size_t len)
+{
+  if(len == 0)
+    return;
+  _ptr = data[0];
+  if(len == 1)
+    return;      // register pointer only
+  _toRegs();
+  bool timeWritten = false;
+  for(size_t i = 1; i < len; i++) {
+    uint8_t reg = _ptr++ % sizeof(_regs);
+    _regs[reg] = data[i];
+    if(reg < 7)
+      timeWritten = true;
+  }
+  if(timeWritten)
+    _fromRegs();
+}
+
+void
+CFakeDS3231::onRead(uint8_t* data, size_t len)
+{
+  if(_ptr == 0)
+    _reads++;
+  _toRegs();
+  for(size_t i = 0; i < len; i++)
+    data[i] = _regs[_ptr++ % sizeof(_regs)];
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CFakeDS3231
+//
+// A DS3231 on the host Wire bus. Time keeps running with the FreeRTOS tick,
+// optionally fast or slow by a given ppm, so a software clock can be 
+// disciplined against it. The time registers are BCD as on the chip, the 
+// alarm, control and status registers are plain RAM (the alarm bytes hold 
+// the RTC store).
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __FAKE_DS3231_H__
+#define __FAKE_DS3231_H__
+
+#include <Wire.h>
+
+class CFakeDS3231 : public CHostI2CDevice {
+  uint8_t _regs[19];
+  uint8_t _ptr;
+  double _ms;               // unix time in ms, as kept by the chip
+  uint32_t _tick;           // tick when _ms applied
+  double _ppm;
+  uint32_t _reads;
+  void _advance();
+  void _toRegs();
+  void _fromRegs();
+public:
+  CFakeDS3231();
+  void attach(TwoWire& bus);
+  void set(uint32_t unixTime, int ms = 0);
+  uint32_t unixtime();
+  void setSkew(double ppm) { _advance(); _ppm = ppm; };
+  void setLostPower() { _regs[0x0f] |= 0x80; };
+  uint32_t timeReads() const { return _reads; };
+  // CHostI2CDevice
+  void onWrite(const uint8_t* data, size_t len);
+  void onRead(uint8_t* data, size_t len);
+};
+
+#endif
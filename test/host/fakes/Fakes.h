@@ -0,0 +1,80 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host stand ins for what Afterburner.cpp provides the modules under test:
+// the debug port, NV storage, RTC store and GPIO globals, the blue wire
+// data and the heater request helpers.
+// Heater requests are counted rather than acted upon.
+// Network_fake.cpp stands in for the WiFi, MQTT and web server status the
+// screens show, set through FakeNetwork.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_FAKES_H__
+#define __HOST_FAKES_H__
+
+#include <stdint.h>
+
+struct sFakeHeater {
+  int onRequests;
+  int offRequests;
+  int runState;             // getHeaterInfo().getRunStateEx() 
+  float temperature;        // getTemperatureSensor()
+  float batteryVoltage;     // getBatteryVoltage()
+  int primeRequests;        // reqPumpPrime(true)
+  void reset();
+};
+
+struct sFakeSystem {
+  int boardRevision;        // getBoardRevision()
+  int uptime;               // sysUptime(), seconds
+  int updateAvailable;      // isUpdateAvailable()
+  bool OEMLCDcontroller;    // hasOEMLCDcontroller()
+  void reset();
+};
+
+struct sFakeNetwork {
+  bool STA;                 // isWifiSTA()
+  bool STAconnected;        // isWifiSTAConnected()
+  bool APonly;              // isWifiAPonly()
+  bool configPortal;        // isWifiConfigPortal()
+  int8_t RSSI;              // getWifiRSSI()
+  bool MQTTconnected;       // isMQTTconnected()
+  bool webClientSpoken;     // hasWebClientSpoken()
+  bool webServerSpoken;     // hasWebServerSpoken()
+  int portalRequests;       // wifiEnterConfigPortal()
+  void reset();
+};
+
+extern sFakeHeater FakeHeater;
+extern sFakeSystem FakeSystem;
+extern sFakeNetwork FakeNetwork;
+
+extern void (*FakeJsonCommand)(const char* pLine);   // interpretJsonCommand() calls it, if set
+
+class CTimerModerator;
+extern CTimerModerator TimerModerator;   // as BTC_JSON.cpp
+
+#endif
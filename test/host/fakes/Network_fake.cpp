@@ -0,0 +1,94 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+#include <Arduino.h>
+#include "Fakes.h"
+#include "WiFi/BTCWifi.h"
+#include "WiFi/ABMQTT.h"
+#include "WiFi/BTCWebServer.h"
+
+sFakeNetwork FakeNetwork;
+
+void
+sFakeNetwork::reset()
+{
+  STA = true;
+  STAconnected = true;
+  APonly = false;
+  configPortal = false;
+  RSSI = -58;
+  MQTTconnected = false;
+  webClientSpoken = false;
+  webServerSpoken = false;
+  portalRequests = 0;
+}
+
+// BTCWifi.cpp
+
+const char* getWifiAPAddrStr() { return "192.168.4.1"; }
+const char* getWifiSTAAddrStr() { return FakeNetwork.STAconnected ? "192.168.1.50" : "0.0.0.0"; }
+const char* getWifiGatewayAddrStr() { return FakeNetwork.STAconnected ? "192.168.1.1" : "0.0.0.0"; }
+const char* getWifiAPMACStr() { return "24:0A:C4:00:00:01"; }
+const char* getWifiSTAMACStr() { return "24:0A:C4:00:00:00"; }
+int8_t getWifiRSSI() { return FakeNetwork.STAconnected ? FakeNetwork.RSSI : 0; }
+bool isWifiSTAConnected() { return FakeNetwork.STAconnected; }
+bool isWifiAPonly() { return FakeNetwork.APonly; }
+bool isWifiSTA() { return FakeNetwork.STA; }
+bool isWifiConfigPortal() { return FakeNetwork.configPortal; }
+int isWifiButton() { return 0; }
+void wifiDisable(long rebootDelay) {}
+void wifiFactoryDefault() {}
+String getSTASSID() { return FakeNetwork.STAconnected ? "HomeNet" : ""; }
+
+void wifiEnterConfigPortal(bool state, bool erase, long timeout, bool STAonly)
+{
+  FakeNetwork.portalRequests++;
+}
+
+bool hasWebClientSpoken(bool reset)
+{
+  bool retval = FakeNetwork.webClientSpoken;
+  if(reset)
+    FakeNetwork.webClientSpoken = false;
+  return retval;
+}
+
+bool hasWebServerSpoken(bool reset)
+{
+  bool retval = FakeNetwork.webServerSpoken;
+  if(reset)
+    FakeNetwork.webServerSpoken = false;
+  return retval;
+}
+
+// ABMQTT.cpp
+
+bool isMQTTconnected() { return FakeNetwork.MQTTconnected; }
+const char* getTopicPrefix() { return "Afterburner000001"; }
+bool mqttPublishJSON(const char* str) { return FakeNetwork.MQTTconnected; }
+
+// BTCWebServer.cpp
+
+const char* getWebContent(bool start) { return ""; }   // no transfer in progress
+bool isWebServerRunning() { return true; }
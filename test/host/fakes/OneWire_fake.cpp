@@ -0,0 +1,176 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "OneWire_fake.h"
+#include "../../../lib/esp32-ds18b20/owb_rmt.h"
+#include "../../../lib/esp32-ds18b20/ds18b20.h"
+
+CFakeOneWire FakeOneWire;
+
+CFakeOneWire::CFakeOneWire()
+{
+  memset(&bus, 0, sizeof(bus));
+  clear();
+}
+
+void
+CFakeOneWire::clear()
+{
+  memset(probes, 0, sizeof(probes));
+  count = 0;
+  searches = 0;
+  conversions = 0;
+}
+
+int
+CFakeOneWire::addProbe(uint8_t serial, float temperature)
+{
+  if(count == maxProbes)
+    return -1;
+  sProbe& probe = probes[count];
+  probe.romCode.fields.family[0] = 0x28;
+  probe.romCode.fields.serial_number[0] = serial;
+  probe.romCode.fields.serial_number[5] = 0x01;
+  probe.romCode.fields.crc[0] = serial ^ 0x5a;
+  probe.temperature = temperature;
+  probe.present = true;
+  return count++;
+}
+
+const CFakeOneWire::sProbe* 
+CFakeOneWire::find(const OneWireBus_ROMCode& romCode) const
+{
+  for(int i = 0; i < count; i++) {
+    if(probes[i].present && memcmp(probes[i].romCode.bytes, romCode.bytes, 8) == 0)
+      return &probes[i];
+  }
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// owb
+
+OneWireBus* 
+owb_rmt_initialize(owb_rmt_driver_info* info, uint8_t gpio_num, rmt_channel_t tx_channel, rmt_channel_t rx_channel)
+{
+  return &FakeOneWire.bus;
+}
+
+owb_status 
+owb_use_crc(OneWireBus* bus, bool use_crc)
+{
+  bus->use_crc = use_crc;
+  return OWB_STATUS_OK;
+}
+
+// last_discrepancy holds the index of the next probe
+static void
+search(OneWireBus_SearchState* state, bool* found_device)
+{
+  *found_device = false;
+  while(state->last_discrepancy < FakeOneWire.count) {
+    const CFakeOneWire::sProbe& probe = FakeOneWire.probes[state->last_discrepancy++];
+    if(probe.present) {
+      state->rom_code = probe.romCode;
+      *found_device = true;
+      return;
+    }
+  }
+}
+
+owb_status 
+owb_search_first(const OneWireBus* bus, OneWireBus_SearchState* state, bool* found_device)
+{
+  FakeOneWire.searches++;
+  memset(state, 0, sizeof(*state));
+  search(state, found_device);
+  return OWB_STATUS_OK;
+}
+
+owb_status 
+owb_search_next(const OneWireBus* bus, OneWireBus_SearchState* state, bool* found_device)
+{
+  search(state, found_device);
+  return OWB_STATUS_OK;
+}
+
+char* 
+owb_string_from_rom_code(OneWireBus_ROMCode rom_code, char* buffer, size_t len)
+{
+  for(int i = 7; i >= 0 && len > 2; i--, len -= 2) 
+    buffer += sprintf(buffer, "%02x", rom_code.bytes[i]);
+  return buffer;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ds18b20
+
+void 
+ds18b20_init(DS18B20_Info* ds18b20_info, const OneWireBus* bus, OneWireBus_ROMCode rom_code)
+{
+  memset(ds18b20_info, 0, sizeof(*ds18b20_info));
+  ds18b20_info->init = true;
+  ds18b20_info->bus = bus;
+  ds18b20_info->rom_code = rom_code;
+  ds18b20_info->resolution = DS18B20_RESOLUTION_12_BIT;
+}
+
+void 
+ds18b20_init_solo(DS18B20_Info* ds18b20_info, const OneWireBus* bus)
+{
+  OneWireBus_ROMCode none;
+  memset(&none, 0, sizeof(none));
+  ds18b20_init(ds18b20_info, bus, none);
+  ds18b20_info->solo = true;
+}
+
+void 
+ds18b20_use_crc(DS18B20_Info* ds18b20_info, bool use_crc)
+{
+  ds18b20_info->use_crc = use_crc;
+}
+
+bool 
+ds18b20_set_resolution(DS18B20_Info* ds18b20_info, DS18B20_RESOLUTION resolution)
+{
+  ds18b20_info->resolution = resolution;
+  return true;
+}
+
+void 
+ds18b20_convert_all(const OneWireBus* bus)
+{
+  FakeOneWire.conversions++;
+}
+
+DS18B20_ERROR 
+ds18b20_read_temp(const DS18B20_Info* ds18b20_info, float* value)
+{
+  const CFakeOneWire::sProbe* pProbe = FakeOneWire.find(ds18b20_info->rom_code);
+  if(pProbe == NULL) 
+    return DS18B20_ERROR_DEVICE;
+  // quantised to the resolution, as the probe would
+  float step = 1.0f / (1 << (ds18b20_info->resolution - 8));
+  *value = floorf(pProbe->temperature / step + 0.5f) * step;
+  return DS18B20_OK;
+}
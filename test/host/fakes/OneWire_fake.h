@@ -0,0 +1,64 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CFakeOneWire
+//
+// The DS18B20 one wire bus, in place of the owb / ds18b20 RMT drivers. 
+// A test adds probes with a ROM code and temperature, searches find them 
+// in the order added and reads return their temperature.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __FAKE_ONEWIRE_H__
+#define __FAKE_ONEWIRE_H__
+
+#include <stdint.h>
+#include "../../../lib/esp32-ds18b20/owb.h"
+
+class CFakeOneWire {
+public:
+  static const int maxProbes = 20;
+  struct sProbe {
+    OneWireBus_ROMCode romCode;
+    float temperature;
+    bool present;
+  };
+  sProbe probes[maxProbes];
+  int count;
+  uint32_t searches;
+  uint32_t conversions;
+  OneWireBus bus;
+
+  CFakeOneWire();
+  void clear();
+  // ROM code 28:<serial>:..:<crc>, the serial number's LSB is given
+  int addProbe(uint8_t serial, float temperature);
+  const sProbe* find(const OneWireBus_ROMCode& romCode) const;
+};
+
+extern CFakeOneWire FakeOneWire;
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "SH1106_fake.h"
+
+CFakeSH1106::CFakeSH1106()
+{
+  clear();
+}
+
+void
+CFakeSH1106::attach(TwoWire& bus, uint8_t address)
+{
+  bus.hostAttach(address, this);
+}
+
+void
+CFakeSH1106::clear()
+{
+  memset(ram, 0, sizeof(ram));
+  _page = 0;
+  _col = 0;
+  _argsPending = 0;
+  dataBytes = 0;
+  commands = 0;
+}
+
+void
+CFakeSH1106::_command(uint8_t cmd)
+{
+  commands++;
+  if(_argsPending) {
+    _argsPending--;
+    return;
+  }
+  if((cmd & 0xf0) == 0xb0) 
+    _page = cmd & 0x07;
+  else if(cmd <= 0x0f) 
+    _col = (_col & 0xf0) | cmd;
+  else if(cmd <= 0x1f) 
+    _col = (_col & 0x0f) | ((cmd & 0x0f) << 4);
+  else {
+    switch(cmd) {
+      case 0x20:   // memory mode
+      case 0x81:   // contrast
+      case 0x8d:   // charge pump
+      case 0xa8:   // multiplex
+      case 0xad:   // DC-DC
+      case 0xd3:   // display offset
+      case 0xd5:   // clock divide
+      case 0xd9:   // precharge
+      case 0xda:   // COM pins
+      case 0xdb:   // VCOM detect
+        _argsPending = 1;
+        break;
+    }
+  }
+}
+
+void
+CFakeSH1106::onWrite(const uint8_t* data, size_t len)
+{
+  // each control byte: b7 = Co (another control byte follows the next byte), b6 = D/C
+  size_t i = 0;
+  while(i < len) {
+    uint8_t control = data[i++];
+    bool single = control & 0x80;
+    bool isData = control & 0x40;
+    size_t end = single ? std::min(i + 1, len) : len;
+    for(; i < end; i++) {
+      if(isData) {
+        if(_col < ramWidth)
+          ram[_page][_col++] = data[i];   // the SH1106 column address stops at the end of RAM
+        dataBytes++;
+      }
+      else {
+        _command(data[i]);
+      }
+    }
+  }
+}
+
+int
+CFakeSH1106::compare(const uint8_t* frame) const
+{
+  for(int page = 0; page < 8; page++) {
+    for(int col = 0; col < 128; col++) {
+      if(ram[page][col + glassOffset] != frame[page * 128 + col])
+        return page * 128 + col;
+    }
+  }
+  return -1;
+}
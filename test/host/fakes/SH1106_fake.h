@@ -0,0 +1,63 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CFakeSH1106
+//
+// An SH1106 OLED controller on the host Wire bus. Commands set the page 
+// and column address, data bytes are written into the 132 x 64 display 
+// RAM, so a test can check the panel holds exactly what was drawn.
+// Commands taking an argument are followed whether the argument shares 
+// the transmission or not (the Adafruit driver sends them separately).
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __FAKE_SH1106_H__
+#define __FAKE_SH1106_H__
+
+#include <Wire.h>
+
+class CFakeSH1106 : public CHostI2CDevice {
+  uint8_t _page;
+  uint8_t _col;
+  int _argsPending;
+  void _command(uint8_t cmd);
+public:
+  static const int ramWidth = 132;
+  static const int glassOffset = 2;        // column of the RAM shown at the left edge
+  uint8_t ram[8][ramWidth];
+  uint32_t dataBytes;                       // display RAM bytes written
+  uint32_t commands;
+
+  CFakeSH1106();
+  void attach(TwoWire& bus, uint8_t address = 0x3c);
+  void clear();
+  // compare the visible RAM with a 128 x 64 page major framebuffer, -1 if the same
+  // else the offset of the first differing framebuffer byte
+  int compare(const uint8_t* frame) const;
+  // CHostI2CDevice
+  void onWrite(const uint8_t* data, size_t len);
+};
+
+#endif
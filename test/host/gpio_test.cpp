@@ -0,0 +1,221 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// GPIO1 status patterns
+//
+// CGPIOout1 in Status mode plays its patterns with the LEDC fade engine,
+// stepped by a software timer. With simulated ticks the timer fires as
+// the tick advances and the host LEDC interpolates each fade, so the
+// output can be sampled every millisecond, as loop() would run manage(),
+// alongside the old millis() polled breathe (oracle/StatusLED_old).
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <driver/ledc.h>
+#include <stdlib.h>
+#include <vector>
+#include "HostTest.h"
+#include "Fakes.h"
+#include "oracle/StatusLED_old.h"
+#define private public
+#include "Utility/BTC_GPIO.h"
+#undef private
+
+static const int GPIO1pin = 33;
+
+struct sTrace {
+  std::vector<int> now;       // fade patterns
+  std::vector<int> old;       // oracle
+};
+
+// run both for the run state, sampling each millisecond
+static sTrace
+play(CGPIOout1& gpio, COldStatusLED& oracle, int runState, int statusMode, int ms)
+{
+  sTrace trace;
+  FakeHeater.runState = runState;
+  for(int i = 0; i < ms; i++) {
+    gpio.manage();
+    oracle.manage(statusMode);
+    trace.now.push_back(hostLedcDuty(LEDC_CHANNEL_0));
+    trace.old.push_back(oracle.getDuty());
+    hostAdvanceTicks(1);
+  }
+  return trace;
+}
+
+// where a sawtooth jumps back to its start, rising is a breathe up
+static std::vector<int>
+wraps(const std::vector<int>& duty, bool rising)
+{
+  std::vector<int> at;
+  for(size_t i = 1; i < duty.size(); i++) {
+    int step = duty[i] - duty[i-1];
+    if(rising ? step < -128 : step > 128)
+      at.push_back(i);
+  }
+  return at;
+}
+
+// the worst difference over one period, each trace taken from its own wrap
+static int
+peakError(const sTrace& trace, int nowStart, int oldStart, int period)
+{
+  int peak = 0;
+  for(int i = 0; i < period; i++)
+    peak = std::max(peak, abs(trace.now[nowStart + i] - trace.old[oldStart + i]));
+  return peak;
+}
+
+static void
+checkBreathe(int runState, int statusMode, bool rising, int expectPeriod, int expectPeak)
+{
+  hostSimTicks(true);
+  hostSetTicks(1000);
+  FakeHeater.reset();
+  FakeHeater.runState = 0;
+  CGPIOout1 gpio;
+  COldStatusLED oracle;
+  gpio.begin(GPIO1pin, CGPIOout1::Status);
+  play(gpio, oracle, 0, 0, 10);
+  sTrace trace = play(gpio, oracle, runState, statusMode, 4 * expectPeriod);
+
+  std::vector<int> nowWraps = wraps(trace.now, rising);
+  std::vector<int> oldWraps = wraps(trace.old, rising);
+  CHECK(nowWraps.size() >= 3);
+  CHECK(oldWraps.size() >= 3);
+  if(nowWraps.size() < 3 || oldWraps.size() < 3)
+    return;
+  // steady state, the second full cycle of each
+  int nowPeriod = nowWraps[2] - nowWraps[1];
+  int oldPeriod = oldWraps[2] - oldWraps[1];
+  CHECK_EQ(expectPeriod, oldPeriod);
+  CHECK_EQ(oldPeriod, nowPeriod);
+  int peak = peakError(trace, nowWraps[1], oldWraps[1], nowPeriod);
+  CHECK(peak <= expectPeak);
+
+  // the fade engine is only touched at the pattern's steps
+  uint32_t calls = hostLedcCalls();
+  play(gpio, oracle, runState, statusMode, nowPeriod);
+  uint32_t perCycle = hostLedcCalls() - calls;
+  CHECK(perCycle <= 2 * 9);             // a set and a start per step
+  CHECK_EQ(rising ? 2 : 3, gpio.getState());
+  REPORT("breathe %s: period %dms (old %dms), peak duty error %d/255, %u LEDC calls per cycle",
+         rising ? "up" : "down", nowPeriod, oldPeriod, peak, perCycle);
+  gpio.setMode(CGPIOout1::Disabled);
+  hostAdvanceTicks(1);                     // the timer callback detaches the PWM
+}
+
+TEST(breathe_up_matches_old_ramp)
+{
+  checkBreathe(2, 1, true, 3735, 7);
+}
+
+TEST(breathe_down_matches_old_ramp)
+{
+  checkBreathe(7, 3, false, 3870, 7);
+}
+
+TEST(suspend_flash)
+{
+  hostSimTicks(true);
+  hostSetTicks(1000);
+  FakeHeater.reset();
+  CGPIOout1 gpio;
+  COldStatusLED oracle;
+  gpio.begin(GPIO1pin, CGPIOout1::Status);
+  play(gpio, oracle, 0, 0, 10);
+  sTrace trace = play(gpio, oracle, 10, 4, 10000);
+  CHECK_EQ(4, gpio.getState());
+
+  // rising edges and on times, steady state after the first flash
+  std::vector<int> rises, onTimes;
+  for(size_t i = 1; i < trace.now.size(); i++) {
+    if(trace.now[i] && !trace.now[i-1])
+      rises.push_back(i);
+    if(!trace.now[i] && trace.now[i-1] && rises.size())
+      onTimes.push_back(i - rises.back());
+  }
+  CHECK(rises.size() >= 4);
+  for(size_t i = 1; i < rises.size(); i++)
+    CHECK_EQ(2000, rises[i] - rises[i-1]);
+  CHECK(onTimes.size() >= 3);
+  for(int on : onTimes)
+    CHECK_EQ(50, on);
+  CHECK_EQ(256, trace.now[rises[0]]);
+  REPORT("suspend: %d flashes of %dms every %dms", (int)rises.size(), onTimes.empty() ? 0 : onTimes[0],
+         rises.size() > 1 ? rises[1] - rises[0] : 0);
+  gpio.setMode(CGPIOout1::Disabled);
+  hostAdvanceTicks(1);                     // the timer callback detaches the PWM
+}
+
+TEST(static_states)
+{
+  hostSimTicks(true);
+  FakeHeater.reset();
+  CGPIOout1 gpio;
+  COldStatusLED oracle;
+  gpio.begin(GPIO1pin, CGPIOout1::Status);
+  sTrace trace = play(gpio, oracle, 5, 2, 100);
+  CHECK_EQ(256, trace.now.back());
+  CHECK_EQ(1, gpio.getState());
+  uint32_t calls = hostLedcCalls();
+  trace = play(gpio, oracle, 0, 0, 5000);
+  CHECK_EQ(0, trace.now.back());
+  CHECK_EQ(0, gpio.getState());
+  CHECK(hostLedcCalls() - calls <= 2);     // one duty change, no timer steps
+  gpio.setMode(CGPIOout1::Disabled);
+  hostAdvanceTicks(1);                     // the timer callback detaches the PWM
+}
+
+TEST(pwm_attach_in_timer)
+{
+  hostSimTicks(true);
+  FakeHeater.reset();
+  CGPIOout1 gpio;
+  gpio.begin(GPIO1pin, CGPIOout1::Status);
+  FakeHeater.runState = 5;
+  gpio.manage();
+  CHECK_EQ(-1, hostLedcPin(GPIO1pin));    // manage() only requests the pattern
+  hostAdvanceTicks(1);
+  CHECK_EQ(0, hostLedcPin(GPIO1pin));
+  gpio.setMode(CGPIOout1::User);
+  CHECK_EQ(0, hostLedcPin(GPIO1pin));     // nor does setMode() touch the LEDC
+  hostAdvanceTicks(1);
+  CHECK_EQ(-1, hostLedcPin(GPIO1pin));
+  gpio.setMode(CGPIOout1::Status);
+  FakeHeater.runState = 2;
+  gpio.manage();
+  hostAdvanceTicks(1);
+  CHECK_EQ(0, hostLedcPin(GPIO1pin));
+  FakeHeater.runState = 7;                 // a new pattern, still attached
+  gpio.manage();
+  hostAdvanceTicks(1);
+  CHECK_EQ(0, hostLedcPin(GPIO1pin));
+  gpio.setMode(CGPIOout1::Disabled);
+  hostAdvanceTicks(1);
+  CHECK_EQ(-1, hostLedcPin(GPIO1pin));
+}
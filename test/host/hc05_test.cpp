@@ -0,0 +1,406 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// HC-05 receive via the IDF UART driver
+//
+// BluetoothESP32.cpp is built here with the HC-05 enabled, its HC05task
+// runs as a host thread on the host UART driver (support/HostDrivers.cpp).
+// Blocks are handed to the driver as the UART ISR would empty the FIFO,
+// and the commands loop() would interpret are taken from the command 
+// ring: commands split across blocks, several in one block, an oversize
+// command, a full ring and a receive buffer overflow.
+//
+// The benchmark emulates a 38400 baud link in 1ms steps: bursts of 8 
+// commands of 44 bytes, 80 in all, reach the FIFO, which is emptied at 
+// 32 bytes or once the line idles. loop() runs every 1, 5 or 20ms. The 
+// per char polling it replaced (CBluetoothHC05::check(), one character 
+// per loop() from Arduino's 256 byte receive queue) is run on the same 
+// link. Commands interpreted intact and their latency from the closing
+// '}' on the wire are reported.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "HostTest.h"
+#include "Fakes.h"
+#define USE_HC05_BLUETOOTH     1
+#define USE_BLE_BLUETOOTH      0
+#define USE_CLASSIC_BLUETOOTH  0
+#define private public
+#define protected public
+#include "Bluetooth/BluetoothESP32.cpp"
+#undef protected
+#undef private
+
+static CBluetoothESP32HC05 HC05(HC05_KeyPin, HC05_SensePin, Rx2Pin, Tx2Pin);
+static int Completed;            // '}' handed to the driver since start()
+
+// (re)start the driver and task, as begin() would once the module is found
+static void
+start()
+{
+  HC05._stopDriver();
+  if(!HC05._cmdRing)
+    HC05._cmdRing = xRingbufferCreate(HC05_CMD_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+  size_t len;
+  void* pItem;
+  while((pItem = xRingbufferReceive(HC05._cmdRing, &len, 0)) != NULL)
+    vRingbufferReturnItem(HC05._cmdRing, pItem);
+  HC05.resetStats();
+  HC05._startDriver();
+  Completed = 0;
+  CHECK(HC05._uartQueue != NULL);
+}
+
+// wait for HC05task to deal with all the driver holds: no events or bytes
+// waiting, and each '}' has ended a command
+static void
+settle()
+{
+  for(int i = 0; i < 4000; i++) {
+    const sHC05Stats& stats = HC05.getStats();
+    size_t waiting = 0;
+    uart_get_buffered_data_len(HC05_UART, &waiting);
+    if(!waiting && !uxQueueMessagesWaiting(HC05._uartQueue) 
+       && stats.commands + stats.dropped + stats.truncated == (uint32_t)Completed)
+      return;
+    usleep(250);
+  }
+  CHECK(!"HC05task settled");
+}
+
+// one FIFO's worth reaches the driver
+static void
+receive(const std::string& block)
+{
+  for(char c : block)
+    if(c == '}')
+      Completed++;
+  hostUARTReceive(HC05_UART, block.data(), block.size());
+}
+
+static void
+receiveSettled(const std::string& block)
+{
+  receive(block);
+  settle();
+}
+
+// what loop() would interpret
+static std::vector<std::string>
+commands()
+{
+  std::vector<std::string> cmds;
+  size_t len;
+  char* pCmd;
+  while((pCmd = (char*)xRingbufferReceive(HC05._cmdRing, &len, 0)) != NULL) {
+    CHECK_EQ(strlen(pCmd) + 1, len);
+    cmds.push_back(pCmd);
+    vRingbufferReturnItem(HC05._cmdRing, pCmd);
+  }
+  return cmds;
+}
+
+static std::string
+command(int len, char pad = 'x')
+{
+  // {"Pad":"xx..."}
+  return "{\"Pad\":\"" + std::string(len - 10, pad) + "\"}";
+}
+
+TEST(split_across_blocks)
+{
+  start();
+  std::string cmd = "{\"TempDesired\":22}";
+  for(size_t i = 0; i < cmd.size(); i++)
+    receiveSettled(cmd.substr(i, 1));
+  CHECK_EQ(cmd.size(), HC05.getStats().rxEvents);
+  std::vector<std::string> cmds = commands();
+  CHECK_EQ(1, cmds.size());
+  if(cmds.size() == 1)
+    CHECK_STREQ(cmd, cmds[0]);
+
+  std::string longCmd = command(300);
+  receiveSettled(longCmd.substr(0, 100));
+  CHECK(commands().empty());
+  receiveSettled(longCmd.substr(100, 100));
+  CHECK(commands().empty());
+  receiveSettled(longCmd.substr(200));
+  cmds = commands();
+  CHECK_EQ(1, cmds.size());
+  if(cmds.size() == 1)
+    CHECK_STREQ(longCmd, cmds[0]);
+  CHECK_EQ(2, HC05.getStats().commands);
+  CHECK_EQ(cmd.size() + longCmd.size(), HC05.getStats().rxBytes);
+}
+
+TEST(several_in_one_block)
+{
+  start();
+  receiveSettled("{\"a\":1}{\"b\":2}\r\n{\"c\":3}{\"d\"");
+  receiveSettled(":4}");
+  std::vector<std::string> cmds = commands();
+  CHECK_EQ(4, cmds.size());
+  if(cmds.size() == 4) {
+    CHECK_STREQ("{\"a\":1}", cmds[0]);
+    CHECK_STREQ("{\"b\":2}", cmds[1]);
+    CHECK_STREQ("\r\n{\"c\":3}", cmds[2]);   // as collectRxData(), the JSON parser skips the white space
+    CHECK_STREQ("{\"d\":4}", cmds[3]);
+  }
+  CHECK_EQ(4, HC05.getStats().commands);
+  CHECK_EQ(2, HC05.getStats().rxEvents);
+
+  // a block larger than the task's 128 byte reads
+  std::string block;
+  for(int i = 0; i < 10; i++)
+    block += command(20, '0' + i);
+  receiveSettled(block);
+  cmds = commands();
+  CHECK_EQ(10, cmds.size());
+  for(int i = 0; i < (int)cmds.size(); i++)
+    CHECK_STREQ(command(20, '0' + i), cmds[i]);
+}
+
+TEST(oversize_truncated)
+{
+  start();
+  // the longest line the buffer holds still fits the command ring
+  std::string longest = command(sizeof(sRxLine::Line) - 1);
+  for(size_t i = 0; i < longest.size(); i += 128)
+    receiveSettled(longest.substr(i, 128));
+  std::vector<std::string> cmds = commands();
+  CHECK_EQ(1, cmds.size());
+  if(cmds.size() == 1)
+    CHECK_STREQ(longest, cmds[0]);
+
+  // one character more overruns the line, it is counted and discarded 
+  // and the next command is intact, however many blocks the overrun spans
+  std::string oversize = command(sizeof(sRxLine::Line) + 500) + "{\"ok\":1}";
+  for(size_t i = 0; i < oversize.size(); i += 128)
+    receiveSettled(oversize.substr(i, 128));
+  cmds = commands();
+  CHECK_EQ(1, cmds.size());
+  if(cmds.size() == 1)
+    CHECK_STREQ("{\"ok\":1}", cmds[0]);
+  CHECK_EQ(1, HC05.getStats().truncated);
+  CHECK_EQ(2, HC05.getStats().commands);
+  CHECK_EQ(0, HC05.getStats().dropped);
+}
+
+TEST(ring_full_drops)
+{
+  start();
+  // loop() has stalled: the ring holds as many as the IDF's NOSPLIT cost allows,
+  // the data rounded up to 4 bytes plus an 8 byte header
+  const int Len = 100;
+  const int Fit = HC05_CMD_RING_SIZE / (((Len + 1 + 3) & ~3) + 8);
+  for(int i = 0; i < Fit + 5; i++)
+    receiveSettled(command(Len, 'a' + i % 26));
+  CHECK_EQ(Fit, HC05.getStats().commands);
+  CHECK_EQ(5, HC05.getStats().dropped);
+
+  // the oldest are kept, and once loop() catches up commands flow again
+  std::vector<std::string> cmds = commands();
+  CHECK_EQ(Fit, cmds.size());
+  for(int i = 0; i < (int)cmds.size(); i++)
+    CHECK_STREQ(command(Len, 'a' + i % 26), cmds[i]);
+  receiveSettled("{\"ok\":1}");
+  cmds = commands();
+  CHECK_EQ(1, cmds.size());
+  CHECK_EQ(5, HC05.getStats().dropped);
+}
+
+TEST(uart_overflow_resyncs)
+{
+  start();
+  receiveSettled("{\"a\":1}{\"b\":");
+  // more than the driver's receive buffer holds: UART_BUFFER_FULL, the
+  // partial command and whatever was buffered are discarded
+  std::string flood(HC05_RX_BUFSIZE + 200, 'z');
+  hostUARTReceive(HC05_UART, flood.data(), flood.size());
+  settle();
+  CHECK_EQ(1, HC05.getStats().overflows);
+  receiveSettled("{\"c\":3}");
+  std::vector<std::string> cmds = commands();
+  CHECK_EQ(2, cmds.size());
+  if(cmds.size() == 2) {
+    CHECK_STREQ("{\"a\":1}", cmds[0]);
+    CHECK_STREQ("{\"c\":3}", cmds[1]);
+  }
+}
+
+TEST(send_queues)
+{
+  start();
+  size_t before = hostUARTTransmitted(HC05_UART);
+  hostSetPin(HC05_SensePin, HIGH);   // a client is connected
+  CHECK(HC05.send("{\"RunState\":0}"));
+  CHECK_EQ(14, hostUARTTransmitted(HC05_UART) - before);
+  CHECK_EQ(1, HC05.getStats().txMessages);
+  hostSetPin(HC05_SensePin, LOW);
+  CHECK(!HC05.send("{\"RunState\":0}"));
+  CHECK_EQ(1, HC05.getStats().txMessages);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// latency benchmark
+
+struct sBench {
+  int delivered;
+  double meanLatency;      // ms
+  double maxLatency;
+};
+
+static const int BytesPer100ms = 384;    // 38400 baud, 10 bits a byte
+
+static std::vector<std::string> Sent;
+static std::vector<int> SentAt;          // tick the closing '}' arrived
+static std::vector<int> Latency;
+
+static void
+onCommand(const char* pLine)
+{
+  int now = xTaskGetTickCount();
+  for(size_t i = 0; i < Sent.size(); i++)
+    if(Sent[i] == pLine && Latency[i] < 0) {
+      Latency[i] = now - SentAt[i];
+      return;
+    }
+}
+
+static sBench
+runLink(bool driver, int loopPeriod)
+{
+  const int Bursts = 10;
+  const int BurstSize = 8;
+  const int BurstInterval = 500;        // ms
+  const int RunTime = Bursts * BurstInterval + 3000;
+  const size_t HALQueue = 256;          // Arduino's UART receive queue
+
+  Sent.clear();
+  SentAt.assign(Bursts * BurstSize, -1);
+  Latency.assign(Bursts * BurstSize, -1);
+  std::string wire;                     // bytes yet to be sent
+  std::vector<int> wireCmd;             // their command, at the closing '}'
+  std::string fifo;
+  std::deque<char> halQueue;
+
+  if(driver)
+    start();
+  else {
+    HC05._stopDriver();
+    HC05._rxLine.clear();
+  }
+  hostSimTicks(true);
+  hostSetTicks(0);
+  FakeJsonCommand = onCommand;
+  int credit = 0;
+  for(int t = 0; t < RunTime; t++) {
+    if(t % BurstInterval == 0 && t / BurstInterval < Bursts) {
+      for(int i = 0; i < BurstSize; i++) {
+        char cmd[48];
+        snprintf(cmd, sizeof(cmd), "{\"Bench\":%03d,\"Pad\":\"abcdefghijklmnopqrstuv\"}", (int)Sent.size());
+        wire += cmd;
+        wireCmd.resize(wire.size(), -1);
+        wireCmd.back() = Sent.size();
+        Sent.push_back(cmd);
+      }
+    }
+    // this millisecond's bytes
+    credit += BytesPer100ms;
+    int arrived = 0;
+    while(credit >= 100 && !wire.empty()) {
+      credit -= 100;
+      char c = wire[0];
+      if(wireCmd[0] >= 0)
+        SentAt[wireCmd[0]] = t;
+      wire.erase(0, 1);
+      wireCmd.erase(wireCmd.begin());
+      arrived++;
+      if(driver)
+        fifo += c;
+      else if(halQueue.size() < HALQueue)
+        halQueue.push_back(c);
+    }
+    if(wire.empty())
+      credit = 0;
+    if(driver) {
+      // FIFO threshold, or the receive timeout once the line idles
+      while(fifo.size() >= HC05_RX_THRESHOLD) {
+        receive(fifo.substr(0, HC05_RX_THRESHOLD));
+        fifo.erase(0, HC05_RX_THRESHOLD);
+      }
+      if(!arrived && !fifo.empty()) {
+        receive(fifo);
+        fifo.clear();
+      }
+      settle();
+    }
+    if(t % loopPeriod == 0) {
+      if(driver)
+        HC05.check();
+      else if(!halQueue.empty()) {
+        HC05.collectRxData(halQueue.front());
+        halQueue.pop_front();
+      }
+    }
+    hostAdvanceTicks(1);
+  }
+  FakeJsonCommand = NULL;
+  hostSimTicks(false);
+
+  sBench result = { 0, 0, 0 };
+  for(int lat : Latency) {
+    if(lat < 0)
+      continue;
+    result.delivered++;
+    result.meanLatency += lat;
+    result.maxLatency = std::max(result.maxLatency, (double)lat);
+  }
+  if(result.delivered)
+    result.meanLatency /= result.delivered;
+  return result;
+}
+
+TEST(latency_vs_polled)
+{
+  const int Periods[] = { 1, 5, 20 };
+  for(int period : Periods) {
+    sBench polled = runLink(false, period);
+    sBench driver = runLink(true, period);
+    REPORT("loop %2dms: driver %2d/80 delivered, mean %5.1fms max %4.0fms   polled %2d/80, mean %6.1fms max %4.0fms",
+           period, driver.delivered, driver.meanLatency, driver.maxLatency,
+           polled.delivered, polled.meanLatency, polled.maxLatency);
+    // a '}' waits at most for the FIFO to reach its threshold, then for loop()
+    CHECK_EQ(80, driver.delivered);
+    CHECK(driver.maxLatency <= (HC05_RX_THRESHOLD * 100 + BytesPer100ms - 1) / BytesPer100ms + period);
+    CHECK_EQ(0, HC05.getStats().dropped);
+  }
+}
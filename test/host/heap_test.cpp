@@ -0,0 +1,239 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Heap monitor and the allocation free moderator and JSON expansion
+//
+// HeapMonitor.cpp is built here with HEAP_GUARD enabled, so its operator
+// new / delete replace the host's and every C++ allocation is counted.
+// The moderators are populated as setup() would, bootComplete() is called,
+// then 200k cycles of 20 keys are moderated with the values changing
+// every 1000 cycles - half the keys hold values beyond the std::string
+// small string size. The allocations since boot are compared for the
+// current CStringModerator and the old one (oracle/BTC_JSON_old).
+// The single pass Expand() must give the old Expand()'s output for all 8
+// combinations of the Bluetooth client's JSON options.
+// An allocation that fails must abort in the throwing operator new (in a
+// child process here) and only return NULL from the nothrow forms.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <string>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "HostTest.h"
+#include "oracle/BTC_JSON_old.h"
+#define HEAP_GUARD 1
+#include "Utility/HeapMonitor.cpp"
+#include "Utility/Moderator.h"
+#include "Utility/NVStorage.h"
+#include "Utility/BTC_JSON.h"
+
+static const int Keys = 20;
+static const int Cycles = 200000;
+static const int ChangeEvery = 1000;
+static const char* KeyNames[Keys] = {
+  "RunState", "ErrorState", "TempCurrent", "TempDesired", "FanRPM",
+  "PumpActual", "GlowPlugI", "BodyTemp", "InputVoltage", "Altitude",
+  "SSID", "IP", "Gateway", "MAC", "Hostname",
+  "Version", "Date", "Time", "MQTTHost", "Uptime"
+};
+
+static CStringModerator NewModerator;
+static COldStringModerator OldModerator;
+
+// the Debug port is captured into a fixed buffer, the sink must not allocate
+static char Captured[1024];
+static int CapturedLen = 0;
+
+static void
+capture(const uint8_t* buf, size_t size)
+{
+  for(size_t i = 0; i < size && CapturedLen < (int)sizeof(Captured) - 1; i++)
+    Captured[CapturedLen++] = buf[i];
+  Captured[CapturedLen] = 0;
+}
+
+static int
+countGuardReports()
+{
+  int count = 0;
+  for(const char* p = strstr(Captured, "HEAP GUARD"); p; p = strstr(p + 1, "HEAP GUARD"))
+    count++;
+  return count;
+}
+
+// keys 10..19 hold values longer than the 15 character small string size
+static const char*
+makeValue(char* value, int size, int key, int cycle)
+{
+  int version = cycle / ChangeEvery;
+  if(key < Keys / 2)
+    snprintf(value, size, "%d.%d", key, version % 10);
+  else
+    snprintf(value, size, "%s-%08d-value", KeyNames[key], version);
+  return value;
+}
+
+// as setup() leaves them, every key sent once with a short value
+static void
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(true);
+  if(!begun) {
+    NVstore.init();
+    for(int key = 0; key < Keys; key++) {
+      NewModerator.shouldSend(KeyNames[key], "-");
+      OldModerator.shouldSend(KeyNames[key], "-");
+    }
+    HeapMonitor.bootComplete();
+    begun = true;
+  }
+}
+
+template<class T> static uint32_t
+soak(T& moderator, int& sent)
+{
+  sHeapCounts all, before, after;
+  char value[48];
+  sent = 0;
+  HeapMonitor.getCounts(all, before);
+  for(int cycle = 0; cycle < Cycles; cycle++) {
+    for(int key = 0; key < Keys; key++) {
+      if(moderator.shouldSend(KeyNames[key], makeValue(value, sizeof(value), key, cycle)))
+        sent++;
+    }
+  }
+  HeapMonitor.getCounts(all, after);
+  return after.allocs - before.allocs;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// only the one time growth of the long values past the small string size
+TEST(moderator_soak_allocations)
+{
+  setup();
+  int sent;
+  double start = hostNow_us();
+  uint32_t allocs = soak(NewModerator, sent);
+  double elapsed = hostNow_us() - start;
+  CHECK_EQ(Keys * (Cycles / ChangeEvery), sent);
+  CHECK_EQ(Keys / 2, allocs);
+  REPORT("%d cycles of %d keys, %d sent: %u allocations, %.0fms", Cycles, Keys, sent, allocs, elapsed / 1000);
+}
+
+// the call sites found by the soak are each printed once, then never again
+TEST(guard_reports_each_site_once)
+{
+  setup();
+  CapturedLen = 0;
+  Captured[0] = 0;
+  hostCaptureSerial(capture);
+  HeapMonitor.manage();
+  int first = countGuardReports();
+  HeapMonitor.manage();
+  int second = countGuardReports() - first;
+  hostCaptureSerial(NULL);
+  CHECK_EQ(1, first);
+  CHECK_EQ(0, second);
+  REPORT("%d call site reported: %.*s", first, (int)strcspn(Captured, "\r\n"), Captured);
+}
+
+// the old moderator built a std::string of every value it was passed
+TEST(old_moderator_soak_allocations)
+{
+  setup();
+  int sent;
+  double start = hostNow_us();
+  uint32_t allocs = soak(OldModerator, sent);
+  double elapsed = hostNow_us() - start;
+  CHECK_EQ(Keys * (Cycles / ChangeEvery), sent);
+  CHECK(allocs >= uint32_t(Cycles * Keys / 2));
+  REPORT("old: %d cycles of %d keys, %d sent: %u allocations, %.0fms", Cycles, Keys, sent, allocs, elapsed / 1000);
+}
+
+TEST(expand_matches_old)
+{
+  setup();
+  const char* messages[] = {
+    "{\"RunState\":5}",
+    "{\"RunState\":5,\"TempCurrent\":21.5,\"TempDesired\":22,\"ErrorState\":1}",
+    "{\"SSID\":\"Afterburner, \\\"home\\\"\",\"IP\":\"192.168.4.1\"}",
+    "{}",
+  };
+  sUserSettings settings = NVstore.getUserSettings();
+  sUserSettings saved = settings;
+  int compared = 0;
+  for(int options = 0; options < 8; options++) {
+    settings.JSON.singleElement = (options & 0x01) ? 1 : 0;
+    settings.JSON.LF = (options & 0x02) ? 1 : 0;
+    settings.JSON.padding = (options & 0x04) ? 1 : 0;
+    NVstore.setUserSettings(settings);
+    for(const char* msg : messages) {
+      std::string expected = msg;
+      oldExpand(expected);
+      char dest[256];
+      CHECK_STREQ(expected.c_str(), Expand(msg, dest, sizeof(dest)));
+      // a destination too small leaves the message unexpanded
+      char small[8];
+      if(expected.size() >= sizeof(small))
+        CHECK(Expand(msg, small, sizeof(small)) == msg);
+      compared++;
+    }
+  }
+  NVstore.setUserSettings(saved);
+  REPORT("%d messages identical over all 8 option combinations", compared);
+}
+
+// a size no heap can provide
+static volatile size_t Exhausted = SIZE_MAX / 2;
+
+static bool
+abortsInChild(void (*fn)())
+{
+  fflush(NULL);
+  pid_t pid = fork();
+  if(pid == 0) {
+    freopen("/dev/null", "w", stderr);
+    fn();
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+TEST(failed_new_aborts)
+{
+  CHECK(operator new(Exhausted, std::nothrow) == NULL);
+  CHECK(operator new[](Exhausted, std::nothrow) == NULL);
+  CHECK(abortsInChild([]() { volatile void* p = operator new(Exhausted); (void)p; }));
+  CHECK(abortsInChild([]() { volatile void* p = operator new[](Exhausted); (void)p; }));
+  CHECK(!abortsInChild([]() { volatile void* p = operator new(64); operator delete((void*)p); }));
+}
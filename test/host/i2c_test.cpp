@@ -0,0 +1,401 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CI2CBus arbitration and queued transactions
+//
+// Tasks contend for a host Wire bus running in real time, each access goes
+// to a recording device that flags any transaction overlapping another.
+// Grant order, bypass limits, nesting, time outs and the I2C task's queue
+// are checked against what CI2CBus promises.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "HostTest.h"
+#include "DS3231_fake.h"
+#define private public
+#include "Utility/I2CBus.h"
+#undef private
+#include "RTC/Clock.h"
+
+static const uint8_t RecorderAddr[I2C_NumDevices] = { 0x3c, 0x68, 0x76 };
+
+// one device per eI2CDevice, noting who used the bus and in what order
+class CRecorder : public CHostI2CDevice {
+public:
+  static std::atomic<int> inUse;
+  static std::atomic<int> overlaps;
+  static std::atomic<int> count;
+  static std::vector<int> order;
+  int device;
+  void onWrite(const uint8_t* data, size_t len) {
+    if(inUse++)
+      overlaps++;
+    order.push_back(device * 256 + data[0]);    // device and the tag written
+    count++;
+    inUse--;
+  }
+};
+std::atomic<int> CRecorder::inUse(0);
+std::atomic<int> CRecorder::overlaps(0);
+std::atomic<int> CRecorder::count(0);
+std::vector<int> CRecorder::order;
+
+static CRecorder Recorders[I2C_NumDevices];
+static CFakeDS3231 FakeRTC;
+
+static void
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(false);
+  if(!begun) {
+    for(int i = 0; i < I2C_NumDevices; i++) {
+      Recorders[i].device = i;
+      Wire.hostAttach(RecorderAddr[i], &Recorders[i]);
+    }
+    I2CBus.begin();
+    begun = true;
+  }
+  Wire.realTime = true;
+  Wire.setClock(400000);
+  CRecorder::order.clear();
+  CRecorder::overlaps = 0;
+  I2CBus.resetStats();
+}
+
+// a short write to the device's recorder, tagged
+static bool
+access(eI2CDevice device, uint8_t tag, int bytes = 4)
+{
+  uint8_t data[32] = { tag };
+  Wire.beginTransmission(RecorderAddr[device]);
+  Wire.write(data, bytes);
+  return Wire.endTransmission() == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// contending tasks
+
+struct sContender {
+  eI2CDevice device;
+  uint8_t tag;
+  int accesses;               // 0: until stopped
+  TickType_t wait;
+  volatile bool stop;
+  volatile bool done;
+  volatile bool timedOut;
+  int worstOthers;            // most accesses by others whilst waiting for the bus
+};
+
+static void
+contenderTask(void* arg)
+{
+  sContender* pContender = (sContender*)arg;
+  for(int i = 0; pContender->accesses == 0 || i < pContender->accesses; i++) {
+    if(pContender->stop)
+      break;
+    int before = CRecorder::count;
+    if(!I2CBus.lock(pContender->device, pContender->wait)) {
+      pContender->timedOut = true;
+      break;
+    }
+    pContender->worstOthers = std::max(pContender->worstOthers, CRecorder::count - before);
+    access(pContender->device, pContender->tag);
+    I2CBus.unlock();
+  }
+  pContender->done = true;
+  vTaskDelete(NULL);
+}
+
+static void
+contend(sContender& contender, eI2CDevice device, uint8_t tag, int accesses = 1, TickType_t wait = portMAX_DELAY)
+{
+  contender.device = device;
+  contender.tag = tag;
+  contender.accesses = accesses;
+  contender.wait = wait;
+  contender.stop = false;
+  contender.done = false;
+  contender.timedOut = false;
+  contender.worstOthers = 0;
+  xTaskCreate(contenderTask, "contender", 4096, &contender, 1, NULL);
+}
+
+static void
+waitDone(sContender* contenders, int count)
+{
+  unsigned long tStart = millis();
+  for(int i = 0; i < count; i++) {
+    while(!contenders[i].done && millis() - tStart < 2000)
+      delay(1);
+    CHECK(contenders[i].done);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// the clock is set when the bus passes to a different device, and only then
+TEST(clock_applied_per_device)
+{
+  setup();
+  const uint32_t expected[I2C_NumDevices] = { 800000, 400000, 400000 };
+  const eI2CDevice sequence[] = { I2C_OLED, I2C_RTC, I2C_OLED, I2C_BME280, I2C_OLED };
+  for(eI2CDevice device : sequence) {
+    Wire.setClock(100000);            // as a Wire.begin() elsewhere does
+    I2CBus.lock(device);
+    CHECK_EQ(expected[device], Wire.getClock());
+    I2CBus.unlock();
+  }
+  Wire.setClock(100000);
+  I2CBus.lock(I2C_OLED);              // same device again
+  CHECK_EQ(100000, Wire.getClock());
+  I2CBus.unlock();
+}
+
+// waiters are served highest priority first, whatever order they arrived in
+TEST(grants_by_priority)
+{
+  setup();
+  sContender contenders[3];
+  I2CBus.lock(I2C_OLED);
+  contend(contenders[0], I2C_OLED, 1);
+  delay(20);
+  contend(contenders[1], I2C_BME280, 2);
+  delay(20);
+  contend(contenders[2], I2C_RTC, 3);
+  delay(20);
+  CHECK(CRecorder::order.empty());
+  I2CBus.unlock();
+  waitDone(contenders, 3);
+  std::vector<int> expected = { I2C_RTC * 256 + 3, I2C_BME280 * 256 + 2, I2C_OLED * 256 + 1 };
+  CHECK(CRecorder::order == expected);
+  CHECK_EQ(0, CRecorder::overlaps);
+}
+
+TEST(oldest_first_within_priority)
+{
+  setup();
+  sContender contenders[3];
+  I2CBus.lock(I2C_BME280);
+  for(int i = 0; i < 3; i++) {
+    contend(contenders[i], I2C_OLED, 10 + i);
+    delay(20);
+  }
+  I2CBus.unlock();
+  waitDone(contenders, 3);
+  std::vector<int> expected = { I2C_OLED * 256 + 10, I2C_OLED * 256 + 11, I2C_OLED * 256 + 12 };
+  CHECK(CRecorder::order == expected);
+}
+
+TEST(nested_holds)
+{
+  setup();
+  sContender contender;
+  I2CBus.lock(I2C_RTC);
+  I2CBus.lock(I2C_RTC);
+  I2CBus.unlock();
+  contend(contender, I2C_OLED, 1, 1, 20);     // still held
+  waitDone(&contender, 1);
+  CHECK(contender.timedOut);
+  I2CBus.unlock();
+  contend(contender, I2C_OLED, 2, 1, 20);     // free
+  waitDone(&contender, 1);
+  CHECK(!contender.timedOut);
+  CHECK_EQ(1, CRecorder::order.size());
+}
+
+// a waiter that gives up leaves no trace, the next unlock does not hand it the bus
+TEST(timed_out_waiter_withdraws)
+{
+  setup();
+  sContender contenders[2];
+  I2CBus.lock(I2C_OLED);
+  contend(contenders[0], I2C_RTC, 1, 1, 10);
+  waitDone(contenders, 1);
+  CHECK(contenders[0].timedOut);
+  contend(contenders[1], I2C_BME280, 2);
+  delay(20);
+  I2CBus.unlock();
+  waitDone(&contenders[1], 1);
+  CHECK(!contenders[1].timedOut);
+  CHECK(I2CBus.lock(I2C_OLED, 0));
+  I2CBus.unlock();
+}
+
+// a low priority waiter is passed over by later arrivals exactly I2C_MAX_BYPASS times
+TEST(bypass_limit)
+{
+  CI2CBus::sTicket oled = { 0, 0, 0 };
+  CI2CBus::sTicket rtc[I2C_MAX_BYPASS + 1];
+  int passedOver = 0;
+  for(int i = 0; i <= I2C_MAX_BYPASS; i++) {
+    rtc[i] = { uint32_t(i + 1), 2, 0 };
+    CI2CBus::sTicket* tickets[2] = { &oled, &rtc[i] };
+    if(CI2CBus::_pickNext(tickets, 2) == 0)
+      break;
+    passedOver++;
+  }
+  CHECK_EQ(I2C_MAX_BYPASS, passedOver);
+  // an older waiter of the same priority going first is no bypass
+  CI2CBus::sTicket first = { 10, 1, 0 }, second = { 11, 1, 0 };
+  CI2CBus::sTicket* tickets[2] = { &second, &first };
+  CHECK_EQ(1, CI2CBus::_pickNext(tickets, 2));
+  CHECK_EQ(0, second.bypassed);
+  // nor is the sequence wrapping
+  CI2CBus::sTicket old = { 0xfffffffe, 0, 0 }, wrapped = { 1, 0, 0 };
+  CI2CBus::sTicket* wrap[2] = { &wrapped, &old };
+  CHECK_EQ(1, CI2CBus::_pickNext(wrap, 2));
+}
+
+// RTC and BME280 hammer the bus, yet the OLED is passed over at most I2C_MAX_BYPASS 
+// times by later arrivals. The accesses by others whilst it waits are reported: 
+// the two hammers already waiting and the holder add up to 3, but the host can 
+// also deschedule the OLED task between its count and its request.
+TEST(low_priority_not_starved)
+{
+  setup();
+  sContender hammer[2], oled;
+  contend(hammer[0], I2C_RTC, 1, 0);
+  contend(hammer[1], I2C_BME280, 2, 0);
+  delay(5);
+  contend(oled, I2C_OLED, 3, 200);
+  unsigned long tStart = millis();
+  while(!oled.done && millis() - tStart < 5000)
+    delay(1);
+  hammer[0].stop = hammer[1].stop = true;
+  waitDone(hammer, 2);
+  CHECK(oled.done);
+  CHECK_EQ(0, CRecorder::overlaps);
+
+  const sI2CStats& stats = I2CBus.getStats(I2C_OLED);
+  CHECK_EQ(200, stats.count);
+  CHECK(stats.maxBypassed <= I2C_MAX_BYPASS);
+  CHECK(stats.bypassed <= stats.count * I2C_MAX_BYPASS);
+  REPORT("OLED: %d grants amongst %d, at most %d others whilst waiting, %d bypasses (worst %d), worst wait %dus",
+         stats.count, (int)CRecorder::order.size(), oled.worstOthers, stats.bypassed, stats.maxBypassed, stats.maxWait_us);
+  REPORT("RTC %d grants, BME280 %d grants", I2CBus.getStats(I2C_RTC).count, I2CBus.getStats(I2C_BME280).count);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// queued transactions
+
+static std::vector<int> Completions;
+
+static bool
+recordTransfer(sI2CTransaction& txn)
+{
+  return access(txn.device, txn.data[0]);
+}
+
+static bool
+absentTransfer(sI2CTransaction& txn)
+{
+  Wire.beginTransmission(0x10);       // nothing attached
+  Wire.write(txn.data[0]);
+  return Wire.endTransmission() == 0;
+}
+
+static void
+recordCompletion(const sI2CTransaction& txn, bool ok)
+{
+  Completions.push_back(ok ? txn.data[0] : -txn.data[0]);
+}
+
+static sI2CTransaction
+transaction(eI2CDevice device, uint8_t tag, tI2CTransfer transfer = recordTransfer)
+{
+  sI2CTransaction txn;
+  txn.device = device;
+  txn.transfer = transfer;
+  txn.complete = recordCompletion;
+  txn.context = NULL;
+  txn.param = 0;
+  txn.len = 1;
+  txn.data[0] = tag;
+  return txn;
+}
+
+TEST(queue_served_by_priority)
+{
+  setup();
+  Completions.clear();
+  I2CBus.lock(I2C_OLED);
+  CHECK(I2CBus.submit(transaction(I2C_OLED, 1)));
+  delay(20);                          // the I2C task takes it, then waits for the bus
+  CHECK(I2CBus.submit(transaction(I2C_OLED, 2)));
+  CHECK(I2CBus.submit(transaction(I2C_BME280, 3)));
+  CHECK(I2CBus.submit(transaction(I2C_RTC, 4, absentTransfer)));
+  CHECK(I2CBus.submit(transaction(I2C_RTC, 5)));
+  CHECK(!I2CBus.isQueueEmpty());
+  CHECK(Completions.empty());
+  I2CBus.unlock();
+  I2CBus.waitQueue(1000);
+  CHECK(I2CBus.isQueueEmpty());
+  std::vector<int> expected = { 1, -4, 5, 3, 2 };     // failed transfers complete with ok false
+  CHECK(Completions == expected);
+  CHECK_EQ(2, I2CBus.getStats(I2C_OLED).queued);
+  CHECK_EQ(2, I2CBus.getStats(I2C_RTC).queued);
+}
+
+TEST(queue_full_refused)
+{
+  setup();
+  Completions.clear();
+  I2CBus.lock(I2C_OLED);
+  int accepted = 0;
+  for(int i = 0; i < I2C_QUEUE_SIZE + 4; i++) {
+    accepted += I2CBus.submit(transaction(I2C_BME280, i + 1));
+    if(i == 0)
+      delay(20);                      // one taken by the task
+  }
+  CHECK_EQ(I2C_QUEUE_SIZE + 1, accepted);
+  I2CBus.unlock();
+  I2CBus.waitQueue(1000);
+  CHECK_EQ(accepted, Completions.size());
+}
+
+// loop() carries on whilst the bus is busy, a later read sees the write
+TEST(rtc_store_writes_queued)
+{
+  setup();
+  FakeRTC.attach(Wire);
+  uint8_t data[4] = { 0x12, 0x34, 0x56, 0x78 };
+  I2CBus.lock(I2C_OLED);
+  unsigned long tStart = micros();
+  Clock.saveData(data, 4, 0);
+  unsigned long saveTime = micros() - tStart;
+  CHECK(saveTime < 2000);
+  I2CBus.unlock();
+  uint8_t readBack[4] = { 0 };
+  Clock.readData(readBack, 4, 0);
+  CHECK(memcmp(data, readBack, 4) == 0);
+  CHECK_EQ(1, I2CBus.getStats(I2C_RTC).queued);
+  REPORT("RTC store write returned in %luus with the bus held", saveTime);
+}
@@ -0,0 +1,338 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CScreenManager screen registry, walked over the full menu tree
+//
+// Every menu loop and branch is visited for each menu mode, with and 
+// without GPIO and a BME280, as the screen sets differ. Screens must be 
+// built on demand, the cache must stay within OLED_SCREEN_CACHE and the
+// heap must return to where it was once the walk is over.
+// Heap is counted by replacing operator new / delete in this test.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <new>
+#include <thread>
+#include "HostTest.h"
+#include "Fakes.h"
+#include "BME280_fake.h"
+#define private public
+#include "OLED/ScreenManager.h"
+#include "Utility/TempSense.h"
+#undef private
+#include "OLED/KeyPad.h"
+#include "OLED/Screen.h"
+#include "Utility/NVStorage.h"
+#include "Utility/BoardDetect.h"
+#include "Protocol/433MHz.h"
+#include "cfg/pins.h"
+
+CScreenManager ScreenManager;
+static CFakeBME280 FakeBME280;
+
+///////////////////////////////////////////////////////////////////////////
+// heap accounting
+
+static long LiveBytes = 0;
+static long Allocations = 0;
+
+void* operator new(size_t size)
+{
+  size_t* p = (size_t*)malloc(size + sizeof(size_t) * 2);
+  if(p == NULL)
+    throw std::bad_alloc();
+  p[0] = size;
+  __sync_fetch_and_add(&LiveBytes, size);
+  __sync_fetch_and_add(&Allocations, 1);
+  return p + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+  if(ptr) {
+    size_t* p = (size_t*)ptr - 2;
+    __sync_fetch_and_sub(&LiveBytes, p[0]);
+    free(p);
+  }
+}
+
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+///////////////////////////////////////////////////////////////////////////
+
+static const char* MenuNames[] = { "root", "timer", "user", "system", "tuning", "branch" };
+
+static void 
+configure(int menuMode, int boardRevision, int BME280count)
+{
+  sUserSettings settings = NVstore.getUserSettings();
+  settings.menuMode = menuMode;
+  settings.menuTimeout = 0;
+  settings.dimTime = 0;
+  NVstore.setUserSettings(settings);
+  FakeSystem.boardRevision = boardRevision;
+  if(BME280count) 
+    FakeBME280.attach(Wire);
+  else
+    FakeBME280.detach(Wire);
+  getTempSensor().getBME280().begin(0x76);
+  CHECK_EQ(BME280count, getTempSensor().getBME280().getCount());
+}
+
+static void 
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(true);
+  FakeHeater.reset();
+  FakeSystem.reset();
+  FakeNetwork.reset();
+  if(!begun) {
+    NVstore.init();
+    UHFremote.begin(Rx433MHz_pin, RMT_CHANNEL_4);   // as setup(), the 433MHz screen polls it
+    ScreenManager.begin();
+    ScreenManager.releaseSplash();
+    hostAdvanceTicks(BOOT_SPLASH_TIME + 1);
+    ScreenManager.checkUpdate();
+    begun = true;
+  }
+  configure(0, BRD_V2_FULLGPIO, 0);
+  ScreenManager.reqReload();
+  ScreenManager.checkUpdate();
+}
+
+// every screen of every loop, stepping loops as the keys do (nextMenu)
+// branch screens are only reached by selectMenu()
+static int
+walk()
+{
+  CScreenManager& mgr = ScreenManager;
+  int visited = 0;
+  for(int menu = 0; menu < (int)mgr._Screens.size(); menu++) {
+    int size = mgr._Screens[menu].size();
+    CHECK(size > 0);
+    mgr.selectMenu(CScreenManager::eUIMenuSets(menu), 0);
+    for(int sub = 0; sub < size; sub++) {
+      CHECK_EQ(menu, mgr._menu);
+      CHECK_EQ(sub, mgr._subMenu);
+      CHECK(mgr.checkUpdate());          // shown, built if need be
+      mgr.animate();
+      mgr.refresh();
+      CHECK(mgr._getScreen(false) != NULL);
+      CHECK(mgr._cache.size() <= OLED_SCREEN_CACHE + 1);   // trimmed at the next safe point
+      visited++;
+      if(menu == CScreenManager::BranchMenu) {
+        if(sub + 1 < size)
+          mgr.selectMenu(CScreenManager::BranchMenu, sub + 1);
+      }
+      else {
+        mgr.nextMenu();
+      }
+    }
+    if(menu != CScreenManager::BranchMenu) {
+      CHECK_EQ(0, mgr._subMenu);    // wrapped around the loop
+    }
+    mgr.checkUpdate();
+    CHECK(mgr._cache.size() <= OLED_SCREEN_CACHE);
+  }
+  mgr.selectMenu(CScreenManager::RootMenuLoop);
+  mgr.checkUpdate();
+  return visited;
+}
+
+TEST(walk_every_configuration)
+{
+  setup();
+  const int modes[] = { 0, 1, 2 };
+  const int boards[] = { BRD_V2_FULLGPIO, BRD_V2_NOGPIO };
+  for(int mode : modes) {
+    for(int board : boards) {
+      for(int BME280 = 0; BME280 <= 1; BME280++) {
+        configure(mode, board, BME280);
+        ScreenManager.reqReload();
+        ScreenManager.checkUpdate();
+        int visited = walk();
+        // a second walk must not grow the heap, only the cached screens remain from the first
+        long after = LiveBytes;
+        walk();
+        CHECK_EQ(after, LiveBytes);
+        char loops[64] = "";
+        for(auto& loop : ScreenManager._Screens) 
+          sprintf(loops + strlen(loops), " %d", (int)loop.size());
+        REPORT("menu mode %d, %s, %s: %2d screens, loops%s", mode, 
+               board == BRD_V2_NOGPIO ? "no GPIO" : "GPIO   ", BME280 ? "BME280   " : "no BME280", visited, loops);
+      }
+    }
+  }
+}
+
+// what constructing every screen up front (as before the registry) held, against the registry
+TEST(heap_against_all_screens)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  mgr._unloadScreens();
+  long before = LiveBytes;
+  mgr._loadScreens();
+  mgr.checkUpdate();
+  long registry = LiveBytes - before;     // the factory vectors and the current screen
+  CHECK_EQ(1, mgr._cache.size());         // only the current screen is built
+
+  long all = 0, largest = 0, screens = 0;
+  for(auto& loop : mgr._Screens) {
+    for(auto factory : loop) {
+      long start = LiveBytes;
+      CScreen* pScreen = factory(*mgr._pDisplay, mgr);
+      long size = LiveBytes - start;
+      delete pScreen;
+      all += size;
+      largest = std::max(largest, size);
+      screens++;
+    }
+  }
+  // the original also built 14 set timer screens, rather than one
+  long setTimer = 0;
+  {
+    long start = LiveBytes;
+    CScreen* pScreen = mgr._Screens[CScreenManager::TimerMenuLoop][CScreenManager::SetTimerUI](*mgr._pDisplay, mgr);
+    setTimer = LiveBytes - start;
+    delete pScreen;
+  }
+  all += 13 * setTimer;
+  REPORT("host sizes - all %ld screens up front: %ld bytes, registry and current screen: %ld bytes, largest screen %ld bytes", 
+         screens + 13, all, registry, largest);
+  CHECK(registry + OLED_SCREEN_CACHE * largest < all);
+}
+
+// the set timer screen's timer outlives the screen
+TEST(timer_state_survives_screen)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  mgr.selectMenu(CScreenManager::TimerMenuLoop, CScreenManager::SetTimerUI);
+  mgr.checkUpdate();
+  mgr.setScreenState(CScreenManager::TimerIDState, 5);
+  // away, long enough for the screen to be dropped from the cache
+  walk();
+  mgr.selectMenu(CScreenManager::TimerMenuLoop, CScreenManager::SetTimerUI);
+  mgr.checkUpdate();
+  CHECK_EQ(5, mgr.getScreenState(CScreenManager::TimerIDState));
+  mgr.setScreenState(CScreenManager::TimerIDState, 0);
+}
+
+// key presses on the root loop step it as nextMenu() does
+TEST(keys_step_root_loop)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  mgr.selectMenu(CScreenManager::RootMenuLoop, 0);
+  mgr.checkUpdate();
+  int size = mgr._Screens[0].size();
+  for(int i = 1; i <= size; i++) {
+    mgr.keyHandler(key_Right | keyPressed);
+    mgr.keyHandler(key_Right | keyReleased);
+    mgr.checkUpdate();
+    CHECK_EQ(i % size, mgr._subMenu);
+    CHECK(mgr._cache.size() <= OLED_SCREEN_CACHE);
+  }
+}
+
+// setup() ends with releaseSplash(), the splash and key lock out stay for BOOT_SPLASH_TIME more
+TEST(splash_held_after_setup)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  mgr.selectMenu(CScreenManager::RootMenuLoop, 0);
+  mgr.checkUpdate();
+  mgr._bSplashHold = true;          // as begin() leaves it
+  hostAdvanceTicks(10 * BOOT_SPLASH_TIME);
+  mgr.keyHandler(key_Right | keyPressed);
+  mgr.keyHandler(key_Right | keyReleased);
+  CHECK(!mgr.checkUpdate());
+  CHECK(!mgr.animate());
+  mgr.releaseSplash();
+  hostAdvanceTicks(BOOT_SPLASH_TIME - 1);
+  mgr.keyHandler(key_Right | keyPressed);
+  mgr.keyHandler(key_Right | keyReleased);
+  CHECK(!mgr.checkUpdate());
+  CHECK_EQ(0, mgr._subMenu);
+  hostAdvanceTicks(2);
+  CHECK(mgr.checkUpdate());
+  mgr.keyHandler(key_Right | keyPressed);
+  mgr.keyHandler(key_Right | keyReleased);
+  mgr.checkUpdate();
+  CHECK_EQ(1, mgr._subMenu);
+}
+
+static int
+bytesDiffering(const uint8_t* a, const uint8_t* b, int firstRow, int lastRow)
+{
+  int count = 0;
+  for(int i = (firstRow / 8) * 128; i < (lastRow / 8 + 1) * 128; i++)
+    count += a[i] != b[i];
+  return count;
+}
+
+// a boot stage's task only posts its message, loop() draws it over the bottom line
+TEST(boot_message_drawn_by_loop)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  mgr.selectMenu(CScreenManager::SystemSettingsLoop, CScreenManager::SysVerUI);
+  mgr.checkUpdate();
+  mgr.animate();
+  uint8_t before[1024], after[1024];
+  memcpy(before, mgr._pDisplay->getBuffer(), sizeof(before));
+
+  std::thread stage([&mgr]() { mgr.showBootMsg("Starting web server"); });
+  stage.join();
+  CHECK_EQ(0, bytesDiffering(before, mgr._pDisplay->getBuffer(), 0, 63));
+  CHECK(mgr.animate());
+  memcpy(after, mgr._pDisplay->getBuffer(), sizeof(after));
+  CHECK_EQ(0, bytesDiffering(before, after, 0, 47));
+  CHECK(bytesDiffering(before, after, 48, 63) > 0);
+  // redrawn screens keep it
+  mgr.reqUpdate();
+  CHECK(mgr.checkUpdate());
+  mgr.animate();
+  CHECK_EQ(0, bytesDiffering(after, mgr._pDisplay->getBuffer(), 0, 63));
+
+  // the hourglass keeps it up, then it goes BOOT_MSG_TIME after the last message
+  mgr.showBootWait(1);
+  hostAdvanceTicks(BOOT_MSG_TIME + 1);
+  CHECK(mgr.animate());
+  CHECK(bytesDiffering(after, mgr._pDisplay->getBuffer(), 48, 63) > 0);
+  mgr.showBootWait(0);
+  CHECK(mgr.checkUpdate());
+  mgr.animate();
+  CHECK_EQ(0, bytesDiffering(before, mgr._pDisplay->getBuffer(), 0, 63));
+  CHECK(!mgr._checkBootMsg());
+}
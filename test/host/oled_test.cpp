@@ -0,0 +1,326 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// C128x64_OLED dirty span refresh
+//
+// The display is driven over the host Wire bus into a simulated SH1106, 
+// so every refresh can be checked pixel for pixel against the framebuffer
+// and its bus traffic counted.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "HostTest.h"
+#include "SH1106_fake.h"
+#include "OLED/128x64OLED.h"
+#include "OLED/fonts/Arial.h"
+#include "OLED/fonts/MidiFont.h"
+#include "OLED/fonts/MiniFont.h"
+#include "OLED/fonts/OCRfont.h"
+#include "OLED/fonts/Tahoma8.h"
+#include "OLED/fonts/Tahoma24.h"
+#include "oracle/DotFactory_old.h"
+#include "cfg/pins.h"
+
+static CFakeSH1106 Panel;
+static C128x64_OLED* pDisplay = NULL;
+
+static C128x64_OLED& 
+setup()
+{
+  hostSimTicks(false);
+  if(pDisplay == NULL) {
+    Panel.attach(Wire);
+    pDisplay = new C128x64_OLED(OLED_SDA_pin, OLED_SCL_pin);
+    pDisplay->begin(SH1106_SWITCHCAPVCC);
+    Wire.setClock(800000);
+  }
+  pDisplay->invalidate();
+  pDisplay->clearDisplay();
+  pDisplay->display();
+  pDisplay->waitFlush();
+  return *pDisplay;
+}
+
+// send a frame, returning the bytes on the bus
+static uint32_t 
+refresh(C128x64_OLED& display)
+{
+  uint32_t before = Wire.bytes;
+  display.display();
+  display.waitFlush();
+  CHECK_EQ(-1, Panel.compare(display.getBuffer()));
+  CHECK_EQ(Wire.bytes - before, display.getLastRefresh().bytes);
+  return Wire.bytes - before;
+}
+
+static void
+randomShapes(C128x64_OLED& display, int count)
+{
+  for(int i = 0; i < count; i++) {
+    int x = rand() % 140 - 6, y = rand() % 72 - 4;
+    int w = rand() % 40 + 1, h = rand() % 30 + 1;
+    uint16_t colour = rand() % 3;
+    switch(rand() % 4) {
+      case 0: display.fillRect(x, y, w, h, colour); break;
+      case 1: display.drawLine(x, y, x + w, y + h, colour); break;
+      case 2: display.drawPixel(x, y, colour); break;
+      case 3: 
+        display.setFontInfo(&arial_8ptFontInfo);
+        display.setTextColor(colour == BLACK ? BLACK : WHITE);
+        display.setCursor(x, y);
+        display.print("12:34");
+        display.setFontInfo(NULL);
+        break;
+    }
+  }
+}
+
+TEST(full_frame)
+{
+  C128x64_OLED& display = setup();
+  display.invalidate();
+  randomShapes(display, 30);
+  uint32_t bytes = refresh(display);
+  // 8 pages: address + control + 3 commands, then 2 chunks of 64 data bytes (each with address + control)
+  CHECK_EQ(8 * (5 + 2 * 2 + 128), bytes);
+  CHECK_EQ(bytes, display.getLastRefresh().bytes);
+  CHECK_EQ(8, display.getLastRefresh().spans);
+  REPORT("full frame %d bytes (was 1224 with 16 byte chunks and separate commands), %.1fms at 800kHz", 
+         bytes, bytes * 9 / 800.0);
+}
+
+TEST(unchanged_frame_is_free)
+{
+  C128x64_OLED& display = setup();
+  randomShapes(display, 30);
+  refresh(display);
+  CHECK_EQ(0, refresh(display));
+  CHECK_EQ(0, display.getLastRefresh().spans);
+  // redrawn from scratch, but identical
+  srand(1);
+  display.clearDisplay();
+  randomShapes(display, 30);
+  refresh(display);
+  srand(1);
+  display.clearDisplay();
+  randomShapes(display, 30);
+  CHECK_EQ(0, refresh(display));
+}
+
+TEST(blinking_icon)
+{
+  C128x64_OLED& display = setup();
+  randomShapes(display, 30);
+  display.fillRect(100, 0, 10, 8, BLACK);
+  refresh(display);
+  display.fillRect(100, 0, 10, 8, WHITE);     // a 10 column header icon appears
+  uint32_t bytes = refresh(display);
+  CHECK_EQ(5 + 2 + 10, bytes);
+  CHECK_EQ(1, display.getLastRefresh().spans);
+}
+
+// random edits, the panel must always match the framebuffer
+TEST(random_edits_match_panel)
+{
+  C128x64_OLED& display = setup();
+  srand(4321);
+  uint32_t total = 0, full = 0;
+  const int frames = 2000;
+  for(int i = 0; i < frames; i++) {
+    randomShapes(display, rand() % 4);
+    total += refresh(display);
+    full += 8 * (5 + 2 * 2 + 128);
+  }
+  REPORT("%d frames of small edits: %.0f bytes per frame against %d for a full refresh", 
+         frames, double(total) / frames, full / frames);
+  CHECK(total < full);
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Dot Factory glyph blitter against the per pixel renderer it replaced
+//
+///////////////////////////////////////////////////////////////////////////
+
+static const struct { const char* name; const FONT_INFO* pFont; } Fonts[] = {
+  { "arial_8pt", &arial_8ptFontInfo },
+  { "arial_8ptBold", &arial_8ptBoldFontInfo },
+  { "arialItalic_7pt", &arialItalic_7ptFontInfo },
+  { "arialItalic_8pt", &arialItalic_8ptFontInfo },
+  { "arialBlack_12pt", &arialBlack_12ptFontInfo },
+  { "segoeUI_8pt", &segoeUI_8ptFontInfo },
+  { "segoeUI_Italic_8pt", &segoeUI_Italic_8ptFontInfo },
+  { "segoeUI_7pt", &segoeUI_7ptFontInfo },
+  { "segoeUI_Italic_7pt", &segoeUI_Italic_7ptFontInfo },
+  { "mini", &miniFontInfo },
+  { "oCRAExtended_8pt", &oCRAExtended_8ptFontInfo },
+  { "tahoma_8pt", &tahoma_8ptFontInfo },
+  { "tahoma_24pt", &tahoma_24ptFontInfo },
+};
+
+static const uint16_t Colours[] = { WHITE, BLACK, INVERSE };
+
+TEST(glyphs_match_per_pixel)
+{
+  C128x64_OLED& display = setup();
+  uint8_t* pBuffer = display.getBuffer();
+  const int size = 128 * 64 / 8;
+  uint8_t random[size], blitted[size];
+  srand(29);
+  long cases = 0, mismatches = 0;
+  for(auto& font : Fonts) {
+    for(int c = font.pFont->StartChar; c <= font.pFont->EndChar; c++) {
+      int w = font.pFont->pCharInfo[c - font.pFont->StartChar].Width;
+      int h = font.pFont->pCharInfo[c - font.pFont->StartChar].Height;
+      // positions clipping each edge, page aligned and not
+      const int xs[] = { -w, -w + 1, -3, -1, 0, 1, 7, 60, 128 - w - 1, 128 - w, 128 - w + 1, 125, 127, 128 };
+      const int ys[] = { -h, -h + 1, -9, -8, -5, -1, 0, 1, 3, 7, 8, 13, 29, 64 - h - 1, 64 - h, 64 - h + 3, 60, 63, 64 };
+      for(int i = 0; i < size; i++) 
+        random[i] = rand();
+      for(int x : xs) {
+        for(int y : ys) {
+          for(uint16_t fg : Colours) {
+            for(uint16_t bg : Colours) {
+              int xsize = 0, ysize = 0;
+              memcpy(pBuffer, random, size);
+              display.drawDotFactoryChar(x, y, c, fg, bg, font.pFont, xsize, ysize);
+              memcpy(blitted, pBuffer, size);
+              memcpy(pBuffer, random, size);
+              oldDrawDotFactoryChar(display, x, y, c, fg, bg, font.pFont, xsize, ysize);
+              if(memcmp(blitted, pBuffer, size) != 0) {
+                if(mismatches++ < 5)
+                  REPORT("%s '%c' at %d,%d fg %d bg %d differs", font.name, c, x, y, fg, bg);
+              }
+              cases++;
+            }
+          }
+        }
+      }
+    }
+  }
+  CHECK_EQ(0, mismatches);
+  REPORT("%ld cases over %d fonts identical", cases, int(sizeof(Fonts) / sizeof(Fonts[0])));
+}
+
+static double
+glyphsPerSecond(C128x64_OLED& display, const FONT_INFO* pFont, bool perPixel)
+{
+  int xsize, ysize;
+  int span = pFont->EndChar - pFont->StartChar + 1;
+  const int count = 200000;
+  double start = hostNow_us();
+  for(int i = 0; i < count; i++) {
+    uint8_t c = pFont->StartChar + i % span;
+    int16_t x = (i * 7) % 120, y = (i * 3) % 56;
+    if(perPixel)
+      oldDrawDotFactoryChar(display, x, y, c, WHITE, BLACK, pFont, xsize, ysize);
+    else
+      display.drawDotFactoryChar(x, y, c, WHITE, BLACK, pFont, xsize, ysize);
+  }
+  return count / (hostNow_us() - start) * 1e6;
+}
+
+TEST(glyph_throughput)
+{
+  C128x64_OLED& display = setup();
+  const FONT_INFO* fonts[] = { &arial_8ptFontInfo, &tahoma_24ptFontInfo };
+  const char* names[] = { "arial_8pt", "tahoma_24pt" };
+  for(int i = 0; i < 2; i++) {
+    double oldRate = glyphsPerSecond(display, fonts[i], true);
+    double newRate = glyphsPerSecond(display, fonts[i], false);
+    REPORT("%-12s per pixel %.2fM glyphs/s, blitted %.2fM glyphs/s", names[i], oldRate / 1e6, newRate / 1e6);
+    CHECK(newRate > oldRate);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// loop() latency of display(), sending from loop() and from the flush task
+//
+// The bus takes real time here, 800kHz as on the target. Each pass redraws
+// the screen from scratch with a changing clock, every 25th pass is a 
+// different screen. Must be the last test, the flush task stays running.
+//
+///////////////////////////////////////////////////////////////////////////
+
+static void
+drawPass(C128x64_OLED& display, int pass)
+{
+  char str[16];
+  srand(pass / 25);
+  display.clearDisplay();
+  randomShapes(display, 20);
+  display.setFontInfo(&arial_8ptFontInfo);
+  display.setTextColor(WHITE, BLACK);
+  display.setCursor(90, 0);
+  sprintf(str, "%02d:%02d", (pass / 60) % 24, pass % 60);
+  display.print(str);
+  display.setFontInfo(NULL);
+}
+
+static std::vector<double> 
+loopLatency(C128x64_OLED& display, int passes)
+{
+  std::vector<double> times;
+  for(int pass = 0; pass < passes; pass++) {
+    drawPass(display, pass);
+    double start = hostNow_us();
+    display.display();
+    times.push_back(hostNow_us() - start);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  display.waitFlush();
+  CHECK_EQ(-1, Panel.compare(display.getBuffer()));
+  std::sort(times.begin(), times.end());
+  return times;
+}
+
+static double 
+percentile(const std::vector<double>& sorted, int pc)
+{
+  return sorted[(sorted.size() - 1) * pc / 100];
+}
+
+TEST(loop_latency)
+{
+  C128x64_OLED& display = setup();
+  const int passes = 400;
+  Wire.realTime = true;
+  std::vector<double> inLoop = loopLatency(display, passes);
+  display.beginFlushTask();
+  CHECK(display.getFlushTaskHandle() != NULL);
+  std::vector<double> inTask = loopLatency(display, passes);
+  Wire.realTime = false;
+  REPORT("display() from loop(): p50 %.0fus p90 %.0fus p99 %.0fus max %.0fus", 
+         percentile(inLoop, 50), percentile(inLoop, 90), percentile(inLoop, 99), inLoop.back());
+  REPORT("display() to the task: p50 %.0fus p90 %.0fus p99 %.0fus max %.0fus", 
+         percentile(inTask, 50), percentile(inTask, 90), percentile(inTask, 99), inTask.back());
+  CHECK(percentile(inTask, 99) < percentile(inLoop, 50));
+}
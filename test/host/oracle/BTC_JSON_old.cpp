@@ -0,0 +1,66 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "Utility/NVStorage.h"
+#include "BTC_JSON_old.h"
+
+const char* 
+COldStringModerator::shouldSend(const char* name, const char* value) 
+{
+  std::string sValue = value;
+  auto it = Memory.find(name);
+  if(it != Memory.end()) {
+    if(it->second == sValue)
+      return NULL;    // unchanged
+    it->second = sValue;
+    return it->second.c_str();
+  }
+  else {
+    return (Memory[name] = sValue).c_str();
+  }
+}
+
+void oldExpand(std::string& str)
+{
+  const sUserSettings& userOptions = NVstore.getUserSettings();
+
+  if(userOptions.JSON.singleElement) {
+    size_t pos = str.find(",\"");
+    while(pos != std::string::npos) {
+      if(userOptions.JSON.LF)
+        str.replace(pos, 2, "}\n{\"");  // converts {"name":value,"name2":value"} to {"name":value}\n{"name2":value}
+      else
+        str.replace(pos, 2, "}{\"");   // converts {"name":value,"name2":value"} to {"name":value}{"name2":value}
+      pos = str.find(",\"");
+    }
+    if(userOptions.JSON.padding) {    // converts {"name":value} to {"name": value}
+      pos = str.find("\":");
+      while(pos != std::string::npos) {
+        str.replace(pos, 2, "\": ");
+        pos = str.find("\":", pos+1);
+      }
+    }
+    if(userOptions.JSON.LF)
+      str.append("\n");
+  }
+}
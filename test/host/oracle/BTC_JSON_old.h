@@ -0,0 +1,42 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: the string moderator's test for a changed value and the
+// Bluetooth client's JSON expansion as they were before the allocation free
+// hot paths (baseline dfb9a03^). shouldSend() built a std::string from every
+// value it was passed, Expand() rewrote a std::string copy of the message.
+
+#ifndef __OLDBTCJSON_H__
+#define __OLDBTCJSON_H__
+
+#include <map>
+#include <string>
+
+class COldStringModerator {
+  std::map<const char*, std::string> Memory;
+public:
+  const char* shouldSend(const char* name, const char* value);
+};
+
+void oldExpand(std::string& str);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "Protocol/Protocol.h"
+#include "Utility/MODBUS-CRC16.h"
+#include "cfg/BTCConfig.h"
+#include "BlueWireLog_old.h"
+
+void 
+oldDebugReportFrame(const char* hdr, const CProtocol& Frame, const char* ftr, char* msg)
+{
+  strcat(msg, hdr);                     // header
+  for(int i=0; i<24; i++) {
+    char str[8];
+    sprintf(str, " %02X", Frame.Data[i]);  // build 2 dig hex values
+    strcat(msg, str);                   // and print     
+  }
+  strcat(msg, ftr);                     // footer
+}
+
+// CProtocolPackage::reportFrames(), the time stamp is given
+void  
+oldReportFrames(bool isOEM, long tFrame, const CProtocol& Controller, const CProtocol& Heater, char* msg)
+{
+  msg[0] = 0;
+  sprintf(msg, "%8ldms ", tFrame);   // CContextTimeStamp::report()
+  if(isOEM) {
+    oldDebugReportFrame("OEM:", Controller, TERMINATE_OEM_LINE ? "\r\n" : "   ", msg);
+  }
+  else {
+    oldDebugReportFrame("BTC:", Controller, TERMINATE_BTC_LINE ? "\r\n" : "   ", msg);
+  }
+  oldDebugReportFrame("HTR:", Heater, "\r\n", msg);
+}
+
+void
+oldRecycleTime(long RxTimeElapsed, char* msg)
+{
+  sprintf(msg, "%ldms - ", RxTimeElapsed);
+}
+
+void
+oldOEMresync(long RxTimeElapsed, char* msg)
+{
+  sprintf(msg, "Re-sync'd with OEM Controller. %ldms Idle time.\r\n", RxTimeElapsed);
+}
+
+// CProtocol::verifyCRC()'s failure message
+void
+oldVerifyCRC(const CProtocol& frame, char* msg)
+{
+  CModBusCRC16 CRCengine;
+  uint16_t CRC = CRCengine.process(22, frame.Data);
+  uint16_t FrameCRC = frame.getCRC();
+  msg[0] = 0;
+  if(FrameCRC != CRC) 
+    sprintf(msg, "verifyCRC FAILED: calc: %04X data: %04X\r\n", CRC, FrameCRC);
+}
+
+// validateFrame()'s two messages, concatenated
+void
+oldBadCRC(const char* name, const CProtocol& frame, char* msg)
+{
+  sprintf(msg, "\007Bad CRC detected for %s frame - restarting blue wire's serial port\r\n", name);
+  oldDebugReportFrame("BAD CRC:", frame, "\r\n", msg);
+}
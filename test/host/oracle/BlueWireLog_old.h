@@ -0,0 +1,39 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: the blue wire task's debug messages as they were built before
+// the deferred binary log (baseline e8dd4a1^), sprintf and DebugReportFrame
+// into a message buffer which was then queued for loop() to print.
+
+#ifndef __OLDBLUEWIRELOG_H__
+#define __OLDBLUEWIRELOG_H__
+
+class CProtocol;
+
+void oldDebugReportFrame(const char* hdr, const CProtocol& Frame, const char* ftr, char* msg);
+void oldReportFrames(bool isOEM, long tFrame, const CProtocol& Controller, const CProtocol& Heater, char* msg);
+void oldRecycleTime(long RxTimeElapsed, char* msg);
+void oldOEMresync(long RxTimeElapsed, char* msg);
+void oldVerifyCRC(const CProtocol& frame, char* msg);
+void oldBadCRC(const char* name, const CProtocol& frame, char* msg);
+
+#endif
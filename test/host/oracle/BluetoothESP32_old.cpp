@@ -0,0 +1,55 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include <BluetoothSerial.h>
+#include <BLEDevice.h>
+#include "BluetoothESP32_old.h"
+
+void
+oldClassicSend(BluetoothSerial& SerialBT, const char* Str)
+{
+  SerialBT.write((uint8_t*)Str, strlen(Str));
+  delay(10);
+}
+
+// break down supplied string into 20 byte chunks (or less)
+// BLE can only handle 20 bytes per packet!
+static void
+BLE_Send(BLECharacteristic* _pTxCharacteristic, std::string Data)
+{
+  while(!Data.empty()) {
+    std::string substr = Data.substr(0, 20);
+    int len = substr.length();    
+    _pTxCharacteristic->setValue((uint8_t*)Data.data(), len);
+    _pTxCharacteristic->notify();
+    Data.erase(0, len);
+  }
+}
+
+void
+oldBLESend(BLECharacteristic* pTxCharacteristic, const char* Str)
+{
+  std::string txData = Str;
+  BLE_Send(pTxCharacteristic, txData);
+  delay(10);
+}
@@ -0,0 +1,37 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: the ESP32 Classic and BLE send() paths, once a client is
+// connected, as they were before the queued transmit (baseline 1b9769c^).
+// Classic wrote the message then waited 10ms. BLE notified it in 20 byte
+// pieces whatever the MTU, then waited 10ms.
+
+#ifndef __OLDBLUETOOTHESP32_H__
+#define __OLDBLUETOOTHESP32_H__
+
+class BluetoothSerial;
+class BLECharacteristic;
+
+void oldClassicSend(BluetoothSerial& SerialBT, const char* Str);
+void oldBLESend(BLECharacteristic* pTxCharacteristic, const char* Str);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: CDebounce as it was before the edge interrupts and event 
+// ring (baseline 8e24b40^), reading every pin on each manage() call.
+
+#ifndef __OLDDEBOUNCE_H__
+#define __OLDDEBOUNCE_H__
+
+#include <stdint.h>
+#include <vector>
+
+class COldDebounce {
+  int _pinActiveState;
+  std::vector<int> _pins;
+  uint8_t _prevPins;
+  uint8_t _debouncedPins;
+  unsigned long _lastDebounceTime;
+  unsigned long _debounceDelay;
+  uint8_t _scanInputs();
+public:
+  COldDebounce();
+  void addPin(int pin);
+  uint8_t manage();
+};
+
+#endif
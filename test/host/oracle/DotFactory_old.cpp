@@ -0,0 +1,62 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include "DotFactory_old.h"
+
+void
+oldDrawDotFactoryChar(Adafruit_GFX& gfx, int16_t x, int16_t y, uint8_t c, uint16_t color, uint16_t bg, const FONT_INFO* pFontDescriptor, int& xsize, int& ysize)
+{
+  if(c >= pFontDescriptor->StartChar && c <= pFontDescriptor->EndChar) {
+
+	  // point to info for selected character
+	  const FONT_CHAR_INFO* pCharInfo = &pFontDescriptor->pCharInfo[c - pFontDescriptor->StartChar];
+    // and extract info from flash (program) storage
+    uint8_t* addr = (uint8_t*)&pCharInfo->Offset;
+	  uint8_t LSB = pgm_read_byte(addr++);
+	  uint8_t MSB = pgm_read_byte(addr);
+    int BmpOffset = (MSB << 8) | LSB;
+    xsize = pgm_read_byte(&pCharInfo->Width);
+    ysize = pgm_read_byte(&pCharInfo->Height);
+
+    // point to bitmap data for selected character
+	  const uint8_t* pBitmap = &pFontDescriptor->pBitmaps[BmpOffset];
+
+    uint8_t mask = 0x80;
+    uint8_t line = 0;
+	  for(int8_t j=0; j < xsize/*pCharInfo->Width*/; j++) {
+      for (int8_t i=0; i < ysize/*pCharInfo->Height*/; i++ ) {
+    	  if((i & 0x07) == 0) {
+	        line = pgm_read_byte(pBitmap++);
+    	  }
+        if(line & mask) {
+          gfx.drawPixel(x+j, y+i, color);
+        }
+        else if(bg != color) {
+          gfx.drawPixel(x+j, y+i, bg);
+        }
+        line <<= 1;
+  	  }
+	  }
+  }
+}
@@ -0,0 +1,37 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: C128x64_OLED::drawDotFactoryChar() as it was before the byte
+// blitter (baseline 0cf9d2f), a drawPixel() per glyph pixel. Made a free 
+// function over any Adafruit_GFX, the debug output is dropped.
+
+#ifndef __OLDDOTFACTORY_H__
+#define __OLDDOTFACTORY_H__
+
+#include <stdint.h>
+#include "OLED/fonts/FontTypes.h"
+
+class Adafruit_GFX;
+
+void oldDrawDotFactoryChar(Adafruit_GFX& gfx, int16_t x, int16_t y, uint8_t c, uint16_t color, uint16_t bg, const FONT_INFO* pFontDescriptor, int& xsize, int& ysize);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "StatusLED_old.h"
+
+const int BREATHINTERVAL = 45;
+const int FLASHPERIOD = 2000;
+const int ONFLASHINTERVAL = 50;
+
+COldStatusLED::COldStatusLED()
+{
+  _prevState = -1;
+  _statusState = 0;
+  _breatheDelay = 0;
+  _duty = 0;
+}
+
+void
+COldStatusLED::manage(int statusMode)
+{
+  if(_prevState != statusMode) {
+    _prevState = statusMode;
+    _statusState = 0;
+    switch(statusMode) {
+      case 0:
+        _duty = 0;
+        break;
+      case 1:
+        _duty = _statusState;
+        _breatheDelay = millis() + BREATHINTERVAL; 
+        break;
+      case 2:
+        _duty = 256;
+        break;
+      case 3:
+        _statusState = 255;
+        _duty = _statusState;
+        _breatheDelay = millis() + BREATHINTERVAL; 
+        break;
+      case 4:
+        _breatheDelay += (FLASHPERIOD - ONFLASHINTERVAL);  // extended off
+        _duty = 0;
+        break;
+    }  
+  }
+  switch(statusMode) {
+    case 1: _doStartMode(); break;
+    case 3: _doStopMode(); break;
+    case 4: _doSuspendMode(); break;
+  }
+}
+
+void 
+COldStatusLED::_doStartMode()
+{
+  long tDelta = millis() - _breatheDelay;
+  if(tDelta >= 0) {
+    _breatheDelay += BREATHINTERVAL;
+    int expo = ((_statusState >> 5) + 1);
+    _statusState += expo;
+    _statusState &= 0xff;
+    _duty = _statusState;
+  }
+}
+
+void 
+COldStatusLED::_doStopMode()
+{
+  long tDelta = millis() - _breatheDelay;
+  if(tDelta >= 0) {
+    _breatheDelay += BREATHINTERVAL;
+    int expo = ((_statusState >> 5) + 1);
+    _statusState -= expo;
+    _statusState &= 0xff;
+    _duty = _statusState;
+  }
+}
+
+void 
+COldStatusLED::_doSuspendMode()
+{
+  long tDelta = millis() - _breatheDelay;
+  if(tDelta >= 0) {
+    _statusState++;
+    if(_statusState & 0x01) {
+      _breatheDelay += ONFLASHINTERVAL;  // brief flash on
+      _duty = 256;
+    }
+    else {
+      _breatheDelay += (FLASHPERIOD - ONFLASHINTERVAL);  // extended off
+      _duty = 0;
+    }
+  }
+}
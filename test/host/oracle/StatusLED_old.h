@@ -0,0 +1,48 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: the GPIO1 status breathe and suspend flash of CGPIOout1 as 
+// they were before the LEDC fade patterns (baseline 933309c^), stepped by 
+// polling millis(). The PWM and pin writes become a duty, digital HIGH 
+// being 256 as it is for the fade patterns.
+
+#ifndef __OLDSTATUSLED_H__
+#define __OLDSTATUSLED_H__
+
+#include <stdint.h>
+
+class COldStatusLED {
+public:
+  COldStatusLED();
+  void manage(int statusMode);   // 0 off, 1 breathe up, 2 on, 3 breathe down, 4 suspend
+  uint32_t getDuty() const { return _duty; }
+private:
+  int _prevState;
+  int _statusState;
+  unsigned long _breatheDelay;
+  uint32_t _duty;
+  void _doStartMode();
+  void _doStopMode();
+  void _doSuspendMode();
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * TELNET SERVER FOR ESP8266 / ESP32
+ * Cloning the serial port via Telnet.
+ *
+ * Written by Wolfgang Mattis (arduino@yasheena.de).
+ * Version 1.1 / September 7, 2018. 
+ * MIT license, all text above must be included in any redistribution.   
+ */
+
+// Test oracle: the TelnetSpy output path as it was before the block oriented,
+// non-blocking write (baseline 7e7c010^). write(uint8_t) is the only output
+// path, each byte is checked against client.connected(), a full ring sends a
+// block in the writer, and serial output waits on the UART byte by byte.
+// The defaults and critical section macros come from the current TelnetSpy.h.
+
+#ifndef __OLDTELNETSPY_H__
+#define __OLDTELNETSPY_H__
+
+#include "../../../lib/TelnetSpy/TelnetSpy.h"
+
+class COldTelnetSpy : public Stream {
+	public:
+		COldTelnetSpy();
+		~COldTelnetSpy();
+		void handle(void);   
+		void setPort(uint16_t portToUse);
+		void setWelcomeMsg(char* msg);
+		void setRejectMsg(char* msg);
+		void setMinBlockSize(uint16_t minSize);
+		void setCollectingTime(uint16_t colTime);
+		void setMaxBlockSize(uint16_t maxSize);
+		bool setBufferSize(uint16_t newSize);
+		uint16_t getBufferSize();
+		void setStoreOffline(bool store);
+		bool getStoreOffline();
+		void setPingTime(uint16_t pngTime);
+		void setSerial(HardwareSerial* usedSerial);
+		bool isClientConnected();
+		void setCallbackOnConnect(void (*callback)());
+		void setCallbackOnDisconnect(void (*callback)());
+		void begin(unsigned long baud, uint32_t config=SERIAL_8N1, int8_t rxPin=-1, int8_t txPin=-1, bool invert=false);
+		void end();
+		int available(void) override;
+		int peek(void) override;
+		int read(void) override;
+		int availableForWrite(void);
+		void flush(void) override;
+		size_t write(uint8_t) override;
+		inline size_t write(unsigned long n) { return write((uint8_t) n); }
+		inline size_t write(long n) { return write((uint8_t) n); }
+		inline size_t write(unsigned int n) { return write((uint8_t) n); }
+		inline size_t write(int n) { return write((uint8_t) n); }
+		using Print::write;
+		operator bool() const;
+		void setDebugOutput(bool);
+		uint32_t baudRate(void);
+
+	protected:
+		CRITCAL_SECTION_MUTEX
+		void sendBlock(void);
+		void addTelnetBuf(char c);
+		char pullTelnetBuf();
+		char peekTelnetBuf();
+		int telnetAvailable();
+		WiFiServer* telnetServer;
+		WiFiClient client;
+		uint16_t port;
+		HardwareSerial* usedSer;
+		bool storeOffline;
+		bool started;
+		bool listening;
+		bool firstMainLoop;
+		unsigned long waitRef;
+		unsigned long pingRef;
+		uint16_t pingTime;
+		char* welcomeMsg;
+		char* rejectMsg;
+		uint16_t minBlockSize;
+		uint16_t collectingTime;
+		uint16_t maxBlockSize;
+		bool debugOutput;
+		char* telnetBuf;
+		uint16_t bufLen;
+		uint16_t bufUsed;
+		uint16_t bufRdIdx;
+		uint16_t bufWrIdx;
+		bool connected;
+		void (*callbackConnect)();
+		void (*callbackDisconnect)();
+};
+
+#endif
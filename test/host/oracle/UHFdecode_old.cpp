@@ -0,0 +1,67 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <Arduino.h>
+#include "UHFdecode_old.h"
+#include "Utility/macros.h"
+
+bool 
+oldDecode433MHz(const rmt_item32_t* rxItems, int size, unsigned long& code)
+{
+  int workingsize = 0;
+  unsigned long newCode = 0;
+  if(size == 32)
+    workingsize = 23;
+  else if(size == 25)
+    workingsize = 24;
+  else {
+    return false;
+  }
+  // start OK, now read the 24 bit payload
+  int meanBitTime = 0;
+  for (int i = 0; i < workingsize; i++)
+  {
+    meanBitTime += rxItems[i].duration0 + rxItems[i].duration1;  // add 1st and 2nd part times
+  }
+  meanBitTime /= workingsize;
+
+  for (int i = 0; i < workingsize; i++)
+  {
+    int bitTime = rxItems[i].duration0 + rxItems[i].duration1;  // add 1st and 2nd part times
+    if(INBOUNDS(bitTime, meanBitTime - 500, meanBitTime + 500)    // confirm duration
+        && rxItems[i].level0 == 1        // confirm 1st part is high
+        && rxItems[i].level1 == 0)       // confirm 2nd part is low
+    {
+
+      newCode <<= 1;
+
+      // OK, a 1 is accepted if high > 0.6ms
+      if(rxItems[i].duration0 > meanBitTime/2)
+        newCode |= 0x0001;
+    }
+    else {
+      return false;
+    }
+  }
+  code = newCode;
+  return true;
+}
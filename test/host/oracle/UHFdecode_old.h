@@ -0,0 +1,35 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Test oracle: the 433MHz frame decoding of C433MHzRemote::_decodeRxItems()
+// as it was before the protocol table (baseline e6e2cce^). A 25 transition 
+// frame yields 24 bits, a 32 transition frame only its first 23. The key 
+// press queueing is left out, the decoded code word is returned.
+
+#ifndef __OLDUHFDECODE_H__
+#define __OLDUHFDECODE_H__
+
+#include "driver/rmt.h"
+
+bool oldDecode433MHz(const rmt_item32_t* rxItems, int size, unsigned long& code);
+
+#endif
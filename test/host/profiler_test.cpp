@@ -0,0 +1,259 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// loop() stage profiler
+//
+// Stages are timed through PROFILE_STAGE / PROFILE_SCOPE as loop() uses
+// them, against the host's micros(). The log4 histogram edges, the loop()
+// period and body, enabling and disabling, printJSON() (parsed back with
+// ArduinoJson) and the registered task table are checked.
+//
+// The benchmark times loop()'s 8 profiled stages around a trivial stage
+// body: as USE_PROFILER 0 compiles them (the body alone), compiled in but
+// stopped, and running. The overhead figures are per stage, over the 
+// compiled out time, the best of several rounds.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <algorithm>
+#include <string>
+#include "HostTest.h"
+#include "../../lib/ArduinoJson/ArduinoJson.h"
+#include "Utility/Profiler.h"
+
+class CStringPrint : public Print {
+public:
+  std::string text;
+  size_t write(uint8_t c) { text += (char)c; return 1; }
+};
+
+static std::string Captured;
+
+static void
+capture(const uint8_t* buf, size_t size)
+{
+  Captured.append((const char*)buf, size);
+}
+
+TEST(histogram_buckets)
+{
+  Profiler.enable(true);
+  // <16us, then every factor of 4 up to >=64ms
+  const uint32_t Times[] = { 0, 15, 16, 63, 64, 255, 256, 1023, 1024, 4095, 4096, 16383, 16384, 65535, 65536, 0xffffffff };
+  for(uint32_t us : Times)
+    Profiler.record(PROF_UHF, us);
+  const sProfStage& stats = Profiler.getStage(PROF_UHF);
+  CHECK_EQ(16, stats.count);
+  CHECK_EQ(0, stats.min);
+  CHECK_EQ(0xffffffff, stats.max);
+  CHECK_EQ(2, stats.hist[0]);
+  for(int b = 1; b < PROFILE_BUCKETS - 1; b++)
+    CHECK_EQ(2, stats.hist[b]);
+  CHECK_EQ(2, stats.hist[PROFILE_BUCKETS - 1]);
+  Profiler.enable(false);
+}
+
+TEST(stages_and_loop)
+{
+  Profiler.enable(true);
+  for(int i = 0; i < 5; i++) {
+    PROFILE_LOOP_START();
+    PROFILE_STAGE(PROF_Clock, delayMicroseconds(2000));
+    {
+      PROFILE_SCOPE(PROF_WiFi);
+      delayMicroseconds(300);
+    }
+    PROFILE_STAGE(PROF_UHF, );
+    PROFILE_LOOP_END();
+    delayMicroseconds(1000);
+  }
+  const sProfStage& clock = Profiler.getStage(PROF_Clock);
+  CHECK_EQ(5, clock.count);
+  CHECK(clock.min >= 2000);
+  CHECK_EQ(5, clock.hist[4]);     // <4ms
+  const sProfStage& wifi = Profiler.getStage(PROF_WiFi);
+  CHECK_EQ(5, wifi.count);
+  CHECK(wifi.min >= 300);
+  CHECK_EQ(5, wifi.hist[3]);      // <1ms
+  CHECK_EQ(5, Profiler.getStage(PROF_UHF).count);
+  CHECK_EQ(5, Profiler.getStage(PROF_UHF).hist[0]);
+  // the period is start to start, one fewer than the bodies
+  CHECK_EQ(4, Profiler.getStage(PROF_Period).count);
+  CHECK_EQ(5, Profiler.getStage(PROF_Body).count);
+  CHECK(Profiler.getStage(PROF_Period).min >= 3300);
+  CHECK(Profiler.getStage(PROF_Body).min >= 2300);
+  CHECK(Profiler.getStage(PROF_Period).min > Profiler.getStage(PROF_Body).min);
+  CHECK_EQ(0, Profiler.getStage(PROF_Display).count);
+
+  // stopped, the stages still run but nothing is recorded, and starting 
+  // again begins afresh
+  Profiler.enable(false);
+  CHECK_EQ(0, clock.count);
+  int ran = 0;
+  PROFILE_LOOP_START();
+  PROFILE_STAGE(PROF_Clock, ran++);
+  PROFILE_LOOP_END();
+  CHECK_EQ(1, ran);
+  CHECK_EQ(0, clock.count);
+  CHECK_EQ(0, Profiler.getStage(PROF_Body).count);
+  Profiler.enable(true);
+  PROFILE_LOOP_END();             // no loop start yet, not a body
+  CHECK_EQ(0, Profiler.getStage(PROF_Body).count);
+  Profiler.enable(false);
+}
+
+static TaskHandle_t 
+noTask() 
+{ 
+  return NULL; 
+}
+
+TEST(print_json)
+{
+  Profiler.enable(true);
+  Profiler.record(PROF_Display, 100);
+  Profiler.record(PROF_Display, 300);
+  Profiler.record(PROF_Display, 20000);
+  Profiler.record(PROF_Sensors, 5);
+  Profiler.addTask("Arduino", xTaskGetCurrentTaskHandle());
+  Profiler.addTask("Idle", noTask);       // not running, not listed
+
+  CStringPrint out;
+  Profiler.printJSON(out);
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject& root = jsonBuffer.parseObject(out.text.c_str());
+  CHECK(root.success());
+  CHECK(root["Enabled"] == true);
+  JsonArray& buckets = root["Buckets"];
+  CHECK_EQ(PROFILE_BUCKETS, buckets.size());
+  CHECK_STREQ("<16u", buckets[0].as<const char*>());
+  CHECK_STREQ("more", buckets[PROFILE_BUCKETS - 1].as<const char*>());
+
+  // stages without counts are left out, in stage order
+  JsonArray& stages = root["Stages"];
+  CHECK_EQ(2, stages.size());
+  JsonObject& sensors = stages[0];
+  CHECK_STREQ("Sensors", sensors["Name"].as<const char*>());
+  CHECK_EQ(1, sensors["Count"].as<int>());
+  CHECK_EQ(1, sensors["Hist"][0].as<int>());
+  JsonObject& display = stages[1];
+  CHECK_STREQ("Display", display["Name"].as<const char*>());
+  CHECK_EQ(3, display["Count"].as<int>());
+  CHECK_EQ(100, display["Min"].as<int>());
+  CHECK_EQ(6800, display["Mean"].as<int>());
+  CHECK_EQ(20000, display["Max"].as<int>());
+  const int Hist[PROFILE_BUCKETS] = { 0, 0, 1, 1, 0, 0, 1, 0 };
+  for(int b = 0; b < PROFILE_BUCKETS; b++)
+    CHECK_EQ(Hist[b], display["Hist"][b].as<int>());
+
+  JsonArray& tasks = root["Tasks"];
+  CHECK_EQ(1, tasks.size());
+  CHECK_STREQ("Arduino", tasks[0]["Name"].as<const char*>());
+  CHECK(tasks[0]["StackFree"].as<int>() > 0);
+  CHECK(!tasks[0].as<JsonObject>().containsKey("CPU"));   // no run time stats
+
+  // the live view leaves the statistics be
+  CHECK_EQ(3, Profiler.getStage(PROF_Display).count);
+  Profiler.enable(false);
+}
+
+TEST(task_table_full)
+{
+  // registering past PROFILER_MAX_TASKS is reported, not silent
+  Captured.clear();
+  hostCaptureSerial(capture);
+  int added = 0;
+  while(Captured.empty() && added <= PROFILER_MAX_TASKS) {
+    Profiler.addTask("Idle", noTask);
+    added++;
+  }
+  CHECK_STREQ("Profiler: no room for task Idle, raise PROFILER_MAX_TASKS\r\n", Captured);
+  Captured.clear();
+  Profiler.addTask("Extra", noTask);
+  hostCaptureSerial(NULL);
+  CHECK(added <= PROFILER_MAX_TASKS + 1);
+  CHECK_STREQ("Profiler: no room for task Extra, raise PROFILER_MAX_TASKS\r\n", Captured);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// overhead benchmark
+
+static volatile int StageWork;
+
+static void __attribute__((noinline))
+stage()
+{
+  StageWork++;
+}
+
+// loop()'s profiled stages, as USE_PROFILER 0 leaves them
+static void __attribute__((noinline))
+loopOut()
+{
+  do { stage(); } while(0);  do { stage(); } while(0);
+  do { stage(); } while(0);  do { stage(); } while(0);
+  do { stage(); } while(0);  do { stage(); } while(0);
+  do { stage(); } while(0);  do { stage(); } while(0);
+}
+
+static void __attribute__((noinline))
+loopIn()
+{
+  PROFILE_STAGE(PROF_Streaming, stage());  PROFILE_STAGE(PROF_WiFi, stage());
+  PROFILE_STAGE(PROF_Bluetooth, stage());  PROFILE_STAGE(PROF_Clock, stage());
+  PROFILE_STAGE(PROF_Sensors, stage());    PROFILE_STAGE(PROF_Display, stage());
+  PROFILE_STAGE(PROF_BlueWire, stage());   PROFILE_STAGE(PROF_UHF, stage());
+}
+
+static double
+timeLoops(void (*fn)(), int loops)
+{
+  double start = hostNow_us();
+  for(int i = 0; i < loops; i++)
+    fn();
+  return (hostNow_us() - start) * 1000.0 / (loops * 8);   // ns a stage
+}
+
+TEST(overhead)
+{
+  const int Loops = 200000;
+  const int Rounds = 7;
+  double out = 1e9, stopped = 1e9, running = 1e9;
+  for(int r = 0; r < Rounds; r++) {
+    out = std::min(out, timeLoops(loopOut, Loops));
+    Profiler.enable(false);
+    stopped = std::min(stopped, timeLoops(loopIn, Loops));
+    Profiler.enable(true);
+    running = std::min(running, timeLoops(loopIn, Loops));
+    CHECK_EQ(Loops, Profiler.getStage(PROF_UHF).count);
+    Profiler.enable(false);
+  }
+  REPORT("stage body alone (compiled out) %5.1fns", out);
+  REPORT("compiled in, stopped            %+5.1fns a stage", stopped - out);
+  REPORT("running                         %+5.1fns a stage (two host micros() and record())", running - out);
+  CHECK(stopped < running);
+}
@@ -0,0 +1,264 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Headless screen rendering against golden images
+//
+// Every screen is shown with a canned blue wire exchange (a heater running
+// at part load), the default settings, a fixed RTC time and fixed network
+// state. Its framebuffer after show() and the first animate(), as refresh()
+// would send it, is compared with golden/<loop>_<sub>_<class>.pbm.
+// The golden images are plain PBMs, as the CTRL-D debug key dumps on the
+// target, so a capture from a device can be dropped in as a reference.
+//
+//   make render GOLDEN=update    rewrite the golden images
+//
+// A differing screen is written to build/render/ for viewing.
+// The draw calls and time of each show() and animate() are reported.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "HostTest.h"
+#include "Fakes.h"
+#include "BME280_fake.h"
+#include "DS3231_fake.h"
+#define private public
+#include "OLED/ScreenManager.h"
+#undef private
+#include "OLED/Screen.h"
+#include "OLED/fonts/Arial.h"
+#include "Utility/NVStorage.h"
+#include "Utility/BoardDetect.h"
+#include "Utility/TempSense.h"
+#include "Protocol/433MHz.h"
+#include "RTC/Clock.h"
+#include "cfg/pins.h"
+
+CScreenManager ScreenManager;
+static CFakeBME280 FakeBME280;
+static CFakeDS3231 FakeRTC;
+
+static const char* LoopNames[] = { "root", "timer", "user", "system", "tuning", "branch" };
+static const int frameBytes = 128 * 64 / 8;
+
+static void
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(true);
+  FakeHeater.reset();
+  FakeHeater.runState = 5;          // running
+  FakeSystem.reset();
+  FakeNetwork.reset();
+  FakeNetwork.STA = true;
+  FakeNetwork.STAconnected = true;
+  FakeNetwork.RSSI = -62;
+  if(!begun) {
+    FakeRTC.attach(Wire);
+    FakeRTC.set(1578220200);        // Sun 5 Jan 2020 10:30:00
+    FakeBME280.attach(Wire);
+    NVstore.init();
+    Clock.begin();
+    getTempSensor().getBME280().begin(0x76);
+    UHFremote.begin(Rx433MHz_pin, RMT_CHANNEL_4);
+    ScreenManager.begin();
+    ScreenManager.releaseSplash();
+    hostAdvanceTicks(BOOT_SPLASH_TIME + 1);
+    ScreenManager.checkUpdate();
+    begun = true;
+  }
+  sUserSettings settings = NVstore.getUserSettings();
+  settings.menuMode = 0;
+  settings.menuTimeout = 0;
+  settings.dimTime = 0;
+  NVstore.setUserSettings(settings);
+  ScreenManager.reqReload();
+  ScreenManager.checkUpdate();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// plain PBM, 1 = pixel lit
+
+static std::string
+toPBM(const uint8_t* frame)
+{
+  std::string pbm = "P1\n128 64\n";
+  for(int y = 0; y < 64; y++) {
+    for(int x = 0; x < 128; x++)
+      pbm += (frame[(y >> 3) * 128 + x] & (0x01 << (y & 0x07))) ? '1' : '0';
+    pbm += '\n';
+  }
+  return pbm;
+}
+
+// any whitespace, so CRLF captures from the debug port load as well
+static bool
+readPBM(const std::string& path, uint8_t* frame)
+{
+  FILE* fp = fopen(path.c_str(), "r");
+  if(fp == NULL)
+    return false;
+  char magic[3] = "";
+  int width = 0, height = 0;
+  bool ok = fscanf(fp, "%2s %d %d", magic, &width, &height) == 3 && strcmp(magic, "P1") == 0 && width == 128 && height == 64;
+  memset(frame, 0, frameBytes);
+  for(int i = 0; ok && i < 128 * 64; ) {
+    int c = fgetc(fp);
+    if(c == EOF)
+      ok = false;
+    else if(c == '0' || c == '1') {
+      int x = i % 128, y = i / 128;
+      if(c == '1')
+        frame[(y >> 3) * 128 + x] |= 0x01 << (y & 0x07);
+      i++;
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+static bool
+writeFile(const std::string& path, const std::string& content)
+{
+  FILE* fp = fopen(path.c_str(), "w");
+  if(fp == NULL)
+    return false;
+  fwrite(content.data(), 1, content.size(), fp);
+  fclose(fp);
+  return true;
+}
+
+static int
+pixelsDiffering(const uint8_t* a, const uint8_t* b)
+{
+  int count = 0;
+  for(int i = 0; i < frameBytes; i++)
+    count += __builtin_popcount(a[i] ^ b[i]);
+  return count;
+}
+
+static std::string
+className(CScreen* pScreen)
+{
+  int status;
+  char* name = abi::__cxa_demangle(typeid(*pScreen).name(), NULL, NULL, &status);
+  std::string result = (status == 0) ? name : typeid(*pScreen).name();
+  free(name);
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// the counter sees what reaches the framebuffer: fills arrive as lines, bitmaps as pixels
+TEST(draw_calls_counted)
+{
+  setup();
+  C128x64_OLED& display = *ScreenManager._pDisplay;
+  display.clearDisplay();
+  display.clearDrawStats();
+  display.drawPixel(1, 1, WHITE);
+  display.fillRect(10, 10, 20, 5, WHITE);       // one line per column
+  display.drawRect(40, 10, 10, 10, WHITE);      // two of each
+  display.setFontInfo(&arial_8ptFontInfo);
+  display.setCursor(0, 40);
+  display.print("Afterburner");
+  display.setFontInfo(NULL);
+  const sOLEDDrawStats& draws = display.getDrawStats();
+  CHECK_EQ(1, draws.pixels);
+  CHECK_EQ(20 + 4, draws.lines);
+  CHECK_EQ(11, draws.glyphs);
+  display.clearDrawStats();
+  CHECK_EQ(0, draws.pixels + draws.lines + draws.glyphs);
+}
+
+TEST(screens_match_golden)
+{
+  setup();
+  CScreenManager& mgr = ScreenManager;
+  bool update = getenv("GOLDEN") && strcmp(getenv("GOLDEN"), "update") == 0;
+  mkdir("build/render", 0755);
+  uint8_t frame[frameBytes], golden[frameBytes], blank[frameBytes] = { 0 };
+  int screens = 0, matched = 0, written = 0;
+  double showTotal = 0, animateTotal = 0;
+  for(int menu = 0; menu < (int)mgr._Screens.size(); menu++) {
+    for(int sub = 0; sub < (int)mgr._Screens[menu].size(); sub++) {
+      mgr.selectMenu(CScreenManager::eUIMenuSets(menu), sub);
+      CHECK(mgr.checkUpdate());
+      const sScreenRender& render = mgr.getLastRender();
+      CHECK_EQ(menu, render.menu);
+      CHECK_EQ(sub, render.subMenu);
+      sScreenRender shown = render;
+      // some screens leave all their drawing to animate()
+      bool animated = mgr.animate();
+      sScreenRender animation = mgr.getLastRender();
+      mgr.refresh();
+      memcpy(frame, mgr._pDisplay->getBuffer(), frameBytes);
+
+      char name[96];
+      snprintf(name, sizeof(name), "%s_%d_%s.pbm", LoopNames[menu], sub, className(mgr._getScreen(false)).c_str());
+      std::string goldenPath = std::string("golden/") + name;
+      if(update) {
+        CHECK(writeFile(goldenPath, toPBM(frame)));
+        written++;
+      }
+      else if(!readPBM(goldenPath, golden)) {
+        REPORT("%s: no golden image, make render GOLDEN=update", name);
+        CHECK(false);
+      }
+      else {
+        int differ = pixelsDiffering(golden, frame);
+        if(differ) {
+          writeFile(std::string("build/render/") + name, toPBM(frame));
+          REPORT("%s: %d pixels differ, see build/render/%s", name, differ, name);
+        }
+        CHECK_EQ(0, differ);
+        matched += (differ == 0);
+      }
+      CHECK(pixelsDiffering(blank, frame) > 0);
+      REPORT("%-52s show %5.0fus %4d px %3d lines %3d glyphs%s", name, (double)shown.time_us,
+             shown.draws.pixels, shown.draws.lines, shown.draws.glyphs,
+             animated ? "" : "  (no animation)");
+      if(animated)
+        REPORT("%-52s  animate %5.0fus %4d px %3d lines %3d glyphs", "", (double)animation.time_us,
+               animation.draws.pixels, animation.draws.lines, animation.draws.glyphs);
+      showTotal += shown.time_us;
+      animateTotal += animated ? animation.time_us : 0;
+      screens++;
+    }
+  }
+  mgr.selectMenu(CScreenManager::RootMenuLoop, 0);
+  mgr.checkUpdate();
+  if(update)
+    REPORT("%d golden images written", written);
+  else
+    REPORT("%d of %d screens match their golden image", matched, screens);
+  REPORT("host times - show %.0fus, animate %.0fus over %d screens", showTotal, animateTotal, screens);
+}
@@ -0,0 +1,150 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Self signed certificate creation (esp32_https_server's SSLCert)
+//
+// SSLCert.cpp is built against the host mbedTLS (2.x, libmbedtls-dev),
+// the firmware's USE_HTTPS is 0 so it is not built for the target by 
+// default. gen_key() and cert_write() are timed for an ECDSA P-256 key,
+// as SSLkeyTask creates with USE_HTTPS_ECDSA 1, and the RSA 2048 key it
+// replaced. The key and certificate are then loaded back as the server's
+// setupCert() does (the IDF's OpenSSL layer parses both with mbedTLS):
+// the certificate must parse, carry the key's public half, verify against
+// itself and name the subject it was given.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <algorithm>
+#include <string>
+#include "HostTest.h"
+#include "../../lib/esp32_https_server-master/src/SSLCert.cpp"
+
+using namespace httpsserver;
+
+static const char* DN = "CN=myesp.local,O=acme,C=US";   // as SSLkeyTask
+
+struct sCertTimes {
+  double key;        // ms, best and worst of the rounds
+  double keyMax;
+  double cert;
+  double certMax;
+};
+
+// create a pair as createSelfSignedCert() does, timing each half
+static int
+create(SSLCert& cert, SSLKeySize keySize, sCertTimes& times)
+{
+  double start = hostNow_us();
+  int res = gen_key(cert, keySize);
+  double mid = hostNow_us();
+  if(res == 0)
+    res = cert_write(cert, DN, "20190101000000", "20300101000000");
+  double end = hostNow_us();
+  times.key = std::min(times.key, (mid - start) / 1000);
+  times.keyMax = std::max(times.keyMax, (mid - start) / 1000);
+  times.cert = std::min(times.cert, (end - mid) / 1000);
+  times.certMax = std::max(times.certMax, (end - mid) / 1000);
+  return res;
+}
+
+// load the pair back as the HTTPS server would
+static void
+checkPair(SSLCert& cert, mbedtls_pk_type_t type, int bits, const char* sigAlg)
+{
+  mbedtls_x509_crt crt;
+  mbedtls_x509_crt_init(&crt);
+  mbedtls_pk_context key;
+  mbedtls_pk_init(&key);
+
+  CHECK_EQ(0, mbedtls_x509_crt_parse_der(&crt, cert.getCertData(), cert.getCertLength()));
+  CHECK_EQ(0, mbedtls_pk_parse_key(&key, cert.getPKData(), cert.getPKLength(), NULL, 0));
+  CHECK_EQ(type, mbedtls_pk_get_type(&key));
+  CHECK_EQ(bits, mbedtls_pk_get_bitlen(&key));
+  // the certificate holds the public half of the key
+  CHECK_EQ(0, mbedtls_pk_check_pair(&crt.pk, &key));
+
+  // self signed: it verifies against itself (time of day aside)
+  uint32_t flags = 0;
+  mbedtls_x509_crt_verify(&crt, &crt, NULL, NULL, &flags, NULL, NULL);
+  CHECK_EQ(0, flags & ~(MBEDTLS_X509_BADCERT_EXPIRED | MBEDTLS_X509_BADCERT_FUTURE));
+
+  char info[1024];
+  CHECK(mbedtls_x509_crt_info(info, sizeof(info), "", &crt) > 0);
+  std::string text(info);
+  CHECK(text.find("subject name      : CN=myesp.local, O=acme, C=US") != std::string::npos);
+  CHECK(text.find(std::string("signed using      : ") + sigAlg) != std::string::npos);
+  CHECK(text.find("basic constraints : CA=true") != std::string::npos);
+
+  mbedtls_pk_free(&key);
+  mbedtls_x509_crt_free(&crt);
+}
+
+TEST(ecdsa_p256)
+{
+  const int Rounds = 10;
+  sCertTimes times = { 1e9, 0, 1e9, 0 };
+  size_t keyLen = 0, certLen = 0;
+  for(int i = 0; i < Rounds; i++) {
+    SSLCert cert;
+    CHECK_EQ(0, create(cert, KEYSIZE_EC_P256, times));
+    checkPair(cert, MBEDTLS_PK_ECKEY, 256, "ECDSA with SHA256");
+    keyLen = cert.getPKLength();
+    certLen = cert.getCertLength();
+    cert.clear();
+  }
+  REPORT("P-256:    gen_key %6.1f-%6.1fms, cert_write %5.1f-%5.1fms, key %3d bytes, certificate %3d bytes",
+         times.key, times.keyMax, times.cert, times.certMax, (int)keyLen, (int)certLen);
+}
+
+TEST(rsa_2048)
+{
+  const int Rounds = 3;
+  sCertTimes times = { 1e9, 0, 1e9, 0 };
+  size_t keyLen = 0, certLen = 0;
+  for(int i = 0; i < Rounds; i++) {
+    SSLCert cert;
+    CHECK_EQ(0, create(cert, KEYSIZE_2048, times));
+    checkPair(cert, MBEDTLS_PK_RSA, 2048, "RSA with SHA-256");
+    keyLen = cert.getPKLength();
+    certLen = cert.getCertLength();
+    cert.clear();
+  }
+  REPORT("RSA 2048: gen_key %6.1f-%6.1fms, cert_write %5.1f-%5.1fms, key %3d bytes, certificate %3d bytes",
+         times.key, times.keyMax, times.cert, times.certMax, (int)keyLen, (int)certLen);
+}
+
+// a key that does not parse is reported, not written into a certificate
+TEST(bad_key)
+{
+  SSLCert cert;
+  unsigned char* junk = new unsigned char[32];
+  memset(junk, 0x5a, 32);
+  cert.setPK(junk, 32);
+  CHECK_EQ(HTTPS_SERVER_ERROR_CERTGEN_READKEY, cert_write(cert, DN, "20190101000000", "20300101000000"));
+  CHECK_EQ(0, cert.getCertLength());
+  cert.clear();
+}
@@ -0,0 +1,442 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Status snapshot behind GET /api/status and /api/events, refreshed on demand
+//
+// loop() only refreshes the snapshot (updateJSONstatus()) whilst a status 
+// or event client has asked within STATUS_REQUEST_HOLD. A client asking
+// after none have must not be served the lagging snapshot: a poll waits
+// up to STATUS_REQUEST_WAIT for the next refresh, or is refused (503),
+// an event stream holds its events until then. Here loop()'s side is a
+// merge and commit() of canned JSON, gated as updateJSONstatus() gates it.
+// Event streams (CStatusEventStream) are checked for their framing, the
+// items each event carries, coalescing, deferral, truncation, keepalives 
+// and the per server stream limit. Then 2 to 60 streams are served by one
+// server task as the snapshot is refreshed from another, reporting the
+// delay from commit() to each stream's event and the heap per stream,
+// serving them must not allocate.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "HostTest.h"
+#include "Utility/StatusSnapshot.h"
+#include "WiFi/StatusEvents.h"
+
+static int Refreshes = 0;
+
+static void
+setup()
+{
+  static bool begun = false;
+  if(!begun) {
+    StatusSnapshot.begin();
+    begun = true;
+  }
+  hostSimTicks(true);
+  hostAdvanceTicks(STATUS_REQUEST_HOLD);    // nobody has asked for a while
+  Refreshes = 0;
+}
+
+// as updateJSONstatus(), after each blue wire exchange
+static void
+blueWireExchange(int seq)
+{
+  if(!StatusSnapshot.isWanted())
+    return;
+  char json[64];
+  snprintf(json, sizeof(json), "{\"RunState\":%d,\"TempCurrent\":%d.5}", seq % 10, 15 + seq % 7);
+  StatusSnapshot.merge(json);
+  StatusSnapshot.commit();
+  Refreshes++;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// without a client, loop() builds nothing
+TEST(no_client_no_refresh)
+{
+  setup();
+  for(int seq = 0; seq < 100; seq++) {
+    blueWireExchange(seq);
+    hostAdvanceTicks(1000);
+  }
+  CHECK_EQ(0, Refreshes);
+  CHECK(!StatusSnapshot.isWanted());
+}
+
+// an event stream asks on every server pass, its first event waits for a refresh
+TEST(stream_held_until_refreshed)
+{
+  setup();
+  CHECK(!StatusSnapshot.request());
+  CHECK(StatusSnapshot.isWanted());
+  CHECK(!StatusSnapshot.request());         // still lagging, asking again does not make it current
+  blueWireExchange(1);
+  CHECK_EQ(1, Refreshes);
+  CHECK(StatusSnapshot.request());
+  // whilst the stream stays open the refreshes carry on
+  for(int seq = 2; seq < 100; seq++) {
+    hostAdvanceTicks(1000);
+    CHECK(StatusSnapshot.request());
+    blueWireExchange(seq);
+  }
+  CHECK_EQ(99, Refreshes);
+  // closed, the refreshes stop STATUS_REQUEST_HOLD later
+  hostAdvanceTicks(STATUS_REQUEST_HOLD - 1);
+  blueWireExchange(100);
+  CHECK_EQ(100, Refreshes);
+  hostAdvanceTicks(1);
+  blueWireExchange(101);
+  CHECK_EQ(100, Refreshes);
+  CHECK(!StatusSnapshot.request());
+}
+
+// with no blue wire exchange a poll gives up after STATUS_REQUEST_WAIT
+TEST(poll_wait_times_out)
+{
+  setup();
+  unsigned long tStart = millis();
+  CHECK(!StatusSnapshot.request(STATUS_REQUEST_WAIT));
+  CHECK_EQ(STATUS_REQUEST_WAIT, millis() - tStart);
+}
+
+// a poll after none for a while is answered once loop() has refreshed the snapshot,
+// a second poll arriving meanwhile waits for the same refresh
+TEST(poll_waits_for_refresh)
+{
+  setup();
+  hostSimTicks(false);
+  std::atomic<int> answered(0);
+  std::atomic<bool> current[2];
+  auto poll = [&](int i) {
+    current[i] = StatusSnapshot.request(STATUS_REQUEST_WAIT);
+    answered++;
+  };
+  double tStart = hostNow_us();
+  std::thread first(poll, 0);
+  delay(50);
+  std::thread second(poll, 1);
+  delay(200);
+  CHECK_EQ(0, answered);
+  blueWireExchange(1);                      // loop(), the next blue wire exchange
+  first.join();
+  second.join();
+  double elapsed = hostNow_us() - tStart;
+  CHECK_EQ(2, answered);
+  CHECK(current[0]);
+  CHECK(current[1]);
+  CHECK_EQ(1, Refreshes);
+  REPORT("polls answered %.0fms after the first asked, one refresh", elapsed / 1000);
+  // from here on polls are answered at once
+  tStart = hostNow_us();
+  CHECK(StatusSnapshot.request(STATUS_REQUEST_WAIT));
+  CHECK(hostNow_us() - tStart < 5000);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// event streams
+
+static void
+refresh(const char* json)
+{
+  char buf[512];
+  strcpy(buf, json);
+  StatusSnapshot.merge(buf);
+  StatusSnapshot.commit();
+}
+
+static const char*
+nextEvent(CStatusEventStream& stream, char* buf, int size = STATUS_EVENT_SIZE)
+{
+  const char* pEvent;
+  int len = stream.render(buf, size, pEvent);
+  CHECK_EQ((int)strlen(pEvent), len);
+  return pEvent;
+}
+
+// the whole snapshot first, then only what changed, framed with the version
+TEST(events_carry_changes)
+{
+  setup();
+  char buf[STATUS_EVENT_SIZE];
+  char expected[256];
+  CStatusEventStream stream;
+  CHECK(!stream.due());                     // stale until refreshed
+  refresh("{\"RunState\":1,\"TempCurrent\":20.5,\"SSID\":\"Home\"}");
+  CHECK(stream.due());
+  snprintf(expected, sizeof(expected), "id: %u\ndata: {\"RunState\":1,\"TempCurrent\":20.5,\"SSID\":\"Home\"}\n\n", 
+           StatusSnapshot.getVersion());
+  CHECK_STREQ(expected, nextEvent(stream, buf));
+  stream.sent();
+  CHECK_EQ(StatusSnapshot.getVersion(), stream.getVersion());
+  hostAdvanceTicks(SSE_MIN_INTERVAL);
+  CHECK(!stream.due());
+  refresh("{\"RunState\":1,\"TempCurrent\":20.5,\"SSID\":\"Home\"}");   // unchanged, no new version
+  CHECK(!stream.due());
+  refresh("{\"RunState\":1,\"TempCurrent\":21,\"SSID\":\"Home\"}");
+  CHECK(stream.due());
+  snprintf(expected, sizeof(expected), "id: %u\ndata: {\"TempCurrent\":21}\n\n", StatusSnapshot.getVersion());
+  CHECK_STREQ(expected, nextEvent(stream, buf));
+  stream.sent();
+}
+
+// changes within SSE_MIN_INTERVAL, or whilst the socket is full, coalesce into one event
+TEST(events_coalesce_and_defer)
+{
+  setup();
+  char buf[STATUS_EVENT_SIZE];
+  char expected[256];
+  CStatusEventStream stream;
+  CHECK(!stream.due());                     // asks, stale until refreshed
+  refresh("{\"RunState\":2,\"TempCurrent\":18,\"SSID\":\"Home\"}");
+  CHECK(stream.due());
+  nextEvent(stream, buf);
+  stream.sent();
+  refresh("{\"RunState\":3}");
+  hostAdvanceTicks(SSE_MIN_INTERVAL - 1);
+  CHECK(!stream.due());
+  hostAdvanceTicks(1);
+  CHECK(stream.due());
+  // the socket is full, nothing is rendered or sent
+  refresh("{\"TempCurrent\":18.5}");
+  CHECK(stream.due());
+  nextEvent(stream, buf);                   // rendered but not sent
+  refresh("{\"SSID\":\"Away\"}");
+  CHECK(stream.due());
+  snprintf(expected, sizeof(expected), "id: %u\ndata: {\"RunState\":3,\"TempCurrent\":18.5,\"SSID\":\"Away\"}\n\n", 
+           StatusSnapshot.getVersion());
+  CHECK_STREQ(expected, nextEvent(stream, buf));
+  stream.sent();
+  CHECK(!stream.due());
+}
+
+// items that do not fit follow in the next event, the id is held back until they have
+TEST(events_truncated_catch_up)
+{
+  setup();
+  char buf[STATUS_EVENT_SIZE];
+  char expected[256];
+  CStatusEventStream stream;
+  CHECK(!stream.due());                     // asks, stale until refreshed
+  refresh("{\"RunState\":4,\"TempCurrent\":19,\"SSID\":\"Home\"}");
+  CHECK(stream.due());
+  nextEvent(stream, buf);
+  stream.sent();
+  uint32_t version = stream.getVersion();
+  hostAdvanceTicks(SSE_MIN_INTERVAL);
+  refresh("{\"RunState\":5}");
+  refresh("{\"SSID\":\"Campsite\"}");
+  CHECK(stream.due());
+  // room for {"RunState":5} only
+  snprintf(expected, sizeof(expected), "id: %u\ndata: {\"RunState\":5}\n\n", version + 1);
+  CHECK_STREQ(expected, nextEvent(stream, buf, 24 + 3 + 20));
+  stream.sent();
+  CHECK_EQ(version + 1, stream.getVersion());
+  hostAdvanceTicks(SSE_MIN_INTERVAL);
+  CHECK(stream.due());
+  snprintf(expected, sizeof(expected), "id: %u\ndata: {\"SSID\":\"Campsite\"}\n\n", version + 2);
+  CHECK_STREQ(expected, nextEvent(stream, buf));
+  stream.sent();
+}
+
+// an idle stream is kept open with a comment, the client's version is unchanged
+TEST(events_keepalive)
+{
+  setup();
+  char buf[STATUS_EVENT_SIZE];
+  CStatusEventStream stream;
+  CHECK(!stream.due());                     // asks, stale until refreshed
+  refresh("{\"RunState\":6}");
+  CHECK(stream.due());
+  nextEvent(stream, buf);
+  stream.sent();
+  uint32_t version = stream.getVersion();
+  hostAdvanceTicks(SSE_KEEPALIVE - 1);
+  StatusSnapshot.request();
+  CHECK(!stream.due());
+  hostAdvanceTicks(1);
+  CHECK(stream.due());
+  CHECK_STREQ(": keepalive\n\n", nextEvent(stream, buf));
+  stream.sent();
+  CHECK_EQ(version, stream.getVersion());
+  CHECK(!stream.due());
+}
+
+// each server takes SSE_MAX_CLIENTS streams, the next is refused (503)
+TEST(stream_limit)
+{
+  CStatusStreamLimit limit;
+  for(int i = 0; i < SSE_MAX_CLIENTS; i++)
+    CHECK(limit.acquire());
+  CHECK(!limit.acquire());
+  CHECK(!limit.acquire());
+  CHECK_EQ(SSE_MAX_CLIENTS, limit.getOpen());
+  CHECK_EQ(2u, limit.getRefused());
+  limit.release();
+  CHECK(limit.acquire());
+  CHECK_EQ(SSE_MAX_CLIENTS, limit.getOpen());
+}
+
+///////////////////////////////////////////////////////////////////////////
+// many streams served by one server task
+
+// C++ allocations, by the thread making them
+static thread_local uint32_t Allocs = 0;
+static thread_local size_t AllocBytes = 0;
+
+void* operator new(size_t size)
+{
+  Allocs++;
+  AllocBytes += size;
+  void* ptr = malloc(size ? size : 1);
+  if(ptr == NULL)
+    abort();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+static const int BenchItems = 70;           // about as many as updateJSONstatus() merges
+static const int BenchChanges = 8;          // changed per refresh
+static const int BenchRefreshes = 6;
+static const int BenchPeriod = 300;         // ms, over SSE_MIN_INTERVAL so every refresh is sent
+
+// a blue wire refresh: BenchChanges of the items change, merged in fragments 
+// of 10 as updateJSONstatus() merges each JSON fragment it builds
+static void
+benchRefresh(double* commitTimes)
+{
+  static int seq = 0;
+  static int values[BenchItems];
+  char json[512];
+  int len = 0;
+  seq++;
+  for(int i = 0; i < BenchItems; i++) {
+    if(seq == 1 || (i + seq) % (BenchItems / BenchChanges) == 0)
+      values[i] = seq * 100 + i;
+    len += sprintf(&json[len], "%s\"Bench%02d\":%d", len ? "," : "{", i, values[i]);
+    if(i % 10 == 9 || i == BenchItems - 1) {
+      strcpy(&json[len], "}");
+      StatusSnapshot.merge(json);
+      len = 0;
+    }
+  }
+  commitTimes[StatusSnapshot.getVersion() + 1] = hostNow_us();
+  StatusSnapshot.commit();
+}
+
+static double
+percentile(std::vector<double>& values, int pc)
+{
+  if(values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * pc / 100)];
+}
+
+TEST(many_streams_delay_and_heap)
+{
+  setup();
+  hostSimTicks(false);
+  const int counts[] = { 2, 16, 32, 60 };
+  static char event[STATUS_EVENT_SIZE];
+  static char sink[STATUS_EVENT_SIZE];
+  static double commitTimes[100000];
+  StatusSnapshot.request();
+  benchRefresh(commitTimes);                // the streams' first event, the full snapshot, is sent at once
+  for(int streams : counts) {
+    std::vector<double> delays;
+    delays.reserve(streams * (BenchRefreshes + 2));
+    double renderTime = 0;
+    uint32_t firstEvents = 0, events = 0, bytes = 0, firstBytes = 0;
+
+    std::vector<CStatusEventStream*> clients;
+    clients.reserve(streams);
+    size_t heapBefore = AllocBytes;
+    for(int i = 0; i < streams; i++)
+      clients.push_back(new CStatusEventStream);
+    size_t heapStreams = AllocBytes - heapBefore;
+
+    // loop() refreshes from its own task whilst the streams are open
+    std::atomic<bool> done(false);
+    StatusSnapshot.request();
+    std::thread loopTask([&]() {
+      for(int seq = 0; seq < BenchRefreshes; seq++) {
+        delay(BenchPeriod);
+        if(StatusSnapshot.isWanted())
+          benchRefresh(commitTimes);
+      }
+      delay(SSE_MIN_INTERVAL);              // for the last events
+      done = true;
+    });
+    // the server task, one pass over its streams then vTaskDelay(1)
+    uint32_t allocsServing = Allocs;
+    while(!done) {
+      for(CStatusEventStream* pStream : clients) {
+        if(!pStream->due())
+          continue;
+        uint32_t held = pStream->getVersion();
+        double tStart = hostNow_us();
+        const char* pEvent;
+        int len = pStream->render(event, sizeof(event), pEvent);
+        memcpy(sink, pEvent, len);          // the socket
+        pStream->sent();
+        double tSent = hostNow_us();
+        renderTime += tSent - tStart;
+        if(held == 0) {
+          firstBytes = len;             // the full snapshot
+          firstEvents++;
+        }
+        else if(pEvent[0] == 'i') {
+          delays.push_back(tSent - commitTimes[pStream->getVersion()]);
+          bytes += len;
+          events++;
+        }
+      }
+      vTaskDelay(1);
+    }
+    allocsServing = Allocs - allocsServing;
+    loopTask.join();
+    for(CStatusEventStream* pStream : clients)
+      delete pStream;
+
+    CHECK_EQ((uint32_t)streams, firstEvents);
+    CHECK_EQ((uint32_t)streams * BenchRefreshes, events);
+    CHECK_EQ(0u, allocsServing);            // serving the streams allocates nothing
+    double deltaBytes = events ? double(bytes) / events : 0;
+    REPORT("%2d streams: delay p50 %.2fms p99 %.2fms, render %.1fus per event, full %u B, delta %.0f B, heap %u B per stream", 
+           streams, percentile(delays, 50) / 1000, percentile(delays, 99) / 1000, renderTime / (firstEvents + events), 
+           firstBytes, deltaBytes, unsigned(heapStreams / streams));
+  }
+}
@@ -0,0 +1,303 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host (Linux) stand in for the ESP32 Arduino core
+//
+// Just enough of the Arduino API for the application modules to build and
+// run under test. Time comes from the host FreeRTOS tick (see HostRTOS.cpp),
+// so tests can either run in real time or step a simulated tick.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <FreeRTOS.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef int esp_err_t;
+
+#define ESP_OK     0
+#define ESP_FAIL   -1
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+#define IRAM_ATTR
+#define PROGMEM
+#define PSTR(x) x
+#define F(x) x
+class __FlashStringHelper;
+#define pgm_read_byte(x)      (*(const uint8_t*)(x))
+#define pgm_read_byte_near(x) (*(const uint8_t*)(x))
+#define pgm_read_word(x)      (*(const uint16_t*)(x))
+#define pgm_read_dword(x)     (*(const uint32_t*)(x))
+#define pgm_read_ptr(x)       (*(void* const*)(x))
+#define memcpy_P  memcpy
+#define strcpy_P  strcpy
+#define strlen_P  strlen
+#define strcmp_P  strcmp
+#define strncmp_P strncmp
+#define sprintf_P sprintf
+
+#define ESP_LOGE(tag, ...) do {} while(0)
+#define ESP_LOGW(tag, ...) do {} while(0)
+#define ESP_LOGI(tag, ...) do {} while(0)
+#define ESP_LOGD(tag, ...) do {} while(0)
+#define ESP_LOGV(tag, ...) do {} while(0)
+#define log_e(...) do {} while(0)
+#define log_w(...) do {} while(0)
+#define log_i(...) do {} while(0)
+#define log_d(...) do {} while(0)
+#define log_v(...) do {} while(0)
+#define ets_printf(...) fprintf(stderr, __VA_ARGS__)   // ROM printf, does not allocate
+
+// time - millis() is wrapped at link time, exactly as the target build (see HostArduino.cpp)
+extern "C" unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// GPIO, tests may drive inputs via hostSetPin() and read outputs with hostGetPin()
+#define LOW          0
+#define HIGH         1
+#define INPUT        0x01
+#define OUTPUT       0x02
+#define INPUT_PULLUP 0x05
+#define RISING       0x01
+#define FALLING      0x02
+#define CHANGE       0x03
+
+typedef enum {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6, GPIO_NUM_7,
+  GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15,
+  GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20, GPIO_NUM_21, GPIO_NUM_22, GPIO_NUM_23,
+  GPIO_NUM_24, GPIO_NUM_25, GPIO_NUM_26, GPIO_NUM_27, GPIO_NUM_28, GPIO_NUM_29, GPIO_NUM_30, GPIO_NUM_31,
+  GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_36, GPIO_NUM_37, GPIO_NUM_38, GPIO_NUM_39,
+  GPIO_NUM_MAX
+} gpio_num_t;
+
+void pinMode(uint8_t pin, uint8_t mode);
+int  digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+void hostSetPin(uint8_t pin, int level);     // runs any attached interrupt handler
+int  hostGetPin(uint8_t pin);
+
+#define digitalPinToPort(p)       0
+#define digitalPinToBitMask(p)    0
+#define portOutputRegister(p)     ((volatile uint32_t*)0)
+
+// LEDC PWM
+void ledcSetup(uint8_t chan, double freq, uint8_t bits);
+void ledcAttachPin(uint8_t pin, uint8_t chan);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t chan, uint32_t duty);
+int  hostLedcPin(uint8_t pin);               // channel the pin is attached to, -1 if none
+
+// hardware timers
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool edge);
+void timerAlarmWrite(hw_timer_t* timer, uint64_t count, bool autoreload);
+void timerAlarmEnable(hw_timer_t* timer);
+void timerAlarmDisable(hw_timer_t* timer);
+void timerSetAutoReload(hw_timer_t* timer, bool autoreload);
+void timerWrite(hw_timer_t* timer, uint64_t val);
+void timerStart(hw_timer_t* timer);
+void timerStop(hw_timer_t* timer);
+uint64_t timerRead(hw_timer_t* timer);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+using std::min;
+using std::max;
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+///////////////////////////////////////////////////////////////////////////
+// String
+
+class String {
+  std::string _s;
+public:
+  String(const char* s = "") : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  String(int val, unsigned char base = 10) { _fmt(base == 16 ? "%x" : "%d", val); }
+  String(unsigned int val, unsigned char base = 10) { _fmt(base == 16 ? "%x" : "%u", val); }
+  String(long val, unsigned char base = 10) { _fmt(base == 16 ? "%lx" : "%ld", val); }
+  String(unsigned long val, unsigned char base = 10) { _fmt(base == 16 ? "%lx" : "%lu", val); }
+  String(double val, unsigned char decimals = 2) { char f[8]; snprintf(f, 8, "%%.%df", decimals); _fmt(f, val); }
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool reserve(unsigned int size) { _s.reserve(size); return true; }
+  char operator[](unsigned int idx) const { return idx < _s.size() ? _s[idx] : 0; }
+  char& operator[](unsigned int idx) { return _s[idx]; }
+  char charAt(unsigned int idx) const { return (*this)[idx]; }
+  String& operator+=(const String& rhs) { _s += rhs._s; return *this; }
+  String& operator+=(const char* rhs) { _s += rhs; return *this; }
+  String& operator+=(char rhs) { _s += rhs; return *this; }
+  String& operator+=(int rhs) { return *this += String(rhs); }
+  bool concat(const String& rhs) { *this += rhs; return true; }
+  bool concat(const char* rhs) { *this += rhs; return true; }
+  bool concat(char rhs) { *this += rhs; return true; }
+  bool concat(int rhs) { *this += rhs; return true; }
+  bool operator==(const String& rhs) const { return _s == rhs._s; }
+  bool operator==(const char* rhs) const { return _s == rhs; }
+  bool operator!=(const String& rhs) const { return _s != rhs._s; }
+  bool operator!=(const char* rhs) const { return _s != rhs; }
+  bool operator<(const String& rhs) const { return _s < rhs._s; }
+  bool equals(const String& rhs) const { return _s == rhs._s; }
+  bool equalsIgnoreCase(const String& rhs) const { return strcasecmp(c_str(), rhs.c_str()) == 0; }
+  int compareTo(const String& rhs) const { return _s.compare(rhs._s); }
+  bool startsWith(const String& s) const { return _s.compare(0, s._s.size(), s._s) == 0; }
+  bool endsWith(const String& s) const { return _s.size() >= s._s.size() && _s.compare(_s.size() - s._s.size(), s._s.size(), s._s) == 0; }
+  int indexOf(char c, unsigned int from = 0) const { return _pos(_s.find(c, from)); }
+  int indexOf(const String& s, unsigned int from = 0) const { return _pos(_s.find(s._s, from)); }
+  int lastIndexOf(char c) const { return _pos(_s.rfind(c)); }
+  String substring(unsigned int from, unsigned int to = 0xffffffff) const { return from < _s.size() ? String(_s.substr(from, to - from)) : String(); }
+  void remove(unsigned int idx, unsigned int count = 0xffffffff) { if(idx < _s.size()) _s.erase(idx, count); }
+  void replace(const String& from, const String& to);
+  void trim();
+  void toLowerCase() { for(auto& c : _s) c = tolower(c); }
+  void toUpperCase() { for(auto& c : _s) c = toupper(c); }
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return atof(c_str()); }
+  void toCharArray(char* buf, unsigned int size) const { strncpy(buf, c_str(), size); if(size) buf[size-1] = 0; }
+  void getBytes(unsigned char* buf, unsigned int size) const { toCharArray((char*)buf, size); }
+private:
+  static int _pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  template<typename T> void _fmt(const char* fmt, T val) { char buf[40]; snprintf(buf, sizeof(buf), fmt, val); _s = buf; }
+};
+
+// a distinct type, as in the Arduino core (ArduinoJson specialises on both)
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+};
+inline StringSumHelper operator+(const String& lhs, const String& rhs) { String s(lhs); s += rhs; return s; }
+inline StringSumHelper operator+(const String& lhs, const char* rhs) { String s(lhs); s += rhs; return s; }
+inline StringSumHelper operator+(const char* lhs, const String& rhs) { String s(lhs); s += rhs; return s; }
+inline StringSumHelper operator+(const String& lhs, char rhs) { String s(lhs); s += rhs; return s; }
+
+///////////////////////////////////////////////////////////////////////////
+// Print / Stream
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) { size_t n = 0; while(n < size && write(buf[n])) n++; return n; }
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buf, size_t size) { return write((const uint8_t*)buf, size); }
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& str) { return write(str.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int val, int base = 10) { return print(String(val, base)); }
+  size_t print(unsigned int val, int base = 10) { return print(String(val, base)); }
+  size_t print(long val, int base = 10) { return print(String(val, base)); }
+  size_t print(unsigned long val, int base = 10) { return print(String(val, base)); }
+  size_t print(double val, int decimals = 2) { return print(String(val, decimals)); }
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(const T& val) { size_t n = print(val); return n + println(); }
+  template<typename T> size_t println(const T& val, int fmt) { size_t n = print(val, fmt); return n + println(); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+protected:
+  unsigned long _timeout = 1000;
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  size_t readBytes(char* buf, size_t len);
+  size_t readBytes(uint8_t* buf, size_t len) { return readBytes((char*)buf, len); }
+  size_t readBytesUntil(char term, char* buf, size_t len);
+  String readStringUntil(char term);
+};
+
+#define SERIAL_8N1 0x800001c
+
+// Serial output is discarded unless HOST_SERIAL is set in the environment
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial(int uart = 0) : _uart(uart) {}
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1, bool invert = false) { _baud = baud; }
+  uint32_t baudRate() { return _baud; }
+  void end() {}
+  void updateBaudRate(unsigned long baud) {}
+  void setRxBufferSize(size_t size) {}
+  using Print::write;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size);
+  int availableForWrite();
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  operator bool() const { return true; }
+private:
+  int _uart;
+  uint32_t _baud = 115200;
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+// Serial (UART0) output is also passed to the sink, NULL stops the capture
+void hostCaptureSerial(void (*sink)(const uint8_t* buf, size_t size));
+// model UART0 as the target's 128 byte TX FIFO, emptied in real time at the
+// baud rate: write() waits for room as the Arduino HAL does
+void hostSerialUART(bool model);
+
+
+///////////////////////////////////////////////////////////////////////////
+// ESP
+
+class EspClass {
+public:
+  uint32_t getHeapSize() { return 327680; }
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  void restart() { exit(0); }
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host BLE stack, a GATT server with one link
+//
+// A client is attached with hostBLEConnect() at the MTU it negotiates.
+// Each notify() costs 150us and is queued in the stack, which carries 4
+// packets per 15ms connection event. A notification is truncated to
+// MTU-3 as the stack does. ESP_GATTS_CONF_EVT follows each notify(),
+// with ESP_GATT_CONGESTED once more than 8 are queued, when
+// ESP_GATTS_CONGEST_EVT is also raised. That clears when 4 or fewer
+// remain. More than 16 queued and notifications are lost.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_BLEDEVICE_H__
+#define __HOST_BLEDEVICE_H__
+
+#include <Arduino.h>
+#include <string>
+
+#define ESP_GATT_DEF_BLE_MTU_SIZE 23
+#define ESP_GATT_MAX_MTU_SIZE     517
+
+typedef enum {
+  ESP_GATTS_MTU_EVT = 4,
+  ESP_GATTS_CONF_EVT = 5,
+  ESP_GATTS_CONNECT_EVT = 14,
+  ESP_GATTS_DISCONNECT_EVT = 15,
+  ESP_GATTS_CONGEST_EVT = 24,
+} esp_gatts_cb_event_t;
+
+typedef enum { ESP_GATT_OK = 0, ESP_GATT_CONGESTED = 0x8f } esp_gatt_status_t;
+typedef uint8_t esp_gatt_if_t;
+
+typedef union {
+  struct { uint16_t conn_id; uint16_t mtu; } mtu;
+  struct { esp_gatt_status_t status; uint16_t conn_id; uint16_t handle; uint16_t len; uint8_t* value; } conf;
+  struct { uint16_t conn_id; bool congested; } congest;
+} esp_ble_gatts_cb_param_t;
+
+typedef void (*tGattsHandler)(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param);
+
+class BLEServer;
+class BLECharacteristic;
+
+class BLEServerCallbacks {
+public:
+  virtual ~BLEServerCallbacks() {}
+  virtual void onConnect(BLEServer* pServer) {}
+  virtual void onDisconnect(BLEServer* pServer) {}
+};
+
+class BLECharacteristicCallbacks {
+public:
+  virtual ~BLECharacteristicCallbacks() {}
+  virtual void onWrite(BLECharacteristic* pCharacteristic) {}
+};
+
+class BLEDescriptor {
+public:
+  virtual ~BLEDescriptor() {}
+};
+
+class BLE2902 : public BLEDescriptor {};
+
+class BLECharacteristic {
+  std::string _value;
+  BLECharacteristicCallbacks* _pCallbacks = NULL;
+public:
+  static const uint32_t PROPERTY_WRITE = 1 << 3;
+  static const uint32_t PROPERTY_NOTIFY = 1 << 4;
+  void setValue(uint8_t* data, size_t size) { _value.assign((const char*)data, size); }
+  std::string getValue() { return _value; }
+  void setCallbacks(BLECharacteristicCallbacks* pCallbacks) { _pCallbacks = pCallbacks; }
+  void addDescriptor(BLEDescriptor* pDescriptor) {}
+  void notify();
+};
+
+class BLEService {
+public:
+  BLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties) { return new BLECharacteristic; }
+  void start() {}
+};
+
+class BLEAdvertising {
+public:
+  void start() {}
+};
+
+class BLEServer {
+  BLEAdvertising _advertising;
+public:
+  BLEServerCallbacks* pCallbacks = NULL;
+  void setCallbacks(BLEServerCallbacks* callbacks) { pCallbacks = callbacks; }
+  BLEService* createService(const char* uuid) { return new BLEService; }
+  BLEAdvertising* getAdvertising() { return &_advertising; }
+  void startAdvertising() {}
+};
+
+class BLEDevice {
+public:
+  static void init(std::string name) {}
+  static void setMTU(uint16_t mtu) {}
+  static void setCustomGattsHandler(tGattsHandler handler);
+  static BLEServer* createServer();
+};
+
+struct sHostBLELink {
+  int notifies;               // notify() calls whilst connected
+  int lost;                   // stack queue was full
+  int maxQueued;
+  std::string received;       // as the client reassembles the notifications
+};
+
+void hostBLEConnect(uint16_t mtu);
+void hostBLEDisconnect();
+bool hostBLEIdle();           // nothing queued in the stack
+sHostBLELink hostBLELink();   // a copy, the stack may be carrying packets
+void hostBLEReset();
+
+#endif
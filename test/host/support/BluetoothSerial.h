@@ -0,0 +1,54 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host BluetoothSerial (Classic SPP). A client is attached with
+// hostBTClient(), each write() is recorded as one block handed to the stack.
+
+#ifndef __HOST_BLUETOOTHSERIAL_H__
+#define __HOST_BLUETOOTHSERIAL_H__
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+class BluetoothSerial : public Stream {
+public:
+  bool begin(String name) { return true; }
+  bool hasClient();
+  using Print::write;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+};
+
+struct sHostBTLink {
+  std::string received;
+  std::vector<int> blocks;    // size of each write()
+};
+
+void hostBTClient(bool connected);
+sHostBTLink hostBTLink();     // a copy, the TX task may be writing
+void hostBTReset();
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host (Linux) stand in for the ESP-IDF FreeRTOS API
+//
+// Tasks are threads, queues, semaphores and ring buffers are built on
+// std::mutex / std::condition_variable. Critical sections take one global
+// recursive lock, which is all the application relies upon.
+//
+// The tick normally follows the host clock (1ms per tick). A test may
+// instead call hostSimTicks(true) then step the tick itself, in which case
+// vTaskDelay() and delay() advance the tick rather than sleep, and software
+// timers fire as the tick passes them. Simulated ticks are for single 
+// threaded tests.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_FREERTOS_H__
+#define __HOST_FREERTOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* RingbufHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE   1
+#define pdFALSE  0
+#define pdPASS   1
+#define pdFAIL   0
+#define errQUEUE_FULL 0
+#define portMAX_DELAY      0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define portTICK_RATE_MS   1
+#define pdMS_TO_TICKS(ms)  (ms)
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY   0
+#define tskNO_AFFINITY     0x7fffffff
+
+// tick control for tests
+void hostSimTicks(bool simulate);
+void hostSetTicks(TickType_t ticks);
+void hostAdvanceTicks(TickType_t ticks);
+
+// critical sections
+typedef struct {
+  volatile uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  vPortExitCritical(mux)
+#define portYIELD_FROM_ISR()
+#define xPortGetCoreID()            1
+
+// tasks
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param, UBaseType_t priority, TaskHandle_t* pHandle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param, UBaseType_t priority, TaskHandle_t* pHandle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* pPrevWake, TickType_t increment);
+TickType_t xTaskGetTickCount();
+TickType_t xTaskGetTickCountFromISR();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetTaskName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* pWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+// queues
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* pWoken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void* item, BaseType_t* pWoken);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// semaphores and mutexes
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* pWoken);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+
+#endif
@@ -0,0 +1,710 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host Arduino core, see Arduino.h
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <WiFi.h>
+#include <SPI.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <nvs.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include "HostTest.h"
+#include <lwip/sockets.h>
+#include <poll.h>
+#include <errno.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+///////////////////////////////////////////////////////////////////////////
+// time
+//
+// The target links with -Wl,--wrap,millis and src/Afterburner.cpp supplies
+// __wrap_millis() from the FreeRTOS tick. The host tests link the same way
+// and this is the same hook, so a test stepping the tick steps millis().
+// __real_millis() is the free running host clock.
+
+static const steady_clock::time_point hostStart = steady_clock::now();
+
+extern "C" unsigned long millis()
+{
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now() - hostStart).count();
+}
+
+extern "C" unsigned long __wrap_millis()
+{
+  return xTaskGetTickCount();
+}
+
+unsigned long micros()
+{
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now() - hostStart).count();
+}
+
+void delay(unsigned long ms)
+{
+  vTaskDelay(ms);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  std::this_thread::sleep_for(microseconds(us));
+}
+
+void yield()
+{
+  std::this_thread::yield();
+}
+
+long random(long howbig)
+{
+  static std::mt19937 rng(1);
+  return howbig > 0 ? rng() % howbig : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// GPIO
+
+struct sHostPin {
+  int level;
+  int mode;
+  void (*handler)(void);
+  void (*argHandler)(void*);
+  void* arg;
+  int edge;
+  int ledc;       // LEDC channel + 1 while attached, 0 when not
+};
+static sHostPin pins[GPIO_NUM_MAX] = {};
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  pins[pin].mode = mode;
+  if(mode == INPUT_PULLUP)
+    pins[pin].level = HIGH;
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pins[pin].level;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  pins[pin].level = val ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  return 0;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+  pins[pin].handler = handler;
+  pins[pin].argHandler = NULL;
+  pins[pin].edge = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode)
+{
+  pins[pin].handler = NULL;
+  pins[pin].argHandler = handler;
+  pins[pin].arg = arg;
+  pins[pin].edge = mode;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  pins[pin].handler = NULL;
+  pins[pin].argHandler = NULL;
+}
+
+void hostSetPin(uint8_t pin, int level)
+{
+  sHostPin& p = pins[pin];
+  int prev = p.level;
+  p.level = level ? HIGH : LOW;
+  if(prev == p.level)
+    return;
+  bool fire = p.edge == CHANGE || (p.edge == RISING && p.level) || (p.edge == FALLING && !p.level);
+  if(fire && p.handler)
+    p.handler();
+  if(fire && p.argHandler)
+    p.argHandler(p.arg);
+}
+
+int hostGetPin(uint8_t pin)
+{
+  return pins[pin].level;
+}
+
+void ledcSetup(uint8_t chan, double freq, uint8_t bits) {}
+void ledcAttachPin(uint8_t pin, uint8_t chan) { pins[pin].ledc = chan + 1; }
+void ledcDetachPin(uint8_t pin) { pins[pin].ledc = 0; }
+int hostLedcPin(uint8_t pin) { return pins[pin].ledc - 1; }
+void ledcWrite(uint8_t chan, uint32_t duty) {}
+
+///////////////////////////////////////////////////////////////////////////
+// hardware timers, not run on the host
+
+struct hw_timer_s {
+  uint64_t count;
+};
+static hw_timer_s timers[4];
+
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp) { return &timers[num & 3]; }
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool edge) {}
+void timerAlarmWrite(hw_timer_t* timer, uint64_t count, bool autoreload) {}
+void timerAlarmEnable(hw_timer_t* timer) {}
+void timerAlarmDisable(hw_timer_t* timer) {}
+void timerSetAutoReload(hw_timer_t* timer, bool autoreload) {}
+void timerWrite(hw_timer_t* timer, uint64_t val) { timer->count = val; }
+void timerStart(hw_timer_t* timer) {}
+void timerStop(hw_timer_t* timer) {}
+uint64_t timerRead(hw_timer_t* timer) { return timer->count; }
+
+///////////////////////////////////////////////////////////////////////////
+// String, Print, Stream
+
+void String::replace(const String& from, const String& to)
+{
+  if(from._s.empty())
+    return;
+  size_t pos = 0;
+  while((pos = _s.find(from._s, pos)) != std::string::npos) {
+    _s.replace(pos, from._s.size(), to._s);
+    pos += to._s.size();
+  }
+}
+
+void String::trim()
+{
+  size_t start = _s.find_first_not_of(" \t\r\n");
+  size_t end = _s.find_last_not_of(" \t\r\n");
+  _s = start == std::string::npos ? std::string() : _s.substr(start, end - start + 1);
+}
+
+size_t Print::printf(const char* fmt, ...)
+{
+  char buf[512];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if(len < 0)
+    return 0;
+  if(len < (int)sizeof(buf))
+    return write((const uint8_t*)buf, len);
+  std::vector<char> big(len + 1);
+  va_start(args, fmt);
+  vsnprintf(big.data(), big.size(), fmt, args);
+  va_end(args);
+  return write((const uint8_t*)big.data(), len);
+}
+
+size_t Stream::readBytes(char* buf, size_t len)
+{
+  size_t count = 0;
+  unsigned long start = millis();
+  while(count < len && millis() - start < _timeout) {
+    int c = read();
+    if(c >= 0)
+      buf[count++] = c;
+    else
+      yield();
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char term, char* buf, size_t len)
+{
+  size_t count = 0;
+  while(count < len) {
+    int c = read();
+    if(c < 0 || c == term)
+      break;
+    buf[count++] = c;
+  }
+  return count;
+}
+
+String Stream::readStringUntil(char term)
+{
+  String str;
+  for(;;) {
+    int c = read();
+    if(c < 0 || c == term)
+      break;
+    str += (char)c;
+  }
+  return str;
+}
+
+static bool serialEcho = getenv("HOST_SERIAL") != NULL;
+static void (*serialSink)(const uint8_t* buf, size_t size) = NULL;
+
+void hostCaptureSerial(void (*sink)(const uint8_t* buf, size_t size))
+{
+  serialSink = sink;
+}
+
+static bool uartModel = false;
+static std::mutex uartMutex;
+static double uartLevel = 0;           // bytes in the FIFO
+static double uartUpdated_us = 0;
+static const int uartFIFO = 128;
+
+void hostSerialUART(bool model)
+{
+  std::lock_guard<std::mutex> lock(uartMutex);
+  uartModel = model;
+  uartLevel = 0;
+  uartUpdated_us = hostNow_us();
+}
+
+// 10 bits a byte
+static int uartRoom(uint32_t baud)
+{
+  double now = hostNow_us();
+  uartLevel = std::max(0.0, uartLevel - (now - uartUpdated_us) * baud / 10e6);
+  uartUpdated_us = now;
+  return uartFIFO - (int)ceil(uartLevel);
+}
+
+int HardwareSerial::availableForWrite()
+{
+  if(!uartModel || _uart != 0)
+    return uartFIFO;
+  std::lock_guard<std::mutex> lock(uartMutex);
+  return uartRoom(_baud);
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size)
+{
+  if(uartModel && _uart == 0) {
+    std::unique_lock<std::mutex> lock(uartMutex);
+    for(size_t done = 0; done < size; ) {
+      int room = uartRoom(_baud);
+      if(room <= 0) {
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::microseconds(10000000 / _baud));   // a byte time
+        lock.lock();
+        continue;
+      }
+      int n = std::min((size_t)room, size - done);
+      uartLevel += n;
+      done += n;
+    }
+  }
+  if(serialEcho && _uart == 0)
+    fwrite(buf, 1, size, stdout);
+  if(serialSink && _uart == 0)
+    serialSink(buf, size);
+  return size;
+}
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+///////////////////////////////////////////////////////////////////////////
+// ESP heap, the host heap is not representative so fixed figures are used
+
+uint32_t EspClass::getFreeHeap() { return 160000; }
+uint32_t EspClass::getMinFreeHeap() { return 150000; }
+uint32_t EspClass::getMaxAllocHeap() { return 110000; }
+
+EspClass ESP;
+
+///////////////////////////////////////////////////////////////////////////
+// Wire
+
+TwoWire::TwoWire(int bus)
+{
+  _clock = 100000;
+  _txAddr = 0;
+  _txLen = 0;
+  _rxLen = 0;
+  _rxPos = 0;
+  realTime = false;
+  memset(_devices, 0, sizeof(_devices));
+  hostResetCounts();
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency)
+{
+  if(frequency)
+    _clock = frequency;
+  return true;
+}
+
+// 9 clocks per byte (8 data + ACK), plus start and stop
+void TwoWire::_account(size_t len)
+{
+  transactions++;
+  bytes += len;
+  double time_us = (len * 9 + 2) * 1e6 / _clock;
+  busTime_us += time_us;
+  if(realTime) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(long(time_us * 1000));
+    while(std::chrono::steady_clock::now() < until) 
+      ;   // spin, sleeps are too coarse
+  }
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _txAddr = address & 0x7f;
+  _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t c)
+{
+  if(_txLen >= sizeof(_txBuf))
+    return 0;
+  _txBuf[_txLen++] = c;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t len)
+{
+  size_t n = 0;
+  while(n < len && write(data[n]))
+    n++;
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  _account(_txLen + 1);
+  CHostI2CDevice* pDev = _devices[_txAddr];
+  if(pDev == NULL)
+    return 2;    // address NAK
+  pDev->onWrite(_txBuf, _txLen);
+  _txLen = 0;      // a stray endTransmission() is an empty write
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop)
+{
+  _account(quantity + 1);
+  _rxLen = 0;
+  _rxPos = 0;
+  CHostI2CDevice* pDev = _devices[address & 0x7f];
+  if(pDev == NULL)
+    return 0;
+  _rxLen = std::min((size_t)quantity, sizeof(_rxBuf));
+  pDev->onRead(_rxBuf, _rxLen);
+  return _rxLen;
+}
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+SPIClass SPI;
+SPIFFSClass SPIFFS;
+
+///////////////////////////////////////////////////////////////////////////
+// WiFi, loopback TCP
+
+WiFiClass WiFi;
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size)
+{
+  size_t done = 0;
+  while(done < size && _fd >= 0) {
+    int n = ::send(_fd, buf + done, size - done, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if(n > 0) {
+      done += n;
+      continue;
+    }
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if(done)
+        break;      // partial write, as lwIP would when its send buffer fills
+      pollfd pfd = { _fd, POLLOUT, 0 };
+      if(poll(&pfd, 1, 100) <= 0)
+        break;
+      continue;
+    }
+    break;
+  }
+  return done;
+}
+
+int WiFiClient::available()
+{
+  if(_fd < 0)
+    return 0;
+  int n = 0;
+  char buf[512];
+  n = ::recv(_fd, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+  return n > 0 ? n : 0;
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  if(_fd < 0 || ::recv(_fd, &c, 1, MSG_DONTWAIT) != 1)
+    return -1;
+  return c;
+}
+
+int WiFiClient::peek()
+{
+  uint8_t c;
+  if(_fd < 0 || ::recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+    return -1;
+  return c;
+}
+
+uint8_t WiFiClient::connected()
+{
+  if(_fd < 0)
+    return 0;
+  char c;
+  int n = ::recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    return 0;
+  return 1;
+}
+
+void WiFiClient::stop()
+{
+  if(_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+}
+
+void WiFiClient::setNoDelay(bool nodelay)
+{
+  int flag = nodelay;
+  if(_fd >= 0)
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+void WiFiServer::begin()
+{
+  _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(::bind(_fd, (sockaddr*)&addr, sizeof(addr)) || ::listen(_fd, 4)) {
+    ::close(_fd);
+    _fd = -1;
+  }
+}
+
+void WiFiServer::end()
+{
+  if(_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+}
+
+bool WiFiServer::hasClient()
+{
+  if(_fd < 0)
+    return false;
+  pollfd pfd = { _fd, POLLIN, 0 };
+  return poll(&pfd, 1, 0) > 0;
+}
+
+WiFiClient WiFiServer::available()
+{
+  if(!hasClient())
+    return WiFiClient();
+  int fd = ::accept(_fd, NULL, NULL);
+  return WiFiClient(fd);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Preferences, an in memory NVS
+
+static std::mutex nvsMutex;
+static std::map<std::string, std::vector<uint8_t>> nvs;   // "namespace/key"
+static std::vector<std::string> nvsNamespaces;           // indexed by handle - 1
+
+bool Preferences::begin(const char* name, bool readOnly)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  _ns = name;
+  auto it = std::find(nvsNamespaces.begin(), nvsNamespaces.end(), _ns);
+  if(it == nvsNamespaces.end())
+    it = nvsNamespaces.insert(it, _ns);
+  _handle = it - nvsNamespaces.begin() + 1;
+  _started = true;
+  _readOnly = readOnly;
+  return true;
+}
+
+size_t Preferences::_get(const char* key, void* buf, size_t len)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto it = nvs.find(_ns + "/" + key);
+  if(it == nvs.end())
+    return 0;
+  size_t n = std::min(len, it->second.size());
+  memcpy(buf, it->second.data(), n);
+  return n;
+}
+
+size_t Preferences::_put(const char* key, const void* buf, size_t len)
+{
+  if(!_started || _readOnly)
+    return 0;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  const uint8_t* pData = (const uint8_t*)buf;
+  nvs[_ns + "/" + key].assign(pData, pData + len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto it = nvs.find(_ns + "/" + key);
+  return it == nvs.end() ? 0 : it->second.size();
+}
+
+String Preferences::getString(const char* key, const String& defaultValue)
+{
+  char buf[256];
+  if(_get(key, buf, sizeof(buf)) == 0)
+    return defaultValue;
+  buf[sizeof(buf)-1] = 0;
+  return buf;
+}
+
+bool Preferences::remove(const char* key)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  return nvs.erase(_ns + "/" + key) != 0;
+}
+
+bool Preferences::clear()
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  std::string prefix = _ns + "/";
+  for(auto it = nvs.begin(); it != nvs.end(); ) {
+    if(it->first.compare(0, prefix.size(), prefix) == 0)
+      it = nvs.erase(it);
+    else
+      ++it;
+  }
+  return true;
+}
+
+static esp_err_t nvsGet(nvs_handle handle, const char* key, void* buf, size_t* pLen)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  if(handle == 0 || handle > nvsNamespaces.size())
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  auto it = nvs.find(nvsNamespaces[handle-1] + "/" + key);
+  if(it == nvs.end())
+    return ESP_ERR_NVS_NOT_FOUND;
+  if(buf) {
+    if(*pLen < it->second.size())
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(buf, it->second.data(), it->second.size());
+  }
+  *pLen = it->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* buf, size_t* pLen)
+{
+  return nvsGet(handle, key, buf, pLen);
+}
+
+esp_err_t nvs_get_str(nvs_handle handle, const char* key, char* buf, size_t* pLen)
+{
+  return nvsGet(handle, key, buf, pLen);
+}
+
+// 126 entries per 4 KB page, the 20 KB partition less one spare page
+esp_err_t nvs_get_stats(const char* partition, nvs_stats_t* pStats)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  size_t used = 0;
+  for(auto& entry : nvs)
+    used += 1 + (entry.second.size() + 31) / 32;
+  pStats->total_entries = 4 * 126;
+  pStats->used_entries = used;
+  pStats->free_entries = pStats->total_entries - std::min(used, pStats->total_entries);
+  pStats->namespace_count = nvsNamespaces.size();
+  return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ADC
+
+static int (*adcSource)(adc1_channel_t channel) = NULL;
+
+void hostSetADC(int (*source)(adc1_channel_t channel))
+{
+  adcSource = source;
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width) { return ESP_OK; }
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten) { return ESP_OK; }
+esp_err_t adc_gpio_init(adc_unit_t unit, adc_channel_t channel) { return ESP_OK; }
+
+int adc1_get_raw(adc1_channel_t channel)
+{
+  return adcSource ? adcSource(channel) : 0;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width, uint32_t defaultVref, esp_adc_cal_characteristics_t* chars)
+{
+  memset(chars, 0, sizeof(*chars));
+  chars->adc_num = unit;
+  chars->atten = atten;
+  chars->bit_width = width;
+  chars->coeff_a = 3100;
+  chars->vref = defaultVref;
+  return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars)
+{
+  return raw * chars->coeff_a / 4095 + chars->coeff_b;
+}
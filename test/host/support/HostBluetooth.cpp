@@ -0,0 +1,227 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host Bluetooth stacks
+//
+// Classic: BluetoothSerial records each block written whilst a client is
+// attached.
+// BLE: one link, modelled as described in BLEDevice.h. The connection
+// events run on their own thread, as the stack's task would raise the
+// GATT server events.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <BluetoothSerial.h>
+#include <BLEDevice.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////
+// Classic
+
+static std::mutex btMutex;
+static bool btClient = false;
+static sHostBTLink btLink;
+
+bool BluetoothSerial::hasClient()
+{
+  std::lock_guard<std::mutex> lock(btMutex);
+  return btClient;
+}
+
+size_t BluetoothSerial::write(const uint8_t* buf, size_t size)
+{
+  std::lock_guard<std::mutex> lock(btMutex);
+  if(!btClient)
+    return 0;
+  btLink.received.append((const char*)buf, size);
+  btLink.blocks.push_back(size);
+  return size;
+}
+
+void hostBTClient(bool connected)
+{
+  std::lock_guard<std::mutex> lock(btMutex);
+  btClient = connected;
+}
+
+sHostBTLink hostBTLink()
+{
+  std::lock_guard<std::mutex> lock(btMutex);
+  return btLink;
+}
+
+void hostBTReset()
+{
+  std::lock_guard<std::mutex> lock(btMutex);
+  btLink = sHostBTLink();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// BLE
+
+static const int NotifyCost_us = 150;
+static const int EventInterval_ms = 15;
+static const int PacketsPerEvent = 4;
+static const int CongestAbove = 8;
+static const int CongestClearAt = 4;
+static const int StackQueue = 16;
+
+static std::mutex bleMutex;
+static tGattsHandler gattsHandler = NULL;
+static BLEServer* bleServer = NULL;
+static bool bleConnected = false;
+static bool bleCongested = false;
+static uint16_t bleMTU = ESP_GATT_DEF_BLE_MTU_SIZE;
+static std::deque<std::string> bleQueue;
+static sHostBLELink bleLink;
+static bool bleLinkRunning = false;
+
+static void gattsEvent(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t& param)
+{
+  if(gattsHandler)
+    gattsHandler(event, 3, &param);
+}
+
+// connection events, carrying the queued packets to the client
+static void linkThread()
+{
+  for(;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(EventInterval_ms));
+    bool cleared = false;
+    {
+      std::lock_guard<std::mutex> lock(bleMutex);
+      for(int i = 0; i < PacketsPerEvent && !bleQueue.empty(); i++) {
+        bleLink.received += bleQueue.front();
+        bleQueue.pop_front();
+      }
+      if(bleCongested && (int)bleQueue.size() <= CongestClearAt) {
+        bleCongested = false;
+        cleared = true;
+      }
+    }
+    if(cleared) {
+      esp_ble_gatts_cb_param_t param = {};
+      param.congest.congested = false;
+      gattsEvent(ESP_GATTS_CONGEST_EVT, param);
+    }
+  }
+}
+
+void BLEDevice::setCustomGattsHandler(tGattsHandler handler)
+{
+  gattsHandler = handler;
+}
+
+BLEServer* BLEDevice::createServer()
+{
+  bleServer = new BLEServer;
+  return bleServer;
+}
+
+void BLECharacteristic::notify()
+{
+  auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(NotifyCost_us);
+  while(std::chrono::steady_clock::now() < until)
+    ;   // spin, sleeps are too coarse
+  esp_ble_gatts_cb_param_t conf = {};
+  bool congest = false;
+  {
+    std::lock_guard<std::mutex> lock(bleMutex);
+    if(!bleConnected)
+      return;
+    bleLink.notifies++;
+    if((int)bleQueue.size() >= StackQueue)
+      bleLink.lost++;
+    else
+      bleQueue.push_back(_value.substr(0, bleMTU - 3));
+    bleLink.maxQueued = std::max(bleLink.maxQueued, (int)bleQueue.size());
+    if((int)bleQueue.size() > CongestAbove) {
+      conf.conf.status = ESP_GATT_CONGESTED;
+      congest = !bleCongested;
+      bleCongested = true;
+    }
+  }
+  if(congest) {
+    esp_ble_gatts_cb_param_t param = {};
+    param.congest.congested = true;
+    gattsEvent(ESP_GATTS_CONGEST_EVT, param);
+  }
+  gattsEvent(ESP_GATTS_CONF_EVT, conf);
+}
+
+void hostBLEConnect(uint16_t mtu)
+{
+  {
+    std::lock_guard<std::mutex> lock(bleMutex);
+    bleConnected = true;
+    bleMTU = mtu;
+    if(!bleLinkRunning)
+      std::thread(linkThread).detach();
+    bleLinkRunning = true;
+  }
+  esp_ble_gatts_cb_param_t param = {};
+  gattsEvent(ESP_GATTS_CONNECT_EVT, param);
+  if(bleServer && bleServer->pCallbacks)
+    bleServer->pCallbacks->onConnect(bleServer);
+  if(mtu != ESP_GATT_DEF_BLE_MTU_SIZE) {
+    param.mtu.mtu = mtu;
+    gattsEvent(ESP_GATTS_MTU_EVT, param);
+  }
+}
+
+void hostBLEDisconnect()
+{
+  {
+    std::lock_guard<std::mutex> lock(bleMutex);
+    bleConnected = false;
+    bleCongested = false;
+    bleMTU = ESP_GATT_DEF_BLE_MTU_SIZE;
+    bleQueue.clear();
+  }
+  if(bleServer && bleServer->pCallbacks)
+    bleServer->pCallbacks->onDisconnect(bleServer);
+  esp_ble_gatts_cb_param_t param = {};
+  gattsEvent(ESP_GATTS_DISCONNECT_EVT, param);
+}
+
+bool hostBLEIdle()
+{
+  std::lock_guard<std::mutex> lock(bleMutex);
+  return bleQueue.empty();
+}
+
+sHostBLELink hostBLELink()
+{
+  std::lock_guard<std::mutex> lock(bleMutex);
+  return bleLink;
+}
+
+void hostBLEReset()
+{
+  std::lock_guard<std::mutex> lock(bleMutex);
+  bleLink = sHostBLELink();
+}
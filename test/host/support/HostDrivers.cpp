@@ -0,0 +1,277 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host ESP-IDF peripheral drivers
+//
+// RMT receive: each channel has a NOSPLIT ring, as the IDF driver does.
+// hostRMTReceive() stands in for the RMT ISR delivering a frame.
+//
+// UART: the receive buffer and event queue of the IDF driver, 
+// hostUARTReceive() stands in for the UART ISR emptying the RX FIFO.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <driver/rmt.h>
+
+static RingbufHandle_t rmtRings[RMT_CHANNEL_MAX];
+static bool rmtRxRunning[RMT_CHANNEL_MAX];
+
+esp_err_t rmt_config(const rmt_config_t* config) { return ESP_OK; }
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rxBufSize, int intrFlags)
+{
+  if(rmtRings[channel])
+    return ESP_FAIL;
+  if(rxBufSize)
+    rmtRings[channel] = xRingbufferCreate(rxBufSize, RINGBUF_TYPE_NOSPLIT);
+  return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+  if(rmtRings[channel])
+    vRingbufferDelete(rmtRings[channel]);
+  rmtRings[channel] = NULL;
+  return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t* pRing)
+{
+  *pRing = rmtRings[channel];
+  return rmtRings[channel] ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool resetMemory)
+{
+  rmtRxRunning[channel] = true;
+  return ESP_OK;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t channel)
+{
+  rmtRxRunning[channel] = false;
+  return ESP_OK;
+}
+
+esp_err_t rmt_set_rx_filter(rmt_channel_t channel, bool enable, uint8_t threshold) { return ESP_OK; }
+esp_err_t rmt_set_rx_idle_thresh(rmt_channel_t channel, uint16_t threshold) { return ESP_OK; }
+esp_err_t rmt_set_rx_intr_en(rmt_channel_t channel, bool enable) { return ESP_OK; }
+esp_err_t rmt_set_err_intr_en(rmt_channel_t channel, bool enable) { return ESP_OK; }
+esp_err_t rmt_memory_rw_rst(rmt_channel_t channel) { return ESP_OK; }
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t* items, int count, bool waitDone) { return ESP_OK; }
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t ticks) { return ESP_OK; }
+
+bool hostRMTReceive(rmt_channel_t channel, const rmt_item32_t* items, int count)
+{
+  if(!rmtRings[channel] || !rmtRxRunning[channel])
+    return false;
+  return xRingbufferSend(rmtRings[channel], items, count * sizeof(rmt_item32_t), 0) == pdTRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// LEDC
+
+#include <driver/ledc.h>
+
+struct sHostLedc {
+  uint32_t duty;          // set, applied by ledc_update_duty()
+  uint32_t from;          // output at the start of the fade
+  uint32_t target;
+  TickType_t start;
+  int fadeTime;
+  uint32_t pending;       // fade target awaiting ledc_fade_start()
+  int pendingTime;
+};
+static sHostLedc ledc[LEDC_CHANNEL_MAX];
+static uint32_t ledcCalls = 0;
+
+uint32_t hostLedcDuty(ledc_channel_t channel)
+{
+  sHostLedc& ch = ledc[channel];
+  int32_t elapsed = xTaskGetTickCount() - ch.start;
+  if(ch.fadeTime <= 0 || elapsed >= ch.fadeTime)
+    return ch.target;
+  return ch.from + ((int64_t)ch.target - ch.from) * elapsed / ch.fadeTime;
+}
+
+uint32_t hostLedcCalls()
+{
+  return ledcCalls;
+}
+
+esp_err_t ledc_fade_func_install(int intrFlags)
+{
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+  ledcCalls++;
+  ledc[channel].duty = duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+  ledcCalls++;
+  sHostLedc& ch = ledc[channel];
+  ch.from = ch.target = ch.duty;
+  ch.fadeTime = 0;
+  return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+  return hostLedcDuty(channel);
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t targetDuty, int maxFadeTime_ms)
+{
+  ledcCalls++;
+  ledc[channel].pending = targetDuty;
+  ledc[channel].pendingTime = maxFadeTime_ms;
+  return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t channel, ledc_fade_mode_t waitDone)
+{
+  ledcCalls++;
+  sHostLedc& ch = ledc[channel];
+  ch.from = hostLedcDuty(channel);
+  ch.target = ch.pending;
+  ch.fadeTime = ch.pendingTime;
+  ch.start = xTaskGetTickCount();
+  if(waitDone == LEDC_FADE_WAIT_DONE)
+    vTaskDelay(ch.fadeTime);
+  return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// UART
+
+#include <driver/uart.h>
+#include <deque>
+#include <mutex>
+
+struct sHostUart {
+  std::mutex mutex;
+  QueueHandle_t queue;
+  size_t rxSize;
+  std::deque<uint8_t> rx;
+  size_t tx;
+};
+static sHostUart uarts[UART_NUM_MAX];
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t* config) { return ESP_OK; }
+esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin) { return ESP_OK; }
+esp_err_t uart_intr_config(uart_port_t port, const uart_intr_config_t* config) { return ESP_OK; }
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks) { return ESP_OK; }
+
+esp_err_t uart_driver_install(uart_port_t port, int rxBufSize, int txBufSize, int queueSize, QueueHandle_t* pQueue, int intrFlags)
+{
+  sHostUart& uart = uarts[port];
+  if(uart.queue)
+    return ESP_FAIL;
+  uart.queue = xQueueCreate(queueSize, sizeof(uart_event_t));
+  uart.rxSize = rxBufSize;
+  uart.rx.clear();
+  uart.tx = 0;
+  if(pQueue)
+    *pQueue = uart.queue;
+  return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t port)
+{
+  sHostUart& uart = uarts[port];
+  if(!uart.queue)
+    return ESP_FAIL;
+  vQueueDelete(uart.queue);
+  uart.queue = NULL;
+  return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t* pSize)
+{
+  sHostUart& uart = uarts[port];
+  std::lock_guard<std::mutex> lock(uart.mutex);
+  *pSize = uart.rx.size();
+  return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, uint8_t* buf, uint32_t length, TickType_t ticks)
+{
+  sHostUart& uart = uarts[port];
+  std::lock_guard<std::mutex> lock(uart.mutex);
+  size_t len = std::min((size_t)length, uart.rx.size());
+  std::copy(uart.rx.begin(), uart.rx.begin() + len, buf);
+  uart.rx.erase(uart.rx.begin(), uart.rx.begin() + len);
+  return len;
+}
+
+int uart_write_bytes(uart_port_t port, const char* src, size_t size)
+{
+  sHostUart& uart = uarts[port];
+  std::lock_guard<std::mutex> lock(uart.mutex);
+  uart.tx += size;
+  return size;
+}
+
+esp_err_t uart_flush_input(uart_port_t port)
+{
+  sHostUart& uart = uarts[port];
+  std::lock_guard<std::mutex> lock(uart.mutex);
+  uart.rx.clear();
+  return ESP_OK;
+}
+
+int hostUARTReceive(uart_port_t port, const char* data, int len)
+{
+  sHostUart& uart = uarts[port];
+  if(!uart.queue)
+    return 0;
+  uart_event_t event;
+  memset(&event, 0, sizeof(event));
+  {
+    std::lock_guard<std::mutex> lock(uart.mutex);
+    int room = uart.rxSize - uart.rx.size();
+    if(len > room) {
+      len = room;
+      event.type = UART_BUFFER_FULL;
+    }
+    else
+      event.type = UART_DATA;
+    uart.rx.insert(uart.rx.end(), data, data + len);
+    event.size = len;
+  }
+  xQueueSendFromISR(uart.queue, &event, NULL);   // as the ISR, the event is lost if the queue is full
+  return len;
+}
+
+size_t hostUARTTransmitted(uart_port_t port)
+{
+  sHostUart& uart = uarts[port];
+  std::lock_guard<std::mutex> lock(uart.mutex);
+  return uart.tx;
+}
@@ -0,0 +1,757 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host FreeRTOS, see FreeRTOS.h
+//
+// Each task runs on a pthread whose stack is allocated here and painted,
+// so uxTaskGetStackHighWaterMark() reports what the task really used on
+// the host. Host frames are larger than Xtensa frames, so host figures are
+// an upper bound. Tasks are given at least HOST_MIN_STACK, the high water
+// mark is still reported against the stack size the task asked for.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/timers.h>
+#include <pthread.h>
+#include <string.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HOST_MIN_STACK  (256 * 1024)
+#define HOST_STACK_PAINT 0xa5
+
+using namespace std::chrono;
+
+///////////////////////////////////////////////////////////////////////////
+// tick
+
+static const steady_clock::time_point hostStart = steady_clock::now();
+static std::atomic<bool> simTicks(false);
+static std::atomic<TickType_t> simTickCount(0);
+
+void hostSimTicks(bool simulate)
+{
+  if(simulate && !simTicks)
+    simTickCount = xTaskGetTickCount();
+  simTicks = simulate;
+}
+
+void hostSetTicks(TickType_t ticks)
+{
+  simTickCount = ticks;
+}
+
+static void runSimTimers(TickType_t until);
+
+void hostAdvanceTicks(TickType_t ticks)
+{
+  TickType_t until = simTickCount + ticks;
+  runSimTimers(until);
+  simTickCount = until;
+}
+
+TickType_t xTaskGetTickCount()
+{
+  if(simTicks)
+    return simTickCount;
+  return (TickType_t)duration_cast<milliseconds>(steady_clock::now() - hostStart).count();
+}
+
+TickType_t xTaskGetTickCountFromISR()
+{
+  return xTaskGetTickCount();
+}
+
+// ticks to a wait, portMAX_DELAY waits for ever
+template<class Lock, class Pred>
+static bool waitFor(std::condition_variable& cv, Lock& lock, TickType_t ticks, Pred pred)
+{
+  if(ticks == portMAX_DELAY) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  return cv.wait_for(lock, milliseconds(ticks), pred);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// critical sections
+
+static std::recursive_mutex criticalMutex;
+
+void vPortEnterCritical(portMUX_TYPE* mux)
+{
+  criticalMutex.lock();
+  mux->count++;
+}
+
+void vPortExitCritical(portMUX_TYPE* mux)
+{
+  mux->count--;
+  criticalMutex.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// tasks
+
+struct sHostTask {
+  std::string name;
+  TaskFunction_t fn;
+  void* param;
+  UBaseType_t priority;
+  uint32_t stackDepth;      // as requested
+  uint8_t* stack;
+  size_t stackSize;         // as allocated
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notify;
+};
+
+struct sHostTaskExit {};
+
+static thread_local sHostTask* currentTask = NULL;
+
+static sHostTask* self()
+{
+  if(currentTask == NULL) {
+    // the main thread plays the Arduino loop task
+    currentTask = new sHostTask;
+    currentTask->name = "loopTask";
+    currentTask->priority = 1;
+    currentTask->stackDepth = 8192;
+    currentTask->stack = NULL;
+    currentTask->stackSize = 0;
+    currentTask->notify = 0;
+  }
+  return currentTask;
+}
+
+static void* taskEntry(void* arg)
+{
+  currentTask = (sHostTask*)arg;
+  try {
+    currentTask->fn(currentTask->param);
+  }
+  catch(sHostTaskExit&) {
+  }
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param, UBaseType_t priority, TaskHandle_t* pHandle)
+{
+  sHostTask* task = new sHostTask;
+  task->name = name;
+  task->fn = fn;
+  task->param = param;
+  task->priority = priority;
+  task->stackDepth = stackDepth;
+  task->notify = 0;
+  task->stackSize = std::max((size_t)stackDepth, (size_t)HOST_MIN_STACK);
+  task->stack = (uint8_t*)mmap(NULL, task->stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  memset(task->stack, HOST_STACK_PAINT, task->stackSize);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, task->stack, task->stackSize);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_t thread;
+  int rc = pthread_create(&thread, &attr, taskEntry, task);
+  pthread_attr_destroy(&attr);
+  if(rc)
+    return pdFAIL;
+  if(pHandle)
+    *pHandle = task;
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param, UBaseType_t priority, TaskHandle_t* pHandle, BaseType_t core)
+{
+  return xTaskCreate(fn, name, stackDepth, param, priority, pHandle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+  // only self deletion is used by the application
+  if(task == NULL || task == currentTask)
+    throw sHostTaskExit();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  if(simTicks)
+    hostAdvanceTicks(ticks);
+  else
+    std::this_thread::sleep_for(milliseconds(ticks));
+}
+
+void vTaskDelayUntil(TickType_t* pPrevWake, TickType_t increment)
+{
+  *pPrevWake += increment;
+  TickType_t now = xTaskGetTickCount();
+  int32_t wait = (int32_t)(*pPrevWake - now);
+  if(wait > 0)
+    vTaskDelay(wait);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  return self();
+}
+
+const char* pcTaskGetTaskName(TaskHandle_t task)
+{
+  sHostTask* pTask = task ? (sHostTask*)task : self();
+  return pTask->name.c_str();
+}
+
+// bytes of the requested stack never touched, as the ESP-IDF reports it
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+  sHostTask* pTask = task ? (sHostTask*)task : self();
+  if(pTask->stack == NULL)
+    return pTask->stackDepth;
+  size_t untouched = 0;
+  while(untouched < pTask->stackSize && pTask->stack[untouched] == HOST_STACK_PAINT)
+    untouched++;
+  size_t used = pTask->stackSize - untouched;
+  return used >= pTask->stackDepth ? 0 : pTask->stackDepth - used;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+  sHostTask* pTask = task ? (sHostTask*)task : self();
+  return pTask->priority;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  sHostTask* pTask = (sHostTask*)task;
+  std::lock_guard<std::mutex> lock(pTask->mutex);
+  pTask->notify++;
+  pTask->cv.notify_all();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* pWoken)
+{
+  xTaskNotifyGive(task);
+  if(pWoken)
+    *pWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  sHostTask* pTask = self();
+  std::unique_lock<std::mutex> lock(pTask->mutex);
+  waitFor(pTask->cv, lock, ticks, [&] { return pTask->notify != 0; });
+  uint32_t value = pTask->notify;
+  if(clearOnExit)
+    pTask->notify = 0;
+  else if(value)
+    pTask->notify--;
+  return value;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// queues
+
+struct sHostQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  sHostQueue* queue = new sHostQueue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+  delete (sHostQueue*)queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t ticks)
+{
+  sHostQueue* queue = (sHostQueue*)handle;
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if(!waitFor(queue->cv, lock, ticks, [&] { return queue->items.size() < queue->length; }))
+    return errQUEUE_FULL;
+  const uint8_t* pItem = (const uint8_t*)item;
+  queue->items.emplace_back(pItem, pItem + queue->itemSize);
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+  return xQueueSend(queue, item, ticks);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* pWoken)
+{
+  if(pWoken)
+    *pWoken = pdTRUE;
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t handle, const void* item)
+{
+  sHostQueue* queue = (sHostQueue*)handle;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->items.clear();
+  const uint8_t* pItem = (const uint8_t*)item;
+  queue->items.emplace_back(pItem, pItem + queue->itemSize);
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+static BaseType_t queueReceive(QueueHandle_t handle, void* item, TickType_t ticks, bool remove)
+{
+  sHostQueue* queue = (sHostQueue*)handle;
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if(!waitFor(queue->cv, lock, ticks, [&] { return !queue->items.empty(); }))
+    return pdFALSE;
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  if(remove) {
+    queue->items.pop_front();
+    queue->cv.notify_all();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+  return queueReceive(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void* item, BaseType_t* pWoken)
+{
+  return queueReceive(queue, item, 0, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+  return queueReceive(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t handle)
+{
+  sHostQueue* queue = (sHostQueue*)handle;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->items.clear();
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle)
+{
+  sHostQueue* queue = (sHostQueue*)handle;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->items.size();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// semaphores and mutexes
+//
+// Waiters are granted a semaphore in task priority order, then first come
+// first served, as FreeRTOS does.
+
+struct sHostSemaphore {
+  std::mutex mutex;
+  std::condition_variable cv;
+  UBaseType_t count;
+  UBaseType_t maxCount;
+  bool recursive;
+  sHostTask* holder;
+  int depth;
+  std::deque<sHostTask*> waiters;
+};
+
+static SemaphoreHandle_t createSemaphore(UBaseType_t maxCount, UBaseType_t initialCount, bool recursive)
+{
+  sHostSemaphore* sem = new sHostSemaphore;
+  sem->count = initialCount;
+  sem->maxCount = maxCount;
+  sem->recursive = recursive;
+  sem->holder = NULL;
+  sem->depth = 0;
+  return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return createSemaphore(1, 0, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+  return createSemaphore(maxCount, initialCount, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return createSemaphore(1, 1, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+  return createSemaphore(1, 1, true);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+  delete (sHostSemaphore*)sem;
+}
+
+// the waiter next in line: highest priority, earliest arrival
+static sHostTask* nextInLine(sHostSemaphore* sem)
+{
+  sHostTask* best = NULL;
+  for(auto pTask : sem->waiters) {
+    if(best == NULL || pTask->priority > best->priority)
+      best = pTask;
+  }
+  return best;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks)
+{
+  sHostSemaphore* sem = (sHostSemaphore*)handle;
+  sHostTask* me = self();
+  std::unique_lock<std::mutex> lock(sem->mutex);
+  if(sem->recursive && sem->holder == me) {
+    sem->depth++;
+    return pdTRUE;
+  }
+  sem->waiters.push_back(me);
+  bool ok = waitFor(sem->cv, lock, ticks, [&] { return sem->count > 0 && nextInLine(sem) == me; });
+  sem->waiters.erase(std::find(sem->waiters.begin(), sem->waiters.end(), me));
+  if(!ok) {
+    sem->cv.notify_all();
+    return pdFALSE;
+  }
+  sem->count--;
+  sem->holder = me;
+  sem->depth = 1;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle)
+{
+  sHostSemaphore* sem = (sHostSemaphore*)handle;
+  std::lock_guard<std::mutex> lock(sem->mutex);
+  if(sem->recursive && --sem->depth > 0)
+    return pdTRUE;
+  if(sem->count >= sem->maxCount)
+    return pdFALSE;
+  sem->count++;
+  sem->holder = NULL;
+  sem->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* pWoken)
+{
+  if(pWoken)
+    *pWoken = pdTRUE;
+  return xSemaphoreGive(sem);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+  return xSemaphoreTake(sem, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+  return xSemaphoreGive(sem);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ring buffers
+
+struct sHostRing {
+  std::mutex mutex;
+  std::condition_variable cv;
+  ringbuf_type_t type;
+  size_t size;
+  size_t used;                               // as charged against size
+  std::deque<std::vector<uint8_t>> items;    // NOSPLIT / ALLOWSPLIT
+  std::deque<uint8_t> bytes;                 // BYTEBUF
+  std::vector<uint8_t> out;                  // item held by the reader
+  bool outstanding;
+};
+
+// IDF NOSPLIT cost: 8 byte header, data rounded up to 4 bytes
+static size_t itemCost(const sHostRing* ring, size_t len)
+{
+  return ring->type == RINGBUF_TYPE_BYTEBUF ? len : ((len + 3) & ~3) + 8;
+}
+
+RingbufHandle_t xRingbufferCreate(size_t size, ringbuf_type_t type)
+{
+  sHostRing* ring = new sHostRing;
+  ring->type = type;
+  ring->size = size;
+  ring->used = 0;
+  ring->outstanding = false;
+  return ring;
+}
+
+void vRingbufferDelete(RingbufHandle_t ring)
+{
+  delete (sHostRing*)ring;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t handle, const void* data, size_t len, TickType_t ticks)
+{
+  sHostRing* ring = (sHostRing*)handle;
+  size_t cost = itemCost(ring, len);
+  if(cost > ring->size || len > xRingbufferGetMaxItemSize(handle))
+    return pdFALSE;
+  std::unique_lock<std::mutex> lock(ring->mutex);
+  if(!waitFor(ring->cv, lock, ticks, [&] { return ring->used + cost <= ring->size; }))
+    return pdFALSE;
+  const uint8_t* pData = (const uint8_t*)data;
+  if(ring->type == RINGBUF_TYPE_BYTEBUF)
+    ring->bytes.insert(ring->bytes.end(), pData, pData + len);
+  else
+    ring->items.emplace_back(pData, pData + len);
+  ring->used += cost;
+  ring->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t ring, const void* data, size_t len, BaseType_t* pWoken)
+{
+  if(pWoken)
+    *pWoken = pdTRUE;
+  return xRingbufferSend(ring, data, len, 0);
+}
+
+void* xRingbufferReceiveUpTo(RingbufHandle_t handle, size_t* pSize, TickType_t ticks, size_t maxSize)
+{
+  sHostRing* ring = (sHostRing*)handle;
+  std::unique_lock<std::mutex> lock(ring->mutex);
+  if(!waitFor(ring->cv, lock, ticks, [&] { return !ring->outstanding && (!ring->items.empty() || !ring->bytes.empty()); }))
+    return NULL;
+  if(ring->type == RINGBUF_TYPE_BYTEBUF) {
+    size_t len = std::min(maxSize, ring->bytes.size());
+    ring->out.assign(ring->bytes.begin(), ring->bytes.begin() + len);
+    ring->bytes.erase(ring->bytes.begin(), ring->bytes.begin() + len);
+  }
+  else {
+    ring->out.swap(ring->items.front());
+    ring->items.pop_front();
+  }
+  ring->outstanding = true;
+  *pSize = ring->out.size();
+  return ring->out.data();
+}
+
+void* xRingbufferReceive(RingbufHandle_t ring, size_t* pSize, TickType_t ticks)
+{
+  return xRingbufferReceiveUpTo(ring, pSize, ticks, SIZE_MAX);
+}
+
+// the space is only released once the reader returns the item
+void vRingbufferReturnItem(RingbufHandle_t handle, void* item)
+{
+  sHostRing* ring = (sHostRing*)handle;
+  std::lock_guard<std::mutex> lock(ring->mutex);
+  ring->used -= itemCost(ring, ring->out.size());
+  ring->out.clear();
+  ring->outstanding = false;
+  ring->cv.notify_all();
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t handle)
+{
+  sHostRing* ring = (sHostRing*)handle;
+  std::lock_guard<std::mutex> lock(ring->mutex);
+  size_t avail = ring->size - ring->used;
+  if(ring->type == RINGBUF_TYPE_BYTEBUF)
+    return avail;
+  return avail > 8 ? (avail - 8) & ~3 : 0;
+}
+
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t handle)
+{
+  sHostRing* ring = (sHostRing*)handle;
+  return ring->type == RINGBUF_TYPE_BYTEBUF ? ring->size : ring->size / 2 - 8;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// software timers
+//
+// With host ticks each timer has a thread which sleeps out its period. With 
+// simulated ticks the timers instead expire as hostAdvanceTicks() (or 
+// vTaskDelay()) steps the tick past them, their callbacks running in order 
+// of expiry in the caller's thread, at the tick they are due.
+
+struct sHostTimer {
+  std::mutex mutex;
+  std::condition_variable cv;
+  TickType_t period;
+  bool autoReload;
+  void* id;
+  TimerCallbackFunction_t callback;
+  bool active;
+  uint32_t generation;      // bumped by each start / stop / reset
+  bool threadRunning;
+  TickType_t expiry;        // tick the timer fires at
+};
+
+static std::mutex timerListMutex;
+static std::vector<sHostTimer*> timerList;
+
+static void timerThread(sHostTimer* timer)
+{
+  std::unique_lock<std::mutex> lock(timer->mutex);
+  for(;;) {
+    timer->cv.wait(lock, [&] { return timer->active; });
+    uint32_t gen = timer->generation;
+    if(simTicks) {
+      timer->cv.wait(lock, [&] { return timer->generation != gen; });
+      continue;   // simulated ticks, runSimTimers() fires it
+    }
+    if(timer->cv.wait_for(lock, milliseconds(timer->period), [&] { return timer->generation != gen; }))
+      continue;   // restarted, stopped or period changed
+    timer->active = timer->autoReload;
+    lock.unlock();
+    timer->callback(timer);
+    lock.lock();
+  }
+}
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id, TimerCallbackFunction_t callback)
+{
+  sHostTimer* timer = new sHostTimer;
+  timer->period = period;
+  timer->autoReload = autoReload;
+  timer->id = id;
+  timer->callback = callback;
+  timer->active = false;
+  timer->generation = 0;
+  timer->threadRunning = false;
+  timer->expiry = 0;
+  std::lock_guard<std::mutex> lock(timerListMutex);
+  timerList.push_back(timer);
+  return timer;
+}
+
+// fire every simulated timer due by the until tick, earliest first
+static void runSimTimers(TickType_t until)
+{
+  if(!simTicks)
+    return;
+  for(;;) {
+    sHostTimer* due = NULL;
+    TickType_t dueIn = 0;
+    {
+      std::lock_guard<std::mutex> listLock(timerListMutex);
+      for(sHostTimer* timer : timerList) {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        TickType_t in = timer->expiry - simTickCount;
+        if(timer->active && in <= until - simTickCount && (due == NULL || in < dueIn)) {
+          due = timer;
+          dueIn = in;
+        }
+      }
+    }
+    if(due == NULL)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(due->mutex);
+      simTickCount = due->expiry;
+      due->active = due->autoReload;
+      due->expiry += due->period;
+    }
+    due->callback(due);
+  }
+}
+
+static BaseType_t timerControl(TimerHandle_t handle, bool active, TickType_t period)
+{
+  sHostTimer* timer = (sHostTimer*)handle;
+  std::lock_guard<std::mutex> lock(timer->mutex);
+  if(!timer->threadRunning) {
+    std::thread(timerThread, timer).detach();
+    timer->threadRunning = true;
+  }
+  timer->active = active;
+  if(period)
+    timer->period = period;
+  timer->expiry = xTaskGetTickCount() + timer->period;
+  timer->generation++;
+  timer->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks)
+{
+  return timerControl(timer, true, 0);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks)
+{
+  return timerControl(timer, true, 0);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks)
+{
+  return timerControl(timer, false, 0);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks)
+{
+  return timerControl(timer, true, period);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t handle)
+{
+  sHostTimer* timer = (sHostTimer*)handle;
+  std::lock_guard<std::mutex> lock(timer->mutex);
+  return timer->active;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer)
+{
+  return ((sHostTimer*)timer)->id;
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "HostTest.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+struct sHostTestEntry {
+  const char* name;
+  tHostTest fn;
+};
+
+static std::vector<sHostTestEntry>& registry()
+{
+  static std::vector<sHostTestEntry> tests;
+  return tests;
+}
+
+static int failures = 0;
+static int testFailures = 0;
+
+CHostTestReg::CHostTestReg(const char* name, tHostTest fn)
+{
+  registry().push_back({ name, fn });
+}
+
+void hostCheckFailed(const char* file, int line, const char* expr)
+{
+  printf("    FAIL %s:%d: %s\n", file, line, expr);
+  failures++;
+  testFailures++;
+}
+
+std::string hostEscape(const std::string& str)
+{
+  std::string out;
+  for(unsigned char c : str) {
+    char esc[8];
+    if(c == '\r')
+      out += "\\r";
+    else if(c == '\n')
+      out += "\\n";
+    else if(c < ' ' || c >= 0x7f) {
+      snprintf(esc, sizeof(esc), "\\x%02X", c);
+      out += esc;
+    }
+    else
+      out += c;
+  }
+  return out;
+}
+
+bool hostCheck(bool ok, const char* file, int line, const char* expr)
+{
+  if(!ok)
+    hostCheckFailed(file, line, expr);
+  return ok;
+}
+
+// optional argument: run only the tests whose name contains it
+int main(int argc, char** argv)
+{
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  int run = 0;
+  for(auto& test : registry()) {
+    if(argc > 1 && strstr(test.name, argv[1]) == NULL)
+      continue;
+    printf("  %s\n", test.name);
+    testFailures = 0;
+    test.fn();
+    if(testFailures)
+      printf("  %s FAILED\n", test.name);
+    run++;
+  }
+  printf("%d tests, %d failed checks\n", run, failures);
+  // firmware never runs its static destructors, so neither do the tests 
+  // (eg TelnetSpy::end() assumes begin() was called)
+  fflush(stdout);
+  _exit(failures ? 1 : 0);
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Minimal host test runner
+//
+//   TEST(name) { CHECK(cond); CHECK_EQ(expected, actual); CHECK_STREQ(expected, actual); }
+//
+// Each test binary runs every TEST in the order defined, and exits non
+// zero if any check failed. Benchmark figures are printed with REPORT(),
+// indented under the test that measured them.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+typedef void (*tHostTest)();
+
+struct CHostTestReg {
+  CHostTestReg(const char* name, tHostTest fn);
+};
+
+void hostCheckFailed(const char* file, int line, const char* expr);
+bool hostCheck(bool ok, const char* file, int line, const char* expr);
+
+#define TEST(name) \
+  static void test_##name(); \
+  static CHostTestReg reg_##name(#name, test_##name); \
+  static void test_##name()
+
+#define CHECK(cond) hostCheck((cond), __FILE__, __LINE__, #cond)
+
+#define CHECK_EQ(expected, actual) \
+  do { \
+    long long e_ = (long long)(expected), a_ = (long long)(actual); \
+    if(e_ != a_) { \
+      char msg_[256]; \
+      snprintf(msg_, sizeof(msg_), "%s == %s (%lld != %lld)", #expected, #actual, e_, a_); \
+      hostCheckFailed(__FILE__, __LINE__, msg_); \
+    } \
+  } while(0)
+
+// strings, control characters are shown escaped when they differ
+#define CHECK_STREQ(expected, actual) \
+  do { \
+    std::string e_ = (expected), a_ = (actual); \
+    if(e_ != a_) { \
+      std::string msg_ = std::string(#expected " == " #actual " (\"") + hostEscape(e_) + "\" != \"" + hostEscape(a_) + "\")"; \
+      hostCheckFailed(__FILE__, __LINE__, msg_.c_str()); \
+    } \
+  } while(0)
+
+std::string hostEscape(const std::string& str);
+
+#define REPORT(...) do { printf("    "); printf(__VA_ARGS__); printf("\n"); } while(0)
+
+// wall clock, for benchmark figures
+inline double hostNow_us()
+{
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
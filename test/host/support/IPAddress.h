@@ -0,0 +1,38 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef __HOST_IPADDRESS_H__
+#define __HOST_IPADDRESS_H__
+
+#include <Arduino.h>
+
+class IPAddress {
+  uint8_t _addr[4];
+public:
+  IPAddress() : _addr{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr{a, b, c, d} {}
+  uint8_t operator[](int idx) const { return _addr[idx]; }
+  operator uint32_t() const { return _addr[0] | (_addr[1] << 8) | (_addr[2] << 16) | ((uint32_t)_addr[3] << 24); }
+  String toString() const { char buf[16]; snprintf(buf, 16, "%d.%d.%d.%d", _addr[0], _addr[1], _addr[2], _addr[3]); return buf; }
+};
+
+#endif
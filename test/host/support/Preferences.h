@@ -0,0 +1,67 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host NVS preferences, held in memory for the life of the test
+
+#ifndef __HOST_PREFERENCES_H__
+#define __HOST_PREFERENCES_H__
+
+#include <Arduino.h>
+
+class Preferences {
+protected:
+  uint32_t _handle;
+  bool _started;
+  bool _readOnly;
+  std::string _ns;
+  size_t _get(const char* key, void* buf, size_t len);
+  size_t _put(const char* key, const void* buf, size_t len);
+public:
+  Preferences() : _handle(0), _started(false), _readOnly(false) {}
+  bool begin(const char* name, bool readOnly = false);
+  void end() { _started = false; }
+  bool clear();
+  bool remove(const char* key);
+#define HOST_PREF(type, name) \
+  type get##name(const char* key, type defaultValue = 0) { type val = defaultValue; _get(key, &val, sizeof(val)); return val; } \
+  size_t put##name(const char* key, type val) { return _put(key, &val, sizeof(val)); }
+  HOST_PREF(int8_t, Char)
+  HOST_PREF(uint8_t, UChar)
+  HOST_PREF(int16_t, Short)
+  HOST_PREF(uint16_t, UShort)
+  HOST_PREF(int32_t, Int)
+  HOST_PREF(uint32_t, UInt)
+  HOST_PREF(int32_t, Long)
+  HOST_PREF(uint32_t, ULong)
+  HOST_PREF(float, Float)
+  HOST_PREF(bool, Bool)
+#undef HOST_PREF
+  size_t putString(const char* key, const char* val) { return _put(key, val, strlen(val) + 1); }
+  size_t putString(const char* key, const String& val) { return putString(key, val.c_str()); }
+  size_t getString(const char* key, char* buf, size_t len) { return _get(key, buf, len); }
+  String getString(const char* key, const String& defaultValue = String());
+  size_t putBytes(const char* key, const void* buf, size_t len) { return _put(key, buf, len); }
+  size_t getBytes(const char* key, void* buf, size_t len) { return _get(key, buf, len); }
+  size_t getBytesLength(const char* key);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef __HOST_SPI_H__
+#define __HOST_SPI_H__
+
+#include <Arduino.h>
+
+#define MSBFIRST  1
+#define SPI_MODE0 0
+#define SPI_CLOCK_DIV2 0
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) {}
+};
+
+class SPIClass {
+public:
+  void begin() {}
+  void beginTransaction(SPISettings settings) {}
+  void endTransaction() {}
+  void setClockDivider(uint32_t div) {}
+  void setDataMode(uint8_t mode) {}
+  void setBitOrder(uint8_t order) {}
+  uint8_t transfer(uint8_t data) { return 0xff; }
+};
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host SPIFFS: an empty file system, opening any file fails
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_SPIFFS_H__
+#define __HOST_SPIFFS_H__
+
+#include <Arduino.h>
+
+class File : public Stream {
+public:
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  size_t write(uint8_t c) { return 0; }
+  using Stream::readBytes;
+  bool seek(uint32_t pos) { return false; }
+  size_t position() { return 0; }
+  size_t size() { return 0; }
+  const char* name() { return ""; }
+  bool isDirectory() { return false; }
+  File openNextFile() { return File(); }
+  void close() {}
+  operator bool() const { return false; }
+};
+
+class SPIFFSClass {
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  bool exists(const char* path) { return false; }
+  bool exists(const String& path) { return false; }
+  File open(const char* path, const char* mode = "r") { return File(); }
+  File open(const String& path, const char* mode = "r") { return File(); }
+  bool remove(const char* path) { return false; }
+  bool remove(const String& path) { return false; }
+  size_t usedBytes() { return 0; }
+  size_t totalBytes() { return 0x16f000; }
+};
+extern SPIFFSClass SPIFFS;
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host WiFi
+//
+// The station is always "connected". WiFiServer / WiFiClient are loopback
+// TCP sockets, so the telnet debug port can be exercised by a real client.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_WIFI_H__
+#define __HOST_WIFI_H__
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum { WIFI_MODE_NULL = 0, WIFI_MODE_STA, WIFI_MODE_AP, WIFI_MODE_APSTA } wifi_mode_t;
+#define WIFI_OFF   WIFI_MODE_NULL
+#define WIFI_STA   WIFI_MODE_STA
+#define WIFI_AP    WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+class WiFiClient : public Stream {
+  int _fd;
+public:
+  WiFiClient() : _fd(-1) {}
+  WiFiClient(int fd) : _fd(fd) {}
+  using Print::write;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size);
+  int available();
+  int read();
+  int peek();
+  uint8_t connected();
+  void stop();
+  void setNoDelay(bool nodelay);
+  int fd() const { return _fd; }
+  IPAddress remoteIP() const { return IPAddress(127, 0, 0, 1); }
+  operator bool() const { return _fd >= 0; }
+};
+
+class WiFiServer {
+  int _fd;
+  uint16_t _port;
+public:
+  WiFiServer(uint16_t port = 23) : _fd(-1), _port(port) {}
+  ~WiFiServer() { end(); }
+  void begin();
+  void end();
+  void close() { end(); }
+  bool hasClient();
+  WiFiClient available();
+  void setNoDelay(bool nodelay) {}
+};
+
+class WiFiClass {
+public:
+  wl_status_t status() { return WL_CONNECTED; }
+  bool isConnected() { return true; }
+  wifi_mode_t getMode() { return WIFI_MODE_STA; }
+  bool mode(wifi_mode_t mode) { return true; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress softAPIP() { return IPAddress(0, 0, 0, 0); }
+  IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+  int8_t RSSI() { return -50; }
+  String SSID() { return "host"; }
+  String macAddress() { return "02:00:00:00:00:01"; }
+  String softAPmacAddress() { return "02:00:00:00:00:02"; }
+};
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,2 @@
+// Host build
+#include <WiFi.h>
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Host Wire (I2C) bus
+//
+// Transactions are delivered to simulated devices attached at an address,
+// an address with no device NAKs. Bytes are counted and the bus time they
+// would take at the current clock is accumulated, so tests can compare
+// traffic and (simulated) bus occupancy. With realTime set a transaction
+// also holds the caller for that long, for latency tests.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_WIRE_H__
+#define __HOST_WIRE_H__
+
+#include <Arduino.h>
+
+class CHostI2CDevice {
+public:
+  virtual ~CHostI2CDevice() {}
+  // a complete write transaction, address excluded
+  virtual void onWrite(const uint8_t* data, size_t len) = 0;
+  // a read transaction, the device fills data
+  virtual void onRead(uint8_t* data, size_t len) { memset(data, 0xff, len); }
+};
+
+class TwoWire : public Stream {
+  uint32_t _clock;
+  uint8_t _txAddr;
+  uint8_t _txBuf[256];
+  size_t _txLen;
+  uint8_t _rxBuf[256];
+  size_t _rxLen;
+  size_t _rxPos;
+  CHostI2CDevice* _devices[128];
+  void _account(size_t bytes);
+public:
+  uint32_t transactions;   // completed transactions, any address
+  uint32_t bytes;          // bytes on the bus, address bytes included
+  double   busTime_us;     // bus time at the clock in force for each transaction
+  bool     realTime;       // transactions take their bus time, as on the target
+
+  TwoWire(int bus = 0);
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+  void setClock(uint32_t frequency) { _clock = frequency; }
+  uint32_t getClock() { return _clock; }
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+  using Print::write;
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* data, size_t len);
+  size_t write(int n) { return write((uint8_t)n); }
+  size_t write(unsigned int n) { return write((uint8_t)n); }
+  size_t write(long n) { return write((uint8_t)n); }
+  size_t write(unsigned long n) { return write((uint8_t)n); }
+  int available() { return _rxLen - _rxPos; }
+  int read() { return _rxPos < _rxLen ? _rxBuf[_rxPos++] : -1; }
+  int peek() { return _rxPos < _rxLen ? _rxBuf[_rxPos] : -1; }
+  // test control
+  void hostAttach(uint8_t address, CHostI2CDevice* device) { _devices[address & 0x7f] = device; }
+  void hostResetCounts() { transactions = 0; bytes = 0; busTime_us = 0; }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
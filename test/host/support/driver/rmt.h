@@ -0,0 +1,96 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host RMT driver, received frames are injected by the test via hostRMTReceive()
+
+#ifndef __HOST_DRIVER_RMT_H__
+#define __HOST_DRIVER_RMT_H__
+
+#include <Arduino.h>
+#include <freertos/ringbuf.h>
+
+typedef enum {
+  RMT_CHANNEL_0 = 0, RMT_CHANNEL_1, RMT_CHANNEL_2, RMT_CHANNEL_3,
+  RMT_CHANNEL_4, RMT_CHANNEL_5, RMT_CHANNEL_6, RMT_CHANNEL_7, RMT_CHANNEL_MAX
+} rmt_channel_t;
+typedef enum { RMT_MODE_TX = 0, RMT_MODE_RX } rmt_mode_t;
+typedef enum { RMT_CARRIER_LEVEL_LOW = 0, RMT_CARRIER_LEVEL_HIGH } rmt_carrier_level_t;
+typedef enum { RMT_IDLE_LEVEL_LOW = 0, RMT_IDLE_LEVEL_HIGH } rmt_idle_level_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct {
+  bool filter_en;
+  uint8_t filter_ticks_thresh;
+  uint16_t idle_threshold;
+} rmt_rx_config_t;
+
+typedef struct {
+  bool loop_en;
+  uint32_t carrier_freq_hz;
+  uint8_t carrier_duty_percent;
+  rmt_carrier_level_t carrier_level;
+  bool carrier_en;
+  rmt_idle_level_t idle_level;
+  bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+  rmt_mode_t rmt_mode;
+  rmt_channel_t channel;
+  uint8_t clk_div;
+  gpio_num_t gpio_num;
+  uint8_t mem_block_num;
+  union {
+    rmt_tx_config_t tx_config;
+    rmt_rx_config_t rx_config;
+  };
+} rmt_config_t;
+
+esp_err_t rmt_config(const rmt_config_t* config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rxBufSize, int intrFlags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t* pRing);
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool resetMemory);
+esp_err_t rmt_rx_stop(rmt_channel_t channel);
+esp_err_t rmt_set_rx_filter(rmt_channel_t channel, bool enable, uint8_t threshold);
+esp_err_t rmt_set_rx_idle_thresh(rmt_channel_t channel, uint16_t threshold);
+esp_err_t rmt_set_rx_intr_en(rmt_channel_t channel, bool enable);
+esp_err_t rmt_set_err_intr_en(rmt_channel_t channel, bool enable);
+esp_err_t rmt_memory_rw_rst(rmt_channel_t channel);
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t* items, int count, bool waitDone);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t ticks);
+
+// deliver one received frame to the channel's ring, as the RMT ISR does
+bool hostRMTReceive(rmt_channel_t channel, const rmt_item32_t* items, int count);
+
+#endif
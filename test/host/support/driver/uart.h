@@ -0,0 +1,90 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host UART driver, received data is injected by the test via hostUARTReceive()
+
+#ifndef __HOST_DRIVER_UART_H__
+#define __HOST_DRIVER_UART_H__
+
+#include <Arduino.h>
+#include <freertos/queue.h>
+
+typedef enum { UART_NUM_0 = 0, UART_NUM_1, UART_NUM_2, UART_NUM_MAX } uart_port_t;
+typedef enum { UART_DATA_5_BITS = 0, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0, UART_PARITY_EVEN = 2, UART_PARITY_ODD = 3 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0, UART_HW_FLOWCTRL_RTS, UART_HW_FLOWCTRL_CTS, UART_HW_FLOWCTRL_CTS_RTS } uart_hw_flowcontrol_t;
+
+typedef enum {
+  UART_DATA = 0, UART_BREAK, UART_BUFFER_FULL, UART_FIFO_OVF,
+  UART_FRAME_ERR, UART_PARITY_ERR, UART_DATA_BREAK, UART_PATTERN_DET, UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct {
+  uart_event_type_t type;
+  size_t size;
+  bool timeout_flag;
+} uart_event_t;
+
+typedef struct {
+  int baud_rate;
+  uart_word_length_t data_bits;
+  uart_parity_t parity;
+  uart_stop_bits_t stop_bits;
+  uart_hw_flowcontrol_t flow_ctrl;
+  uint8_t rx_flow_ctrl_thresh;
+} uart_config_t;
+
+typedef struct {
+  uint32_t intr_enable_mask;
+  uint8_t rx_timeout_thresh;
+  uint8_t txfifo_empty_intr_thresh;
+  uint8_t rxfifo_full_thresh;
+} uart_intr_config_t;
+
+#define UART_PIN_NO_CHANGE          (-1)
+#define UART_RXFIFO_FULL_INT_ENA_M  (1 << 0)
+#define UART_FRM_ERR_INT_ENA_M      (1 << 3)
+#define UART_RXFIFO_OVF_INT_ENA_M   (1 << 4)
+#define UART_PARITY_ERR_INT_ENA_M   (1 << 2)
+#define UART_BRK_DET_INT_ENA_M      (1 << 7)
+#define UART_RXFIFO_TOUT_INT_ENA_M  (1 << 8)
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t* config);
+esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin);
+esp_err_t uart_driver_install(uart_port_t port, int rxBufSize, int txBufSize, int queueSize, QueueHandle_t* pQueue, int intrFlags);
+esp_err_t uart_driver_delete(uart_port_t port);
+esp_err_t uart_intr_config(uart_port_t port, const uart_intr_config_t* config);
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t* pSize);
+int uart_read_bytes(uart_port_t port, uint8_t* buf, uint32_t length, TickType_t ticks);
+int uart_write_bytes(uart_port_t port, const char* src, size_t size);
+esp_err_t uart_flush_input(uart_port_t port);
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks);
+
+// stands in for the UART ISR: a block of bytes leaves the RX FIFO, on a FIFO
+// threshold or receive timeout. Bytes that do not fit the driver's receive
+// buffer are lost and UART_BUFFER_FULL is posted instead of UART_DATA.
+// Returns the bytes buffered.
+int hostUARTReceive(uart_port_t port, const char* data, int len);
+size_t hostUARTTransmitted(uart_port_t port);
+
+#endif
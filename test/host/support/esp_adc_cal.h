@@ -0,0 +1,48 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host ADC calibration: a straight line, 0 to 3.1V over 4095 counts at 11dB
+
+#ifndef __HOST_ESP_ADC_CAL_H__
+#define __HOST_ESP_ADC_CAL_H__
+
+#include <driver/adc.h>
+
+typedef struct {
+  adc_unit_t adc_num;
+  adc_atten_t atten;
+  adc_bits_width_t bit_width;
+  uint32_t coeff_a;
+  uint32_t coeff_b;
+  uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+typedef enum {
+  ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+  ESP_ADC_CAL_VAL_EFUSE_TP,
+  ESP_ADC_CAL_VAL_DEFAULT_VREF
+} esp_adc_cal_value_t;
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width, uint32_t defaultVref, esp_adc_cal_characteristics_t* chars);
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars);
+
+#endif
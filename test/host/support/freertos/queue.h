@@ -0,0 +1,2 @@
+// Host build: the IDF path to the FreeRTOS API
+#include <FreeRTOS.h>
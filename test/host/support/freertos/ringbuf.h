@@ -0,0 +1,47 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Host ESP-IDF ring buffer. NOSPLIT rings charge each item its 8 byte
+// header and 4 byte alignment, as the IDF does, so fill levels match,
+// and refuse items larger than half the ring.
+
+#ifndef __HOST_RINGBUF_H__
+#define __HOST_RINGBUF_H__
+
+#include <FreeRTOS.h>
+
+typedef enum {
+  RINGBUF_TYPE_NOSPLIT = 0,
+  RINGBUF_TYPE_ALLOWSPLIT,
+  RINGBUF_TYPE_BYTEBUF
+} ringbuf_type_t;
+
+RingbufHandle_t xRingbufferCreate(size_t size, ringbuf_type_t type);
+void vRingbufferDelete(RingbufHandle_t ring);
+BaseType_t xRingbufferSend(RingbufHandle_t ring, const void* data, size_t size, TickType_t ticks);
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t ring, const void* data, size_t size, BaseType_t* pWoken);
+void* xRingbufferReceive(RingbufHandle_t ring, size_t* pSize, TickType_t ticks);
+void* xRingbufferReceiveUpTo(RingbufHandle_t ring, size_t* pSize, TickType_t ticks, size_t maxSize);
+void vRingbufferReturnItem(RingbufHandle_t ring, void* item);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring);
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t ring);
+
+#endif
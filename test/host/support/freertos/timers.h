@@ -0,0 +1,41 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host FreeRTOS software timers, each runs its callback from its own thread
+
+#ifndef __HOST_TIMERS_H__
+#define __HOST_TIMERS_H__
+
+#include <FreeRTOS.h>
+
+typedef void* TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id, TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void* pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif
@@ -0,0 +1,7 @@
+// Host build: lwIP sockets are the host's BSD sockets
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
@@ -0,0 +1,48 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Host NVS, the in memory store behind Preferences
+
+#ifndef __HOST_NVS_H__
+#define __HOST_NVS_H__
+
+#include <Arduino.h>
+
+typedef uint32_t nvs_handle;
+
+#define ESP_ERR_NVS_BASE            0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND       (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH  (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef struct {
+  size_t used_entries;
+  size_t free_entries;
+  size_t total_entries;
+  size_t namespace_count;
+} nvs_stats_t;
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* buf, size_t* pLen);
+esp_err_t nvs_get_str(nvs_handle handle, const char* key, char* buf, size_t* pLen);
+esp_err_t nvs_get_stats(const char* partition, nvs_stats_t* pStats);
+
+#endif
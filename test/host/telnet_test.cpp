@@ -0,0 +1,370 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// TelnetSpy output path
+//
+// A telnet client on a loopback socket reads numbered 88 byte lines, and
+// checks that each arrives whole and in order, counting the lines lost in
+// between. Serial output goes to a model of the target's 128 byte UART FIFO
+// emptied at 115200 baud, and is captured for comparison. Each run is made
+// with the current TelnetSpy and the old one (oracle/TelnetSpy_old), and
+// the time spent in write() is measured, handle() being called between
+// writes as loop() would.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <lwip/sockets.h>
+#include <signal.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "HostTest.h"
+#define protected public
+#include "../../lib/TelnetSpy/TelnetSpy.h"
+#include "oracle/TelnetSpy_old.h"
+#undef protected
+
+static const int LineLen = 88;
+
+static std::string
+makeLine(unsigned seq)
+{
+  char line[LineLen + 1];
+  int n = snprintf(line, sizeof(line), "%08u ", seq);
+  for(int i = n; i < LineLen - 2; i++)
+    line[i] = 'a' + (seq + i) % 26;
+  line[LineLen - 2] = '\r';
+  line[LineLen - 1] = '\n';
+  return std::string(line, LineLen);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// telnet client, reading on its own thread
+
+struct sClientStats {
+  int lines = 0;
+  int malformed = 0;
+  int outOfOrder = 0;
+  int lost = 0;                 // gaps in the sequence
+  long bytes = 0;
+  double first_us = 0, last_us = 0;
+};
+
+class CTelnetClient {
+  int _fd = -1;
+  int _readSize, _readDelay_us;
+  std::thread _thread;
+  std::string _pending;
+  long _lastSeq = -1;
+  bool _welcomed = false;
+  void _parse(const char* data, int len);
+  void _run();
+public:
+  sClientStats stats;
+  // a slow client reads <readSize> bytes every <readDelay_us> into a small socket buffer
+  bool connect(uint16_t port, int readSize = 65536, int readDelay_us = 0);
+  void join() { if(_thread.joinable()) _thread.join(); ::close(_fd); }
+};
+
+bool
+CTelnetClient::connect(uint16_t port, int readSize, int readDelay_us)
+{
+  _readSize = readSize;
+  _readDelay_us = readDelay_us;
+  _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if(readDelay_us) {
+    int size = 4096;
+    setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(::connect(_fd, (sockaddr*)&addr, sizeof(addr)))
+    return false;
+  _thread = std::thread(&CTelnetClient::_run, this);
+  return true;
+}
+
+void
+CTelnetClient::_run()
+{
+  char buf[65536];
+  for(;;) {
+    int n = ::recv(_fd, buf, std::min(_readSize, (int)sizeof(buf)), 0);
+    if(n <= 0)
+      break;
+    double now = hostNow_us();
+    if(stats.bytes == 0)
+      stats.first_us = now;
+    stats.last_us = now;
+    stats.bytes += n;
+    _parse(buf, n);
+    if(_readDelay_us)
+      std::this_thread::sleep_for(std::chrono::microseconds(_readDelay_us));
+  }
+}
+
+void
+CTelnetClient::_parse(const char* data, int len)
+{
+  _pending.append(data, len);
+  size_t start = 0, end;
+  while((end = _pending.find('\n', start)) != std::string::npos) {
+    std::string line = _pending.substr(start, end + 1 - start);
+    start = end + 1;
+    if(!_welcomed && line == TELNETSPY_WELCOME_MSG) {
+      _welcomed = true;
+      continue;
+    }
+    unsigned seq;
+    if(sscanf(line.c_str(), "%8u", &seq) != 1 || line != makeLine(seq)) {
+      stats.malformed++;
+      continue;
+    }
+    stats.lines++;
+    if((long)seq <= _lastSeq)
+      stats.outOfOrder++;
+    else
+      stats.lost += seq - _lastSeq - 1;
+    _lastSeq = seq;
+  }
+  _pending.erase(0, start);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+static std::string SerialOut;
+
+static void
+captureSerial(const uint8_t* buf, size_t size)
+{
+  SerialOut.append((const char*)buf, size);
+}
+
+struct sWriteStats {
+  int writes = 0;
+  double total_us = 0, max_us = 0;
+  double mean() const { return writes ? total_us / writes : 0; }
+  void add(double us) { writes++; total_us += us; max_us = std::max(max_us, us); }
+};
+
+template<class T> static bool
+start(T& spy, uint16_t port, HardwareSerial* pSerial, CTelnetClient& client, int readSize = 65536, int readDelay_us = 0)
+{
+  signal(SIGPIPE, SIG_IGN);      // sends to a closed client
+  hostSimTicks(false);
+  spy.setSerial(pSerial);
+  spy.setPort(port);
+  spy.setPingTime(0);
+  spy.begin(115200);
+  spy.handle();                  // now listening
+  if(!client.connect(port, readSize, readDelay_us))
+    return false;
+  for(int i = 0; i < 1000 && !spy.isClientConnected(); i++) {
+    spy.handle();
+    delay(1);
+  }
+  return spy.isClientConnected();
+}
+
+static int pending(TelnetSpy& spy) { return spy.bufUsed + spy.tailLen; }
+static int pending(COldTelnetSpy& spy) { return spy.bufUsed; }
+
+// keep handling until everything buffered has gone to the client
+template<class T> static void
+finish(T& spy, CTelnetClient& client, int timeout_ms = 5000)
+{
+  for(int i = 0; i < timeout_ms && pending(spy); i++) {
+    spy.handle();
+    delay(1);
+  }
+  spy.flush();
+  delay(50);                     // let the client read the last block
+  spy.client.stop();             // the destructor's end() closes the server
+  client.join();
+}
+
+static void
+reportClient(const char* name, const sClientStats& stats)
+{
+  REPORT("%s: %d lines received, %d lost, %d malformed, %d out of order", name,
+         stats.lines, stats.lost, stats.malformed, stats.outOfOrder);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+template<class T> static sWriteStats
+telnetFlatOut(T& spy, uint16_t port, int lines, sClientStats& received, double& elapsed_us)
+{
+  sWriteStats writes;
+  CTelnetClient client;
+  CHECK(start(spy, port, NULL, client));
+  std::string line;
+  double t0 = hostNow_us();
+  for(int seq = 0; seq < lines; seq++) {
+    line = makeLine(seq);
+    double t = hostNow_us();
+    spy.write((const uint8_t*)line.data(), line.size());
+    writes.add(hostNow_us() - t);
+    spy.handle();
+  }
+  elapsed_us = hostNow_us() - t0;
+  finish(spy, client);
+  received = client.stats;
+  received.first_us = t0;
+  return writes;
+}
+
+TEST(telnet_only_flat_out)
+{
+  const int lines = 20000;
+  sClientStats now, old;
+  double nowTime, oldTime;
+  TelnetSpy spy;
+  sWriteStats nowWrites = telnetFlatOut(spy, 2301, lines, now, nowTime);
+  COldTelnetSpy oldSpy;
+  sWriteStats oldWrites = telnetFlatOut(oldSpy, 2302, lines, old, oldTime);
+
+  for(const sClientStats* stats : { &now, &old }) {
+    CHECK(stats->lines > 0);
+    CHECK_EQ(0, stats->malformed);
+    CHECK_EQ(0, stats->outOfOrder);
+    CHECK_EQ(lines, stats->lines + stats->lost);
+  }
+  CHECK(nowWrites.mean() < oldWrites.mean());
+  double bytes = double(lines) * LineLen;
+  REPORT("write() mean %.2fus per %d byte line (was %.2fus)", nowWrites.mean(), LineLen, oldWrites.mean());
+  REPORT("written %.1fMB/s (was %.1fMB/s), received %.1fMB/s (was %.1fMB/s)",
+         bytes / nowTime, bytes / oldTime,
+         now.bytes / (now.last_us - now.first_us), old.bytes / (old.last_us - old.first_us));
+  reportClient("now", now);
+  reportClient("old", old);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+template<class T> static sWriteStats
+serialBursts(T& spy, uint16_t port, int bursts, sClientStats& received, std::string& written)
+{
+  sWriteStats writes;
+  CTelnetClient client;
+  SerialOut.clear();
+  hostCaptureSerial(captureSerial);
+  hostSerialUART(true);
+  CHECK(start(spy, port, &Serial, client));
+  SerialOut.clear();             // anything before the client connected
+  written.clear();
+  std::string line;
+  int seq = 0;
+  for(int burst = 0; burst < bursts; burst++) {
+    double next = hostNow_us() + 50000;
+    for(int i = 0; i < 5; i++) {
+      line = makeLine(seq++);
+      written += line;
+      double t = hostNow_us();
+      spy.write((const uint8_t*)line.data(), line.size());
+      writes.add(hostNow_us() - t);
+    }
+    while(hostNow_us() < next) {
+      spy.handle();
+      delay(1);
+    }
+  }
+  finish(spy, client);
+  hostSerialUART(false);
+  hostCaptureSerial(NULL);
+  received = client.stats;
+  return writes;
+}
+
+TEST(serial_and_telnet_bursts)
+{
+  const int bursts = 20;
+  sClientStats now, old;
+  std::string written;
+  TelnetSpy spy;
+  sWriteStats nowWrites = serialBursts(spy, 2303, bursts, now, written);
+  CHECK_EQ(written.size(), SerialOut.size());
+  CHECK(written == SerialOut);
+  COldTelnetSpy oldSpy;
+  sWriteStats oldWrites = serialBursts(oldSpy, 2304, bursts, old, written);
+  CHECK(written == SerialOut);
+
+  for(const sClientStats* stats : { &now, &old }) {
+    CHECK_EQ(bursts * 5, stats->lines);
+    CHECK_EQ(0, stats->lost + stats->malformed + stats->outOfOrder);
+  }
+  // the 1kB backlog takes a burst, the old path waited for the UART
+  CHECK(nowWrites.max_us < oldWrites.mean() / 4);
+  REPORT("5 line bursts every 50ms at 115200 baud: write() mean %.1fus, max %.0fus (was %.0fus mean, %.0fus max)",
+         nowWrites.mean(), nowWrites.max_us, oldWrites.mean(), oldWrites.max_us);
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+template<class T> static sWriteStats
+slowClient(T& spy, uint16_t port, int lines, sClientStats& received)
+{
+  sWriteStats writes;
+  CTelnetClient client;
+  CHECK(start(spy, port, NULL, client, 512, 10000));     // ~50kB/s
+  int size = 4096;
+  setsockopt(spy.client.fd(), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  std::string line;
+  for(int seq = 0; seq < lines; seq++) {
+    line = makeLine(seq);
+    double t = hostNow_us();
+    spy.write((const uint8_t*)line.data(), line.size());
+    writes.add(hostNow_us() - t);
+    spy.handle();
+    if(seq % 10 == 0)
+      delay(1);
+  }
+  finish(spy, client);
+  received = client.stats;
+  return writes;
+}
+
+TEST(slow_client_loses_whole_lines)
+{
+  const int lines = 1000;
+  sClientStats now, old;
+  TelnetSpy spy;
+  sWriteStats nowWrites = slowClient(spy, 2305, lines, now);
+  COldTelnetSpy oldSpy;
+  sWriteStats oldWrites = slowClient(oldSpy, 2306, lines, old);
+
+  CHECK(now.lines > 0);
+  CHECK(now.lost > 0);
+  CHECK_EQ(lines, now.lines + now.lost);
+  CHECK_EQ(0, now.malformed);
+  CHECK_EQ(0, now.outOfOrder);
+  reportClient("now", now);
+  reportClient("old", old);
+  REPORT("write() mean %.1fus, max %.0fus (was %.0fus mean, %.0fus max)",
+         nowWrites.mean(), nowWrites.max_us, oldWrites.mean(), oldWrites.max_us);
+}
@@ -0,0 +1,325 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Temperature sensor acquisition task
+//
+// CTempSense's SensorTask runs as a host thread on the fake one wire bus
+// (fakes/OneWire_fake.cpp): three DS18B20 probes are found by begin(), 
+// and loop()'s side only picks up the published readings. Checked are the
+// readings (each probe's first is held off) and their resolution, the 
+// cycle time the task keeps for 9 and 12 bit probes (one convert_all per 
+// cycle), and probes joining and leaving the bus on a rescan. The time 
+// loop() spends reading a temperature whilst the task converts is 
+// reported.
+// BTC_JSON.cpp is built here for the JSON of sensors beyond the fourth:
+// seven then ten probes report through makeJSONStringTemp(), a page of 
+// TEMP_JSON_PAGE sensors per string, only what changed is sent and a 
+// changed temperature is held off for 5s.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <math.h>
+#include <algorithm>
+#include "HostTest.h"
+#include "OneWire_fake.h"
+#include "cfg/BTCConfig.h"
+#include "Utility/TempSense.h"
+#include "Utility/BTC_JSON.cpp"
+#include "../../lib/ArduinoJson/ArduinoJson.h"
+
+// the rest of BTC_JSON.cpp's dependencies
+void DecodeCmd(const char* cmd, String& payload) {}   // commands are not interpreted
+CScreenManager ScreenManager;
+
+static const float ProbeTemps[] = { 20.0f, 21.5f, -5.25f };
+
+static CTempSense& 
+sensors()
+{
+  static CTempSense sensors;
+  static bool begun = false;
+  hostSimTicks(false);
+  if(!begun) {
+    FakeOneWire.clear();
+    for(int i = 0; i < 3; i++)
+      FakeOneWire.addProbe(i+1, ProbeTemps[i]);
+    sensors.begin(0, 0x76);      // the fake bus ignores the pin, no BME280 is attached
+    begun = true;
+  }
+  return sensors;
+}
+
+// as loop(), polled every 1ms, the longest temperature read is kept
+static long
+waitReadings(CTempSense& sensors, long timeout, long* pMaxRead_us = NULL)
+{
+  unsigned long tStart = millis();
+  while(long(millis() - tStart) < timeout) {
+    unsigned long t0 = micros();
+    float temperature;
+    sensors.getTemperature(0, temperature);
+    if(pMaxRead_us) 
+      *pMaxRead_us = std::max(*pMaxRead_us, long(micros() - t0));
+    if(sensors.hasNewReadings())
+      return millis() - tStart;
+    delay(1);
+  }
+  return -1;
+}
+
+// readings published until a probe's is valid, its first is held off
+static int
+waitValid(CTempSense& sensors, int usrIdx)
+{
+  float temperature;
+  for(int n = 1; n <= 4; n++) {
+    if(waitReadings(sensors, 2 * MIN_TEMPERATURE_INTERVAL + 100) < 0)
+      return -1;
+    if(sensors.getTemperature(usrIdx, temperature, false))
+      return n;
+  }
+  return -1;
+}
+
+static float
+quantised(float temperature, int bits)
+{
+  float step = 1.0f / (1 << (bits - 8));
+  return floorf(temperature / step + 0.5f) * step;
+}
+
+TEST(task_reads_probes)
+{
+  CTempSense& ts = sensors();
+  CHECK(ts.getTaskHandle() != NULL);
+  CHECK_EQ(3, ts.getNumSensors());
+  CHECK_EQ(2, waitValid(ts, 0));
+  for(int i = 0; i < 3; i++) {
+    float temperature = -100;
+    CHECK(ts.getTemperature(i, temperature, false));
+    CHECK(temperature == quantised(ProbeTemps[i], ts.getResolution(i)));
+  }
+}
+
+// the task sleeps out the conversion, or the rest of the sample interval
+TEST(cycle_time)
+{
+  CTempSense& ts = sensors();
+  ts.setSampleInterval(100);
+  const int resolutions[] = { 9, 12 };
+  for(int bits : resolutions) {
+    for(int i = 0; i < 3; i++) 
+      CHECK(ts.setResolution(i, bits));
+    // the task applies the resolution at the start of its next cycle
+    waitReadings(ts, 2000);
+    waitReadings(ts, 2000);
+    CHECK(waitReadings(ts, 2000) >= 0);
+
+    long conversion = 750 >> (12 - bits);
+    long expected = std::max(100L, conversion + 2);
+    int cycles = bits == 9 ? 10 : 3;
+    uint32_t conversions = FakeOneWire.conversions;
+    long maxRead_us = 0;
+    unsigned long tStart = millis();
+    for(int n = 0; n < cycles; n++) 
+      CHECK(waitReadings(ts, 2000, &maxRead_us) >= 0);
+    long period = (millis() - tStart) / cycles;
+    CHECK(abs(period - expected) <= expected / 10 + 5);
+    CHECK_EQ(uint32_t(cycles), FakeOneWire.conversions - conversions);
+    CHECK(maxRead_us < 5000);   // never waits on a conversion
+
+    float temperature = -100;
+    CHECK(ts.getTemperature(2, temperature, false));
+    CHECK(temperature == quantised(ProbeTemps[2], bits));
+    REPORT("%2d bit: %3ldms conversion, %3ldms cycle (expected %3ld), longest read from loop() %ldus", 
+           bits, conversion, period, expected, maxRead_us);
+  }
+  ts.setSampleInterval(MIN_TEMPERATURE_INTERVAL);
+}
+
+static void
+rescan(CTempSense& ts)
+{
+  int scans = ts.getScanCount();
+  ts.requestRescan();
+  long t = 0;
+  while(ts.getScanCount() == scans && t < 2000) {
+    delay(1);
+    t++;
+  }
+  CHECK(ts.getScanCount() == scans + 1);
+  CHECK(waitReadings(ts, 2000) >= 0);
+}
+
+// roles follow the probes in bus order when none are assigned
+TEST(probes_join_and_leave)
+{
+  CTempSense& ts = sensors();
+  int added = FakeOneWire.addProbe(4, 30.0f);
+  rescan(ts);
+  CHECK_EQ(4, ts.getNumSensors());
+  CHECK(waitValid(ts, 3) > 0);
+  float temperature = -100;
+  CHECK(ts.getTemperature(3, temperature, false));
+  CHECK(fabs(temperature - 30.0f) <= 0.5f);
+
+  FakeOneWire.probes[1].present = false;
+  rescan(ts);
+  CHECK_EQ(3, ts.getNumSensors());
+  CHECK(ts.getTemperature(1, temperature, false));
+  CHECK(fabs(temperature - ProbeTemps[2]) <= 0.5f);
+  CHECK(ts.getTemperature(2, temperature, false));
+  CHECK(fabs(temperature - 30.0f) <= 0.5f);
+
+  FakeOneWire.probes[1].present = true;
+  FakeOneWire.probes[added].present = false;
+  rescan(ts);
+  CHECK_EQ(3, ts.getNumSensors());
+  CHECK(waitValid(ts, 1) > 0);
+  CHECK(ts.getTemperature(1, temperature, false));
+  CHECK(fabs(temperature - ProbeTemps[1]) <= 0.5f);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// JSON of the sensors beyond the fourth
+
+// the sensors getTempSensor() reports, seven probes at 10 to 16C
+static CTempSense& 
+reporting()
+{
+  static bool begun = false;
+  hostSimTicks(false);
+  if(!begun) {
+    FakeOneWire.clear();
+    for(int i = 0; i < 7; i++)
+      FakeOneWire.addProbe(11+i, 10.0f + i);
+    getTempSensor().begin(0, 0x76);
+    begun = true;
+  }
+  return getTempSensor();
+}
+
+static int
+parse(DynamicJsonBuffer& jsonBuffer, const char* json, JsonObject*& pRoot)
+{
+  pRoot = &jsonBuffer.parseObject(json);
+  CHECK(pRoot->success());
+  return pRoot->size();
+}
+
+TEST(json_beyond_fourth)
+{
+  CTempSense& ts = reporting();
+  CHECK_EQ(7, ts.getNumSensors());
+  CHECK(waitValid(ts, 6) > 0);
+
+  CModerator moderator;
+  char json[800];
+  CHECK(makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject* pRoot;
+  CHECK_EQ(9, parse(jsonBuffer, json, pRoot));
+  for(int usrIdx = 4; usrIdx < 7; usrIdx++) {
+    JsonObject& root = *pRoot;
+    CHECK(root[CTempSense::getName(usrIdx, CTempSense::CurrentName)].as<float>() == 10.0f + usrIdx);
+    CHECK(root[CTempSense::getName(usrIdx, CTempSense::OffsetName)].as<float>() == 0);
+    CHECK_STREQ("DS18B20", root[CTempSense::getName(usrIdx, CTempSense::TypeName)].as<const char*>());
+  }
+  CHECK(!pRoot->containsKey("Temp4Current"));
+  CHECK(!pRoot->containsKey("Temp8Current"));
+  REPORT("%s", json);
+
+  // nothing has changed
+  CHECK(!makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+}
+
+TEST(json_moderated)
+{
+  CTempSense& ts = reporting();
+  CHECK(waitValid(ts, 6) > 0);
+  CModerator moderator;
+  char json[800];
+  CHECK(makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+
+  // an offset is sent at once, the temperature it moves is held off
+  ts.setOffset(5, 1.5);
+  CHECK(makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+  {
+    DynamicJsonBuffer jsonBuffer;
+    JsonObject* pRoot;
+    CHECK_EQ(1, parse(jsonBuffer, json, pRoot));
+    CHECK(pRoot->get<float>("Temp6Offset") == 1.5f);
+  }
+  FakeOneWire.probes[4].temperature = 25;
+  CHECK(waitReadings(ts, 2000) >= 0);
+  CHECK(!makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+
+  // a reset (a new client) sends everything
+  moderator.reset();
+  CHECK(makeJSONStringTemp(moderator, 4, json, sizeof(json)));
+  {
+    DynamicJsonBuffer jsonBuffer;
+    JsonObject* pRoot;
+    CHECK_EQ(9, parse(jsonBuffer, json, pRoot));
+    float temperature = pRoot->get<float>("Temp5Current");   // filtered, on its way to 25
+    CHECK(temperature > 14.0f && temperature <= 25.0f);
+    CHECK(pRoot->get<float>("Temp6Current") == 16.5f);
+  }
+
+  FakeOneWire.probes[4].temperature = 14;
+  ts.setOffset(5, 0);
+}
+
+// as updateJSONclients(), a string per page
+TEST(json_pages)
+{
+  CTempSense& ts = reporting();
+  for(int i = 7; i < 10; i++)
+    FakeOneWire.addProbe(11+i, 10.0f + i);
+  rescan(ts);
+  CHECK_EQ(10, ts.getNumSensors());
+  CHECK(waitValid(ts, 9) > 0);
+
+  CModerator moderator;
+  char json[800];
+  int pages = 0;
+  for(int first = 4; first < ts.getNumSensors(); first += TEMP_JSON_PAGE) {
+    CHECK(makeJSONStringTemp(moderator, first, json, sizeof(json)));
+    DynamicJsonBuffer jsonBuffer;
+    JsonObject* pRoot;
+    int last = std::min(first + TEMP_JSON_PAGE, ts.getNumSensors());
+    CHECK_EQ(3 * (last - first), parse(jsonBuffer, json, pRoot));
+    CHECK(pRoot->containsKey(CTempSense::getName(first, CTempSense::CurrentName)));
+    CHECK(pRoot->containsKey(CTempSense::getName(last-1, CTempSense::TypeName)));
+    CHECK(strlen(json) < sizeof(json) - 1);
+    REPORT("Temp%d to Temp%d: %d bytes", first+1, last, int(strlen(json)));
+    pages++;
+  }
+  CHECK_EQ(2, pages);
+  // the moderators key on the name pointer
+  CHECK(CTempSense::getName(9, CTempSense::CurrentName) == CTempSense::getName(9, CTempSense::CurrentName));
+}
@@ -0,0 +1,395 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// CTimerManager interval list against the original per minute week map
+//
+// The original implementation (oracle/TimerManager_old) is the reference:
+// random sets of the 14 legacy timers must give the same timer at every
+// minute of the week, the same next timer and start, the same condensed
+// chart and the same conflict verdicts.
+// Two defects of the week map are avoided in the random sets and instead
+// checked directly against the interval list:
+//   - overnight timers on consecutive days lost the following day's run
+//   - Saturday overnight timers never ended (no wrap to Sunday morning)
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "HostTest.h"
+#include "DS3231_fake.h"
+#define private public
+#include "RTC/TimerManager.h"
+#include "oracle/TimerManager_old.h"
+#undef private
+#include "RTC/Timers.h"
+#include "RTC/Clock.h"
+#include "Utility/NVStorage.h"
+#include "Utility/Moderator.h"
+#include "Fakes.h"
+
+static CFakeDS3231 FakeRTC;
+
+static void 
+setup()
+{
+  hostSimTicks(true);
+  FakeRTC.attach(Wire);
+  NVstore.init();
+}
+
+static void 
+clearTimers()
+{
+  for(int i = 0; i < MAX_TIMERS; i++) {
+    sTimer timer;
+    timer.init(i);
+    NVstore.setTimerInfo(i, timer);
+  }
+}
+
+static void 
+setTimer(int ID, int startHour, int startMin, int stopHour, int stopMin, uint8_t enabled, bool repeat)
+{
+  sTimer timer;
+  timer.init(ID);
+  timer.start.hour = startHour;
+  timer.start.min = startMin;
+  timer.stop.hour = stopHour;
+  timer.stop.min = stopMin;
+  timer.enabled = enabled;
+  timer.repeat = repeat;
+  NVstore.setTimerInfo(ID, timer);
+}
+
+static int 
+weekMinute(int dow, int hour, int minute)
+{
+  return dow * 1440 + hour * 60 + minute;
+}
+
+// a random legacy timer, steering clear of the week map's known defects
+static void 
+randomTimer(int ID)
+{
+  int startHour = rand() % 24, startMin = rand() % 60;
+  int stopHour = rand() % 24, stopMin = rand() % 60;
+  uint8_t enabled = (rand() % 4 == 0) ? 0x80 : (rand() & 0x7f);
+  bool repeat = rand() & 1;
+  bool overnight = (stopHour * 60 + stopMin) <= (startHour * 60 + startMin);
+  if(overnight && enabled != 0x80) {
+    enabled &= ~0x40;                          // no Saturday overnight
+    uint8_t next = ((enabled << 1) | (enabled >> 6)) & 0x7f;
+    if(enabled & next)
+      enabled &= 0x15;                         // no consecutive overnight days
+  }
+  setTimer(ID, startHour, startMin, stopHour, stopMin, enabled, repeat);
+}
+
+TEST(random_sets_match_week_map)
+{
+  setup();
+  srand(1234);
+  long minutes = 0, mapMismatch = 0, nextMismatch = 0, chartMismatch = 0, conflictMismatch = 0;
+  for(int trial = 0; trial < 3000; trial++) {
+    clearTimers();
+    int n = rand() % 15;
+    for(int i = 0; i < n; i++) 
+      randomTimer(rand() % 14);
+    Clock.set(DateTime(2020, 1, 1 + rand() % 28, rand() % 24, rand() % 60, 0));
+
+    COldTimerManager::createMap();
+    CTimerManager::createMap();
+
+    for(int dow = 0; dow < 7; dow++) {
+      for(int minute = 0; minute < 1440; minute++) {
+        minutes++;
+        if(COldTimerManager::_weekMap[dow][minute] != CTimerManager::_getTimerAt(dow * 1440 + minute))
+          mapMismatch++;
+      }
+    }
+    for(int k = 0; k < 50; k++) {
+      int dow = rand() % 7, hour = rand() % 24, minute = rand() % 60;
+      int oldNext = COldTimerManager::findNextTimer(hour, minute, dow);
+      int newNext = CTimerManager::findNextTimer(hour, minute, dow);
+      if(oldNext != newNext || (oldNext && COldTimerManager::_nextStart != CTimerManager::_nextStart))
+        nextMismatch++;
+    }
+    uint8_t oldChart[7][120], newChart[7][120];
+    COldTimerManager::condenseMap(oldChart);
+    CTimerManager::condenseMap(newChart);
+    if(memcmp(oldChart, newChart, sizeof(oldChart)))
+      chartMismatch++;
+
+    sTimer candidate;
+    candidate.init(rand() % 14);
+    candidate.start.hour = rand() % 24;
+    candidate.stop.hour = rand() % 24;
+    candidate.enabled = rand() & 0x15;
+    candidate.repeat = true;
+    if((COldTimerManager::conflictTest(candidate) != 0) != (CTimerManager::conflictTest(candidate) != 0))
+      conflictMismatch++;
+  }
+  REPORT("%ld minutes compared", minutes);
+  CHECK_EQ(0, mapMismatch);
+  CHECK_EQ(0, nextMismatch);
+  CHECK_EQ(0, chartMismatch);
+  CHECK_EQ(0, conflictMismatch);
+}
+
+TEST(overnight_consecutive_days)
+{
+  setup();
+  clearTimers();
+  setTimer(0, 22, 0, 2, 0, 0x06, true);        // Monday and Tuesday nights
+  CTimerManager::createMap();
+  int ID = 1 | CTimerManager::_repeatFlag;
+  CHECK_EQ(0, CTimerManager::_getTimerAt(weekMinute(1, 21, 59)));
+  CHECK_EQ(ID, CTimerManager::_getTimerAt(weekMinute(1, 22, 0)));
+  CHECK_EQ(ID, CTimerManager::_getTimerAt(weekMinute(2, 1, 59)));
+  CHECK_EQ(0, CTimerManager::_getTimerAt(weekMinute(2, 2, 0)));
+  CHECK_EQ(ID, CTimerManager::_getTimerAt(weekMinute(2, 22, 0)));
+  CHECK_EQ(ID, CTimerManager::_getTimerAt(weekMinute(3, 1, 59)));   // lost by the week map
+  CHECK_EQ(0, CTimerManager::_getTimerAt(weekMinute(3, 2, 0)));
+  CHECK_EQ(2, (int)CTimerManager::_intervals.size());
+}
+
+TEST(saturday_wraps_to_sunday)
+{
+  setup();
+  clearTimers();
+  setTimer(3, 23, 0, 1, 0, 0x40, false);       // Saturday night
+  CTimerManager::createMap();
+  CHECK_EQ(2, (int)CTimerManager::_intervals.size());
+  CHECK_EQ(0, CTimerManager::_intervals[0].start);
+  CHECK_EQ(60, CTimerManager::_intervals[0].stop);
+  CHECK_EQ(weekMinute(6, 23, 0), CTimerManager::_intervals[1].start);
+  CHECK_EQ(CTimerManager::_weekMinutes, CTimerManager::_intervals[1].stop);
+  CHECK_EQ(4, CTimerManager::_getTimerAt(weekMinute(6, 23, 59)));
+  CHECK_EQ(4, CTimerManager::_getTimerAt(weekMinute(0, 0, 59)));
+  CHECK_EQ(0, CTimerManager::_getTimerAt(weekMinute(0, 1, 0)));        // never ended by the week map
+  CHECK_EQ(4, CTimerManager::findNextTimer(22, 0, 6));
+  CHECK_EQ(weekMinute(6, 23, 0), CTimerManager::_nextStart);
+  CHECK_EQ(4, CTimerManager::findNextTimer(0, 30, 0));     // Sunday morning, already running
+  CHECK_EQ(30, CTimerManager::_nextStart);
+  CHECK_EQ(4, CTimerManager::findNextTimer(1, 0, 0));      // then on to Saturday night
+  CHECK_EQ(weekMinute(6, 23, 0), CTimerManager::_nextStart);
+}
+
+TEST(overlap_conflicts)
+{
+  setup();
+  clearTimers();
+  setTimer(0, 8, 0, 10, 0, 0x02, true);        // Monday morning
+  setTimer(1, 23, 0, 1, 0, 0x40, true);        // Saturday night, into Sunday
+  CTimerManager::createMap();
+
+  sTimer timer;
+  timer.init(2);
+  timer.start.hour = 9;  timer.stop.hour = 11;
+  timer.enabled = 0x02;  timer.repeat = true;
+  CHECK_EQ(1, CTimerManager::conflictTest(timer));
+  timer.start.hour = 10;                       // abutting is no conflict
+  CHECK_EQ(0, CTimerManager::conflictTest(timer));
+  timer.enabled = 0x01;  timer.start.hour = 0; timer.start.min = 30; timer.stop.hour = 2;
+  CHECK_EQ(2, CTimerManager::conflictTest(timer));     // Sunday morning, the split tail
+  timer.start.min = 0; timer.start.hour = 1;
+  CHECK_EQ(0, CTimerManager::conflictTest(timer));
+  // overlapping timers painted later win, as the week map did
+  setTimer(2, 9, 0, 9, 30, 0x02, false);
+  CTimerManager::createMap();
+  CHECK_EQ(3, CTimerManager::_getTimerAt(weekMinute(1, 9, 0)));
+  CHECK_EQ(1 | CTimerManager::_repeatFlag, CTimerManager::_getTimerAt(weekMinute(1, 9, 30)));
+  CHECK_EQ(5, (int)CTimerManager::_intervals.size());
+}
+
+TEST(cost_against_week_map)
+{
+  setup();
+  clearTimers();
+  for(int i = 0; i < 14; i++)
+    setTimer(i, i, 10, i, 50, 0x7f, true);
+
+  const int reps = 100;
+  double t0 = hostNow_us();
+  for(int i = 0; i < reps; i++)
+    COldTimerManager::createMap();
+  double t1 = hostNow_us();
+  for(int i = 0; i < reps; i++)
+    CTimerManager::createMap();
+  double t2 = hostNow_us();
+  volatile int sum = 0;
+  for(int m = 0; m < CTimerManager::_weekMinutes; m++)
+    sum += COldTimerManager::findNextTimer((m / 60) % 24, m % 60, m / 1440);
+  double t3 = hostNow_us();
+  for(int m = 0; m < CTimerManager::_weekMinutes; m++)
+    sum += CTimerManager::findNextTimer((m / 60) % 24, m % 60, m / 1440);
+  double t4 = hostNow_us();
+
+  REPORT("createMap:     week map %8.1fus  intervals %8.1fus", (t1 - t0) / reps, (t2 - t1) / reps);
+  REPORT("findNextTimer: week map %8.3fus  intervals %8.3fus", (t3 - t2) / CTimerManager::_weekMinutes, (t4 - t3) / CTimerManager::_weekMinutes);
+  // week map: static map plus createMap()'s two day long working arrays on the stack
+  REPORT("RAM, 14 daily timers: week map %d bytes (+%d stack)  intervals %d bytes", 
+         int(sizeof(COldTimerManager::_weekMap)), int(2 * 1440 * sizeof(uint16_t)), 
+         int(CTimerManager::_intervals.capacity() * sizeof(sTimerInterval)));
+  CHECK_EQ(98, (int)CTimerManager::_intervals.size());
+}
+
+// manageTime() runs every minute, its cost should not grow with the timers defined
+TEST(manage_time_scaling)
+{
+  setup();
+  Clock.set(DateTime(2020, 1, 5, 0, 0, 0));    // Sunday
+  for(int n : { 14, 32, 64 }) {
+    clearTimers();
+    for(int i = 0; i < n; i++)
+      setTimer(i, (i / 7) * 2, 5, (i / 7) * 2 + 1, 0, 0x01 << (i % 7), true);
+    CTimerManager::createMap();
+    FakeHeater.reset();
+    FakeHeater.runState = 1;        // running, no restart attempts
+
+    double elapsed = 0;
+    for(int m = 0; m < CTimerManager::_weekMinutes; m++) {
+      hostAdvanceTicks(60000);
+      Clock.update();
+      double t0 = hostNow_us();
+      CTimerManager::manageTime(0, 0, 0);
+      elapsed += hostNow_us() - t0;
+    }
+    REPORT("%2d timers: %3d intervals (%4d bytes held), manageTime %.3fus per minute", n, 
+           (int)CTimerManager::_intervals.size(), 
+           int(CTimerManager::_intervals.capacity() * sizeof(sTimerInterval)),
+           elapsed / CTimerManager::_weekMinutes);
+    CHECK_EQ(n, (int)CTimerManager::_intervals.size());
+    CHECK_EQ(n, FakeHeater.onRequests);
+    CHECK_EQ(n, FakeHeater.offRequests);
+  }
+}
+
+// changed timers are offered to the JSON clients ahead of the round robin
+TEST(changed_timers_first)
+{
+  setup();
+  clearTimers();
+  Clock.set(DateTime(2020, 1, 5, 0, 0, 0));
+  CTimerManager::createMap();
+  TimerModerator.reset();
+  CHECK_EQ(-1, TimerModerator.nextPending());
+
+  sTimer timer;
+  timer.init(40);
+  timer.start.hour = 6;  timer.stop.hour = 7;
+  timer.enabled = 0x02;  timer.repeat = true;
+  CHECK_EQ(1, CTimerManager::setTimer(timer));
+  timer.init(5);
+  timer.start.hour = 8;  timer.stop.hour = 9;
+  timer.enabled = 0x02;
+  CHECK_EQ(1, CTimerManager::setTimer(timer));
+
+  StaticJsonBuffer<400> jsonBuffer;
+  JsonObject& root = jsonBuffer.createObject();
+  CHECK_EQ(5, TimerModerator.nextPending());
+  NVstore.getTimerInfo(5, timer);
+  CHECK(TimerModerator.addJson(5, timer, root));
+  CHECK_EQ(40, TimerModerator.nextPending());
+  NVstore.getTimerInfo(40, timer);
+  CHECK(TimerModerator.addJson(40, timer, root));
+  CHECK_EQ(-1, TimerModerator.nextPending());
+}
+
+// the timers in use are noted as the map is built, the timer screen steps by them
+// and rebuilds keep the interval list's storage
+TEST(in_use_and_capacity)
+{
+  setup();
+  clearTimers();
+  const int used[] = { 0, 1, 2, 5, 40, MAX_TIMERS-1 };
+  for(int i = 0; i < 6; i++) 
+    setTimer(used[i], 6, 0, 7, 0, 0x01 << i, false);
+  CTimerManager::createMap();
+  for(int ID = 0; ID < MAX_TIMERS; ID++) {
+    sTimer timer;
+    NVstore.getTimerInfo(ID, timer);
+    CHECK_EQ(!timer.isBlank(), CTimerManager::isTimerInUse(ID));
+  }
+  CHECK_EQ(3, CTimerManager::getFirstBlank());
+  CHECK(!CTimerManager::isTimerInUse(-1));
+  CHECK(!CTimerManager::isTimerInUse(MAX_TIMERS));
+
+  const sTimerInterval* pData = CTimerManager::_intervals.data();
+  size_t capacity = CTimerManager::_intervals.capacity();
+  CHECK_EQ(size_t(6), CTimerManager::_intervals.size());
+  CHECK(capacity >= 6);
+  CTimerManager::createMap();
+  CHECK(pData == CTimerManager::_intervals.data());
+  CHECK_EQ(capacity, CTimerManager::_intervals.capacity());
+
+  for(int ID = 0; ID < MAX_TIMERS; ID++) 
+    setTimer(ID, 6, 0, 7, 0, 0, false);   // none blank, none enabled
+  CTimerManager::createMap();
+  CHECK_EQ(-1, CTimerManager::getFirstBlank());
+  CHECK_EQ(size_t(0), CTimerManager::_intervals.size());
+}
+
+// the first load after an upgrade moves the legacy timers into the table, 
+// and clears their namespaces once it is saved
+TEST(legacy_namespaces_cleared)
+{
+  setup();
+  Preferences prefs;
+  prefs.begin("timers", false);
+  prefs.clear();
+  prefs.end();
+  for(int i = 0; i < LEGACY_TIMERS; i++) {
+    sTimer legacy;
+    legacy.init(i);
+    legacy.start.hour = i;
+    legacy.stop.hour = i + 1;
+    legacy.enabled = 0x01 << (i % 7);
+    legacy.save();
+  }
+
+  sTimerTable table;
+  table.load();
+  for(int i = 0; i < LEGACY_TIMERS; i++) {
+    sTimer timer;
+    timer.unpack(table.timer[i], i);
+    CHECK_EQ(i, timer.start.hour);
+    CHECK_EQ(0x01 << (i % 7), timer.enabled);
+    char SectionName[16];
+    sprintf(SectionName, "timer%d", i+1);
+    prefs.begin(SectionName, true);
+    CHECK_EQ(0xee, prefs.getUChar("enabled", 0xee));
+    prefs.end();
+  }
+  prefs.begin("timers", true);
+  CHECK_EQ(sizeof(table.timer), prefs.getBytesLength("table"));
+  prefs.end();
+
+  // and reloads from the table
+  sTimerTable reload;
+  reload.load();
+  CHECK(memcmp(table.timer, reload.timer, sizeof(table.timer)) == 0);
+}
@@ -0,0 +1,288 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// 433MHz remote decoding
+//
+// Fob transmissions are synthesised for every protocol table entry across
+// its T range: sync then code word, repeated, with a receiver that
+// stretches highs and +-8% jitter on every edge. They are cut into RMT
+// frames as the receiver would be configured, a frame ends after a low of
+// more than the idle threshold, and one RMT memory block holds 64 items,
+// the rest of a longer frame is lost. Random noise frames must yield no
+// code words. The receive task is then run end to end.
+// Fobs paired with the original decoder (oracle/UHFdecode_old) must still
+// yield the codes held in NV.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <random>
+#include <vector>
+#include "HostTest.h"
+#include "cfg/BTCConfig.h"
+#include "cfg/pins.h"
+#define protected public
+#include "Protocol/433MHz.h"
+#undef protected
+#include "Utility/NVStorage.h"
+#include "oracle/UHFdecode_old.h"
+
+static const int IdleThreshold = 6000;    // us, as begin() configures the RMT
+static const int RMTblockItems = 64;
+static const int Repeats = 4;
+
+struct sPulse {
+  int high, low;     // us
+};
+
+typedef std::vector<rmt_item32_t> tFrame;
+
+static std::mt19937 Rand(40);
+
+// sync then code word, repeated, then idle
+static std::vector<sPulse>
+transmit(const s433MHzProtocol& proto, unsigned long code, int T, int stretch, float jitter)
+{
+  std::uniform_real_distribution<float> spread(-jitter, jitter);
+  std::vector<sPulse> pulses;
+  for(int r = 0; r < Repeats; r++) {
+    pulses.push_back({ T * proto.sync.high, T * proto.sync.low });
+    for(int bit = proto.bits - 1; bit >= 0; bit--) {
+      if(code & (1ul << bit))
+        pulses.push_back({ T * proto.one.high, T * proto.one.low });
+      else
+        pulses.push_back({ T * proto.zero.high, T * proto.zero.low });
+    }
+  }
+  for(sPulse& pulse : pulses) {
+    pulse.high = int(pulse.high * (1 + spread(Rand))) + stretch;
+    pulse.low = int(pulse.low * (1 + spread(Rand))) - stretch;
+  }
+  pulses.back().low = 0x7fffffff;
+  return pulses;
+}
+
+// cut into RMT frames at each idle, losing the end of over long frames
+static std::vector<tFrame>
+receive(const std::vector<sPulse>& pulses)
+{
+  std::vector<tFrame> frames;
+  tFrame frame;
+  bool overflow = false;
+  for(const sPulse& pulse : pulses) {
+    bool idle = pulse.low > IdleThreshold;
+    if(!overflow) {
+      rmt_item32_t item;
+      item.val = 0;
+      item.level0 = 1;
+      item.duration0 = pulse.high;
+      item.level1 = 0;
+      item.duration1 = idle ? 0 : pulse.low;
+      frame.push_back(item);
+      overflow = frame.size() == RMTblockItems;
+    }
+    if(idle || frame.size() == RMTblockItems) {
+      if(frame.size())
+        frames.push_back(frame);
+      frame.clear();
+    }
+    if(idle)
+      overflow = false;
+  }
+  return frames;
+}
+
+struct sDecoded {
+  int words;
+  bool correct;
+};
+
+static sDecoded
+decode(const std::vector<tFrame>& frames, unsigned long code)
+{
+  C433MHzRemote& uhf = UHFremote;
+  uhf._candidate = 0;
+  uhf._repeats = 0;
+  uhf._prevCode = 0;
+  uint32_t before = uhf._stats.words;
+  for(const tFrame& frame : frames) 
+    uhf._decodeRxItems(frame.data(), frame.size());
+  sDecoded result;
+  result.words = uhf._stats.words - before;
+  // any other word in the sequence restarts the repeat count
+  result.correct = result.words == 0 || (uhf._candidate == code && uhf._repeats == result.words);
+  return result;
+}
+
+TEST(all_protocols_decode)
+{
+  UHFremote.resetStats();
+  std::uniform_int_distribution<unsigned long> codes(0, 0xffffff);
+  const int stretches[] = { 0, 30, 60 };
+  int total = 0, totalWrong = 0;
+  double totalTime = 0;
+  int totalFrames = 0;
+  for(int p = 0; p < C433MHzRemote::getProtocolCount(); p++) {
+    const s433MHzProtocol& proto = C433MHzRemote::getProtocol(p);
+    int sent = 0, accepted = 0, wrong = 0, words = 0;
+    // a fob right at a bound of the T range is as likely to estimate outside it
+    for(int T = proto.minT + 10; T <= proto.maxT - 10; T += 10) {
+      for(int stretch : stretches) {
+        for(int i = 0; i < 5; i++) {
+          unsigned long code = codes(Rand);
+          std::vector<tFrame> frames = receive(transmit(proto, code, T, std::min(stretch, T/2), 0.08));
+          double tStart = hostNow_us();
+          sDecoded result = decode(frames, code);
+          totalTime += hostNow_us() - tStart;
+          totalFrames += frames.size();
+          sent++;
+          words += result.words;
+          accepted += result.words >= UHF_MIN_REPEATS;
+          wrong += !result.correct;
+        }
+      }
+    }
+    CHECK_EQ(sent, accepted);
+    CHECK_EQ(0, wrong);
+    REPORT("%-14s T %3d-%3dus: %4d transmissions, %4d accepted, %5d code words, %d wrong", 
+           proto.name, proto.minT + 10, proto.maxT - 10, sent, accepted, words, wrong);
+    total += sent;
+    totalWrong += wrong;
+  }
+  REPORT("%d transmissions in %d RMT frames, %d wrong codes, %.2fus per frame", 
+         total, totalFrames, totalWrong, totalTime / totalFrames);
+}
+
+TEST(noise_rejected)
+{
+  UHFremote.resetStats();
+  std::uniform_int_distribution<int> length(1, RMTblockItems);
+  std::uniform_int_distribution<int> duration(30, IdleThreshold);
+  const int count = 10000;
+  for(int i = 0; i < count; i++) {
+    tFrame frame(length(Rand));
+    for(rmt_item32_t& item : frame) {
+      item.val = 0;
+      item.level0 = 1;
+      item.duration0 = duration(Rand);
+      item.level1 = 0;
+      item.duration1 = duration(Rand);
+    }
+    frame.back().duration1 = 0;
+    CHECK(!UHFremote._decodeRxItems(frame.data(), frame.size()));
+  }
+  const s433MHzStats& stats = UHFremote.getStats();
+  CHECK_EQ(count, stats.frames);
+  CHECK_EQ(count, stats.rejected);
+  CHECK_EQ(0, stats.words);
+  REPORT("%d noise frames, %d code words", count, stats.words);
+}
+
+// a single code word is not a key press
+TEST(repeats_required)
+{
+  const s433MHzProtocol& proto = C433MHzRemote::getProtocol(0);
+  std::vector<tFrame> frames = receive(transmit(proto, 0x123458, 350, 0, 0));
+  std::vector<tFrame> one;
+  for(const tFrame& frame : frames) {
+    one.push_back(frame);
+    if(frame.size() >= proto.bits)
+      break;
+  }
+  UHFremote.resetStats();
+  sDecoded result = decode(one, 0x123458);
+  CHECK_EQ(1, result.words);
+  CHECK_EQ(0, UHFremote.getStats().accepted);
+  result = decode(frames, 0x123458);
+  CHECK_EQ(1, UHFremote.getStats().accepted);
+}
+
+// codes as paired with the original decoder: 24 bits from a 25 transition
+// frame, the first 23 from a 32 transition frame
+TEST(paired_codes_unchanged)
+{
+  std::uniform_int_distribution<unsigned long> codes(0, 0x7fffffff);
+  int checked[2] = { 0, 0 }, missed[2] = { 0, 0 }, differ[2] = { 0, 0 };
+  for(int legacy = 0; legacy < 2; legacy++) {
+    s433MHzProtocol proto = C433MHzRemote::getProtocol(0);
+    if(legacy)
+      proto.bits = 31;      // the sync high follows, 32 transitions
+    for(int T = proto.minT + 10; T <= proto.maxT - 10; T += 10) {
+      for(int i = 0; i < 20; i++) {
+        unsigned long code = codes(Rand) & ((1ul << proto.bits) - 1);
+        std::vector<tFrame> frames = receive(transmit(proto, code, T, 30, 0.08));
+        for(const tFrame& frame : frames) {
+          unsigned long paired;
+          if(!oldDecode433MHz(frame.data(), frame.size(), paired))
+            continue;
+          CHECK_EQ(legacy ? 32u : 25u, frame.size());
+          UHFremote._candidate = 0;
+          checked[legacy]++;
+          if(!UHFremote._decodeRxItems(frame.data(), frame.size()))
+            missed[legacy]++;   // the original decoder's bit time window is wider
+          else
+            differ[legacy] += paired != UHFremote._candidate;
+        }
+      }
+    }
+    CHECK(checked[legacy] > 0);
+    CHECK_EQ(0, differ[legacy]);
+    CHECK(missed[legacy] * 100 < checked[legacy]);
+  }
+  REPORT("25 transition frames: %d paired codes, %d not decoded, %d differ", checked[0], missed[0], differ[0]);
+  REPORT("32 transition frames: %d paired codes, %d not decoded, %d differ", checked[1], missed[1], differ[1]);
+}
+
+// the task sleeps on the ring buffer, queues the press and later its release
+TEST(receive_task)
+{
+  hostSimTicks(false);
+  NVstore.init();
+  UHFremote.begin(Rx433MHz_pin, RMT_CHANNEL_4);
+  UHFremote.resetStats();
+  delay(10);
+  CHECK(UHFremote.getTaskHandle() != NULL);
+
+  std::vector<tFrame> frames = receive(transmit(C433MHzRemote::getProtocol(0), 0xa5a5a1, 350, 30, 0.08));
+  unsigned long tSent = millis();
+  for(const tFrame& frame : frames)
+    CHECK(hostRMTReceive(RMT_CHANNEL_4, frame.data(), frame.size()));
+  unsigned long code = 0;
+  while(!UHFremote.read(code) && millis() - tSent < 100)
+    delay(1);
+  CHECK_EQ(0xa5a5a1ul, code);
+  unsigned long tPress = millis() - tSent;
+  // the release follows 100 ticks after the last word
+  while(!UHFremote.read(code) && millis() - tSent < 500)
+    delay(1);
+  unsigned long tRelease = millis() - tSent;
+  CHECK_EQ(0ul, code);
+  CHECK(tRelease >= 100 && tRelease < 150);
+  CHECK_EQ(1, UHFremote.getStats().accepted);
+  REPORT("press after %lums, release after %lums", tPress, tRelease);
+
+  UHFremote.end();
+  CHECK_EQ(0, UHFremote._runState);
+}
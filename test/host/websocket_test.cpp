@@ -0,0 +1,177 @@
+/*
+ * This file is part of the "bluetoothheater" distribution
+ * (https://gitlab.com/mrjones.id.au/bluetoothheater)
+ *
+ * Copyright (C) 2018  Ray Jones <ray@mrjones.id.au>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Websocket transmit queues, one per web server
+//
+// sendWebSocketString() is called by loop() with each JSON delta, the
+// server tasks drain their own queue. Here the queues are set up as
+// initWebServer() does, each server's clients are added and removed as
+// JSONHandler does, and the queues are drained as processWebsocketQueue()
+// does. Messages must only be copied to servers with a client, oversized
+// messages and full rings must be counted as dropped.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <string>
+#include "HostTest.h"
+#include "WiFi/WebSocketQueue.h"
+#include "cfg/BTCConfig.h"
+
+static sWebServerStats Stats[eNumWebServers];
+static const int RingSizes[eNumWebServers] = { WEB_TX_RING_SIZE, WEB_TX_RING_SMALL, WEB_TX_RING_SMALL };
+
+// as initWebServer(), then every queue empty with no clients
+static void
+setup()
+{
+  static bool begun = false;
+  hostSimTicks(true);
+  for(int i = 0; i < eNumWebServers; i++) {
+    if(!begun)
+      WebSocketQueues[i].begin(RingSizes[i], Stats[i]);
+    while(WebSocketQueues[i].getClients())
+      WebSocketQueues[i].removeClient();
+    uint32_t tQueued;
+    const char* msg;
+    while((msg = WebSocketQueues[i].get(tQueued)) != NULL)
+      WebSocketQueues[i].release(msg);
+    memset(&Stats[i], 0, sizeof(Stats[i]));
+  }
+  begun = true;
+}
+
+static std::string
+makeDelta(int seq, int len)
+{
+  std::string msg = "{\"seq\":" + std::to_string(seq) + ",\"pad\":\"";
+  while((int)msg.size() < len - 2)
+    msg += 'x';
+  return msg + "\"}";
+}
+
+// drains a server's queue, returns the messages taken
+static int
+drain(int server, std::string* last = NULL)
+{
+  int count = 0;
+  uint32_t tQueued;
+  const char* msg;
+  while((msg = WebSocketQueues[server].get(tQueued)) != NULL) {
+    if(last)
+      *last = msg;
+    WebSocketQueues[server].release(msg);
+    count++;
+  }
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+// nobody connected - nothing is copied, nothing is counted
+TEST(no_clients_nothing_queued)
+{
+  setup();
+  CHECK(!sendWebSocketString(makeDelta(1, 100).c_str()));
+  for(int i = 0; i < eNumWebServers; i++) {
+    CHECK_EQ(0, drain(i));
+    CHECK_EQ(0, Stats[i].wsDropped);
+  }
+}
+
+// only the servers with a websocket client are given a copy
+TEST(only_servers_with_clients)
+{
+  setup();
+  WebSocketQueues[eWebSocketServer].addClient();
+  WebSocketQueues[eWebSocketServer].addClient();
+  for(int seq = 0; seq < 10; seq++)
+    CHECK(sendWebSocketString(makeDelta(seq, 100).c_str()));
+  std::string last;
+  CHECK_EQ(10, drain(eWebSocketServer, &last));
+  CHECK_STREQ(makeDelta(9, 100).c_str(), last.c_str());
+  CHECK_EQ(0, drain(eHTTPServer));
+  CHECK_EQ(0, drain(eHTTPSServer));
+
+  // a wss client on port 443 joins, then the port 81 clients leave
+  WebSocketQueues[eHTTPSServer].addClient();
+  CHECK(sendWebSocketString(makeDelta(10, 100).c_str()));
+  WebSocketQueues[eWebSocketServer].removeClient();
+  WebSocketQueues[eWebSocketServer].removeClient();
+  CHECK(sendWebSocketString(makeDelta(11, 100).c_str()));
+  CHECK_EQ(1, drain(eWebSocketServer));
+  CHECK_EQ(0, drain(eHTTPServer));
+  CHECK_EQ(2, drain(eHTTPSServer, &last));
+  CHECK_STREQ(makeDelta(11, 100).c_str(), last.c_str());
+  for(int i = 0; i < eNumWebServers; i++)
+    CHECK_EQ(0, Stats[i].wsDropped);
+}
+
+// a message beyond WEB_TX_MAXMSG is dropped, and counted, by each server with a client
+TEST(oversized_counted_as_dropped)
+{
+  setup();
+  WebSocketQueues[eWebSocketServer].addClient();
+  WebSocketQueues[eHTTPServer].addClient();
+  CHECK(sendWebSocketString(makeDelta(1, WEB_TX_MAXMSG - 1).c_str()));    // largest, with its terminator
+  CHECK(!sendWebSocketString(makeDelta(2, WEB_TX_MAXMSG).c_str()));
+  CHECK_EQ(1, Stats[eWebSocketServer].wsDropped);
+  CHECK_EQ(1, Stats[eHTTPServer].wsDropped);
+  CHECK_EQ(0, Stats[eHTTPSServer].wsDropped);
+  CHECK_EQ(1, drain(eWebSocketServer));
+  CHECK_EQ(1, drain(eHTTPServer));
+}
+
+// each ring holds what its server needs, a full ring drops and counts
+TEST(ring_sizes_per_server)
+{
+  setup();
+  const int MsgLen = 200;
+  int held[eNumWebServers];
+  for(int i = 0; i < eNumWebServers; i++) {
+    WebSocketQueues[i].addClient();
+    int seq = 0;
+    while(Stats[i].wsDropped == 0)
+      sendWebSocketString(makeDelta(seq++, MsgLen).c_str());
+    held[i] = drain(i);
+    CHECK_EQ(seq - 1, held[i]);
+    WebSocketQueues[i].removeClient();
+    REPORT("%-7s ring %4d bytes: %2d messages of %d bytes held", 
+           i == eWebSocketServer ? "ws:81" : i == eHTTPServer ? "ws:80" : "wss:443", RingSizes[i], held[i], MsgLen);
+  }
+  CHECK(held[eWebSocketServer] > held[eHTTPServer]);
+  CHECK_EQ(held[eHTTPServer], held[eHTTPSServer]);
+  // each holds at least two of the largest messages
+  for(int i = 0; i < eNumWebServers; i++) {
+    WebSocketQueues[i].addClient();
+    CHECK(sendWebSocketString(makeDelta(1, WEB_TX_MAXMSG - 1).c_str()));
+    CHECK(sendWebSocketString(makeDelta(2, WEB_TX_MAXMSG - 1).c_str()));
+    CHECK_EQ(2, drain(i));
+    WebSocketQueues[i].removeClient();
+  }
+  REPORT("ring memory %d bytes, was %d with %d bytes per server", 
+         WEB_TX_RING_SIZE + 2 * WEB_TX_RING_SMALL, 3 * WEB_TX_RING_SIZE, WEB_TX_RING_SIZE);
+}